@@ -30,6 +30,9 @@
 #endif
 
 #define FILEXIO_IRX	0xb0b0b00
+/** Async workers use the RPC IDs FILEXIO_ASYNC_IRX to FILEXIO_ASYNC_IRX + FILEXIO_ASYNC_WORKERS - 1. */
+#define FILEXIO_ASYNC_IRX	0xb0b0b10
+#define FILEXIO_ASYNC_WORKERS	4
 enum FILEXIO_CMDS{
 	FILEXIO_DOPEN	= 0x01,
 	FILEXIO_DREAD,
@@ -265,6 +268,7 @@ struct fxio_lseek64_return_pkt {
 
 struct fxio_rwbuff{
 	int size;
+	int count;	// Number of buffers that size is divided into, 0 to keep the current count.
 };
 
 #endif /* __FILEXIO_H__ */
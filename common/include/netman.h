@@ -46,6 +46,20 @@ struct NetManEthStatus{
 	struct NetManEthRuntimeStats stats;
 };
 
+/** Statistics of the IOP -> EE frame path. Frames are sent to the EE in batches. */
+struct NetManRxBatchStats{
+	u32 FrameCount;
+	u32 BatchCount;
+	/** SIF DMA tags used for the batches. */
+	u32 TagCount;
+	/** Batches that were held back while the previous batch was still being transferred. */
+	u32 GroupedBatchCount;
+	u32 MaxBatchFrames;
+	/** Total time that the frames were held back for grouping, in microseconds. */
+	u32 GroupingLatency;
+	u32 MaxGroupingLatency;
+};
+
 /** Flow-control */
 #define NETMAN_NETIF_ETH_LINK_DISABLE_PAUSE	0x40
 
@@ -96,6 +110,10 @@ enum NETMAN_NETIF_IOCTL_CODES{
 	NETMAN_NETIF_IOCTL_GET_LINK_STATUS	= 0x3000,
 	NETMAN_NETIF_IOCTL_GET_TX_DROPPED_COUNT,
 	NETMAN_NETIF_IOCTL_GET_RX_DROPPED_COUNT,
+
+	// NETMAN IOCTL codes, handled by NETMAN itself.
+	/** Output = struct NetManRxBatchStats. */
+	NETMAN_IOCTL_GET_RX_BATCH_STATS	= 0x4000,
 };
 
 //*** Higher-level services, for the running user program ***
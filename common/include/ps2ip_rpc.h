@@ -42,6 +42,7 @@ enum PS2IPS_RPC_ID{
 	PS2IPS_ID_DNS_SETSERVER,
 	PS2IPS_ID_DNS_GETSERVER,
 #endif
+	PS2IPS_ID_GETSTATS,
 
 	PS2IPS_ID_COUNT
 };
@@ -26,6 +26,7 @@
 #define SMB_DEVCTL_CLOSESHARE		0xC0DE0006
 #define SMB_DEVCTL_ECHO			0xC0DE0007
 #define SMB_DEVCTL_QUERYDISKINFO	0xC0DE0008
+#define SMB_DEVCTL_GETREADSTATS		0xC0DE0009
 
 // helpers for DEVCTL commands
 
@@ -69,6 +70,17 @@ typedef struct {		// size = 16
 	int FreeUnits;
 } smbQueryDiskInfo_out_t;
 
+typedef struct {		// size = 32
+	u32 ReadCalls;		// read() calls
+	u32 ReadBytes;		// bytes returned by read()
+	u32 ReadAheadHits;	// read() calls served from the read-ahead window
+	u32 ReadTime;		// time spent in read(), in milliseconds
+	u32 ReadRequests;	// ReadAndX requests sent
+	u32 RequestBytes;	// bytes received with ReadAndX
+	u32 MaxOutstanding;	// most ReadAndX requests in flight at once
+	u32 reserved;
+} smbReadStats_out_t;
+
 typedef struct {		// size = 512
 	char ShareName[256];
 	char ShareComment[256];
@@ -0,0 +1,189 @@
+/**
+ * @file
+ * Batched SIF RPC calls, shared by the EE and the IOP.
+ * Several calls to the same server are packed into one request and sent with a
+ * single SifCallRpc(). The server unpacks them with SifRpcBatchDispatch() and
+ * returns all of their results in one transfer.
+ *
+ * Request layout, every part 16-byte aligned:
+ *   SifRpcBatchHeader_t
+ *   SifRpcBatchEntry_t, followed by ssize bytes of send data (repeated count times)
+ * The reply holds the result of each call at its entry's roffset.
+ */
+
+#ifndef __SIFRPC_BATCH_H__
+#define __SIFRPC_BATCH_H__
+
+#include <tamtypes.h>
+#include <sifrpc.h>
+
+/** Function number of a batch, must not be used by the server for anything else */
+#define SIF_RPC_BATCH	0x7fffff00
+
+#define SIF_RPC_BATCH_ALIGN(x)	(((x) + 15) & ~15)
+
+typedef struct {
+	/** Calls in the batch */
+	u32 count;
+	/** Size of the request, including this header */
+	u32 size;
+	/** Size of the reply */
+	u32 rsize;
+	u32 reserved;
+} SifRpcBatchHeader_t;
+
+typedef struct {
+	s32 rpc_number;
+	u32 ssize;
+	u32 rsize;
+	/** Offset of the result in the reply */
+	u32 roffset;
+} SifRpcBatchEntry_t;
+
+typedef struct {
+	u8 *buff;
+	int size;
+} SifRpcBatch_t;
+
+/** Starts an empty batch in buff, which must be 64-byte aligned and hold size bytes. */
+static inline void SifRpcBatchInit(SifRpcBatch_t *batch, void *buff, int size)
+{
+	SifRpcBatchHeader_t *header = (SifRpcBatchHeader_t *)buff;
+
+	batch->buff = (u8 *)buff;
+	batch->size = size;
+
+	header->count = 0;
+	header->size = sizeof(SifRpcBatchHeader_t);
+	header->rsize = 0;
+	header->reserved = 0;
+}
+
+/**
+ * Adds a call with ssize bytes of send data and rsize bytes of result to the batch.
+ * The send data is copied if send is not NULL, otherwise it can be filled in through *data.
+ * @return the offset of the result in the receive buffer, or -1 if the batch is full.
+ */
+static inline int SifRpcBatchAdd(SifRpcBatch_t *batch, int rpc_number, const void *send, int ssize, int rsize, void **data)
+{
+	SifRpcBatchHeader_t *header = (SifRpcBatchHeader_t *)batch->buff;
+	SifRpcBatchEntry_t *entry;
+	const u8 *src = (const u8 *)send;
+	u8 *dst;
+	int roffset, i;
+
+	if (header->size + sizeof(SifRpcBatchEntry_t) + SIF_RPC_BATCH_ALIGN(ssize) > (u32)batch->size)
+		return -1;
+
+	entry = (SifRpcBatchEntry_t *)(batch->buff + header->size);
+	dst = (u8 *)(entry + 1);
+
+	roffset = header->rsize;
+
+	entry->rpc_number = rpc_number;
+	entry->ssize = ssize;
+	entry->rsize = rsize;
+	entry->roffset = roffset;
+
+	if (src != NULL) {
+		for (i = 0; i < ssize; i++)
+			dst[i] = src[i];
+	}
+
+	if (data != NULL)
+		*data = dst;
+
+	header->count++;
+	header->size += sizeof(SifRpcBatchEntry_t) + SIF_RPC_BATCH_ALIGN(ssize);
+	header->rsize += SIF_RPC_BATCH_ALIGN(rsize);
+
+	return roffset;
+}
+
+/** Returns the number of calls in the batch. */
+static inline int SifRpcBatchCount(SifRpcBatch_t *batch)
+{
+	return ((SifRpcBatchHeader_t *)batch->buff)->count;
+}
+
+/**
+ * Sends the batch to the server bound to client. recvbuf must hold the reply, whose size is
+ * the sum of the calls' rsize rounded up to 16 bytes each. The mode and end function are the
+ * same as for SifCallRpc(). The batch has to be started again with SifRpcBatchInit() to reuse it.
+ */
+static inline int SifCallRpcBatch(SifRpcClientData_t *client, int mode, SifRpcBatch_t *batch, void *recvbuf, SifRpcEndFunc_t end_function, void *end_param)
+{
+	SifRpcBatchHeader_t *header = (SifRpcBatchHeader_t *)batch->buff;
+
+	return SifCallRpc(client, SIF_RPC_BATCH, mode, batch->buff, header->size, recvbuf, header->rsize, end_function, end_param);
+}
+
+/**
+ * Server side: runs the calls of a batch received in buff through func, in order, as if they
+ * had been made separately. size is the size of the request that was received and buff_size the
+ * size of the server's receive buffer: the reply is built after the request, so the buffer must
+ * hold both, or the batch is rejected. Returns the reply, to be returned by the server function.
+ * Dispatching stops at the first malformed entry, and buff is returned instead. Nested batches
+ * are skipped.
+ *
+ * func gets each call's send data in place, in the request. It may also return its result there,
+ * but only if the result is not larger than the send data: the bytes after it belong to the next
+ * call. A call whose result was returned in place and is larger is treated as malformed. Larger
+ * results must be returned from a buffer of the server's own.
+ */
+static inline void *SifRpcBatchDispatch(SifRpcFunc_t func, void *buff, int size, int buff_size)
+{
+	SifRpcBatchHeader_t *header = (SifRpcBatchHeader_t *)buff;
+	SifRpcBatchEntry_t *entry;
+	u8 *reply, *data, *src;
+	u32 offset, remaining, reply_offset, i, j;
+
+	if (size < (int)sizeof(SifRpcBatchHeader_t) || buff_size < size)
+		return buff;
+
+	if (header->size < sizeof(SifRpcBatchHeader_t) || header->size > (u32)size)
+		return buff;
+
+	// The reply must fit in the receive buffer, after the request.
+	reply_offset = SIF_RPC_BATCH_ALIGN(header->size);
+	if (reply_offset > (u32)buff_size || header->rsize > (u32)buff_size - reply_offset)
+		return buff;
+
+	reply = (u8 *)buff + reply_offset;
+	offset = sizeof(SifRpcBatchHeader_t);
+
+	for (i = 0; i < header->count; i++) {
+		entry = (SifRpcBatchEntry_t *)((u8 *)buff + offset);
+		data = (u8 *)(entry + 1);
+		remaining = header->size - offset;
+
+		// Compare against the space that is left, so that nothing can wrap around.
+		if (remaining < sizeof(SifRpcBatchEntry_t) ||
+		    entry->ssize > remaining - sizeof(SifRpcBatchEntry_t) ||
+		    SIF_RPC_BATCH_ALIGN(entry->ssize) > remaining - sizeof(SifRpcBatchEntry_t) ||
+		    entry->rsize > header->rsize ||
+		    entry->roffset > header->rsize - entry->rsize)
+			return buff;
+
+		offset += sizeof(SifRpcBatchEntry_t) + SIF_RPC_BATCH_ALIGN(entry->ssize);
+
+		if (entry->rpc_number == SIF_RPC_BATCH)
+			continue;
+
+		src = (u8 *)func(entry->rpc_number, data, entry->ssize);
+
+		if (src != NULL) {
+			// A result in the request may not run into the next call.
+			if (src >= data && src < (u8 *)buff + header->size &&
+			    entry->rsize > (u32)(data + SIF_RPC_BATCH_ALIGN(entry->ssize) - src))
+				return buff;
+
+			for (j = 0; j < entry->rsize; j++)
+				reply[entry->roffset + j] = src[j];
+		}
+	}
+
+	return reply;
+}
+
+#endif /* __SIFRPC_BATCH_H__ */
@@ -1758,4 +1758,17 @@ typedef struct
 	u8			hw_addr[8];
 } t_ip_info;
 
+/** Data path statistics of the ps2ips RPC server, since the last time that they were retrieved ***/
+typedef struct
+{
+	u32			recv_rpcs;
+	u32			recv_bytes;
+	/** recv() calls made on lwIP, several per RPC for stream sockets */
+	u32			recv_chunks;
+	u32			send_rpcs;
+	u32			send_bytes;
+	/** send() calls made on lwIP */
+	u32			send_chunks;
+} t_ps2ips_stats;
+
 #endif /* __TCPIP_H__ */
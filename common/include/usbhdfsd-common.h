@@ -30,6 +30,26 @@
 #define USBMASS_DEVCTL_STOP_UNIT	0x0000
 /** Issues the SCSI STOP UNIT command too all devices. Use this to shut down devices properly. */
 #define USBMASS_DEVCTL_STOP_ALL		0x0001
+/** Returns the sector cache statistics of the specified device. Output buffer -> struct usbmass_cache_stats. */
+#define USBMASS_DEVCTL_GET_CACHE_STATS	0x0002
+/** Resets the sector cache statistics of the specified device. */
+#define USBMASS_DEVCTL_RESET_CACHE_STATS	0x0003
+/** Changes the number of sector cache slots (4KB each) of the specified device. Argument -> unsigned int. Dirty blocks are flushed and the cache is emptied. */
+#define USBMASS_DEVCTL_SET_CACHE_SIZE	0x0004
+
+/** Sector cache statistics, as returned by USBMASS_DEVCTL_GET_CACHE_STATS. */
+struct usbmass_cache_stats{
+	/** Number of cache slots. */
+	unsigned int size;
+	/** Number of sector reads served through the cache. */
+	unsigned int accesses;
+	/** Number of reads that did not need to access the device. */
+	unsigned int hits;
+	/** Number of valid blocks that were replaced. */
+	unsigned int evictions;
+	/** Number of dirty blocks written back to the device. */
+	unsigned int writebacks;
+};
 
 //Device status bits.
 /** CONNected */
@@ -0,0 +1,150 @@
+/**
+ * @file
+ * Single-producer/single-consumer ring buffer between the EE and the IOP.
+ *
+ * The data lives in the consumer's memory and is written by the producer through
+ * the transport (SIF DMA on the console). Each side publishes its own index, the
+ * producer the head and the consumer the tail, into a mirror in the other side's
+ * memory, so both sides only ever read local memory.
+ */
+
+#ifndef __SIFRING_H__
+#define __SIFRING_H__
+
+#include <tamtypes.h>
+
+/** Granularity of the ring, sizes and the producer's source buffers must be aligned to it */
+#define SIF_RING_ALIGN 16
+
+/** An index published to the other side, alone in its cache line. */
+typedef struct st_SIF_RingIndex
+{
+    volatile u32 index;
+    u32 pad[15];
+} __attribute__((aligned(64))) SIF_RingIndex;
+
+/** One contiguous copy into the other side's memory. */
+typedef struct st_SIF_RingSpan
+{
+    const void *src;
+    void *dest;
+    int size;
+    int attr;
+} SIF_RingSpan;
+
+typedef struct st_SIF_RingOps
+{
+    /** Queues the spans, in order, as one transfer. Returns 0, or -1 if it should be retried later. */
+    int (*copy)(void *arg, SIF_RingSpan *spans, int count);
+    /** Waits until all queued transfers have completed. */
+    void (*sync)(void *arg);
+    /** Drops cached copies of memory written by the other side, may be NULL. */
+    void (*invalidate)(void *arg, volatile void *addr, int size);
+    /** Wakes the consumer. */
+    void (*wake)(void *arg);
+    void *arg;
+} SIF_RingOps;
+
+typedef struct st_SIF_RingStats
+{
+    /** Bytes written or read */
+    u32 bytes;
+    /** Calls that moved data */
+    u32 calls;
+    /** Transfers queued */
+    u32 transfers;
+    /** Spans in those transfers */
+    u32 spans;
+    /** Producer: writes that found the ring full. Consumer: waits that found it empty */
+    u32 stalls;
+    /** Producer: wake-ups sent to the consumer */
+    u32 wakes;
+} SIF_RingStats;
+
+typedef struct st_SIF_Ring
+{
+    /** Consumer: the data. Producer: address of the data in the consumer's memory */
+    u8 *data;
+    /** Size of the data, a power of 2 */
+    u32 size;
+    /** Head for the producer, tail for the consumer */
+    u32 local;
+    /** The other side's index, written by the other side */
+    SIF_RingIndex *mirror;
+    /** Where the local index is published in the other side's memory */
+    SIF_RingIndex *remote;
+    /** Source of the index transfers */
+    SIF_RingIndex publish;
+    const SIF_RingOps *ops;
+    SIF_RingStats stats;
+} SIF_Ring;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets up the producer side. data and head are addresses in the consumer's memory,
+ * tail is the mirror that the consumer publishes its tail to. Returns 0, or -1 if
+ * size isn't a power of 2 of at least SIF_RING_ALIGN.
+ */
+int SIF_ring_init_producer(SIF_Ring *ring, void *data, u32 size, SIF_RingIndex *head, SIF_RingIndex *tail, const SIF_RingOps *ops);
+
+/**
+ * Sets up the consumer side. tail is an address in the producer's memory, head is
+ * the mirror that the producer publishes its head to. Both sides must start on an
+ * empty ring, with both mirrors cleared.
+ */
+int SIF_ring_init_consumer(SIF_Ring *ring, void *data, u32 size, SIF_RingIndex *head, SIF_RingIndex *tail, const SIF_RingOps *ops);
+
+/** Producer: bytes that can be written without waiting. */
+u32 SIF_ring_free(SIF_Ring *ring);
+
+/**
+ * Producer: writes up to size bytes of src, at most two spans and the new head in one transfer.
+ * Wakes the consumer if it had emptied the ring. Returns the bytes written, a multiple of
+ * SIF_RING_ALIGN, 0 if the ring is full, or -1 if size or src isn't aligned to SIF_RING_ALIGN.
+ */
+int SIF_ring_write(SIF_Ring *ring, const void *src, int size);
+
+/** Consumer: bytes that can be read. */
+u32 SIF_ring_available(SIF_Ring *ring);
+
+/**
+ * Consumer: returns the contiguous bytes available at the tail and points *ptr at them,
+ * so they can be used in place before SIF_ring_consume().
+ */
+u32 SIF_ring_peek(SIF_Ring *ring, void **ptr);
+
+/** Consumer: releases size bytes and publishes the new tail. */
+void SIF_ring_consume(SIF_Ring *ring, u32 size);
+
+/** Consumer: copies up to size bytes into dest and releases them. Returns the bytes read. */
+int SIF_ring_read(SIF_Ring *ring, void *dest, int size);
+
+/**
+ * Consumer: call before going to sleep. Waits for the tail to be published and checks the
+ * ring again. If it returns 0, the producer will wake the consumer when it writes, otherwise
+ * that many bytes arrived and the consumer must not sleep.
+ */
+u32 SIF_ring_prepare_wait(SIF_Ring *ring);
+
+/** Retrieves the statistics and resets them. */
+void SIF_ring_get_stats(SIF_Ring *ring, SIF_RingStats *stats);
+
+/** State of the SIF DMA transport. */
+typedef struct st_SIF_RingSif
+{
+    u32 dma_id;
+    void (*wake)(void *arg);
+    void *wake_arg;
+} SIF_RingSif;
+
+/** Fills in ops for SIF DMA, with wake called to wake the consumer. Not available on the host. */
+void SIF_ring_sif_ops(SIF_RingOps *ops, SIF_RingSif *sif, void (*wake)(void *arg), void *wake_arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIFRING_H__ */
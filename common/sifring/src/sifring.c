@@ -0,0 +1,222 @@
+/*
+
+Single-producer/single-consumer ring buffer between the EE and the IOP.
+
+This file contains the transport independent part, which also builds on the host.
+
+Wake-ups: the producer publishes the head and then reads the tail, the consumer
+publishes the tail and then reads the head (SIF_ring_prepare_wait()). Both wait for
+their own transfer to complete in between, so at least one of them sees the other's
+update and the consumer can't go to sleep on data that it wasn't woken for.
+
+*/
+
+#include <tamtypes.h>
+#include "sifring.h"
+
+#ifdef _IOP
+#include <sysclib.h>
+#else
+#include <string.h>
+#endif
+
+static u32 _sif_ring_peer_index(SIF_Ring *ring)
+{
+    if(ring->ops->invalidate) { ring->ops->invalidate(ring->ops->arg, &ring->mirror->index, sizeof(ring->mirror->index)); }
+
+    return(ring->mirror->index);
+}
+
+static void _sif_ring_transfer(SIF_Ring *ring, SIF_RingSpan *spans, int count)
+{
+    while(ring->ops->copy(ring->ops->arg, spans, count) < 0)
+        ;
+
+    ring->stats.transfers++;
+    ring->stats.spans += count;
+}
+
+static int _sif_ring_init(SIF_Ring *ring, void *data, u32 size, SIF_RingIndex *mirror, SIF_RingIndex *remote, const SIF_RingOps *ops)
+{
+    if((size < SIF_RING_ALIGN) || (size & (size - 1))) { return(-1); }
+
+    ring->data = (u8 *)data;
+    ring->size = size;
+    ring->local = 0;
+    ring->mirror = mirror;
+    ring->remote = remote;
+    ring->publish.index = 0;
+    ring->ops = ops;
+
+    memset(&ring->stats, 0, sizeof(ring->stats));
+
+    return(0);
+}
+
+int SIF_ring_init_producer(SIF_Ring *ring, void *data, u32 size, SIF_RingIndex *head, SIF_RingIndex *tail, const SIF_RingOps *ops)
+{
+    return(_sif_ring_init(ring, data, size, tail, head, ops));
+}
+
+int SIF_ring_init_consumer(SIF_Ring *ring, void *data, u32 size, SIF_RingIndex *head, SIF_RingIndex *tail, const SIF_RingOps *ops)
+{
+    return(_sif_ring_init(ring, data, size, head, tail, ops));
+}
+
+u32 SIF_ring_free(SIF_Ring *ring)
+{
+    return(ring->size - (ring->local - _sif_ring_peer_index(ring)));
+}
+
+int SIF_ring_write(SIF_Ring *ring, const void *src, int size)
+{
+    SIF_RingSpan spans[3];
+    u32 head = ring->local;
+    u32 tail, offset, first;
+    int n, count = 0;
+
+    if((size & (SIF_RING_ALIGN - 1)) || ((u32)src & (SIF_RING_ALIGN - 1))) { return(-1); }
+
+    tail = _sif_ring_peer_index(ring);
+    n = ring->size - (head - tail);
+    if(n > size) { n = size; }
+
+    // The transfers are rounded up, so stay clear of data that isn't consumed yet.
+    n &= ~(SIF_RING_ALIGN - 1);
+
+    if(n <= 0)
+    {
+        ring->stats.stalls++;
+        return(0);
+    }
+
+    offset = head & (ring->size - 1);
+    first = ring->size - offset;
+    if(first > (u32)n) { first = n; }
+
+    spans[count].src = src;
+    spans[count].dest = ring->data + offset;
+    spans[count].size = first;
+    spans[count].attr = 0;
+    count++;
+
+    if(first < (u32)n)
+    {
+        spans[count].src = (const u8 *)src + first;
+        spans[count].dest = ring->data;
+        spans[count].size = n - first;
+        spans[count].attr = 0;
+        count++;
+    }
+
+    // The head goes last in the same transfer, so it never arrives before the data.
+    ring->local = head + n;
+    ring->publish.index = ring->local;
+
+    spans[count].src = &ring->publish;
+    spans[count].dest = ring->remote;
+    spans[count].size = SIF_RING_ALIGN;
+    spans[count].attr = 0;
+    count++;
+
+    _sif_ring_transfer(ring, spans, count);
+
+    // publish can't change before the transfer is done, and the consumer may only have
+    // gone to sleep if it had caught up with the old head.
+    ring->ops->sync(ring->ops->arg);
+
+    if(_sif_ring_peer_index(ring) == head)
+    {
+        ring->ops->wake(ring->ops->arg);
+        ring->stats.wakes++;
+    }
+
+    ring->stats.bytes += n;
+    ring->stats.calls++;
+
+    return(n);
+}
+
+u32 SIF_ring_available(SIF_Ring *ring)
+{
+    return(_sif_ring_peer_index(ring) - ring->local);
+}
+
+u32 SIF_ring_peek(SIF_Ring *ring, void **ptr)
+{
+    u32 offset = ring->local & (ring->size - 1);
+    u32 n = SIF_ring_available(ring);
+
+    if(n > ring->size - offset) { n = ring->size - offset; }
+
+    if(n && ring->ops->invalidate) { ring->ops->invalidate(ring->ops->arg, ring->data + offset, n); }
+
+    *ptr = ring->data + offset;
+
+    return(n);
+}
+
+void SIF_ring_consume(SIF_Ring *ring, u32 size)
+{
+    SIF_RingSpan span;
+
+    if(size == 0) { return; }
+
+    // If the previous tail is still on its way, it may pick up this one early, which is harmless.
+    ring->local += size;
+    ring->publish.index = ring->local;
+
+    span.src = &ring->publish;
+    span.dest = ring->remote;
+    span.size = SIF_RING_ALIGN;
+    span.attr = 0;
+
+    _sif_ring_transfer(ring, &span, 1);
+
+    ring->stats.bytes += size;
+    ring->stats.calls++;
+}
+
+int SIF_ring_read(SIF_Ring *ring, void *dest, int size)
+{
+    void *ptr;
+    u32 n, total = 0;
+
+    // At most two spans, the second one starting at the beginning of the data.
+    while((total < (u32)size) && ((n = SIF_ring_peek(ring, &ptr)) > 0))
+    {
+        if(n > size - total) { n = size - total; }
+
+        memcpy((u8 *)dest + total, ptr, n);
+        total += n;
+
+        ring->local += n;
+    }
+
+    if(total)
+    {
+        // Publish once for both spans.
+        ring->local -= total;
+        SIF_ring_consume(ring, total);
+    }
+
+    return(total);
+}
+
+u32 SIF_ring_prepare_wait(SIF_Ring *ring)
+{
+    u32 n;
+
+    ring->ops->sync(ring->ops->arg);
+
+    if((n = SIF_ring_available(ring)) == 0) { ring->stats.stalls++; }
+
+    return(n);
+}
+
+void SIF_ring_get_stats(SIF_Ring *ring, SIF_RingStats *stats)
+{
+    *stats = ring->stats;
+
+    memset(&ring->stats, 0, sizeof(ring->stats));
+}
@@ -0,0 +1,98 @@
+/*
+
+SIF DMA transport of the EE/IOP ring buffer, for both EE and IOP.
+
+*/
+
+#include <tamtypes.h>
+#include "sifring.h"
+
+#ifdef _EE
+#include <kernel.h>
+#include <sifdma.h>
+#include <sifcmd.h>
+#else
+#include <intrman.h>
+#include <sifman.h>
+#endif
+
+static int _sif_ring_sif_copy(void *arg, SIF_RingSpan *spans, int count)
+{
+    SIF_RingSif *sif = (SIF_RingSif *)arg;
+    SifDmaTransfer_t dmat[3];
+    u32 id;
+    int i;
+#ifndef _EE
+    int intr_stat;
+#endif
+
+    if(count > 3) { return(-1); }
+
+    for(i = 0; i < count; i++)
+    {
+#ifdef _EE
+        SifWriteBackDCache((void *)spans[i].src, spans[i].size);
+#endif
+        dmat[i].src = (void *)spans[i].src;
+        dmat[i].dest = spans[i].dest;
+        dmat[i].size = spans[i].size;
+        dmat[i].attr = spans[i].attr;
+    }
+
+    // All spans in one request, the DMA queue processes them in order.
+#ifdef _EE
+    id = SifSetDma(dmat, count);
+#else
+    CpuSuspendIntr(&intr_stat);
+    id = SifSetDma(dmat, count);
+    CpuResumeIntr(intr_stat);
+#endif
+    if(id == 0) { return(-1); }
+
+    sif->dma_id = id;
+
+    return(0);
+}
+
+static void _sif_ring_sif_sync(void *arg)
+{
+    SIF_RingSif *sif = (SIF_RingSif *)arg;
+
+    if(sif->dma_id == 0) { return; }
+
+    while(SifDmaStat(sif->dma_id) >= 0)
+        ;
+
+    sif->dma_id = 0;
+}
+
+#ifdef _EE
+static void _sif_ring_sif_invalidate(void *arg, volatile void *addr, int size)
+{
+    SifWriteBackDCache((void *)addr, size);
+}
+#endif
+
+static void _sif_ring_sif_wake(void *arg)
+{
+    SIF_RingSif *sif = (SIF_RingSif *)arg;
+
+    sif->wake(sif->wake_arg);
+}
+
+void SIF_ring_sif_ops(SIF_RingOps *ops, SIF_RingSif *sif, void (*wake)(void *arg), void *wake_arg)
+{
+    sif->dma_id = 0;
+    sif->wake = wake;
+    sif->wake_arg = wake_arg;
+
+    ops->copy = _sif_ring_sif_copy;
+    ops->sync = _sif_ring_sif_sync;
+#ifdef _EE
+    ops->invalidate = _sif_ring_sif_invalidate;
+#else
+    ops->invalidate = NULL;
+#endif
+    ops->wake = _sif_ring_sif_wake;
+    ops->arg = sif;
+}
@@ -0,0 +1,300 @@
+/*
+
+Host stress test of the ring logic in sifring.c.
+
+The SIF DMA is emulated by one thread per direction, which performs the queued
+transfers in order after random delays, so the indices and the data arrive late
+like they do over the SIF. The producer writes a counting byte stream in random
+sizes, the consumer reads it in random sizes, sometimes in place with
+SIF_ring_peek() and SIF_ring_consume(), and checks every byte. When the ring is
+empty the consumer calls SIF_ring_prepare_wait() and sleeps until it is woken;
+a wait of 2 seconds is counted as a lost wake-up, and the test stops after 3.
+
+Build and run from the root of the tree:
+
+  gcc -O2 -D_EE -Icommon/include -Icommon/sifring/include \
+      common/sifring/test/ring_stress.c common/sifring/src/sifring.c -lpthread -o ring_stress
+  ./ring_stress [bytes]
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include <tamtypes.h>
+#include "sifring.h"
+
+#define DMA_QUEUE 64
+#define MAX_SPAN 4096
+#define MAX_LOST 3
+
+/* A queued transfer, with the source data as it was when the transfer was queued. */
+typedef struct
+{
+    SIF_RingSpan spans[3];
+    u8 data[3][MAX_SPAN];
+    int count;
+} transfer_t;
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    transfer_t queue[DMA_QUEUE];
+    int head, tail;
+    unsigned int seed;
+} dma_t;
+
+static dma_t to_consumer, to_producer;
+static sem_t wake_sem;
+
+static SIF_RingIndex head_mirror, tail_mirror;
+static u8 ring_data[1024] __attribute__((aligned(64)));
+static SIF_Ring producer_ring, consumer_ring;
+
+static long long total = 8 * 1024 * 1024;
+static int errors, lost;
+static volatile int stop;
+
+static void *dma_thread(void *arg)
+{
+    dma_t *dma = (dma_t *)arg;
+    transfer_t *transfer;
+    struct timespec delay;
+    int i;
+
+    for(;;)
+    {
+        pthread_mutex_lock(&dma->mutex);
+        while(dma->head == dma->tail) { pthread_cond_wait(&dma->cond, &dma->mutex); }
+        transfer = &dma->queue[dma->tail % DMA_QUEUE];
+        pthread_mutex_unlock(&dma->mutex);
+
+        if(rand_r(&dma->seed) % 4 == 0)
+        {
+            delay.tv_sec = 0;
+            delay.tv_nsec = rand_r(&dma->seed) % 20000;
+            nanosleep(&delay, NULL);
+        }
+
+        for(i = 0; i < transfer->count; i++) { memcpy(transfer->spans[i].dest, transfer->data[i], transfer->spans[i].size); }
+
+        __sync_synchronize();
+
+        pthread_mutex_lock(&dma->mutex);
+        dma->tail++;
+        pthread_cond_broadcast(&dma->cond);
+        pthread_mutex_unlock(&dma->mutex);
+    }
+
+    return(NULL);
+}
+
+static int dma_copy(void *arg, SIF_RingSpan *spans, int count)
+{
+    dma_t *dma = (dma_t *)arg;
+    transfer_t *transfer;
+    int i;
+
+    pthread_mutex_lock(&dma->mutex);
+
+    if(dma->head - dma->tail >= DMA_QUEUE)
+    {
+        pthread_mutex_unlock(&dma->mutex);
+        return(-1);
+    }
+
+    transfer = &dma->queue[dma->head % DMA_QUEUE];
+    transfer->count = count;
+
+    for(i = 0; i < count; i++)
+    {
+        if(spans[i].size > MAX_SPAN)
+        {
+            printf("error: span of %d bytes\n", spans[i].size);
+            errors++;
+            spans[i].size = MAX_SPAN;
+        }
+
+        transfer->spans[i] = spans[i];
+        memcpy(transfer->data[i], spans[i].src, spans[i].size);
+    }
+
+    dma->head++;
+    pthread_cond_broadcast(&dma->cond);
+    pthread_mutex_unlock(&dma->mutex);
+
+    return(0);
+}
+
+static void dma_sync(void *arg)
+{
+    dma_t *dma = (dma_t *)arg;
+    int head;
+
+    pthread_mutex_lock(&dma->mutex);
+    head = dma->head;
+    while(dma->tail - head < 0) { pthread_cond_wait(&dma->cond, &dma->mutex); }
+    pthread_mutex_unlock(&dma->mutex);
+}
+
+static void wake(void *arg)
+{
+    sem_post(&wake_sem);
+}
+
+static const SIF_RingOps producer_ops = { dma_copy, dma_sync, NULL, wake, &to_consumer };
+static const SIF_RingOps consumer_ops = { dma_copy, dma_sync, NULL, wake, &to_producer };
+
+/* Byte pos of the stream, the bytes of consecutive 32-bit words. */
+static u8 stream_byte(long long pos)
+{
+    u32 word = (u32)(pos / 4);
+
+    return(((u8 *)&word)[pos & 3]);
+}
+
+static void *producer(void *arg)
+{
+    static u8 buffer[1024] __attribute__((aligned(16)));
+    unsigned int seed = 1;
+    long long sent = 0;
+    struct timespec delay = { 0, 1000 };
+    int i, size, n;
+
+    while((sent < total) && !stop)
+    {
+        size = ((rand_r(&seed) % 64) + 1) * SIF_RING_ALIGN;
+        if(size > total - sent) { size = total - sent; }
+        for(i = 0; i < size; i++) { buffer[i] = stream_byte(sent + i); }
+
+        if((n = SIF_ring_write(&producer_ring, buffer, size)) < 0)
+        {
+            printf("error: SIF_ring_write failed\n");
+            errors++;
+            return(NULL);
+        }
+
+        if(n == 0) { nanosleep(&delay, NULL); }
+
+        sent += n;
+    }
+
+    return(NULL);
+}
+
+static void *consumer(void *arg)
+{
+    static u8 buffer[600];
+    unsigned int seed = 2;
+    long long received = 0;
+    struct timespec timeout;
+    void *ptr;
+    u8 *src;
+    int i, n;
+
+    while(received < total)
+    {
+        if(rand_r(&seed) % 4 == 0)
+        {
+            n = SIF_ring_peek(&consumer_ring, &ptr);
+            if(n > 0) { n = rand_r(&seed) % n + 1; }
+            src = (u8 *)ptr;
+        }
+        else
+        {
+            n = SIF_ring_read(&consumer_ring, buffer, rand_r(&seed) % sizeof(buffer) + 1);
+            src = buffer;
+        }
+
+        if(n == 0)
+        {
+            if(SIF_ring_prepare_wait(&consumer_ring) == 0)
+            {
+                clock_gettime(CLOCK_REALTIME, &timeout);
+                timeout.tv_sec += 2;
+
+                if((sem_timedwait(&wake_sem, &timeout) < 0) && (++lost == MAX_LOST))
+                {
+                    printf("error: %d lost wake-ups after %lld bytes\n", lost, received);
+                    stop = 1;
+                    return(NULL);
+                }
+            }
+
+            continue;
+        }
+
+        for(i = 0; i < n; i++)
+        {
+            if(src[i] != stream_byte(received + i))
+            {
+                printf("error: wrong data at byte %lld\n", received + i);
+                errors++;
+                stop = 1;
+                return(NULL);
+            }
+        }
+
+        if(src != buffer) { SIF_ring_consume(&consumer_ring, n); }
+
+        received += n;
+    }
+
+    return(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[4];
+    SIF_RingStats p, c;
+    dma_t *dma[2] = { &to_consumer, &to_producer };
+    int i;
+
+    if(argc > 1) { total = (atoll(argv[1]) + SIF_RING_ALIGN - 1) & ~(SIF_RING_ALIGN - 1); }
+
+    for(i = 0; i < 2; i++)
+    {
+        pthread_mutex_init(&dma[i]->mutex, NULL);
+        pthread_cond_init(&dma[i]->cond, NULL);
+        dma[i]->seed = i + 3;
+        pthread_create(&threads[i], NULL, dma_thread, dma[i]);
+    }
+
+    sem_init(&wake_sem, 0, 0);
+
+    if(SIF_ring_init_producer(&producer_ring, ring_data, 1000, &head_mirror, &tail_mirror, &producer_ops) != -1)
+    {
+        printf("FAIL: a size that isn't a power of 2 was accepted\n");
+        return(1);
+    }
+
+    SIF_ring_init_producer(&producer_ring, ring_data, sizeof(ring_data), &head_mirror, &tail_mirror, &producer_ops);
+    SIF_ring_init_consumer(&consumer_ring, ring_data, sizeof(ring_data), &head_mirror, &tail_mirror, &consumer_ops);
+
+    pthread_create(&threads[2], NULL, producer, NULL);
+    pthread_create(&threads[3], NULL, consumer, NULL);
+    pthread_join(threads[2], NULL);
+    pthread_join(threads[3], NULL);
+
+    SIF_ring_get_stats(&producer_ring, &p);
+    SIF_ring_get_stats(&consumer_ring, &c);
+
+    printf("producer: %u bytes in %u writes, %u transfers, %u spans, %u full, %u wake-ups\n", p.bytes, p.calls, p.transfers, p.spans, p.stalls, p.wakes);
+    printf("consumer: %u bytes in %u reads, %u transfers, %u empty\n", c.bytes, c.calls, c.transfers, c.stalls);
+    printf("%d lost wake-ups\n", lost);
+
+    if(errors || lost || (p.bytes != total) || (c.bytes != total))
+    {
+        printf("FAIL\n");
+        return(1);
+    }
+
+    printf("OK\n");
+
+    return(0);
+}
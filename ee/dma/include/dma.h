@@ -72,6 +72,13 @@ void dma_wait_fast(void);
  */
 int dma_channel_wait(int channel, int timeout);
 
+/**
+ *	Checks if the specified dma channel is still transferring, without waiting
+ *	@param channel 	Channel to check
+ *	@return 1 if a transfer is in progress, 0 if the channel is ready
+ */
+int dma_channel_busy(int channel);
+
 /**
  *	Send a dmachain to the specified dma channel.
  *	@param channel 	Channel to send the chain to
@@ -154,6 +154,13 @@ int dma_channel_wait(int channel, int timeout)
 
 }
 
+int dma_channel_busy(int channel)
+{
+
+	return (*((vu32 *)dma_chcr[channel]) & 0x00000100) ? 1 : 0;
+
+}
+
 int dma_channel_send_chain(int channel, void *data, int data_size, int flags, int spr)
 {
 
@@ -16,10 +16,12 @@
 #include <draw_primitives.h>
 #include <draw_sampling.h>
 #include <draw_tests.h>
+#include <draw_texcache.h>
 #include <draw_types.h>
 
 #include <draw2d.h>
 #include <draw3d.h>
+#include <draw_batch.h>
 
 #define DRAW_DISABLE 0
 #define DRAW_ENABLE  1
@@ -57,6 +57,19 @@ int draw_convert_st(texel_t *output, int count, vertex_f_t *vertices, texel_f_t
 /** Converts and translates floating point vertices to fixed point vertices */
 int draw_convert_xyz(xyz_t *output, float x, float y, int z, int count, vertex_f_t *vertices);
 
+/**
+ * The interleaved versions write one doubleword every stride doublewords of output, so they can fill
+ * the vertex data of a regList packet in place. With a stride of 2, (u64*)q and (u64*)q + 1 address the
+ * first and second register of each qword.
+ */
+int draw_convert_rgbq_interleaved(u64 *output, int stride, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha);
+int draw_convert_rgbaq_interleaved(u64 *output, int stride, int count, vertex_f_t *vertices, color_f_t *colours);
+int draw_convert_st_interleaved(u64 *output, int stride, int count, vertex_f_t *vertices, texel_f_t *coords);
+int draw_convert_xyz_interleaved(u64 *output, int stride, float x, float y, int z, int count, vertex_f_t *vertices);
+
+/** Converts count vertices into RGBAQ, XYZ2 regList data at q (DRAW_RGBAQ_REGLIST) and returns the qword following it */
+qword_t *draw_convert_rgbq_xyz(qword_t *q, float x, float y, int z, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,82 @@
+/**
+ * @file
+ * Draw library batched 2D primitives
+ */
+
+#ifndef __DRAW_BATCH_H__
+#define __DRAW_BATCH_H__
+
+#include <tamtypes.h>
+
+#include <packet.h>
+
+#include <draw2d.h>
+
+typedef struct {
+	/** Primitives added */
+	unsigned int primitives;
+	/** Runs of primitives sharing one giftag */
+	unsigned int runs;
+	/** Qwords emitted */
+	unsigned int qwords;
+	/** Qwords saved compared to the single primitive draw functions, negative if batching cost more */
+	int qwords_saved;
+	/** Times the packet was handed to the send function */
+	unsigned int sends;
+} draw_batch_stats_t;
+
+/**
+ * Called when the packet is full, with the number of qwords in it.
+ * The packet is refilled from the start when this returns, so it has to be sent or copied.
+ */
+typedef void (*draw_batch_send_t)(packet_t *packet, int qwords, void *arg);
+
+typedef struct {
+	packet_t *packet;
+	u64 *dw;				// next free doubleword
+	qword_t *giftag;		// giftag of the open run, or NULL
+	u64 prim;				// prim register of the open run
+	u64 reglist;
+	int nreg;
+	int nloop;
+	unsigned int baseline;	// qwords the single primitive draw functions would have used
+	draw_batch_send_t send;
+	void *send_arg;
+	draw_batch_stats_t stats;
+} draw_batch_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts a batch at q, which must lie inside packet.
+ * Consecutive primitives with the same prim register settings (type, context, blending, texturing)
+ * share a single regList giftag. Each run costs 3 qwords of setup.
+ */
+void draw_batch_begin(draw_batch_t *batch, packet_t *packet, qword_t *q);
+
+/** Sets the function that sends a full packet, or NULL to make the draw_batch_* functions fail instead. */
+void draw_batch_set_send(draw_batch_t *batch, draw_batch_send_t send, void *arg);
+
+/** Ends the open run and returns the qword following it, where other data can be added. */
+qword_t *draw_batch_end(draw_batch_t *batch);
+
+/**
+ * Adds a primitive, with the same results as the single primitive draw functions.
+ * Returns 0, or -1 if the packet is full and there is no send function.
+ */
+int draw_batch_point(draw_batch_t *batch, int context, point_t *point);
+int draw_batch_line(draw_batch_t *batch, int context, line_t *line);
+int draw_batch_triangle_filled(draw_batch_t *batch, int context, triangle_t *triangle);
+int draw_batch_rect_filled(draw_batch_t *batch, int context, rect_t *rect);
+int draw_batch_rect_textured(draw_batch_t *batch, int context, texrect_t *rect);
+
+/** Retrieves the statistics and resets them. */
+void draw_batch_get_stats(draw_batch_t *batch, draw_batch_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DRAW_BATCH_H__ */
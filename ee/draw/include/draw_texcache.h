@@ -0,0 +1,67 @@
+/**
+ * @file
+ * Draw library texture residency cache
+ */
+
+#ifndef __DRAW_TEXCACHE_H__
+#define __DRAW_TEXCACHE_H__
+
+#include <tamtypes.h>
+
+#include <draw_buffers.h>
+
+/** Maximum number of textures tracked by the cache */
+#define TEXCACHE_MAX_ENTRIES	128
+
+typedef struct {
+	/** Lookups of resident textures this frame */
+	unsigned int hits;
+	/** Lookups that needed an upload this frame */
+	unsigned int misses;
+	/** Hit rate this frame, in percent */
+	unsigned int hit_rate;
+	/** Textures uploaded this frame */
+	unsigned int uploads;
+	/** Bytes uploaded this frame */
+	unsigned int upload_bytes;
+	/** Textures evicted this frame */
+	unsigned int evictions;
+	/** Textures that could not be made resident this frame */
+	unsigned int failures;
+	/** Textures that are resident */
+	unsigned int resident;
+} texcache_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Initializes the texture cache, forgetting all textures. */
+void draw_texcache_init(void);
+
+/**
+ * Makes the texture identified by handle resident and sets up texbuf for it.
+ * Textures used this frame are never evicted, the least recently used others are evicted if vram runs short.
+ * A texture that isn't resident is uploaded by the next draw_texcache_upload(), which must be sent before
+ * anything that uses the texture. Returns 0, or -1 if the texture could not be made resident.
+ */
+int draw_texcache_use(texbuffer_t *texbuf, unsigned int handle, void *src, int width, int height, int psm);
+
+/**
+ * Adds the pending uploads of this frame to a dma chain and ends it with a texture flush.
+ * Each texture needs 6 qwords plus 3 qwords per GIF_BLOCK_SIZE qwords of data, and the flush 3 qwords.
+ * Returns q unchanged if there is nothing to upload.
+ */
+qword_t *draw_texcache_upload(qword_t *q);
+
+/** Forgets the texture identified by handle and frees its vram. */
+void draw_texcache_invalidate(unsigned int handle);
+
+/** Ends the frame, optionally retrieving its statistics. */
+void draw_texcache_end_frame(texcache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DRAW_TEXCACHE_H__ */
@@ -3,6 +3,7 @@
 #include <draw.h>
 #include <draw2d.h>
 #include <draw3d.h>
+#include <draw_batch.h>
 
 #include <gif_tags.h>
 
@@ -672,3 +673,290 @@ qword_t *draw_round_rect_outline(qword_t *q, int context, rect_t *rect)
 	return q;
 
 }
+
+#define DRAW_BATCH_RUN_QWORDS 3
+#define DRAW_BATCH_MAX_NLOOP 0x7FFF
+
+// The batched primitives leave out the prim register, which is set once per run.
+#define DRAW_BATCH_POINT_NREG 2
+#define DRAW_BATCH_POINT_REGLIST DRAW_RGBAQ_REGLIST
+
+#define DRAW_BATCH_LINE_NREG 3
+#define DRAW_BATCH_LINE_REGLIST \
+		((u64)GIF_REG_RGBAQ) <<  0 | \
+		((u64)GIF_REG_XYZ2)  <<  4 | \
+		((u64)GIF_REG_XYZ2)  <<  8
+
+#define DRAW_BATCH_TRIANGLE_NREG 4
+#define DRAW_BATCH_TRIANGLE_REGLIST \
+		((u64)GIF_REG_RGBAQ) <<  0 | \
+		((u64)GIF_REG_XYZ2)  <<  4 | \
+		((u64)GIF_REG_XYZ2)  <<  8 | \
+		((u64)GIF_REG_XYZ2)  << 12
+
+#define DRAW_BATCH_SPRITE_NREG 3
+#define DRAW_BATCH_SPRITE_REGLIST DRAW_BATCH_LINE_REGLIST
+
+#define DRAW_BATCH_SPRITE_TEX_NREG 5
+#define DRAW_BATCH_SPRITE_TEX_REGLIST \
+		((u64)GIF_REG_RGBAQ) <<  0 | \
+		((u64)GIF_REG_UV)    <<  4 | \
+		((u64)GIF_REG_XYZ2)  <<  8 | \
+		((u64)GIF_REG_UV)    << 12 | \
+		((u64)GIF_REG_XYZ2)  << 16
+
+void draw_batch_begin(draw_batch_t *batch, packet_t *packet, qword_t *q)
+{
+
+	batch->packet = packet;
+	batch->dw = (u64*)q;
+	batch->giftag = NULL;
+	batch->send = NULL;
+	batch->send_arg = NULL;
+	batch->baseline = 0;
+
+	batch->stats.primitives = 0;
+	batch->stats.runs = 0;
+	batch->stats.qwords = 0;
+	batch->stats.sends = 0;
+
+}
+
+void draw_batch_set_send(draw_batch_t *batch, draw_batch_send_t send, void *arg)
+{
+
+	batch->send = send;
+	batch->send_arg = arg;
+
+}
+
+qword_t *draw_batch_end(draw_batch_t *batch)
+{
+
+	if (batch->giftag != NULL)
+	{
+
+		// Pad the last qword
+		if ((batch->nloop * batch->nreg) & 1)
+		{
+			*batch->dw++ = 0;
+		}
+
+		PACK_GIFTAG(batch->giftag,GIF_SET_TAG(batch->nloop,0,0,0,GIF_FLG_REGLIST,batch->nreg),batch->reglist);
+
+		batch->giftag = NULL;
+
+	}
+
+	return (qword_t*)batch->dw;
+
+}
+
+// Makes room for one more primitive, starting a new run if the prim register changes.
+static int draw_batch_add(draw_batch_t *batch, u64 prim, int nreg, u64 reglist, int single_nreg)
+{
+
+	qword_t *q;
+	int dwords;
+	int used;
+
+	if ((batch->giftag == NULL) || (batch->prim != prim) || (batch->nloop == DRAW_BATCH_MAX_NLOOP))
+	{
+		draw_batch_end(batch);
+	}
+
+	// Room for the primitive, padding and a new run if needed
+	dwords = nreg + 1;
+
+	if (batch->giftag == NULL)
+	{
+		dwords += DRAW_BATCH_RUN_QWORDS * 2;
+	}
+
+	if ((u64*)(batch->packet->data + batch->packet->qwords) - batch->dw < dwords)
+	{
+
+		q = draw_batch_end(batch);
+
+		if (batch->send == NULL)
+		{
+			return -1;
+		}
+
+		batch->send(batch->packet,q - batch->packet->data,batch->send_arg);
+		batch->stats.sends++;
+
+		batch->dw = (u64*)batch->packet->data;
+
+		if (batch->packet->qwords * 2 < nreg + 1 + DRAW_BATCH_RUN_QWORDS * 2)
+		{
+			return -1;
+		}
+
+	}
+
+	if (batch->giftag == NULL)
+	{
+
+		q = (qword_t*)batch->dw;
+
+		PACK_GIFTAG(q,GIF_SET_TAG(1,0,0,0,GIF_FLG_PACKED,1),GIF_REG_AD);
+		q++;
+
+		PACK_GIFTAG(q,prim,GIF_REG_PRIM);
+		q++;
+
+		batch->giftag = q;
+		q++;
+
+		batch->dw = (u64*)q;
+		batch->prim = prim;
+		batch->reglist = reglist;
+		batch->nreg = nreg;
+		batch->nloop = 0;
+
+		batch->stats.runs++;
+		batch->stats.qwords += DRAW_BATCH_RUN_QWORDS;
+
+	}
+
+	// Qwords added by this primitive, including the padding of the run
+	used = batch->nloop * nreg;
+	batch->stats.qwords += ((used + nreg + 1) >> 1) - ((used + 1) >> 1);
+
+	batch->nloop++;
+	batch->stats.primitives++;
+
+	// The single primitive functions use a giftag and one register per doubleword
+	batch->baseline += 1 + ((single_nreg + 1) >> 1);
+
+	return 0;
+
+}
+
+int draw_batch_point(draw_batch_t *batch, int context, point_t *point)
+{
+
+	u64 *dw;
+
+	if (draw_batch_add(batch,GIF_SET_PRIM(PRIM_POINT,0,0,0,blending,0,0,context,0),DRAW_BATCH_POINT_NREG,DRAW_BATCH_POINT_REGLIST,DRAW_POINT_NREG) < 0)
+	{
+		return -1;
+	}
+
+	dw = batch->dw;
+
+	*dw++ = point->color.rgbaq;
+	*dw++ = GIF_SET_XYZ(ftoi4(point->v0.x + OFFSET),ftoi4(point->v0.y + OFFSET),point->v0.z);
+
+	batch->dw = dw;
+
+	return 0;
+
+}
+
+int draw_batch_line(draw_batch_t *batch, int context, line_t *line)
+{
+
+	u64 *dw;
+
+	if (draw_batch_add(batch,GIF_SET_PRIM(PRIM_LINE,0,0,0,blending,0,0,context,0),DRAW_BATCH_LINE_NREG,DRAW_BATCH_LINE_REGLIST,DRAW_LINE_NREG) < 0)
+	{
+		return -1;
+	}
+
+	dw = batch->dw;
+
+	*dw++ = line->color.rgbaq;
+	*dw++ = GIF_SET_XYZ(ftoi4(line->v0.x + START_OFFSET),ftoi4(line->v0.y + START_OFFSET),line->v0.z);
+	*dw++ = GIF_SET_XYZ(ftoi4(line->v1.x + END_OFFSET),ftoi4(line->v1.y + END_OFFSET),line->v0.z);
+
+	batch->dw = dw;
+
+	return 0;
+
+}
+
+int draw_batch_triangle_filled(draw_batch_t *batch, int context, triangle_t *triangle)
+{
+
+	u64 *dw;
+
+	if (draw_batch_add(batch,GIF_SET_PRIM(PRIM_TRIANGLE,0,0,0,blending,0,0,context,0),DRAW_BATCH_TRIANGLE_NREG,DRAW_BATCH_TRIANGLE_REGLIST,DRAW_TRIANGLE_NREG) < 0)
+	{
+		return -1;
+	}
+
+	dw = batch->dw;
+
+	*dw++ = triangle->color.rgbaq;
+	*dw++ = GIF_SET_XYZ(ftoi4(triangle->v0.x + OFFSET),ftoi4(triangle->v0.y + OFFSET),triangle->v0.z);
+	*dw++ = GIF_SET_XYZ(ftoi4(triangle->v1.x + OFFSET),ftoi4(triangle->v1.y + OFFSET),triangle->v0.z);
+	*dw++ = GIF_SET_XYZ(ftoi4(triangle->v2.x + OFFSET),ftoi4(triangle->v2.y + OFFSET),triangle->v0.z);
+
+	batch->dw = dw;
+
+	return 0;
+
+}
+
+int draw_batch_rect_filled(draw_batch_t *batch, int context, rect_t *rect)
+{
+
+	u64 *dw;
+
+	if (draw_batch_add(batch,GIF_SET_PRIM(PRIM_SPRITE,0,0,0,blending,0,0,context,0),DRAW_BATCH_SPRITE_NREG,DRAW_BATCH_SPRITE_REGLIST,DRAW_SPRITE_NREG) < 0)
+	{
+		return -1;
+	}
+
+	dw = batch->dw;
+
+	*dw++ = rect->color.rgbaq;
+	*dw++ = GIF_SET_XYZ(ftoi4(rect->v0.x + START_OFFSET),ftoi4(rect->v0.y + START_OFFSET),rect->v0.z);
+	*dw++ = GIF_SET_XYZ(ftoi4(rect->v1.x + END_OFFSET),ftoi4(rect->v1.y + END_OFFSET),rect->v0.z);
+
+	batch->dw = dw;
+
+	return 0;
+
+}
+
+int draw_batch_rect_textured(draw_batch_t *batch, int context, texrect_t *rect)
+{
+
+	u64 *dw;
+
+	if (draw_batch_add(batch,GIF_SET_PRIM(PRIM_SPRITE,0,DRAW_ENABLE,0,blending,0,PRIM_MAP_UV,context,0),DRAW_BATCH_SPRITE_TEX_NREG,DRAW_BATCH_SPRITE_TEX_REGLIST,DRAW_SPRITE_TEX_NREG) < 0)
+	{
+		return -1;
+	}
+
+	dw = batch->dw;
+
+	*dw++ = rect->color.rgbaq;
+	*dw++ = GIF_SET_UV(ftoi4(rect->t0.u),ftoi4(rect->t0.v));
+	*dw++ = GIF_SET_XYZ(ftoi4(rect->v0.x + START_OFFSET),ftoi4(rect->v0.y + START_OFFSET),rect->v0.z);
+	*dw++ = GIF_SET_UV(ftoi4(rect->t1.u),ftoi4(rect->t1.v));
+	*dw++ = GIF_SET_XYZ(ftoi4(rect->v1.x + END_OFFSET),ftoi4(rect->v1.y + END_OFFSET),rect->v0.z);
+
+	batch->dw = dw;
+
+	return 0;
+
+}
+
+void draw_batch_get_stats(draw_batch_t *batch, draw_batch_stats_t *stats)
+{
+
+	*stats = batch->stats;
+	stats->qwords_saved = (int)batch->baseline - (int)batch->stats.qwords;
+
+	batch->baseline = 0;
+
+	batch->stats.primitives = 0;
+	batch->stats.runs = 0;
+	batch->stats.qwords = 0;
+	batch->stats.sends = 0;
+
+}
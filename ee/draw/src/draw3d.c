@@ -53,124 +53,253 @@ qword_t *draw_prim_end(qword_t *q, int nreg, u64 reglist)
 
 }
 
-int draw_convert_rgbq(color_t *output, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha)
+// The conversion kernels write every stride doublewords of output, so they can fill
+// the registers of a regList packet in place. They take 4 vertices per iteration and
+// carry q over from the last vertex with a non-zero w, like the single stride versions.
+
+static inline float draw_convert_q(vertex_f_t *vertex, float q)
+{
+
+	if (vertex->w != 0)
+	{
+		q = 1 / vertex->w;
+	}
+
+	return q;
+
+}
+
+static inline u64 draw_convert_colour(color_f_t *colour, u8 alpha, float q)
+{
+
+	union { float f; u32 u; } bits;
+	u32 rgba;
+
+	// Packed in a register rather than through the bytes of a color_t.
+	rgba  = (u8)(int)(colour->r * 128.0f);
+	rgba |= (u8)(int)(colour->g * 128.0f) << 8;
+	rgba |= (u8)(int)(colour->b * 128.0f) << 16;
+	rgba |= (u32)alpha << 24;
+
+	bits.f = q;
+
+	return (u64)rgba | ((u64)bits.u << 32);
+
+}
+
+static inline u64 draw_convert_texel(texel_f_t *coord, float q)
+{
+
+	texel_t t;
+
+	t.s = coord->s * q;
+	t.t = coord->t * q;
+
+	return t.uv;
+
+}
+
+static inline u64 draw_convert_vertex(vertex_f_t *vertex, float center_x, float center_y, float max_z)
+{
+
+	u64 x, y, z;
+
+	x = (u16)(short)((vertex->x + 1.0f) * center_x);
+	y = (u16)(short)((vertex->y + 1.0f) * center_y);
+	z = (unsigned int)((vertex->z + 1.0f) * max_z);
+
+	return x | (y << 16) | (z << 32);
+
+}
+
+int draw_convert_rgbq_interleaved(u64 *output, int stride, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha)
 {
 
 	int i;
-	float q = 1.00f;
+	float q0, q1, q2, q3 = 1.00f;
 
-	// For each colour...
-	for (i=0;i<count;i++)
+	for (i = 0; i < (count & ~3); i += 4)
 	{
 
-		// Calculate the Q value.
-		if (vertices[i].w != 0)
-		{
+		q0 = draw_convert_q(&vertices[i+0],q3);
+		q1 = draw_convert_q(&vertices[i+1],q0);
+		q2 = draw_convert_q(&vertices[i+2],q1);
+		q3 = draw_convert_q(&vertices[i+3],q2);
 
-			q = 1 / vertices[i].w;
+		output[0*stride] = draw_convert_colour(&colours[i+0],alpha,q0);
+		output[1*stride] = draw_convert_colour(&colours[i+1],alpha,q1);
+		output[2*stride] = draw_convert_colour(&colours[i+2],alpha,q2);
+		output[3*stride] = draw_convert_colour(&colours[i+3],alpha,q3);
 
-		}
+		output += 4*stride;
 
-		// Calculate the RGBA values.
-		output[i].r = (int)(colours[i].r * 128.0f);
-		output[i].g = (int)(colours[i].g * 128.0f);
-		output[i].b = (int)(colours[i].b * 128.0f);
-		output[i].a = alpha;
-		output[i].q = q;
+	}
+
+	for (; i < count; i++)
+	{
+
+		q3 = draw_convert_q(&vertices[i],q3);
+
+		*output = draw_convert_colour(&colours[i],alpha,q3);
+
+		output += stride;
 
 	}
 
-	// End function.
 	return 0;
 
 }
 
-int draw_convert_rgbaq(color_t *output, int count, vertex_f_t *vertices, color_f_t *colours)
+int draw_convert_rgbaq_interleaved(u64 *output, int stride, int count, vertex_f_t *vertices, color_f_t *colours)
 {
 
 	int i;
-	float q = 1.00f;
+	float q0, q1, q2, q3 = 1.00f;
 
-	// For each colour...
-	for (i=0;i<count;i++)
+	for (i = 0; i < (count & ~3); i += 4)
 	{
 
-		// Calculate the Q value.
-		if (vertices[i].w != 0)
-		{
+		q0 = draw_convert_q(&vertices[i+0],q3);
+		q1 = draw_convert_q(&vertices[i+1],q0);
+		q2 = draw_convert_q(&vertices[i+2],q1);
+		q3 = draw_convert_q(&vertices[i+3],q2);
 
-			q = 1 / vertices[i].w;
+		output[0*stride] = draw_convert_colour(&colours[i+0],(int)(colours[i+0].a * 128.0f),q0);
+		output[1*stride] = draw_convert_colour(&colours[i+1],(int)(colours[i+1].a * 128.0f),q1);
+		output[2*stride] = draw_convert_colour(&colours[i+2],(int)(colours[i+2].a * 128.0f),q2);
+		output[3*stride] = draw_convert_colour(&colours[i+3],(int)(colours[i+3].a * 128.0f),q3);
 
-		}
+		output += 4*stride;
 
-		// Calculate the RGBA values.
-		output[i].r = (int)(colours[i].r * 128.0f);
-		output[i].g = (int)(colours[i].g * 128.0f);
-		output[i].b = (int)(colours[i].b * 128.0f);
-		output[i].a = (int)(colours[i].a * 128.0f);
-		output[i].q = q;
+	}
+
+	for (; i < count; i++)
+	{
+
+		q3 = draw_convert_q(&vertices[i],q3);
+
+		*output = draw_convert_colour(&colours[i],(int)(colours[i].a * 128.0f),q3);
+
+		output += stride;
 
 	}
 
-	// End function.
 	return 0;
 
 }
 
-int draw_convert_st(texel_t *output, int count, vertex_f_t *vertices, texel_f_t *coords)
+int draw_convert_st_interleaved(u64 *output, int stride, int count, vertex_f_t *vertices, texel_f_t *coords)
 {
 
-	int i = 0;
-	float q = 1.00f;
+	int i;
+	float q0, q1, q2, q3 = 1.00f;
+
+	for (i = 0; i < (count & ~3); i += 4)
+	{
+
+		q0 = draw_convert_q(&vertices[i+0],q3);
+		q1 = draw_convert_q(&vertices[i+1],q0);
+		q2 = draw_convert_q(&vertices[i+2],q1);
+		q3 = draw_convert_q(&vertices[i+3],q2);
+
+		output[0*stride] = draw_convert_texel(&coords[i+0],q0);
+		output[1*stride] = draw_convert_texel(&coords[i+1],q1);
+		output[2*stride] = draw_convert_texel(&coords[i+2],q2);
+		output[3*stride] = draw_convert_texel(&coords[i+3],q3);
+
+		output += 4*stride;
 
-	// For each coordinate...
-	for (i=0;i<count;i++)
+	}
+
+	for (; i < count; i++)
 	{
 
-		// Calculate the Q value.
-		if (vertices[i].w != 0)
-		{
-			q = 1 / vertices[i].w;
-		}
+		q3 = draw_convert_q(&vertices[i],q3);
+
+		*output = draw_convert_texel(&coords[i],q3);
 
-		// Calculate the S and T values.
-		output[i].s = coords[i].s * q;
-		output[i].t = coords[i].t * q;
+		output += stride;
 
 	}
 
-	// End function.
 	return 0;
 
 }
 
-int draw_convert_xyz(xyz_t *output, float x, float y, int z, int count, vertex_f_t *vertices)
+int draw_convert_xyz_interleaved(u64 *output, int stride, float x, float y, int z, int count, vertex_f_t *vertices)
 {
 
 	int i;
 
-	int center_x;
-	int center_y;
+	float center_x;
+	float center_y;
+	float max_z;
+
+	// Converted once instead of for every vertex.
+	center_x = (float)ftoi4(x);
+	center_y = (float)-ftoi4(y);
 
-	unsigned int max_z;
+	max_z = (float)(1u << (z - 1));
 
-	center_x = ftoi4(x);
-	center_y = ftoi4(y);
+	for (i = 0; i < (count & ~3); i += 4)
+	{
 
-	max_z = 1 << (z - 1);
+		output[0*stride] = draw_convert_vertex(&vertices[i+0],center_x,center_y,max_z);
+		output[1*stride] = draw_convert_vertex(&vertices[i+1],center_x,center_y,max_z);
+		output[2*stride] = draw_convert_vertex(&vertices[i+2],center_x,center_y,max_z);
+		output[3*stride] = draw_convert_vertex(&vertices[i+3],center_x,center_y,max_z);
 
-	// For each colour...
-	for (i=0;i<count;i++)
+		output += 4*stride;
+
+	}
+
+	for (; i < count; i++)
 	{
 
-		// Calculate the XYZ values.
-		output[i].x = (short)((vertices[i].x + 1.0f) * center_x);
-		output[i].y = (short)((vertices[i].y + 1.0f) * -center_y);
-		output[i].z = (unsigned int)((vertices[i].z + 1.0f) * max_z);
+		*output = draw_convert_vertex(&vertices[i],center_x,center_y,max_z);
+
+		output += stride;
 
 	}
 
-	// End function.
 	return 0;
 
 }
+
+qword_t *draw_convert_rgbq_xyz(qword_t *q, float x, float y, int z, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha)
+{
+
+	draw_convert_rgbq_interleaved(&q->dw[0],2,count,vertices,colours,alpha);
+	draw_convert_xyz_interleaved(&q->dw[1],2,x,y,z,count,vertices);
+
+	return q + count;
+
+}
+
+int draw_convert_rgbq(color_t *output, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha)
+{
+
+	return draw_convert_rgbq_interleaved((u64*)output,1,count,vertices,colours,alpha);
+
+}
+
+int draw_convert_rgbaq(color_t *output, int count, vertex_f_t *vertices, color_f_t *colours)
+{
+
+	return draw_convert_rgbaq_interleaved((u64*)output,1,count,vertices,colours);
+
+}
+
+int draw_convert_st(texel_t *output, int count, vertex_f_t *vertices, texel_f_t *coords)
+{
+
+	return draw_convert_st_interleaved((u64*)output,1,count,vertices,coords);
+
+}
+
+int draw_convert_xyz(xyz_t *output, float x, float y, int z, int count, vertex_f_t *vertices)
+{
+
+	return draw_convert_xyz_interleaved((u64*)output,1,x,y,z,count,vertices);
+
+}
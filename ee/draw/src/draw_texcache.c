@@ -0,0 +1,404 @@
+#include <gs_psm.h>
+
+#include <graph_vram.h>
+
+#include <draw.h>
+#include <draw_texcache.h>
+
+#define TEXCACHE_HASH_SIZE	64
+#define TEXCACHE_NONE		-1
+
+typedef struct {
+	unsigned int handle;
+	void *src;
+	int width;
+	int height;
+	int psm;
+	int address;		// vram address, -1 if not resident
+	int buffer_width;
+	unsigned int frame;	// last frame that the texture was used in
+	int pending;		// needs to be uploaded
+	int hash_next;
+	int newer;			// LRU list
+	int older;
+} texcache_entry_t;
+
+static texcache_entry_t texcache_entries[TEXCACHE_MAX_ENTRIES];
+static int texcache_hash[TEXCACHE_HASH_SIZE];
+static int texcache_free;	// unused entries, linked through hash_next
+static int texcache_mru;
+static int texcache_lru;
+static unsigned int texcache_frame;
+static texcache_stats_t texcache_stats;
+
+static void texcache_unlink(int i)
+{
+
+	texcache_entry_t *e = &texcache_entries[i];
+
+	if (e->newer != TEXCACHE_NONE)
+	{
+		texcache_entries[e->newer].older = e->older;
+	}
+	else
+	{
+		texcache_mru = e->older;
+	}
+
+	if (e->older != TEXCACHE_NONE)
+	{
+		texcache_entries[e->older].newer = e->newer;
+	}
+	else
+	{
+		texcache_lru = e->newer;
+	}
+
+}
+
+static void texcache_link_mru(int i)
+{
+
+	texcache_entry_t *e = &texcache_entries[i];
+
+	e->newer = TEXCACHE_NONE;
+	e->older = texcache_mru;
+
+	if (texcache_mru != TEXCACHE_NONE)
+	{
+		texcache_entries[texcache_mru].newer = i;
+	}
+	else
+	{
+		texcache_lru = i;
+	}
+
+	texcache_mru = i;
+
+}
+
+static int *texcache_find(unsigned int handle)
+{
+
+	int *link = &texcache_hash[handle % TEXCACHE_HASH_SIZE];
+
+	while ((*link != TEXCACHE_NONE) && (texcache_entries[*link].handle != handle))
+	{
+		link = &texcache_entries[*link].hash_next;
+	}
+
+	return link;
+
+}
+
+static void texcache_release(int i)
+{
+
+	texcache_entry_t *e = &texcache_entries[i];
+
+	if (e->address >= 0)
+	{
+		graph_vram_free(e->address);
+	}
+
+	e->address = -1;
+	e->pending = 0;
+
+}
+
+static void texcache_remove(int *link)
+{
+
+	int i = *link;
+
+	texcache_release(i);
+	texcache_unlink(i);
+
+	*link = texcache_entries[i].hash_next;
+	texcache_entries[i].hash_next = texcache_free;
+	texcache_free = i;
+
+}
+
+// Evicts the least recently used texture that isn't used in this frame.
+static int texcache_evict(void)
+{
+
+	int i;
+
+	for (i = texcache_lru; i != TEXCACHE_NONE; i = texcache_entries[i].newer)
+	{
+
+		if (texcache_entries[i].frame == texcache_frame)
+		{
+			// Everything newer was used in this frame as well.
+			return -1;
+		}
+
+		if (texcache_entries[i].address >= 0)
+		{
+
+			texcache_remove(texcache_find(texcache_entries[i].handle));
+			texcache_stats.evictions++;
+			return 0;
+
+		}
+
+	}
+
+	return -1;
+
+}
+
+static int texcache_bytes(int width, int height, int psm)
+{
+
+	switch (psm)
+	{
+
+		case GS_PSM_4:
+		case GS_PSM_4HL:
+		case GS_PSM_4HH:	return (width*height)>>1;
+		case GS_PSM_8:
+		case GS_PSM_8H:		return width*height;
+		case GS_PSM_16:
+		case GS_PSM_16S:
+		case GS_PSMZ_16:
+		case GS_PSMZ_16S:	return (width*height)<<1;
+		case GS_PSM_24:
+		case GS_PSMZ_24:	return width*height*3;
+		default:			return (width*height)<<2;
+
+	}
+
+}
+
+void draw_texcache_init(void)
+{
+
+	int i;
+
+	for (i = 0; i < TEXCACHE_HASH_SIZE; i++)
+	{
+		texcache_hash[i] = TEXCACHE_NONE;
+	}
+
+	for (i = 0; i < TEXCACHE_MAX_ENTRIES; i++)
+	{
+		texcache_entries[i].address = -1;
+		texcache_entries[i].hash_next = (i < TEXCACHE_MAX_ENTRIES - 1) ? i + 1 : TEXCACHE_NONE;
+	}
+
+	texcache_free = 0;
+	texcache_mru = TEXCACHE_NONE;
+	texcache_lru = TEXCACHE_NONE;
+	texcache_frame = 1;
+
+	texcache_stats.hits = 0;
+	texcache_stats.misses = 0;
+	texcache_stats.uploads = 0;
+	texcache_stats.upload_bytes = 0;
+	texcache_stats.evictions = 0;
+	texcache_stats.failures = 0;
+
+}
+
+int draw_texcache_use(texbuffer_t *texbuf, unsigned int handle, void *src, int width, int height, int psm)
+{
+
+	int *link;
+	int i;
+	texcache_entry_t *e;
+
+	link = texcache_find(handle);
+
+	if (*link != TEXCACHE_NONE)
+	{
+
+		i = *link;
+		e = &texcache_entries[i];
+
+		// The handle now refers to different texture data.
+		if ((e->src != src) || (e->width != width) || (e->height != height) || (e->psm != psm))
+		{
+			texcache_release(i);
+		}
+
+		texcache_unlink(i);
+
+	}
+	else
+	{
+
+		// Reuse the least recently used entry if all of them are taken.
+		if ((texcache_free == TEXCACHE_NONE) && ((texcache_lru == TEXCACHE_NONE) || (texcache_entries[texcache_lru].frame == texcache_frame)))
+		{
+			texcache_stats.failures++;
+			return -1;
+		}
+
+		if (texcache_free == TEXCACHE_NONE)
+		{
+
+			if (texcache_entries[texcache_lru].address >= 0)
+			{
+				texcache_stats.evictions++;
+			}
+
+			texcache_remove(texcache_find(texcache_entries[texcache_lru].handle));
+
+		}
+
+		i = texcache_free;
+		e = &texcache_entries[i];
+		texcache_free = e->hash_next;
+
+		e->handle = handle;
+		e->address = -1;
+		e->pending = 0;
+		e->hash_next = texcache_hash[handle % TEXCACHE_HASH_SIZE];
+		texcache_hash[handle % TEXCACHE_HASH_SIZE] = i;
+
+	}
+
+	e->src = src;
+	e->width = width;
+	e->height = height;
+	e->psm = psm;
+	e->frame = texcache_frame;
+
+	texcache_link_mru(i);
+
+	if (e->address >= 0)
+	{
+		texcache_stats.hits++;
+	}
+	else
+	{
+
+		texcache_stats.misses++;
+
+		while ((e->address = graph_vram_allocate(width,height,psm,GRAPH_ALIGN_BLOCK)) < 0)
+		{
+
+			if (texcache_evict() < 0)
+			{
+				texcache_stats.failures++;
+				return -1;
+			}
+
+		}
+
+		e->buffer_width = -64 & (width + 63);
+
+		if ((psm == GS_PSM_8) || (psm == GS_PSM_4) || (psm == GS_PSM_8H) || (psm == GS_PSM_4HL) || (psm == GS_PSM_4HH))
+		{
+			e->buffer_width = -128 & (width + 127);
+		}
+
+		e->pending = 1;
+
+	}
+
+	texbuf->address = e->address;
+	texbuf->width = e->buffer_width;
+	texbuf->psm = psm;
+
+	return 0;
+
+}
+
+qword_t *draw_texcache_upload(qword_t *q)
+{
+
+	int i, uploads = 0;
+	texcache_entry_t *e;
+
+	// The pending textures were all used in this frame, so they are at the MRU end.
+	for (i = texcache_mru; i != TEXCACHE_NONE; i = texcache_entries[i].older)
+	{
+
+		e = &texcache_entries[i];
+
+		if (e->frame != texcache_frame)
+		{
+			break;
+		}
+
+		if (e->pending)
+		{
+
+			q = draw_texture_transfer(q,e->src,e->width,e->height,e->psm,e->address,e->buffer_width);
+
+			texcache_stats.uploads++;
+			texcache_stats.upload_bytes += texcache_bytes(e->width,e->height,e->psm);
+
+			e->pending = 0;
+			uploads++;
+
+		}
+
+	}
+
+	if (uploads)
+	{
+		q = draw_texture_flush(q);
+	}
+
+	return q;
+
+}
+
+void draw_texcache_invalidate(unsigned int handle)
+{
+
+	int *link = texcache_find(handle);
+
+	if (*link != TEXCACHE_NONE)
+	{
+		texcache_remove(link);
+	}
+
+}
+
+void draw_texcache_end_frame(texcache_stats_t *stats)
+{
+
+	int i;
+
+	if (stats)
+	{
+
+		texcache_stats.hit_rate = 100;
+
+		if (texcache_stats.hits + texcache_stats.misses)
+		{
+			texcache_stats.hit_rate = (texcache_stats.hits * 100) / (texcache_stats.hits + texcache_stats.misses);
+		}
+
+		texcache_stats.resident = 0;
+
+		for (i = texcache_mru; i != TEXCACHE_NONE; i = texcache_entries[i].older)
+		{
+
+			if (texcache_entries[i].address >= 0)
+			{
+				texcache_stats.resident++;
+			}
+
+		}
+
+		*stats = texcache_stats;
+
+	}
+
+	texcache_stats.hits = 0;
+	texcache_stats.misses = 0;
+	texcache_stats.uploads = 0;
+	texcache_stats.upload_bytes = 0;
+	texcache_stats.evictions = 0;
+	texcache_stats.failures = 0;
+
+	texcache_frame++;
+
+}
@@ -0,0 +1,334 @@
+/*
+ * Host comparison of the batched 2D primitive builder with the single-primitive functions.
+ *
+ * The same primitives are written with draw_point(), draw_rect_filled() etc.
+ * and with the draw_batch_*() functions. Both GIF streams are replayed into
+ * register writes, and the PRIM, RGBAQ, UV and XYZ2 values at every vertex kick
+ * must be the same. The sizes of both streams are printed.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   gcc -O2 -D_EE -Icommon/include -Iee/kernel/include -Iee/draw/include \
+ *       -Iee/graph/include -Iee/packet/include -Iee/dma/include -Iee/math3d/include \
+ *       ee/draw/test/batch_replay.c ee/draw/src/draw2d.c -lm -o batch_replay
+ *   ./batch_replay
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <draw.h>
+#include <draw_batch.h>
+#include <gif_tags.h>
+#include <gs_gp.h>
+
+#define MAX_QWORDS	200000
+
+typedef struct {
+	int reg;
+	u64 value;
+} reg_write_t;
+
+static qword_t single[MAX_QWORDS];
+static qword_t batched[MAX_QWORDS];
+static qword_t sent[MAX_QWORDS];
+static int sent_qwords = 0;
+
+static reg_write_t writes_single[2*MAX_QWORDS];
+static reg_write_t writes_batched[2*MAX_QWORDS];
+static u64 kicks_single[4*MAX_QWORDS];
+static u64 kicks_batched[4*MAX_QWORDS];
+
+// Replays a GIF stream of PACKED and REGLIST tags into register writes.
+static int replay(qword_t *q, qword_t *end, reg_write_t *out)
+{
+
+	u64 tag, regs;
+	u64 *dw;
+	int n = 0, nloop, flg, nreg, loop, r, reg, count;
+
+	while (q < end)
+	{
+
+		tag = q->dw[0];
+		regs = q->dw[1];
+		q++;
+
+		nloop = tag & 0x7FFF;
+		flg = (tag >> 58) & 3;
+		nreg = (tag >> 60) & 15;
+
+		if (!nreg)
+		{
+			nreg = 16;
+		}
+
+		if (flg == GIF_FLG_PACKED)
+		{
+
+			for (loop = 0; loop < nloop; loop++)
+			{
+				for (r = 0; r < nreg; r++, q++)
+				{
+
+					reg = (regs >> (4*r)) & 15;
+
+					out[n].reg = (reg == GIF_REG_AD) ? (int)q->dw[1] : reg;
+					out[n].value = q->dw[0];
+					n++;
+
+				}
+			}
+
+		}
+		else
+		{
+
+			dw = (u64 *)q;
+			count = 0;
+
+			for (loop = 0; loop < nloop; loop++)
+			{
+				for (r = 0; r < nreg; r++, dw++, count++)
+				{
+
+					reg = (regs >> (4*r)) & 15;
+
+					if (reg != GIF_REG_NOP)
+					{
+						out[n].reg = reg;
+						out[n].value = *dw;
+						n++;
+					}
+
+				}
+			}
+
+			q += (count + 1) / 2;
+
+		}
+
+	}
+
+	return n;
+
+}
+
+// Records the PRIM, RGBAQ, UV and XYZ2 values at every XYZ2 kick.
+static int kicks(reg_write_t *writes, int n, u64 *out)
+{
+
+	u64 prim = 0, rgbaq = 0, uv = 0;
+	int i, k = 0;
+
+	for (i = 0; i < n; i++)
+	{
+
+		switch (writes[i].reg)
+		{
+			case GS_REG_PRIM:	prim = writes[i].value; break;
+			case GS_REG_RGBAQ:	rgbaq = writes[i].value; break;
+			case GS_REG_UV:		uv = writes[i].value; break;
+			case GS_REG_XYZ2:
+				out[k++] = prim;
+				out[k++] = rgbaq;
+				out[k++] = uv;
+				out[k++] = writes[i].value;
+				break;
+		}
+
+	}
+
+	return k;
+
+}
+
+static int compare(qword_t *a, qword_t *a_end, qword_t *b, qword_t *b_end)
+{
+
+	int ka, kb;
+
+	ka = kicks(writes_single, replay(a, a_end, writes_single), kicks_single);
+	kb = kicks(writes_batched, replay(b, b_end, writes_batched), kicks_batched);
+
+	return (ka == kb) && !memcmp(kicks_single, kicks_batched, ka * sizeof(u64));
+
+}
+
+static void send(packet_t *packet, int qwords, void *arg)
+{
+
+	memcpy(&sent[sent_qwords], packet->data, qwords * sizeof(qword_t));
+	sent_qwords += qwords;
+
+}
+
+static int fail(const char *what)
+{
+
+	printf("FAIL: %s\n", what);
+
+	return 1;
+
+}
+
+int main(void)
+{
+
+	packet_t packet;
+	draw_batch_t batch;
+	draw_batch_stats_t stats;
+	qword_t *q, *end;
+	int i, added, context;
+
+	point_t point;
+	line_t line;
+	triangle_t triangle;
+	rect_t rect;
+	texrect_t texrect;
+
+	// 5000 mixed primitives, mostly sprites, with a context change every 500 and blending from the middle on.
+	packet.qwords = 1000;
+	packet.data = batched;
+
+	draw_batch_begin(&batch, &packet, batched);
+	draw_batch_set_send(&batch, send, NULL);
+
+	srand(1);
+	q = single;
+
+	for (i = 0; i < 5000; i++)
+	{
+
+		int kind = (rand() % 10 < 8) ? 3 : rand() % 5;
+
+		context = (i / 500) & 1;
+
+		if (i == 2500)
+		{
+			draw_enable_blending();
+		}
+
+		point.v0.x = rand() % 640; point.v0.y = rand() % 480; point.v0.z = rand();
+		point.color.rgbaq = rand();
+
+		line.v0.x = rand() % 640; line.v0.y = rand() % 480; line.v0.z = 5;
+		line.v1.x = rand() % 640; line.v1.y = rand() % 480; line.v1.z = 5;
+		line.color.rgbaq = rand();
+
+		triangle.v0.x = 1; triangle.v0.y = 2; triangle.v0.z = 3;
+		triangle.v1.x = rand() % 640; triangle.v1.y = 5; triangle.v1.z = 3;
+		triangle.v2.x = 7; triangle.v2.y = rand() % 480; triangle.v2.z = 3;
+		triangle.color.rgbaq = rand();
+
+		rect.v0.x = rand() % 640; rect.v0.y = rand() % 480; rect.v0.z = 9;
+		rect.v1.x = rand() % 640; rect.v1.y = rand() % 480; rect.v1.z = 9;
+		rect.color.rgbaq = rand();
+
+		texrect.v0.x = 1; texrect.v0.y = 2; texrect.v0.z = 3;
+		texrect.t0.u = rand() % 64; texrect.t0.v = 4;
+		texrect.v1.x = 5; texrect.v1.y = 6; texrect.v1.z = 3;
+		texrect.t1.u = 7; texrect.t1.v = rand() % 64;
+		texrect.color.rgbaq = rand();
+
+		switch (kind)
+		{
+			case 0:
+				q = draw_point(q, context, &point);
+				draw_batch_point(&batch, context, &point);
+				break;
+			case 1:
+				q = draw_line(q, context, &line);
+				draw_batch_line(&batch, context, &line);
+				break;
+			case 2:
+				q = draw_triangle_filled(q, context, &triangle);
+				draw_batch_triangle_filled(&batch, context, &triangle);
+				break;
+			case 3:
+				q = draw_rect_filled(q, context, &rect);
+				draw_batch_rect_filled(&batch, context, &rect);
+				break;
+			case 4:
+				q = draw_rect_textured(q, context, &texrect);
+				draw_batch_rect_textured(&batch, context, &texrect);
+				break;
+		}
+
+	}
+
+	draw_batch_get_stats(&batch, &stats);
+
+	end = draw_batch_end(&batch);
+	memcpy(&sent[sent_qwords], batched, (end - batched) * sizeof(qword_t));
+	sent_qwords += end - batched;
+
+	printf("5000 mixed primitives: %d qwords single, %d batched in %u runs and %u sends, %d saved\n",
+		(int)(q - single), sent_qwords, stats.runs, stats.sends, stats.qwords_saved);
+
+	if (!compare(single, q, sent, &sent[sent_qwords]))
+	{
+		return fail("the kicks of the mixed primitives differ");
+	}
+
+	// 100 sprites in one run.
+	draw_disable_blending();
+	draw_batch_begin(&batch, &packet, batched);
+
+	q = single;
+
+	for (i = 0; i < 100; i++)
+	{
+
+		rect.v0.x = i; rect.v0.y = i; rect.v0.z = 1;
+		rect.v1.x = i + 8; rect.v1.y = i + 8; rect.v1.z = 1;
+		rect.color.rgbaq = i;
+
+		q = draw_rect_filled(q, 0, &rect);
+		draw_batch_rect_filled(&batch, 0, &rect);
+
+	}
+
+	end = draw_batch_end(&batch);
+	draw_batch_get_stats(&batch, &stats);
+
+	printf("100 sprites: %d qwords single, %d batched, %d saved\n", (int)(q - single), (int)(end - batched), stats.qwords_saved);
+
+	if (!compare(single, q, batched, end))
+	{
+		return fail("the kicks of the sprites differ");
+	}
+
+	// Without a send function, primitives that don't fit are refused.
+	packet.qwords = 10;
+	draw_batch_begin(&batch, &packet, batched);
+
+	for (i = 0, added = 0; i < 10; i++)
+	{
+
+		rect.v0.x = i; rect.v0.y = i; rect.v0.z = 1;
+		rect.v1.x = i + 8; rect.v1.y = i + 8; rect.v1.z = 1;
+		rect.color.rgbaq = i;
+
+		if (draw_batch_rect_filled(&batch, 0, &rect) == 0)
+		{
+			added++;
+		}
+
+	}
+
+	end = draw_batch_end(&batch);
+
+	printf("10-qword packet without a send function: %d sprites added, %d qwords\n", added, (int)(end - batched));
+
+	if ((end - batched) > packet.qwords)
+	{
+		return fail("the packet overflowed");
+	}
+
+	printf("OK\n");
+
+	return 0;
+
+}
@@ -0,0 +1,462 @@
+/*
+ * Host test and benchmark of the vertex conversion kernels in draw3d.c.
+ *
+ * The one-vertex-at-a-time versions from before the kernels are copied below.
+ * For random batches of 0 to 1000 vertices, with w = 0 now and then so that q
+ * carries over, both versions must give the same doublewords, bit for bit.
+ * The interleaved kernels are run with strides of 2 and 3 and must leave the
+ * doublewords in between alone, and draw_convert_rgbq_xyz() must give the same
+ * regList data as the separate conversions.
+ *
+ * Batches of 10000 vertices are then converted with both versions, and the
+ * fastest of 500 batches is printed for each. For the regList data, the old
+ * way is to convert the colours and vertices into arrays and copy them into
+ * the packet.
+ *
+ * Build and run from the root of the tree. The -Wno option is for the address
+ * helpers in tamtypes.h:
+ *
+ *   gcc -O2 -Wall -Wno-int-to-pointer-cast -D_EE -Icommon/include -Iee/kernel/include \
+ *       -Iee/draw/include -Iee/graph/include -Iee/packet/include -Iee/dma/include \
+ *       -Iee/math3d/include ee/draw/test/convert_bench.c ee/draw/src/draw3d.c -lm -o convert_bench
+ *   ./convert_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <draw.h>
+#include <draw3d.h>
+
+#define MAX_VERTICES	10000
+#define CASES		2000
+#define BENCH_ROUNDS	500
+#define SENTINEL	0x5555555555555555ull
+
+static vertex_f_t vertices[MAX_VERTICES];
+static color_f_t colours[MAX_VERTICES];
+static texel_f_t coords[MAX_VERTICES];
+
+static u64 expected[MAX_VERTICES];
+static u64 expected_xyz[MAX_VERTICES];
+static u64 output[3*MAX_VERTICES];
+static qword_t packet[MAX_VERTICES];
+
+static int errors = 0;
+
+static void error(const char *what, int count, int i)
+{
+
+	if (errors++ < 10)
+	{
+		printf("error: %s, %d vertices, vertex %d\n", what, count, i);
+	}
+
+}
+
+static double seconds(void)
+{
+
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+
+}
+
+// draw_convert_rgbq(), draw_convert_rgbaq(), draw_convert_st() and draw_convert_xyz()
+// from before the conversion kernels.
+static int ref_convert_rgbq(color_t *output, int count, vertex_f_t *vertices, color_f_t *colours, unsigned char alpha)
+{
+
+	int i;
+	float q = 1.00f;
+
+	// For each colour...
+	for (i=0;i<count;i++)
+	{
+
+		// Calculate the Q value.
+		if (vertices[i].w != 0)
+		{
+
+			q = 1 / vertices[i].w;
+
+		}
+
+		// Calculate the RGBA values.
+		output[i].r = (int)(colours[i].r * 128.0f);
+		output[i].g = (int)(colours[i].g * 128.0f);
+		output[i].b = (int)(colours[i].b * 128.0f);
+		output[i].a = alpha;
+		output[i].q = q;
+
+	}
+
+	// End function.
+	return 0;
+
+}
+
+static int ref_convert_rgbaq(color_t *output, int count, vertex_f_t *vertices, color_f_t *colours)
+{
+
+	int i;
+	float q = 1.00f;
+
+	// For each colour...
+	for (i=0;i<count;i++)
+	{
+
+		// Calculate the Q value.
+		if (vertices[i].w != 0)
+		{
+
+			q = 1 / vertices[i].w;
+
+		}
+
+		// Calculate the RGBA values.
+		output[i].r = (int)(colours[i].r * 128.0f);
+		output[i].g = (int)(colours[i].g * 128.0f);
+		output[i].b = (int)(colours[i].b * 128.0f);
+		output[i].a = (int)(colours[i].a * 128.0f);
+		output[i].q = q;
+
+	}
+
+	// End function.
+	return 0;
+
+}
+
+static int ref_convert_st(texel_t *output, int count, vertex_f_t *vertices, texel_f_t *coords)
+{
+
+	int i = 0;
+	float q = 1.00f;
+
+	// For each coordinate...
+	for (i=0;i<count;i++)
+	{
+
+		// Calculate the Q value.
+		if (vertices[i].w != 0)
+		{
+			q = 1 / vertices[i].w;
+		}
+
+		// Calculate the S and T values.
+		output[i].s = coords[i].s * q;
+		output[i].t = coords[i].t * q;
+
+	}
+
+	// End function.
+	return 0;
+
+}
+
+static int ref_convert_xyz(xyz_t *output, float x, float y, int z, int count, vertex_f_t *vertices)
+{
+
+	int i;
+
+	int center_x;
+	int center_y;
+
+	unsigned int max_z;
+
+	center_x = ftoi4(x);
+	center_y = ftoi4(y);
+
+	// 1u, so that the shift is defined for a 32-bit z.
+	max_z = 1u << (z - 1);
+
+	// For each colour...
+	for (i=0;i<count;i++)
+	{
+
+		// Calculate the XYZ values.
+		output[i].x = (short)((vertices[i].x + 1.0f) * center_x);
+		output[i].y = (short)((vertices[i].y + 1.0f) * -center_y);
+		output[i].z = (unsigned int)((vertices[i].z + 1.0f) * max_z);
+
+	}
+
+	// End function.
+	return 0;
+
+}
+
+static float random_float(float min, float max)
+{
+
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+
+}
+
+static void random_vertices(int count)
+{
+
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+
+		vertices[i].x = random_float(-1.0f, 1.0f);
+		vertices[i].y = random_float(-1.0f, 1.0f);
+		vertices[i].z = random_float(-1.0f, 0.999f);
+		vertices[i].w = (rand() % 5 == 0) ? 0.0f : random_float(0.1f, 100.0f);
+
+		colours[i].r = random_float(0.0f, 1.99f);
+		colours[i].g = random_float(0.0f, 1.99f);
+		colours[i].b = random_float(0.0f, 1.99f);
+		colours[i].a = random_float(0.0f, 1.99f);
+
+		coords[i].s = random_float(0.0f, 1.0f);
+		coords[i].t = random_float(0.0f, 1.0f);
+
+	}
+
+}
+
+// Checks output at the given stride against expected, and that the doublewords in between are untouched.
+static void compare(const char *what, int count, int stride)
+{
+
+	int i, j;
+
+	for (i = 0; i < count; i++)
+	{
+
+		if (output[i*stride] != expected[i])
+		{
+			error(what, count, i);
+			return;
+		}
+
+		for (j = 1; j < stride; j++)
+		{
+			if (output[i*stride + j] != SENTINEL)
+			{
+				error("a doubleword in between was written", count, i);
+				return;
+			}
+		}
+
+	}
+
+	if (output[count*stride] != SENTINEL)
+	{
+		error("a doubleword after the output was written", count, count);
+	}
+
+}
+
+static void clear(void)
+{
+
+	int i;
+
+	for (i = 0; i < 3*MAX_VERTICES; i++)
+	{
+		output[i] = SENTINEL;
+	}
+
+}
+
+static void check_batch(int count)
+{
+
+	static const int z_bits[3] = { 16, 24, 32 };
+	int stride, i, z;
+	float x, y;
+
+	for (stride = 1; stride <= 3; stride++)
+	{
+
+		ref_convert_rgbq((color_t *)expected, count, vertices, colours, 0x80);
+		clear();
+		if (stride == 1)
+			draw_convert_rgbq((color_t *)output, count, vertices, colours, 0x80);
+		else
+			draw_convert_rgbq_interleaved(output, stride, count, vertices, colours, 0x80);
+		compare("rgbq is different", count, stride);
+
+		ref_convert_rgbaq((color_t *)expected, count, vertices, colours);
+		clear();
+		if (stride == 1)
+			draw_convert_rgbaq((color_t *)output, count, vertices, colours);
+		else
+			draw_convert_rgbaq_interleaved(output, stride, count, vertices, colours);
+		compare("rgbaq is different", count, stride);
+
+		ref_convert_st((texel_t *)expected, count, vertices, coords);
+		clear();
+		if (stride == 1)
+			draw_convert_st((texel_t *)output, count, vertices, coords);
+		else
+			draw_convert_st_interleaved(output, stride, count, vertices, coords);
+		compare("st is different", count, stride);
+
+		for (i = 0; i < 3; i++)
+		{
+
+			// Small enough for x and y to fit the casts to short.
+			x = random_float(0.0f, 1000.0f);
+			y = random_float(0.0f, 1000.0f);
+			z = z_bits[i];
+
+			ref_convert_xyz((xyz_t *)expected, x, y, z, count, vertices);
+			clear();
+			if (stride == 1)
+				draw_convert_xyz((xyz_t *)output, x, y, z, count, vertices);
+			else
+				draw_convert_xyz_interleaved(output, stride, x, y, z, count, vertices);
+			compare("xyz is different", count, stride);
+
+		}
+
+	}
+
+	ref_convert_rgbq((color_t *)expected, count, vertices, colours, 0x40);
+	ref_convert_xyz((xyz_t *)expected_xyz, 320.0f, 224.0f, 24, count, vertices);
+
+	if (draw_convert_rgbq_xyz(packet, 320.0f, 224.0f, 24, count, vertices, colours, 0x40) != packet + count)
+	{
+		error("draw_convert_rgbq_xyz returned the wrong qword", count, count);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if ((packet[i].dw[0] != expected[i]) || (packet[i].dw[1] != expected_xyz[i]))
+		{
+			error("the regList data is different", count, i);
+			break;
+		}
+	}
+
+}
+
+// Converts one batch of vertices, the old way for even kernels and the new way for odd ones.
+static void convert_batch(int kernel)
+{
+
+	int i;
+
+	switch (kernel)
+	{
+		case 0:
+			ref_convert_rgbq((color_t *)output, MAX_VERTICES, vertices, colours, 0x80);
+			break;
+		case 1:
+			draw_convert_rgbq((color_t *)output, MAX_VERTICES, vertices, colours, 0x80);
+			break;
+		case 2:
+			ref_convert_st((texel_t *)output, MAX_VERTICES, vertices, coords);
+			break;
+		case 3:
+			draw_convert_st((texel_t *)output, MAX_VERTICES, vertices, coords);
+			break;
+		case 4:
+			ref_convert_xyz((xyz_t *)output, 320.0f, 224.0f, 24, MAX_VERTICES, vertices);
+			break;
+		case 5:
+			draw_convert_xyz((xyz_t *)output, 320.0f, 224.0f, 24, MAX_VERTICES, vertices);
+			break;
+		case 6:
+			ref_convert_rgbq((color_t *)expected, MAX_VERTICES, vertices, colours, 0x80);
+			ref_convert_xyz((xyz_t *)expected_xyz, 320.0f, 224.0f, 24, MAX_VERTICES, vertices);
+			for (i = 0; i < MAX_VERTICES; i++)
+			{
+				packet[i].dw[0] = expected[i];
+				packet[i].dw[1] = expected_xyz[i];
+			}
+			break;
+		case 7:
+			draw_convert_rgbq_xyz(packet, 320.0f, 224.0f, 24, MAX_VERTICES, vertices, colours, 0x80);
+			break;
+	}
+
+}
+
+static void benchmark(void)
+{
+
+	static const char *names[4] = { "rgbq", "st", "xyz", "rgbq + xyz" };
+	double best[8], t;
+	int round, kernel;
+
+	random_vertices(MAX_VERTICES);
+
+	// The rounds of all the kernels are interleaved, and the fastest round of each is kept.
+	for (kernel = 0; kernel < 8; kernel++)
+	{
+		best[kernel] = 1e9;
+	}
+
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		for (kernel = 0; kernel < 8; kernel++)
+		{
+
+			t = seconds();
+			convert_batch(kernel);
+			t = seconds() - t;
+
+			if (t < best[kernel])
+			{
+				best[kernel] = t;
+			}
+
+		}
+	}
+
+	printf("%d vertices per batch, million vertices per second, old and new:\n", MAX_VERTICES);
+
+	for (kernel = 0; kernel < 8; kernel += 2)
+	{
+		printf("%-10s %7.1f %7.1f\n", names[kernel/2], MAX_VERTICES / 1e6 / best[kernel], MAX_VERTICES / 1e6 / best[kernel+1]);
+	}
+
+}
+
+int main(void)
+{
+
+	int n, count;
+
+	srand(5);
+
+	for (count = 0; count <= 9; count++)
+	{
+		random_vertices(count);
+		check_batch(count);
+	}
+
+	for (n = 0; n < CASES; n++)
+	{
+		count = rand() % 1001;
+		random_vertices(count);
+		check_batch(count);
+	}
+
+	// Leading vertices with w = 0 keep q at 1.
+	random_vertices(16);
+	for (n = 0; n < 6; n++)
+	{
+		vertices[n].w = 0.0f;
+	}
+	check_batch(16);
+
+	benchmark();
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return (errors ? 1 : 0);
+
+}
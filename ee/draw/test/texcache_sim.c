@@ -0,0 +1,221 @@
+/*
+ * Host simulation of the texture residency cache in draw_texcache.c.
+ *
+ * The cache runs over the real graph_vram allocator, with two 640x448 frame
+ * buffers allocated first. draw_texture_transfer() and draw_texture_flush()
+ * are stubbed to count transfers. The simulation covers a working set that
+ * shifts across frames, a frame that uses more textures than fit in vram,
+ * running out of cache entries, changed sources and 24-bit textures.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   gcc -O2 -D_EE -Icommon/include -Iee/kernel/include -Iee/draw/include \
+ *       -Iee/graph/include -Iee/packet/include -Iee/dma/include -Iee/math3d/include \
+ *       ee/draw/test/texcache_sim.c ee/draw/src/draw_texcache.c ee/graph/src/graph_vram.c \
+ *       -o texcache_sim
+ *   ./texcache_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <draw.h>
+#include <draw_texcache.h>
+#include <gs_psm.h>
+#include <graph_vram.h>
+
+static int transfers = 0;
+
+qword_t *draw_texture_transfer(qword_t *q, void *src, int width, int height, int psm, int dest, int dest_width)
+{
+
+	transfers++;
+
+	return q + 1;
+
+}
+
+qword_t *draw_texture_flush(qword_t *q)
+{
+
+	return q + 1;
+
+}
+
+static qword_t packet[4096];
+
+static void *source(unsigned int handle)
+{
+
+	return (void *)(unsigned long)(handle * 0x10000 + 0x100000);
+
+}
+
+static void print_stats(const char *label, texcache_stats_t *stats)
+{
+
+	printf("%s: hits %u misses %u rate %u%% uploads %u bytes %u evictions %u failures %u resident %u\n",
+		label, stats->hits, stats->misses, stats->hit_rate, stats->uploads, stats->upload_bytes,
+		stats->evictions, stats->failures, stats->resident);
+
+}
+
+static int fail(const char *what)
+{
+
+	printf("FAIL: %s\n", what);
+
+	return 1;
+
+}
+
+int main(void)
+{
+
+	texbuffer_t texbuf;
+	texcache_stats_t stats;
+	unsigned int hits = 0, misses = 0;
+	int frame, i, handle, failures, used[64];
+	char label[32];
+
+	graph_vram_clear();
+	graph_vram_allocate(640, 448, GS_PSM_32, GRAPH_ALIGN_PAGE);
+	graph_vram_allocate(640, 448, GS_PSM_32, GRAPH_ALIGN_PAGE);
+
+	draw_texcache_init();
+
+	// A working set of 256x256 32-bit textures that moves every 50 frames, about 7 fit in vram.
+	srand(5);
+
+	for (frame = 0; frame < 300; frame++)
+	{
+
+		for (i = 0; i < 64; i++)
+		{
+			used[i] = 0;
+		}
+
+		for (i = 0; i < 5; i++)
+		{
+
+			handle = (frame / 50) * 3 + (rand() % ((i < 3) ? 3 : 20));
+
+			if (used[handle])
+			{
+				continue;
+			}
+
+			used[handle] = 1;
+
+			if (draw_texcache_use(&texbuf, handle, source(handle), 256, 256, GS_PSM_32) < 0)
+			{
+				return fail("texture of the working set not made resident");
+			}
+
+			if (texbuf.address % GRAPH_ALIGN_BLOCK)
+			{
+				return fail("misaligned texture");
+			}
+
+		}
+
+		draw_texcache_upload(packet);
+		draw_texcache_end_frame(&stats);
+
+		hits += stats.hits;
+		misses += stats.misses;
+
+		if ((frame % 50) == 49)
+		{
+			sprintf(label, "frame %d", frame);
+			print_stats(label, &stats);
+		}
+
+	}
+
+	printf("300 frames: %u hits, %u misses, %d transfers\n", hits, misses, transfers);
+
+	// A frame that needs more textures than fit: only textures of earlier frames are evicted.
+	failures = 0;
+
+	for (handle = 100; handle < 120; handle++)
+	{
+
+		if (draw_texcache_use(&texbuf, handle, source(handle), 256, 256, GS_PSM_32) < 0)
+		{
+			failures++;
+		}
+
+	}
+
+	draw_texcache_upload(packet);
+	draw_texcache_end_frame(&stats);
+	print_stats("overcommitted frame", &stats);
+
+	if ((stats.failures != failures) || (stats.misses != 20) || (stats.resident != 20 - failures))
+	{
+		return fail("overcommitted frame");
+	}
+
+	// A changed source is uploaded again, an unchanged one is not.
+	draw_texcache_use(&texbuf, 100, source(100), 256, 256, GS_PSM_32);
+	draw_texcache_use(&texbuf, 101, source(200), 256, 256, GS_PSM_32);
+	draw_texcache_upload(packet);
+	draw_texcache_end_frame(&stats);
+	print_stats("changed source", &stats);
+
+	if ((stats.hits != 1) || (stats.uploads != 1))
+	{
+		return fail("changed source");
+	}
+
+	// 24-bit textures are uploaded at 3 bytes per pixel.
+	draw_texcache_init();
+	graph_vram_clear();
+
+	draw_texcache_use(&texbuf, 1, source(1), 256, 256, GS_PSM_24);
+	draw_texcache_use(&texbuf, 2, source(2), 256, 256, GS_PSM_16);
+	draw_texcache_upload(packet);
+	draw_texcache_end_frame(&stats);
+	print_stats("24 and 16-bit", &stats);
+
+	if (stats.upload_bytes != 256 * 256 * 3 + 256 * 256 * 2)
+	{
+		return fail("upload bytes of 24 and 16-bit textures");
+	}
+
+	// Running out of cache entries within a frame, and replacing all of them in the next frame.
+	draw_texcache_init();
+	graph_vram_clear();
+
+	for (handle = 0; handle < 200; handle++)
+	{
+		draw_texcache_use(&texbuf, handle, source(handle), 8, 8, GS_PSM_32);
+	}
+
+	draw_texcache_end_frame(&stats);
+	print_stats("200 textures", &stats);
+
+	if ((stats.resident != TEXCACHE_MAX_ENTRIES) || (stats.failures != 200 - TEXCACHE_MAX_ENTRIES))
+	{
+		return fail("running out of entries");
+	}
+
+	for (handle = 200; handle < 300; handle++)
+	{
+		draw_texcache_use(&texbuf, handle, source(handle), 8, 8, GS_PSM_32);
+	}
+
+	draw_texcache_end_frame(&stats);
+	print_stats("100 new textures", &stats);
+
+	if ((stats.failures != 0) || (stats.evictions != 100))
+	{
+		return fail("replacing entries");
+	}
+
+	printf("OK\n");
+
+	return 0;
+
+}
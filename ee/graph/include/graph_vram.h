@@ -15,19 +15,45 @@
 /** Texture Buffer and CLUT Buffer */
 #define GRAPH_ALIGN_BLOCK    64
 
+/** Maximum number of simultaneous allocations */
+#define GRAPH_VRAM_MAX_AREAS 256
+
+typedef struct {
+	/** Allocated words */
+	int used;
+	/** Free words */
+	int free;
+	/** Largest contiguous free area in words */
+	int largest_free;
+	/** Number of allocations */
+	int areas;
+	/** Number of failed allocations since the last clear */
+	int failures;
+} GRAPH_VRAM_STATS;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/** Allocates vram and returns vram base pointer */
+/** Allocates vram and returns vram base pointer, or -1 if there is no room. */
 int graph_vram_allocate(int width, int height, int psm, int alignment);
 
-/** Frees in FIFO order... */
+/** Frees the allocation at address. */
 void graph_vram_free(int address);
 
 /** Clears the vram status */
 void graph_vram_clear(void);
 
+/** Returns the address of an allocation that can be moved to a lower address, or -1 if none can. */
+int graph_vram_compact_hint(void);
+
+/** Allocates a new area below the allocation at address and returns it, or -1 if there is none.
+ *  Copy the contents to the new area, then free the old address. */
+int graph_vram_move(int address);
+
+/** Retrieves vram usage statistics. */
+void graph_vram_get_stats(GRAPH_VRAM_STATS *stats);
+
 /** Calculate the size in vram of a texture or buffer */
 int graph_vram_size(int width, int height, int psm, int alignment);
 
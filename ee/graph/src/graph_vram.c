@@ -2,42 +2,249 @@
 
 #include <graph_vram.h>
 
-static int graph_vram_pointer = 0;
+// Allocated areas, sorted by address. Everything in between is free.
+typedef struct {
+	int address;
+	int size;
+	int alignment;
+} GRAPH_VRAM_AREA;
+
+static GRAPH_VRAM_AREA graph_vram_areas[GRAPH_VRAM_MAX_AREAS];
+static int graph_vram_count = 0;
+static int graph_vram_failures = 0;
+
+// Finds a free area of size words, aligned to alignment, that ends at or below limit.
+// The smallest gap that fits is used, to keep large gaps for frame buffers and large
+// textures. Ties go to the lowest address.
+static int graph_vram_find(int size, int alignment, int limit, int *index)
+{
+
+	int i, start, end, address;
+	int best = -1, best_waste = 0;
+
+	start = 0;
+
+	for (i = 0; i <= graph_vram_count; i++)
+	{
+
+		end = (i < graph_vram_count) ? graph_vram_areas[i].address : GRAPH_VRAM_MAX_WORDS;
+
+		address = -alignment & (start + (alignment-1));
+
+		if ((address + size <= end) && (address + size <= limit))
+		{
+
+			if ((best < 0) || ((end - start) - size < best_waste))
+			{
+				best = address;
+				best_waste = (end - start) - size;
+				*index = i;
+			}
+
+		}
+
+		if (i < graph_vram_count)
+		{
+			start = graph_vram_areas[i].address + graph_vram_areas[i].size;
+		}
+
+	}
+
+	return best;
+
+}
+
+static int graph_vram_insert(int index, int address, int size, int alignment)
+{
+
+	int i;
+
+	if (graph_vram_count >= GRAPH_VRAM_MAX_AREAS)
+	{
+		return -1;
+	}
+
+	for (i = graph_vram_count; i > index; i--)
+	{
+		graph_vram_areas[i] = graph_vram_areas[i-1];
+	}
+
+	graph_vram_areas[index].address = address;
+	graph_vram_areas[index].size = size;
+	graph_vram_areas[index].alignment = alignment;
+	graph_vram_count++;
+
+	return address;
+
+}
+
+static int graph_vram_lookup(int address)
+{
+
+	int low = 0, high = graph_vram_count - 1, middle;
+
+	while (low <= high)
+	{
+
+		middle = (low + high) / 2;
+
+		if (graph_vram_areas[middle].address == address)
+		{
+			return middle;
+		}
+
+		if (graph_vram_areas[middle].address < address)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+
+	}
+
+	return -1;
+
+}
 
 int graph_vram_allocate(int width, int height, int psm, int alignment)
 {
 
-	int size;
+	int size, address, index = 0;
 
-	// Calculate the size and increment the pointer
+	// Calculate the size
 	size = graph_vram_size(width,height,psm,alignment);
 
-	graph_vram_pointer += size;
+	// An empty buffer is placed after the last allocation, so that the rest
+	// of vram can be used as scratch space.
+	if (size == 0)
+	{
+
+		address = 0;
+
+		if (graph_vram_count > 0)
+		{
+			address = graph_vram_areas[graph_vram_count-1].address + graph_vram_areas[graph_vram_count-1].size;
+		}
+
+		return -alignment & (address + (alignment-1));
+
+	}
+
+	address = graph_vram_find(size, alignment, GRAPH_VRAM_MAX_WORDS, &index);
 
-	// If the pointer overflows the vram size
-	if (graph_vram_pointer > GRAPH_VRAM_MAX_WORDS)
+	if ((address < 0) || (graph_vram_insert(index, address, size, alignment) < 0))
 	{
 
-		graph_vram_pointer -= size;
+		graph_vram_failures++;
 		return -1;
 
 	}
 
-	return graph_vram_pointer - size;
+	return address;
 
 }
 
 void graph_vram_free(int address)
 {
 
-	graph_vram_pointer = address;
+	int i;
+
+	if ((i = graph_vram_lookup(address)) < 0)
+	{
+		return;
+	}
+
+	graph_vram_count--;
+
+	for (; i < graph_vram_count; i++)
+	{
+		graph_vram_areas[i] = graph_vram_areas[i+1];
+	}
 
 }
 
 void graph_vram_clear(void)
 {
 
-	graph_vram_pointer = 0;
+	graph_vram_count = 0;
+	graph_vram_failures = 0;
+
+}
+
+int graph_vram_compact_hint(void)
+{
+
+	int i, index;
+
+	// The lowest allocation that fits into a free area below it.
+	for (i = 0; i < graph_vram_count; i++)
+	{
+
+		if (graph_vram_find(graph_vram_areas[i].size, graph_vram_areas[i].alignment, graph_vram_areas[i].address, &index) >= 0)
+		{
+			return graph_vram_areas[i].address;
+		}
+
+	}
+
+	return -1;
+
+}
+
+int graph_vram_move(int address)
+{
+
+	int i, index, new_address;
+
+	if ((i = graph_vram_lookup(address)) < 0)
+	{
+		return -1;
+	}
+
+	new_address = graph_vram_find(graph_vram_areas[i].size, graph_vram_areas[i].alignment, address, &index);
+
+	if (new_address < 0)
+	{
+		return -1;
+	}
+
+	return graph_vram_insert(index, new_address, graph_vram_areas[i].size, graph_vram_areas[i].alignment);
+
+}
+
+void graph_vram_get_stats(GRAPH_VRAM_STATS *stats)
+{
+
+	int i, start, end;
+
+	stats->used = 0;
+	stats->largest_free = 0;
+	stats->areas = graph_vram_count;
+	stats->failures = graph_vram_failures;
+
+	start = 0;
+
+	for (i = 0; i <= graph_vram_count; i++)
+	{
+
+		end = (i < graph_vram_count) ? graph_vram_areas[i].address : GRAPH_VRAM_MAX_WORDS;
+
+		if (end - start > stats->largest_free)
+		{
+			stats->largest_free = end - start;
+		}
+
+		if (i < graph_vram_count)
+		{
+			stats->used += graph_vram_areas[i].size;
+			start = graph_vram_areas[i].address + graph_vram_areas[i].size;
+		}
+
+	}
+
+	stats->free = GRAPH_VRAM_MAX_WORDS - stats->used;
 
 }
 
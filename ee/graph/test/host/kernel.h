@@ -0,0 +1,8 @@
+/* Host stand-in for the EE kernel.h, with the macro used by libgs/src/texture.c. */
+
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#define UNCACHED_SEG(x)	(x)
+
+#endif /* __KERNEL_H__ */
@@ -0,0 +1,374 @@
+/*
+ * Host test for the vram allocators in graph_vram.c and in libgs/src/texture.c.
+ *
+ * A random trace of allocations, frees and compaction passes is run against the
+ * graph allocator. A shadow list of the live areas is used to check that areas
+ * never overlap or run past the end of vram, that they keep their alignment,
+ * that graph_vram_move() only moves areas down and that the statistics match.
+ *
+ * A random trace of texture buffer allocations and frees is then run against
+ * libgs, above two frame buffers, with the same checks. Allocating a frame
+ * buffer while texture buffers are live must fail and leave them alone. Once
+ * they are all freed, a frame buffer goes above the others again.
+ *
+ * Build and run from the root of the tree. The -Wno option is for the address
+ * helpers in tamtypes.h:
+ *
+ *   gcc -O2 -Wall -Wno-int-to-pointer-cast -D_EE \
+ *       -Iee/graph/test/host -Icommon/include -Iee/graph/include -Iee/libgs/include \
+ *       ee/graph/test/vram_trace.c ee/graph/src/graph_vram.c ee/libgs/src/texture.c -o vram_trace
+ *   ./vram_trace [seed]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gs_psm.h>
+#include <graph_vram.h>
+#include <libgs.h>
+
+#define MAX_LIVE	200
+#define STEPS		200000
+
+#define GS_VRAM_WORDS	(1024 * 1024)
+#define FB_WIDTH	640
+#define FB_HEIGHT	448
+
+/* Only GsLoadImage() in texture.c sends anything to the GS. */
+QWORD GsPrimWorkArea[1];
+
+void GsDmaSend(const void *addr, u32 qwords)
+{
+
+}
+
+void GsDmaWait(void)
+{
+
+}
+
+static int live_address[MAX_LIVE];
+static int live_size[MAX_LIVE];
+static int live = 0;
+
+static int fail(const char *what, int step)
+{
+
+	printf("FAIL: %s at step %d\n", what, step);
+
+	return 1;
+
+}
+
+static int check_stats(void)
+{
+
+	GRAPH_VRAM_STATS stats;
+	int i, used = 0;
+
+	graph_vram_get_stats(&stats);
+
+	for (i = 0; i < live; i++)
+	{
+		used += live_size[i];
+	}
+
+	return (stats.used == used) && (stats.areas == live) && (stats.used + stats.free == GRAPH_VRAM_MAX_WORDS);
+
+}
+
+static int compact(int step, int *moves)
+{
+
+	int i, from, to;
+
+	while ((from = graph_vram_compact_hint()) >= 0)
+	{
+
+		to = graph_vram_move(from);
+
+		if ((to < 0) || (to >= from))
+		{
+			return fail("graph_vram_move did not move the area down", step);
+		}
+
+		graph_vram_free(from);
+
+		for (i = 0; i < live; i++)
+		{
+			if (live_address[i] == from)
+			{
+				live_address[i] = to;
+			}
+		}
+
+		(*moves)++;
+
+	}
+
+	return 0;
+
+}
+
+static int graph_trace(void)
+{
+
+	GRAPH_VRAM_STATS stats;
+	int step, i, width, height, alignment, address, size;
+	int failures = 0, moves = 0;
+
+	for (step = 0; step < STEPS; step++)
+	{
+
+		if ((live < MAX_LIVE) && (rand() % 3))
+		{
+
+			width = 16 << (rand() % 5);
+			height = 16 << (rand() % 5);
+			alignment = (rand() % 4 == 0) ? GRAPH_ALIGN_PAGE : GRAPH_ALIGN_BLOCK;
+
+			if ((address = graph_vram_allocate(width, height, GS_PSM_32, alignment)) < 0)
+			{
+				failures++;
+				continue;
+			}
+
+			size = graph_vram_size(width, height, GS_PSM_32, alignment);
+
+			if (address % alignment)
+			{
+				return fail("misaligned area", step);
+			}
+
+			if (address + size > GRAPH_VRAM_MAX_WORDS)
+			{
+				return fail("area past the end of vram", step);
+			}
+
+			for (i = 0; i < live; i++)
+			{
+				if ((address < live_address[i] + live_size[i]) && (live_address[i] < address + size))
+				{
+					return fail("overlapping areas", step);
+				}
+			}
+
+			live_address[live] = address;
+			live_size[live] = size;
+			live++;
+
+		}
+		else if (live)
+		{
+
+			i = rand() % live;
+			graph_vram_free(live_address[i]);
+
+			live--;
+			live_address[i] = live_address[live];
+			live_size[i] = live_size[live];
+
+		}
+
+		if ((step % 1000) == 0)
+		{
+
+			if (compact(step, &moves))
+			{
+				return 1;
+			}
+
+			if (!check_stats())
+			{
+				return fail("statistics don't match", step);
+			}
+
+		}
+
+	}
+
+	graph_vram_get_stats(&stats);
+
+	printf("%d steps, %d failed allocations, %d areas moved by compaction\n", STEPS, failures, moves);
+	printf("used %d, free %d, largest free %d, areas %d\n", stats.used, stats.free, stats.largest_free, stats.areas);
+
+	return 0;
+
+}
+
+static int libgs_overlaps(int address, int size, int fb_end)
+{
+
+	int i;
+
+	if (address < fb_end)
+	{
+		return 1;
+	}
+
+	for (i = 0; i < live; i++)
+	{
+		if ((address < live_address[i] + live_size[i]) && (live_address[i] < address + size))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+
+}
+
+static int libgs_check_stats(int fb_end)
+{
+
+	GS_VRAM_STATS stats;
+	int i, used = 0;
+
+	GsVramGetStats(&stats);
+
+	for (i = 0; i < live; i++)
+	{
+		used += live_size[i];
+	}
+
+	return (stats.fb_used == fb_end) && (stats.tex_used == used) && (stats.tex_count == live) &&
+		(stats.fb_used + stats.tex_used + stats.tex_free == GS_VRAM_WORDS);
+
+}
+
+static int libgs_trace(void)
+{
+
+	static const int psm[3] = { GS_PIXMODE_32, GS_TEX_8, GS_TEX_4 };
+	static const int divisor[3] = { 1, 4, 2 };	/* texture.c gives 4-bit textures half a word per pixel */
+	GS_VRAM_STATS stats;
+	int step, i, width, height, kind, tbp, address, size, fb_end;
+	int failures = 0;
+
+	live = 0;
+	GsVramFreeAll();
+
+	if ((GsVramAllocFrameBuffer(FB_WIDTH, FB_HEIGHT, GS_PIXMODE_32) != 0) ||
+		(GsVramAllocFrameBuffer(FB_WIDTH, FB_HEIGHT, GS_PIXMODE_32) * 2048 != FB_WIDTH * FB_HEIGHT))
+	{
+		return fail("libgs frame buffers not at the start of vram", 0);
+	}
+
+	fb_end = 2 * FB_WIDTH * FB_HEIGHT;
+
+	for (step = 0; step < STEPS; step++)
+	{
+
+		if ((live < MAX_LIVE) && (rand() % 3))
+		{
+
+			width = 16 << (rand() % 5);
+			height = 16 << (rand() % 5);
+			kind = rand() % 3;
+
+			if ((tbp = GsVramAllocTextureBuffer(width, height, psm[kind])) < 0)
+			{
+				failures++;
+				continue;
+			}
+
+			address = tbp * 64;
+			size = ((width * height / divisor[kind]) + 63) & ~63;
+
+			if (address + size > GS_VRAM_WORDS)
+			{
+				return fail("libgs texture buffer past the end of vram", step);
+			}
+
+			if (libgs_overlaps(address, size, fb_end))
+			{
+				return fail("overlapping libgs buffers", step);
+			}
+
+			live_address[live] = address;
+			live_size[live] = size;
+			live++;
+
+		}
+		else if (live)
+		{
+
+			i = rand() % live;
+			GsVramFreeTextureBuffer(live_address[i] / 64);
+
+			live--;
+			live_address[i] = live_address[live];
+			live_size[i] = live_size[live];
+
+		}
+
+		if ((step % 1000) == 0)
+		{
+
+			if (!libgs_check_stats(fb_end))
+			{
+				return fail("libgs statistics don't match", step);
+			}
+
+		}
+
+		if ((step % 50000) == 0 && live)
+		{
+
+			if (GsVramAllocFrameBuffer(FB_WIDTH, FB_HEIGHT, GS_PIXMODE_32) != -EBUSY)
+			{
+				return fail("libgs frame buffer allocated above live texture buffers", step);
+			}
+
+			if (!libgs_check_stats(fb_end))
+			{
+				return fail("libgs frame buffer allocation changed the texture buffers", step);
+			}
+
+		}
+
+	}
+
+	GsVramGetStats(&stats);
+
+	printf("%d steps, %d failed texture allocations\n", STEPS, failures);
+	printf("frame buffers %u, textures %u, free %u, largest free %u, buffers %u\n", stats.fb_used, stats.tex_used, stats.tex_free, stats.tex_largest_free, stats.tex_count);
+
+	// With the texture buffers gone, a frame buffer goes above the others.
+	GsVramFreeAllTextureBuffer();
+	live = 0;
+
+	if (GsVramAllocFrameBuffer(FB_WIDTH, 64, GS_PIXMODE_32) * 2048 != ((fb_end + 2047) & ~2047))
+	{
+		return fail("libgs frame buffer not above the others", STEPS);
+	}
+
+	fb_end = ((fb_end + 2047) & ~2047) + FB_WIDTH * 64;
+
+	if (((tbp = GsVramAllocTextureBuffer(64, 64, GS_PIXMODE_32)) < 0) || (tbp * 64 < fb_end))
+	{
+		return fail("libgs texture buffer not above the frame buffers", STEPS);
+	}
+
+	GsVramFreeAll();
+
+	return 0;
+
+}
+
+int main(int argc, char **argv)
+{
+
+	srand((argc > 1) ? atoi(argv[1]) : 3);
+
+	if (graph_trace() || libgs_trace())
+	{
+		return 1;
+	}
+
+	printf("OK\n");
+
+	return 0;
+
+}
@@ -218,6 +218,18 @@ typedef struct t_SifRpcDataQueue
    struct t_SifRpcDataQueue	*next;  	/* 05 */
 } SifRpcDataQueue_t;
 
+/**
+ *	Packet allocation statistics
+ *	@see {@link SifGetRpcPacketStats()}
+ */
+typedef struct t_SifRpcPacketStats
+{
+   u32				allocated;	/* Packets allocated */
+   u32				reclaimed;	/* Packets found by scanning the table after the IOP released them */
+   u32				exhausted;	/* Allocations that failed because all packets were in use */
+   u32				capacity;	/* Packets in the table */
+} SifRpcPacketStats_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -233,6 +245,21 @@ void SifInitRpc(int mode);
  */
 void SifExitRpc(void);
 
+/**
+ *	Replaces the table that packets for RPC requests are allocated from, which
+ *	holds 32 packets by default. Must be called before {@link SifInitRpc()}.
+ *	@param 	table 64-byte aligned memory for count packets of 64 bytes each
+ *	@param 	count number of packets
+ *	@return 0 if successful; -1 if the table is misaligned or RPC is already initialized.
+ */
+int SifSetRpcPacketTable(void *table, int count);
+
+/**
+ *	Retrieves the packet allocation statistics and resets them.
+ *	@param 	stats pointer to the statistics to fill in
+ */
+void SifGetRpcPacketStats(SifRpcPacketStats_t *stats);
+
 /* SIF RPC client API */
 /**
  *	<sub>SIF RPC client API</sub><br/>
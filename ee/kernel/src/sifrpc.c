@@ -22,11 +22,17 @@
 #include <sifcmd.h>
 #include <sifrpc.h>
 
+/** Packets are 64 bytes on the EE, a host build with larger pointers can raise this */
+#ifndef RPC_PACKET_SIZE
 #define RPC_PACKET_SIZE	64
+#endif
 
 /** Set if the packet has been allocated */
 #define PACKET_F_ALLOC	0x01
 
+/** Size of the server lookup table, a power of 2 */
+#define RPC_SV_TABLE_LEN	64
+
 struct rpc_data {
 	int	pid;
 	void	*pkt_table;
@@ -39,6 +45,17 @@ struct rpc_data {
 	int	client_table_len;
 	int	rdata_table_idx;
 	void	*active_queue;
+	void	*pkt_free;
+	SifRpcServerData_t **sv_table;
+	int	sv_table_count;
+	int	sv_overflow;
+	SifRpcPacketStats_t stats;
+};
+
+/* Free packets are linked through the word following the header. */
+struct rpc_free_pkt {
+	SifRpcPktHeader_t	hdr;
+	struct rpc_free_pkt	*next;
 };
 
 extern int _iop_reboot_count;
@@ -46,28 +63,44 @@ extern struct rpc_data _sif_rpc_data;
 
 void *_rpc_get_packet(struct rpc_data *rpc_data);
 void *_rpc_get_fpacket(struct rpc_data *rpc_data);
+void _rpc_sv_insert(struct rpc_data *rpc_data, SifRpcServerData_t *sd);
+void _rpc_sv_remove(struct rpc_data *rpc_data, SifRpcServerData_t *sd);
 
 #ifdef F__rpc_get_packet
 void *_rpc_get_packet(struct rpc_data *rpc_data)
 {
 	SifRpcPktHeader_t *packet;
+	struct rpc_free_pkt *free;
 	int len, pid, rid = 0;
 
 	DI();
 
 	len = rpc_data->pkt_table_len;
 	if (len > 0) {
-		packet = (SifRpcPktHeader_t *)rpc_data->pkt_table;
+		if ((free = rpc_data->pkt_free) != NULL) {
+			rpc_data->pkt_free = free->next;
+			packet = &free->hdr;
+			rid = ((u8 *)packet - (u8 *)rpc_data->pkt_table) / RPC_PACKET_SIZE;
+		} else {
+			/* Packets of calls without an end function are released by the IOP,
+			   which clears their rec_id without going through the free list. */
+			packet = (SifRpcPktHeader_t *)rpc_data->pkt_table;
 
-		for (rid = 0; rid < len; rid++, packet = (SifRpcPktHeader_t *)(((unsigned char *)packet) +  RPC_PACKET_SIZE)) {
-			if (!(packet->rec_id & PACKET_F_ALLOC))
-				break;
-		}
-		if (rid == len) {
-			EI();
-			return NULL;
+			for (rid = 0; rid < len; rid++, packet = (SifRpcPktHeader_t *)(((unsigned char *)packet) +  RPC_PACKET_SIZE)) {
+				if (!(packet->rec_id & PACKET_F_ALLOC))
+					break;
+			}
+			if (rid == len) {
+				rpc_data->stats.exhausted++;
+				EI();
+				return NULL;
+			}
+
+			rpc_data->stats.reclaimed++;
 		}
 
+		rpc_data->stats.allocated++;
+
 		pid = rpc_data->pid;
 		if (pid) {
 			rpc_data->pid = ++pid;
@@ -249,11 +282,14 @@ int SifRpcGetOtherData(SifRpcReceiveData_t *rd, void *src, void *dest,
 
 #ifdef F_SifRpcMain
 
-/* The packets sent on EE RPC requests are allocated from this table.  */
-static u8 pkt_table[2048] __attribute__((aligned(64)));
+/* The packets sent on EE RPC requests are allocated from this table,
+   unless SifSetRpcPacketTable() provides another one.  */
+static u8 pkt_table[32 * RPC_PACKET_SIZE] __attribute__((aligned(64)));
 /* A ring buffer used to allocate packets sent on IOP requests.  */
-static u8 rdata_table[2048] __attribute__((aligned(64)));
-static u8 client_table[2048] __attribute__((aligned(64)));
+static u8 rdata_table[32 * RPC_PACKET_SIZE] __attribute__((aligned(64)));
+static u8 client_table[32 * RPC_PACKET_SIZE] __attribute__((aligned(64)));
+/* Registered servers by sid.  */
+static SifRpcServerData_t *sv_table[RPC_SV_TABLE_LEN];
 
 struct rpc_data _sif_rpc_data = {
 	pid:			1,
@@ -263,17 +299,37 @@ struct rpc_data _sif_rpc_data = {
 	rdata_table_len:	sizeof(rdata_table)/RPC_PACKET_SIZE,
 	client_table:		client_table,
 	client_table_len:	sizeof(client_table)/RPC_PACKET_SIZE,
-	rdata_table_idx:	0
+	rdata_table_idx:	0,
+	sv_table:		sv_table
 };
 
 static int init = 0;
 
 static void rpc_packet_free(void *packet)
 {
-	SifRpcRendPkt_t *rendpkt = (SifRpcRendPkt_t *)packet;
+	struct rpc_free_pkt *free = (struct rpc_free_pkt *)packet;
 
-	rendpkt->rpc_id = 0;
-	rendpkt->rec_id &= (~PACKET_F_ALLOC);
+	free->hdr.rpc_id = 0;
+	free->hdr.rec_id &= (~PACKET_F_ALLOC);
+
+	free->next = _sif_rpc_data.pkt_free;
+	_sif_rpc_data.pkt_free = free;
+}
+
+static void rpc_packet_init(struct rpc_data *rpc_data)
+{
+	struct rpc_free_pkt *free;
+	int i;
+
+	rpc_data->pkt_free = NULL;
+
+	for (i = rpc_data->pkt_table_len - 1; i >= 0; i--) {
+		free = (struct rpc_free_pkt *)((u8 *)rpc_data->pkt_table + (i * RPC_PACKET_SIZE));
+		free->hdr.rpc_id = 0;
+		free->hdr.rec_id = 0;
+		free->next = rpc_data->pkt_free;
+		rpc_data->pkt_free = free;
+	}
 }
 
 /* Command 0x80000008 */
@@ -297,14 +353,74 @@ static void _request_end(SifRpcRendPkt_t *request, void *data)
 	client->hdr.pkt_addr = NULL;
 }
 
+static int rpc_sv_hash(u32 sid)
+{
+	return (sid ^ (sid >> 8) ^ (sid >> 16) ^ (sid >> 24)) & (RPC_SV_TABLE_LEN - 1);
+}
+
+/* Called with interrupts disabled. The table is kept at most 3/4 full, servers
+   that don't fit are only found by walking the queues. */
+void _rpc_sv_insert(struct rpc_data *rpc_data, SifRpcServerData_t *sd)
+{
+	int i;
+
+	if (rpc_data->sv_table_count >= (RPC_SV_TABLE_LEN * 3) / 4) {
+		rpc_data->sv_overflow++;
+		return;
+	}
+
+	for (i = rpc_sv_hash(sd->sid); rpc_data->sv_table[i] != NULL; i = (i + 1) & (RPC_SV_TABLE_LEN - 1))
+		;
+
+	rpc_data->sv_table[i] = sd;
+	rpc_data->sv_table_count++;
+}
+
+void _rpc_sv_remove(struct rpc_data *rpc_data, SifRpcServerData_t *sd)
+{
+	SifRpcServerData_t **table = rpc_data->sv_table;
+	int i, j, k;
+
+	for (i = rpc_sv_hash(sd->sid); table[i] != sd; i = (i + 1) & (RPC_SV_TABLE_LEN - 1)) {
+		if (table[i] == NULL) {
+			if (rpc_data->sv_overflow > 0)
+				rpc_data->sv_overflow--;
+			return;
+		}
+	}
+
+	/* Move the following entries of the probe sequence back into the hole,
+	   unless they are already at or before their home slot. */
+	for (j = (i + 1) & (RPC_SV_TABLE_LEN - 1); table[j] != NULL; j = (j + 1) & (RPC_SV_TABLE_LEN - 1)) {
+		k = rpc_sv_hash(table[j]->sid);
+
+		if (((j - k) & (RPC_SV_TABLE_LEN - 1)) >= ((j - i) & (RPC_SV_TABLE_LEN - 1))) {
+			table[i] = table[j];
+			i = j;
+		}
+	}
+
+	table[i] = NULL;
+	rpc_data->sv_table_count--;
+}
+
 static void *search_svdata(u32 sid, struct rpc_data *rpc_data)
 {
 	SifRpcServerData_t *server;
 	SifRpcDataQueue_t *queue = rpc_data->active_queue;
+	int i;
 
 	if (!queue)
 		return NULL;
 
+	for (i = rpc_sv_hash(sid); (server = rpc_data->sv_table[i]) != NULL; i = (i + 1) & (RPC_SV_TABLE_LEN - 1)) {
+		if (server->sid == sid)
+			return server;
+	}
+
+	if (!rpc_data->sv_overflow)
+		return NULL;
+
 	while (queue) {
 		server = queue->link;
 		while (server) {
@@ -352,11 +468,12 @@ static void _request_call(SifRpcCallPkt_t *request, void *data)
 	SifRpcDataQueue_t *base = server->base;
 
 	if (base->start)
-		base->end->link = server;
+		base->end->next = server;
 	else
 		base->start = server;
 
 	base->end          = server;
+	server->next       = NULL;
 	server->pkt_addr   = request->pkt_addr;
 	server->client     = request->client;
 	server->rpc_number = request->rpc_number;
@@ -406,6 +523,7 @@ void SifInitRpc(int mode)
 	_sif_rpc_data.pkt_table    = UNCACHED_SEG(_sif_rpc_data.pkt_table);
 	_sif_rpc_data.rdata_table  = UNCACHED_SEG(_sif_rpc_data.rdata_table);
 	_sif_rpc_data.client_table = UNCACHED_SEG(_sif_rpc_data.client_table);
+	rpc_packet_init(&_sif_rpc_data);
 
 	SifAddCmdHandler(SIF_CMD_RPC_END, (void *)_request_end, &_sif_rpc_data);
 	SifAddCmdHandler(SIF_CMD_RPC_BIND, (void *)_request_bind, &_sif_rpc_data);
@@ -430,6 +548,31 @@ void SifExitRpc(void)
 	SifExitCmd();
 	init = 0;
 }
+
+int SifSetRpcPacketTable(void *table, int count)
+{
+	if (init || ((u32)table & (RPC_PACKET_SIZE - 1)) || count < 1 || count > 0x7fff)
+		return -1;
+
+	_sif_rpc_data.pkt_table     = table;
+	_sif_rpc_data.pkt_table_len = count;
+
+	return 0;
+}
+
+void SifGetRpcPacketStats(SifRpcPacketStats_t *stats)
+{
+	DI();
+
+	*stats = _sif_rpc_data.stats;
+	stats->capacity = _sif_rpc_data.pkt_table_len;
+
+	_sif_rpc_data.stats.allocated = 0;
+	_sif_rpc_data.stats.reclaimed = 0;
+	_sif_rpc_data.stats.exhausted = 0;
+
+	EI();
+}
 #endif
 
 #ifdef F_SifRegisterRpc
@@ -454,12 +597,14 @@ SifRegisterRpc(SifRpcServerData_t *sd,
 	if (!(server = qd->link)) {
 		qd->link = sd;
 	} else {
-		while ((server = server->next))
-			;
+		while (server->link)
+			server = server->link;
 
-		server->next = sd;
+		server->link = sd;
 	}
 
+	_rpc_sv_insert(&_sif_rpc_data, sd);
+
 	EI();
 
 	return server;
@@ -490,6 +635,9 @@ SifRemoveRpc(SifRpcServerData_t *sd, SifRpcDataQueue_t *queue)
 		}
 	}
 
+	if (server != NULL)
+		_rpc_sv_remove(&_sif_rpc_data, sd);
+
 	EI();
 
 	return server;
@@ -532,9 +680,13 @@ SifRpcDataQueue_t *
 SifRemoveRpcQueue(SifRpcDataQueue_t *qd)
 {
 	SifRpcDataQueue_t *queue;
+	SifRpcServerData_t *server;
 
 	DI();
 
+	for (server = qd->link; server != NULL; server = server->link)
+		_rpc_sv_remove(&_sif_rpc_data, server);
+
 	if((queue = _sif_rpc_data.active_queue) == qd)
 	{
 		_sif_rpc_data.active_queue = queue->next;
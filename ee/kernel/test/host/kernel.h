@@ -0,0 +1,35 @@
+/* Host stand-in for the EE kernel.h, with the calls used by sifrpc.c. */
+
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <tamtypes.h>
+#include <sifdma.h>
+
+#define UNCACHED_SEG(x)	(x)
+
+typedef struct {
+	int	count;
+	int	max_count;
+	int	init_count;
+	int	wait_threads;
+	u32	attr;
+	u32	option;
+} ee_sema_t;
+
+static inline int DI(void) { return 0; }
+static inline int EI(void) { return 0; }
+static inline void nopdelay(void) { }
+
+int CreateSema(ee_sema_t *sema);
+int DeleteSema(int sema_id);
+int WaitSema(int sema_id);
+int iSignalSema(int sema_id);
+int iWakeupThread(int thread_id);
+int SleepThread(void);
+
+int SifSetReg(u32 register_num, int register_value);
+int SifGetReg(u32 register_num);
+u32 SifSetDma(SifDmaTransfer_t *sdd, s32 len);
+
+#endif /* __KERNEL_H__ */
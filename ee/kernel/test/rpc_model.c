@@ -0,0 +1,217 @@
+/*
+ * Host model of the EE side of SIF RPC in sifrpc.c, with a loopback IOP.
+ *
+ * The SIF command layer is replaced by a handler table and a fake IOP that
+ * completes calls in order with a fixed number of calls outstanding. Calls
+ * with an end function are finished with an RPC_END command, calls without
+ * one are released by clearing the packet as the IOP does, so both the free
+ * list and the reclaim scan are used. The model checks bind lookups after
+ * removals and with more servers than fit in the lookup table, checks the
+ * packet statistics, and prints bind lookups and calls per second.
+ *
+ * Pointers are larger on the host, so the packets are 128 bytes here.
+ *
+ * Build and run from the root of the tree. The -Wno options are for the
+ * address helpers in tamtypes.h and the packet table alignment check in
+ * sifrpc.c, which cast between pointers and 32-bit integers:
+ *
+ *   F="-DF__rpc_get_packet -DF__rpc_get_fpacket -DF_SifBindRpc -DF_SifCallRpc \
+ *      -DF_SifRpcGetOtherData -DF_SifRpcMain -DF_SifRegisterRpc -DF_SifRemoveRpc \
+ *      -DF_SifSetRpcQueue -DF_SifRemoveRpcQueue -DF_SifGetNextRequest \
+ *      -DF_SifExecRequest -DF_SifRpcLoop -DF_SifCheckStatRpc"
+ *   gcc -O2 -Wall -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -D_EE -DRPC_PACKET_SIZE=128 \
+ *       $F -Iee/kernel/test/host -Iee/kernel/include -Icommon/include \
+ *       ee/kernel/test/rpc_model.c ee/kernel/src/sifrpc.c -o rpc_model
+ *   ./rpc_model [outstanding]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <kernel.h>
+#include <sifcmd.h>
+#include <sifrpc.h>
+
+#define MAX_PENDING	4096
+#define RUNS		2000000
+
+int _iop_reboot_count = 0;
+
+static SifCmdHandler_t handlers[32];
+static void *handler_args[32];
+
+static SifRpcCallPkt_t *pending[MAX_PENDING];
+static int pending_head = 0, pending_tail = 0, outstanding = 24;
+static u8 rend[RPC_PACKET_SIZE] __attribute__((aligned(64)));
+
+/* The server that the last bind request was answered with.  */
+static SifRpcServerData_t *bound;
+
+void SifAddCmdHandler(int pos, SifCmdHandler_t handler, void *harg)
+{
+	handlers[pos & 31] = handler;
+	handler_args[pos & 31] = harg;
+}
+
+void SifInitCmd(void) { }
+void SifExitCmd(void) { }
+int SifGetSreg(int index) { return 1; }
+void SifWriteBackDCache(void *ptr, int size) { }
+
+int CreateSema(ee_sema_t *sema) { return 1; }
+int DeleteSema(int sema_id) { return 0; }
+int WaitSema(int sema_id) { return 0; }
+int iSignalSema(int sema_id) { return 0; }
+int iWakeupThread(int thread_id) { return 0; }
+int SleepThread(void) { return 0; }
+
+int SifSetReg(u32 register_num, int register_value) { return 0; }
+int SifGetReg(u32 register_num) { return 1; }
+u32 SifSetDma(SifDmaTransfer_t *sdd, s32 len) { return 1; }
+
+/* The IOP finishes the oldest call.  */
+static void complete(void)
+{
+	SifRpcCallPkt_t *call = pending[pending_tail++ % MAX_PENDING];
+	SifRpcRendPkt_t *end = (SifRpcRendPkt_t *)rend;
+
+	if (call->rmode) {
+		end->client = call->client;
+		end->cid = SIF_CMD_RPC_CALL;
+		handlers[SIF_CMD_RPC_END & 31](end, handler_args[SIF_CMD_RPC_END & 31]);
+	} else {
+		call->rec_id = 0;
+		call->rpc_id = 0;
+	}
+}
+
+unsigned int SifSendCmd(int cmd, void *packet, int packet_size, void *src_extra, void *dest_extra, int size_extra)
+{
+	if (cmd == SIF_CMD_RPC_CALL) {
+		pending[pending_head++ % MAX_PENDING] = packet;
+		while (pending_head - pending_tail > outstanding)
+			complete();
+	}
+
+	return 1;
+}
+
+unsigned int iSifSendCmd(int cmd, void *packet, int packet_size, void *src_extra, void *dest_extra, int size_extra)
+{
+	bound = ((SifRpcRendPkt_t *)packet)->server;
+
+	return bound != NULL;
+}
+
+static SifRpcServerData_t *bind(u32 sid)
+{
+	SifRpcBindPkt_t bind;
+
+	bind.sid = sid;
+	bind.client = NULL;
+	handlers[SIF_CMD_RPC_BIND & 31](&bind, handler_args[SIF_CMD_RPC_BIND & 31]);
+
+	return bound;
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void end_function(void *param) { }
+
+static const u32 sids[16] = {
+	0x80000100, 0x80000101, 0x80000400, 0x80000401, 0x80000901, 0x80000902, 0x80000905, 0x80000906,
+	0x80000a01, 0x80001000, 0x0b001337, 0x00012345, 0x80000597, 0x80000598, 0x80000599, 0x8000059a
+};
+
+static SifRpcDataQueue_t queues[16], queue;
+static SifRpcServerData_t servers[16], many[80];
+static SifRpcClientData_t clients[64];
+
+int main(int argc, char **argv)
+{
+	SifRpcPacketStats_t stats;
+	int i, failures = 0, bad = 0;
+	double t0;
+
+	if (argc > 1)
+		outstanding = atoi(argv[1]);
+
+	SifInitRpc(0);
+
+	for (i = 0; i < 16; i++) {
+		SifSetRpcQueue(&queues[i], -1);
+		SifRegisterRpc(&servers[i], sids[i], NULL, NULL, NULL, NULL, &queues[i]);
+	}
+
+	t0 = seconds();
+	for (i = 0; i < RUNS; i++)
+		bind(sids[15 - (i & 7)]);
+	printf("bind lookups with 16 servers: %.1f M/s\n", RUNS / (seconds() - t0) / 1e6);
+
+	/* Every fourth call has no end function and is released by the IOP.  */
+	t0 = seconds();
+	for (i = 0; i < RUNS; i++) {
+		if (SifCallRpc(&clients[i & 63], 1, SIF_RPC_M_NOWAIT, NULL, 0, NULL, 0, (i & 3) ? end_function : NULL, NULL) < 0) {
+			failures++;
+			complete();
+		}
+	}
+	while (pending_head != pending_tail)
+		complete();
+	printf("calls with %d outstanding: %.1f M/s, %d allocation failures\n", outstanding, RUNS / (seconds() - t0) / 1e6, failures);
+
+	SifGetRpcPacketStats(&stats);
+	printf("packets: %u allocated, %u reclaimed, %u exhausted, capacity %u\n",
+		stats.allocated, stats.reclaimed, stats.exhausted, stats.capacity);
+
+	if (stats.allocated != RUNS - failures || stats.exhausted != failures ||
+	    (outstanding < (int)stats.capacity && failures != 0)) {
+		printf("FAIL: packet statistics\n");
+		return 1;
+	}
+
+	/* Lookups after removing a server and a whole queue, and of unknown sids.  */
+	SifRemoveRpc(&servers[3], &queues[3]);
+	SifRemoveRpcQueue(&queues[5]);
+
+	for (i = 0; i < 16; i++)
+		bad += (i == 3 || i == 5) ? bind(sids[i]) != NULL : bind(sids[i]) != &servers[i];
+	for (i = 0; i < 16; i++)
+		bad += bind(0x1000 + i) != NULL;
+
+	/* More servers on one queue than fit in the lookup table.  */
+	SifSetRpcQueue(&queue, -1);
+
+	for (i = 0; i < 80; i++)
+		SifRegisterRpc(&many[i], 0x90000000 + i * 64, NULL, NULL, NULL, NULL, &queue);
+	for (i = 0; i < 80; i++)
+		bad += bind(0x90000000 + i * 64) != &many[i];
+
+	for (i = 0; i < 80; i += 3)
+		SifRemoveRpc(&many[i], &queue);
+	for (i = 0; i < 80; i++)
+		bad += (i % 3 == 0) ? bind(0x90000000 + i * 64) != NULL : bind(0x90000000 + i * 64) != &many[i];
+
+	SifRemoveRpcQueue(&queue);
+	for (i = 0; i < 80; i++)
+		bad += bind(0x90000000 + i * 64) != NULL;
+
+	printf("%d lookup mismatches\n", bad);
+
+	if (bad) {
+		printf("FAIL: lookups\n");
+		return 1;
+	}
+
+	printf("OK\n");
+
+	return 0;
+}
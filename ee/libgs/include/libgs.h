@@ -2310,6 +2310,20 @@ typedef struct
 	u8	psm;
 }GS_IMAGE;
 
+typedef struct
+{
+	/** Words used by frame buffers */
+	u32	fb_used;
+	/** Words used by texture buffers */
+	u32	tex_used;
+	/** Words free for texture buffers */
+	u32	tex_free;
+	/** Largest contiguous free area in words */
+	u32	tex_largest_free;
+	/** Number of texture buffers */
+	u32	tex_count;
+}GS_VRAM_STATS;
+
 #if 0
 typedef struct
 {
@@ -2396,8 +2410,12 @@ void GsHSync(int mode);
 void GsVSync(int mode);
 
 /* Vram Allocation */
+/** allocate a frame buffer, returns -EBUSY once texture buffers are allocated */
 int    GsVramAllocFrameBuffer(s16 w, s16 h, s16 psm);
 int    GsVramAllocTextureBuffer(s16 w, s16 h, s16 psm);
+/** free a single texture buffer, returned by GsVramAllocTextureBuffer() */
+void GsVramFreeTextureBuffer(int tbp);
+void GsVramGetStats(GS_VRAM_STATS *stats);
 /** free texture buffer without freeing frame buffer */
 void GsVramFreeAllTextureBuffer(void);
 void GsVramFreeAll(void);
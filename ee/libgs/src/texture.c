@@ -98,9 +98,18 @@ int GsLoadImage(const void *source_addr, GS_IMAGE *dest)
 }
 
 /* VRAM */
+#define VR_MAX_ADDR		(1024*1024)	// 4MB, in 32bit words
+#define VR_MAX_TEXTURES	256
+
 static unsigned int vr_addr=0;
 static unsigned int vr_tex_start=0;
-static unsigned int vr_2ndtolast_alloc=0;	//address before last alloc so we can Free the last alloc
+
+/* texture buffers above vr_tex_start, sorted by address. Everything in between is free */
+static struct {
+	unsigned int addr;
+	unsigned int size;
+} vr_tex[VR_MAX_TEXTURES];
+static int vr_tex_count=0;
 
 int GsVramAllocFrameBuffer(s16 w, s16 h, s16 psm)
 {
@@ -141,11 +150,18 @@ int GsVramAllocFrameBuffer(s16 w, s16 h, s16 psm)
 		size = (w*h)/2;
 	}
 
+	// frame buffers go below the texture buffers, so they must all be allocated first
+	if(vr_tex_count > 0)
+		return -EBUSY;
+
 	remainder = (vr_addr % (2048));
 
 	if(remainder)
 		vr_addr += ((2048)-remainder);
 
+	if(vr_addr + size > VR_MAX_ADDR)
+		return -ENOMEM;
+
 	ret = vr_addr/(2048);
 	vr_addr += size;
 	vr_tex_start = vr_addr;
@@ -156,7 +172,10 @@ int GsVramAllocFrameBuffer(s16 w, s16 h, s16 psm)
 int GsVramAllocTextureBuffer(s16 w, s16 h, s16 psm)
 {
 	int size, remainder, ret, byte_pp;	// byte per pixel
+	unsigned int start, end, best_gap=0;
+	int i, best;
 
+	ret = 0;
 	switch(psm)
 	{
 	case GS_PIXMODE_32:
@@ -189,38 +208,96 @@ int GsVramAllocTextureBuffer(s16 w, s16 h, s16 psm)
 		size = (w*h)/2;
 	}
 
-	remainder = (vr_addr % (64));
+	size = (size + 63) & ~63;
 
-	//---
-	vr_2ndtolast_alloc = vr_addr;
+	// use the smallest gap between the texture buffers that fits (lowest address if several do)
+	start	= vr_tex_start;
+	best	= -1;
+	for(i=0; i<=vr_tex_count; i++)
+	{
+		end = (i < vr_tex_count)? vr_tex[i].addr : VR_MAX_ADDR;
 
-	if(remainder)
-		vr_addr += ((64)-remainder);
+		remainder = (start % (64));
+		if(remainder)
+			start += ((64)-remainder);
 
-	ret = vr_addr/(64);
-	vr_addr += size;
+		if(start + size <= end && (best < 0 || end - start < best_gap))
+		{
+			best		= i;
+			best_gap	= end - start;
+			ret			= start;
+		}
 
-	return ret;
+		if(i < vr_tex_count)
+			start = vr_tex[i].addr + vr_tex[i].size;
+	}
+
+	if(best < 0 || vr_tex_count >= VR_MAX_TEXTURES)
+		return -ENOMEM;
+
+	for(i=vr_tex_count; i>best; i--)
+		vr_tex[i] = vr_tex[i-1];
+
+	vr_tex[best].addr = ret;
+	vr_tex[best].size = size;
+	vr_tex_count++;
+
+	return ret/(64);
 }
 
-void GsVramFreeAllTextureBuffer(void)
+void GsVramFreeTextureBuffer(int tbp)
 {
-	vr_addr = vr_tex_start;
+	int i;
+
+	for(i=0; i<vr_tex_count; i++)
+	{
+		if(vr_tex[i].addr == tbp*64)
+		{
+			vr_tex_count--;
+			for(; i<vr_tex_count; i++)
+				vr_tex[i] = vr_tex[i+1];
+			return;
+		}
+	}
 }
 
-#if 0
-int VramFreeLastTextureBuffer()
+void GsVramGetStats(GS_VRAM_STATS *stats)
 {
-	if(vr_2ndtolast_alloc)
+	unsigned int start, end;
+	int i;
+
+	stats->tex_used		= 0;
+	stats->tex_largest_free	= 0;
+	stats->tex_count	= vr_tex_count;
+
+	start = vr_tex_start;
+	for(i=0; i<=vr_tex_count; i++)
 	{
-		vr_addr = vr_2ndtolast_alloc;
-		vr_2ndtolast_alloc =0;
+		end = (i < vr_tex_count)? vr_tex[i].addr : VR_MAX_ADDR;
+
+		if(end - start > stats->tex_largest_free)
+			stats->tex_largest_free = end - start;
+
+		if(i < vr_tex_count)
+		{
+			stats->tex_used += vr_tex[i].size;
+			start = vr_tex[i].addr + vr_tex[i].size;
+		}
 	}
+
+	stats->fb_used		= vr_tex_start;
+	stats->tex_free		= VR_MAX_ADDR - vr_tex_start - stats->tex_used;
+}
+
+void GsVramFreeAllTextureBuffer(void)
+{
+	vr_addr			= vr_tex_start;
+	vr_tex_count	= 0;
 }
-#endif
 
 void GsVramFreeAll(void)
 {
 	vr_addr			= 0;
 	vr_tex_start	= 0;
+	vr_tex_count	= 0;
 }
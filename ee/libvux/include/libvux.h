@@ -16,6 +16,8 @@
 #ifndef __LIBVUX_H__
 #define __LIBVUX_H__
 
+#include <packet.h>
+
 /*
 
 y
@@ -100,6 +102,34 @@ typedef struct
 
 }VU_FLAT_LIGHT;
 
+/** Transformed vertex, in the layout of the gs RGBAQ and XYZ2 registers (128 bit) */
+typedef struct
+{
+	VU_CVECTOR		rgbaq;
+	VU_SXYZ			xyz;
+
+}VU_GS_VERTEX __attribute__((aligned(16)));
+
+/** VuxDrawTrianglesN() clip flags */
+#define VU_CLIP_NEAR				0x01	/* behind the near plane */
+#define VU_CLIP_GUARD				0x02	/* outside of the gs coordinate space */
+
+/** VuxDrawTrianglesN() culling, the winding is as seen on the screen */
+#define VU_CULL_NONE				0
+#define VU_CULL_CW					1
+#define VU_CULL_CCW					2
+
+/** VuxDrawTrianglesN() results */
+typedef struct
+{
+	unsigned int	visible;
+	unsigned int	backface;
+	unsigned int	clipped;
+	/** triangles that didn't fit into the packet */
+	unsigned int	remaining;
+
+}VU_DRAW_STATS;
+
 #ifndef ftoi4
 #define ftoi4(f)				((int)((f)*16.0f))
 #endif
@@ -200,6 +230,25 @@ extern int   VuxClipSxyz(VU_SXYZ *sxyz0, VU_SXYZ *sxyz1, VU_SXYZ *sxyz2);
 /*lighting*/
 extern int VuxLightNormal(VU_VECTOR *normal, VU_CVECTOR *col0, void *light, unsigned int light_type, VU_CVECTOR *out0);
 
+/*pipeline*/
+/**
+ * Transforms, lights and projects num_verts vertices in one pass, with the same results as
+ * VuxRotTransPers() and VuxLightNormal(). normals can be NULL to use the colors as they are.
+ * work and clip receive the results and VU_CLIP_* flags of each vertex. Returns the number of
+ * vertices with clip flags.
+ */
+extern int VuxRotTransPersLightN(VU_VECTOR *verts, VU_VECTOR *normals, VU_CVECTOR *colors, void *light, unsigned int light_type, VU_GS_VERTEX *work, unsigned char *clip, unsigned int num_verts);
+
+/**
+ * Runs VuxRotTransPersLightN() and adds the triangles of the index list to the packet at q,
+ * leaving out triangles with clipped vertices and the culled winding. The triangles are drawn
+ * with the prim register value prim, using a regList giftag of RGBAQ and XYZ2.
+ * Returns the qword following the data. If the packet fills up, stats->remaining tells how
+ * many triangles are left. They can be drawn after sending the packet by another call with the
+ * rest of the index list and verts NULL, which reuses work and clip.
+ */
+extern qword_t *VuxDrawTrianglesN(packet_t *packet, qword_t *q, u64 prim, int cull, VU_VECTOR *verts, VU_VECTOR *normals, VU_CVECTOR *colors, void *light, unsigned int light_type, VU_GS_VERTEX *work, unsigned char *clip, unsigned int num_verts, unsigned short *indices, unsigned int num_tris, VU_DRAW_STATS *stats);
+
 extern VU_MATRIX	VuWorldMatrix;
 extern VU_MATRIX	VuViewMatrix;
 extern VU_MATRIX	VuPrjectionMatrix;
@@ -12,6 +12,10 @@
 
 #include "vux.h"
 
+#include <gif_tags.h>
+
+#define VU_RGBAQ_XYZ2_REGLIST		((u64)GIF_REG_RGBAQ << 0 | (u64)GIF_REG_XYZ2 << 4)
+
 
 #include <math.h>
 
@@ -962,3 +966,160 @@ int VuxLightNormal(VU_VECTOR *normal, VU_CVECTOR *col0, void *light, unsigned in
 	return 0;
 }
 
+
+
+
+
+
+
+
+/* PIPELINE */
+
+
+
+int VuxRotTransPersLightN(VU_VECTOR *verts, VU_VECTOR *normals, VU_CVECTOR *colors, void *light, unsigned int light_type, VU_GS_VERTEX *work, unsigned char *clip, unsigned int num_verts)
+{
+	unsigned int	i;
+	int				x, y, clipped = 0;
+	unsigned char	flags;
+	VU_VECTOR		tv;
+
+
+	for(i=0;i<num_verts;i++)
+	{
+		VuxApplyMatrixLS(&verts[i], &tv);
+
+		// same as VuxPers(), but keeping the coordinates before they are truncated
+		if(vu_projection_type==0)
+		{
+			flags = (tv.z <= 0.0f) ? VU_CLIP_NEAR : 0;
+
+			x = ftoi4( (vu_projection * tv.x / (tv.z))		+vu_offset_x);
+			y = ftoi4(-(vu_projection * tv.y / (tv.z))		+vu_offset_y);
+			work[i].xyz.z = 0xffffff-(short)(float)tv.z;
+		}
+		else	// use projection matrix
+		{
+			flags = (tv.w <= 0.0f) ? VU_CLIP_NEAR : 0;
+
+			x = ftoi4( (((tv.x)/(tv.w))*vu_near_plane_w)	+vu_offset_x);
+			y = ftoi4(-(((tv.y)/(tv.w))*vu_near_plane_h)	+vu_offset_y);
+			work[i].xyz.z =  (int)(-(tv.z/tv.w) * 0xffff);
+		}
+
+		if(x < 0 || x > 0xffff || y < 0 || y > 0xffff)
+			flags |= VU_CLIP_GUARD;
+
+		work[i].xyz.x = x;
+		work[i].xyz.y = y;
+
+		if(normals != NULL)
+			VuxLightNormal(&normals[i], &colors[i], light, light_type, &work[i].rgbaq);
+		else
+			work[i].rgbaq = colors[i];
+
+		clip[i] = flags;
+		if(flags)
+			clipped++;
+	}
+
+	return clipped;
+}
+
+
+
+
+
+qword_t *VuxDrawTrianglesN(packet_t *packet, qword_t *q, u64 prim, int cull, VU_VECTOR *verts, VU_VECTOR *normals, VU_CVECTOR *colors, void *light, unsigned int light_type, VU_GS_VERTEX *work, unsigned char *clip, unsigned int num_verts, unsigned short *indices, unsigned int num_tris, VU_DRAW_STATS *stats)
+{
+	unsigned int	i, i0, i1, i2;
+	int				area;
+	qword_t			*end = packet->data + packet->qwords;
+	qword_t			*giftag = NULL;
+	unsigned int	nloop = 0;
+	VU_DRAW_STATS	st = {0, 0, 0, 0};
+
+
+	if(verts != NULL)
+		VuxRotTransPersLightN(verts, normals, colors, light, light_type, work, clip, num_verts);
+
+	// prim is set once for all triangles
+	if(end - q < 2)
+	{
+		st.remaining = num_tris;
+		num_tris = 0;
+	}
+	else
+	{
+		PACK_GIFTAG(q, GIF_SET_TAG(1,0,0,0,GIF_FLG_PACKED,1), GIF_REG_AD);
+		q++;
+		PACK_GIFTAG(q, prim, GIF_REG_PRIM);
+		q++;
+	}
+
+	for(i=0;i<num_tris;i++)
+	{
+		i0 = indices[i*3+0];
+		i1 = indices[i*3+1];
+		i2 = indices[i*3+2];
+
+		// the gs can't clip, so these are left out
+		if(clip[i0] | clip[i1] | clip[i2])
+		{
+			st.clipped++;
+			continue;
+		}
+
+		if(cull != VU_CULL_NONE)
+		{
+			// positive is clockwise on the screen
+			area = VuxClipSxyz(&work[i0].xyz, &work[i1].xyz, &work[i2].xyz);
+
+			if(area == 0 || (cull == VU_CULL_CW && area > 0) || (cull == VU_CULL_CCW && area < 0))
+			{
+				st.backface++;
+				continue;
+			}
+		}
+
+		// start a new giftag when needed, nloop counts vertices
+		if(giftag == NULL || nloop + 3 > 0x7fff)
+		{
+			if(end - q < 4)
+			{
+				st.remaining = num_tris - i;
+				break;
+			}
+
+			if(giftag != NULL)
+				PACK_GIFTAG(giftag, GIF_SET_TAG(nloop,0,0,0,GIF_FLG_REGLIST,2), VU_RGBAQ_XYZ2_REGLIST);
+
+			giftag = q;
+			q++;
+			nloop = 0;
+		}
+		else if(end - q < 3)
+		{
+			st.remaining = num_tris - i;
+			break;
+		}
+
+		*(VU_GS_VERTEX *)q = work[i0];
+		q++;
+		*(VU_GS_VERTEX *)q = work[i1];
+		q++;
+		*(VU_GS_VERTEX *)q = work[i2];
+		q++;
+
+		nloop += 3;
+		st.visible++;
+	}
+
+	if(giftag != NULL)
+		PACK_GIFTAG(giftag, GIF_SET_TAG(nloop,0,0,0,GIF_FLG_REGLIST,2), VU_RGBAQ_XYZ2_REGLIST);
+
+	if(stats != NULL)
+		*stats = st;
+
+	return q;
+}
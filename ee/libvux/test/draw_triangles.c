@@ -0,0 +1,208 @@
+/*
+ * Host comparison of VuxDrawTrianglesN() with the per-vertex libvux functions.
+ *
+ * Random meshes are drawn with both projection types. Every transformed vertex
+ * must match VuxRotTransPers() and VuxLightNormal() bit for bit, and the
+ * triangles in the packet must be the ones VuxRotTransPersClip3() keeps, with
+ * the same screen coordinates. The mesh is then drawn again into a 100-qword
+ * packet, resuming until no triangles remain, and the vertices of all the
+ * small packets must be the same as those of the single large one.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   gcc -O2 -D_EE -Icommon/include -Iee/kernel/include -Iee/libvux/include \
+ *       -Iee/libvux/src -Iee/packet/include -Iee/draw/include -Iee/math3d/include \
+ *       ee/libvux/test/draw_triangles.c ee/libvux/src/vux.c ee/libvux/src/vusw.c \
+ *       -lm -o draw_triangles
+ *   ./draw_triangles
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libvux.h>
+
+#define NUM_VERTS	600
+#define NUM_TRIS	1000
+#define PRIM		0x1234
+
+static VU_VECTOR		verts[NUM_VERTS];
+static VU_VECTOR		normals[NUM_VERTS];
+static VU_CVECTOR		colors[NUM_VERTS];
+static VU_GS_VERTEX		work[NUM_VERTS];
+static unsigned char	clip[NUM_VERTS];
+static unsigned short	indices[NUM_TRIS*3];
+
+static qword_t			buffer[4000];
+static qword_t			vertices[3*NUM_TRIS];
+static qword_t			resumed[3*NUM_TRIS];
+
+
+static float random_float(void)
+{
+	return rand() / (float)RAND_MAX * 2 - 1;
+}
+
+// Copies the vertex qwords of the REGLIST giftags that follow the PRIM write.
+static int collect(qword_t *q, qword_t *end, qword_t *out)
+{
+	int	n = 0, nloop;
+
+	for(q += 2; q < end; q += nloop)
+	{
+		nloop = q->dw[0] & 0x7fff;
+		q++;
+
+		memcpy(&out[n], q, nloop * sizeof(qword_t));
+		n += nloop;
+	}
+
+	return n;
+}
+
+static int run(int projection)
+{
+	VU_FLAT_LIGHT	light = {{0.5f, -0.5f, -0.7f, 1.0f}, {1.0f, 0.9f, 0.8f, 1.0f}};
+	VU_MATRIX		world, view, proj, local_screen;
+	VU_DRAW_STATS	stats, part;
+	VU_SXYZ			s0, s1, s2;
+	VU_CVECTOR		color;
+	packet_t		packet;
+	qword_t			*end;
+	int				i, area, errors = 0, bad = 0, visible = 0, backface = 0, clipped = 0;
+	int				count, total, calls, done;
+	unsigned int	visible_resumed;
+
+
+	for(i=0;i<NUM_VERTS;i++)
+	{
+		verts[i].x = random_float() * 300;
+		verts[i].y = random_float() * 300;
+		verts[i].z = random_float() * 200;
+		verts[i].w = 1;
+		normals[i].x = random_float();
+		normals[i].y = random_float();
+		normals[i].z = random_float();
+		normals[i].w = 1;
+		colors[i].r = rand();
+		colors[i].g = rand();
+		colors[i].b = rand();
+		colors[i].a = 0x80;
+		colors[i].q = 1;
+	}
+
+	for(i=0;i<NUM_TRIS*3;i++)
+		indices[i] = rand() % NUM_VERTS;
+
+	VuxResetMatrix(&world);
+	VuxRotMatrixXYZ(&world, 0.3f, 0.5f, 0.1f);
+	VuxTransMatrixXYZ(&world, 0, 0, 150);
+	VuxResetMatrix(&view);
+
+	if(projection)
+	{
+		VuxMakeProjectionMatrix(&proj, 300, 300, 10, 2000);
+		VuSetProjectionMatrix(&proj);
+		VuxMakeLocalScreenMatrix2(&local_screen, &world, &view, &proj);
+	}
+	else
+	{
+		VuSetProjection(500);
+		VuxMakeLocalScreenMatrix(&local_screen, &world, &view);
+	}
+
+	VuSetLocalScreenMatrix(&local_screen);
+
+	packet.qwords	= sizeof(buffer) / sizeof(qword_t);
+	packet.data		= buffer;
+
+	end = VuxDrawTrianglesN(&packet, buffer, PRIM, VU_CULL_CW, verts, normals, colors, &light, VU_LIGHT_TYPE_FLAT, work, clip, NUM_VERTS, indices, NUM_TRIS, &stats);
+
+	// vertices against the per-vertex functions
+	for(i=0;i<NUM_VERTS;i++)
+	{
+		VuxRotTransPers(&verts[i], &s0);
+		VuxLightNormal(&normals[i], &colors[i], &light, VU_LIGHT_TYPE_FLAT, &color);
+
+		if(memcmp(&s0, &work[i].xyz, 8) || memcmp(&color, &work[i].rgbaq, 8))
+			bad++;
+	}
+
+	printf("projection %d: %d vertex mismatches\n", projection, bad);
+	errors += bad;
+
+	// triangles against VuxRotTransPersClip3()
+	count = collect(buffer, end, vertices);
+	bad = 0;
+
+	for(i=0;i<NUM_TRIS;i++)
+	{
+		area = VuxRotTransPersClip3(&verts[indices[i*3+0]], &verts[indices[i*3+1]], &verts[indices[i*3+2]], &s0, &s1, &s2);
+
+		if(clip[indices[i*3+0]] | clip[indices[i*3+1]] | clip[indices[i*3+2]])
+		{
+			clipped++;
+			continue;
+		}
+
+		if(area >= 0)
+		{
+			backface++;
+			continue;
+		}
+
+		if(visible*3+3 > count || memcmp(&vertices[visible*3+0].dw[1], &s0, 8) || memcmp(&vertices[visible*3+1].dw[1], &s1, 8) || memcmp(&vertices[visible*3+2].dw[1], &s2, 8))
+			bad++;
+
+		visible++;
+	}
+
+	if(stats.visible != visible || stats.backface != backface || stats.clipped != clipped || stats.remaining != 0 || count != visible*3)
+		bad++;
+
+	printf("  visible %u, backface %u, clipped %u, %d qwords, %d triangle mismatches\n", stats.visible, stats.backface, stats.clipped, (int)(end - buffer), bad);
+	errors += bad;
+
+	// the same triangles in a small packet, resuming with verts NULL
+	packet.qwords = 100;
+	total = 0;
+	done = 0;
+	visible_resumed = 0;
+
+	for(calls=0;done<NUM_TRIS;calls++)
+	{
+		end = VuxDrawTrianglesN(&packet, buffer, PRIM, VU_CULL_CW, calls ? NULL : verts, normals, colors, &light, VU_LIGHT_TYPE_FLAT, work, clip, NUM_VERTS, indices + done*3, NUM_TRIS - done, &part);
+
+		if(end - buffer > packet.qwords)
+		{
+			printf("  packet overflow\n");
+			return errors + 1;
+		}
+
+		total += collect(buffer, end, &resumed[total]);
+		visible_resumed += part.visible;
+		done = NUM_TRIS - part.remaining;
+	}
+
+	bad = (total != count || memcmp(resumed, vertices, count * sizeof(qword_t)) || visible_resumed != stats.visible);
+
+	printf("  100-qword packet: %d calls, %u visible, %s\n", calls, visible_resumed, bad ? "different vertices" : "same vertices");
+	errors += bad;
+
+	return errors;
+}
+
+int main(void)
+{
+	int	errors;
+
+	srand(7);
+
+	errors = run(0);
+	errors += run(1);
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return errors ? 1 : 0;
+}
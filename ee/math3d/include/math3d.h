@@ -116,9 +116,42 @@ void calculate_lights(VECTOR *output, int count, VECTOR *normals, VECTOR *light_
 /** Calculate colour values given an array of light intensity values. */
 void calculate_colours(VECTOR *output, int count, VECTOR *colours, VECTOR *lights);
 
-/** Calculate vertex values by applying the specific local_screen matrix. */
+/** Calculate vertex values by applying the specific local_screen matrix.
+ * Vertices outside of the clipping volume are set to (0,0,0,1).
+ */
 void calculate_vertices(VECTOR *output, int count, VECTOR *vertices, MATRIX local_screen);
 
+/* STREAM FUNCTIONS */
+
+/** Vectors stored as separate arrays of each component, for transforming many at once.
+ * The w array is only needed where noted.
+ */
+typedef struct {
+	float *x;
+	float *y;
+	float *z;
+	float *w;
+} VECTOR_STREAM;
+
+/** Clipping judgements, in the order of the VU clip flags. */
+#define CLIP_POS_X	0x01
+#define CLIP_NEG_X	0x02
+#define CLIP_POS_Y	0x04
+#define CLIP_NEG_Y	0x08
+#define CLIP_POS_Z	0x10
+#define CLIP_NEG_Z	0x20
+
+/** Same as calculate_normals(), the output w is optional. */
+void calculate_normals_stream(VECTOR_STREAM *output, int count, VECTOR_STREAM *normals, MATRIX local_light);
+
+/** Same as calculate_lights(), the normals' w is optional and the output w is optional. */
+void calculate_lights_stream(VECTOR_STREAM *output, int count, VECTOR_STREAM *normals, VECTOR *light_directions, VECTOR *light_colours, int *light_types, int light_count);
+
+/** Same as calculate_vertices(), also storing the clipping judgements of each vertex if clip isn't NULL.
+ * The output w is optional. Returns the number of clipped vertices.
+ */
+int calculate_vertices_stream(VECTOR_STREAM *output, u8 *clip, int count, VECTOR_STREAM *vertices, MATRIX local_screen);
+
 #ifdef __cplusplus
 }
 #endif
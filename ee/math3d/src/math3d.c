@@ -15,9 +15,37 @@
  #include <string.h>
  #include <math.h>
 
+ // The EE uses VU0 macro mode, host builds for tools use the C versions, or SSE on x86.
+ // Both give the same results on the host, build with MATH3D_NO_SSE to compare them.
+#if defined(__mips__)
+ #define MATH3D_VU0
+#elif defined(__SSE__) && !defined(MATH3D_NO_SSE)
+ #define MATH3D_SSE
+ #include <xmmintrin.h>
+#endif
+
+ // The VU transforms ignore the w of the input, using 1.
+ static void math3d_apply(VECTOR output, VECTOR input0, MATRIX input1) {
+  int loop0;
+
+  for (loop0=0;loop0<4;loop0++) {
+   output[loop0] = ((input1[0x0C + loop0] + (input1[0x00 + loop0] * input0[0])) + (input1[0x04 + loop0] * input0[1])) + (input1[0x08 + loop0] * input0[2]);
+  }
+
+ }
+
+#if defined(MATH3D_SSE)
+ static inline __m128 math3d_apply_sse(__m128 x, __m128 y, __m128 z, __m128 row0, __m128 row1, __m128 row2, __m128 row3) {
+  return _mm_add_ps(_mm_add_ps(_mm_add_ps(row3, _mm_mul_ps(row0, x)), _mm_mul_ps(row1, y)), _mm_mul_ps(row2, z));
+ }
+
+ #define MATH3D_SPLAT(V, N) _mm_shuffle_ps(V, V, _MM_SHUFFLE(N, N, N, N))
+#endif
+
  /* VECTOR FUNCTIONS */
 
  void vector_apply(VECTOR output, VECTOR input0, MATRIX input1) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%2)  \n"
@@ -44,6 +72,16 @@
 #endif
    : : "r" (output), "r" (input0), "r" (input1)
   );
+#elif defined(MATH3D_SSE)
+  __m128 v = _mm_load_ps(input0);
+
+  _mm_store_ps(output, math3d_apply_sse(MATH3D_SPLAT(v, 0), MATH3D_SPLAT(v, 1), MATH3D_SPLAT(v, 2), _mm_load_ps(&input1[0x00]), _mm_load_ps(&input1[0x04]), _mm_load_ps(&input1[0x08]), _mm_load_ps(&input1[0x0C])));
+#else
+  VECTOR work;
+
+  math3d_apply(work, input0, input1);
+  vector_copy(output, work);
+#endif
  }
 
  void vector_clamp(VECTOR output, VECTOR input0, float min, float max) {
@@ -70,6 +108,7 @@
  }
 
  void vector_copy(VECTOR output, VECTOR input0) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%1)  \n"
@@ -80,6 +119,9 @@
 #endif
    : : "r" (output), "r" (input0)
   );
+#else
+  memcpy(output, input0, sizeof(VECTOR));
+#endif
  }
 
  float vector_innerproduct(VECTOR input0, VECTOR input1) {
@@ -117,6 +159,7 @@
  }
 
  void vector_normalize(VECTOR output, VECTOR input0) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%1)  \n"
@@ -143,9 +186,18 @@
 #endif
    : : "r" (output), "r" (input0)
   );
+#else
+  float q = 1.00f / sqrtf((input0[0] * input0[0]) + (input0[1] * input0[1]) + (input0[2] * input0[2]));
+
+  output[0] = input0[0] * q;
+  output[1] = input0[1] * q;
+  output[2] = input0[2] * q;
+  output[3] = 0.00f;
+#endif
  }
 
  void vector_outerproduct(VECTOR output, VECTOR input0, VECTOR input1) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%1)  \n"
@@ -164,11 +216,22 @@
 #endif
    : : "r" (output), "r" (input0), "r" (input1)
   );
+#else
+  VECTOR work;
+
+  work[0] = (input0[1] * input1[2]) - (input1[1] * input0[2]);
+  work[1] = (input0[2] * input1[0]) - (input1[2] * input0[0]);
+  work[2] = (input0[0] * input1[1]) - (input1[0] * input0[1]);
+  work[3] = 0.00f;
+
+  vector_copy(output, work);
+#endif
  }
 
  /* MATRIX FUNCTIONS */
 
  void matrix_copy(MATRIX output, MATRIX input0) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%1)  \n"
@@ -191,6 +254,9 @@
 #endif
    : : "r" (output), "r" (input0)
   );
+#else
+  memcpy(output, input0, sizeof(MATRIX));
+#endif
  }
 
  void matrix_inverse(MATRIX output, MATRIX input0) {
@@ -212,6 +278,7 @@
  }
 
  void matrix_multiply(MATRIX output, MATRIX input0, MATRIX input1) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%1)  \n"
@@ -274,6 +341,30 @@
 #endif
    : : "r" (output), "r" (input0), "r" (input1)
   );
+#elif defined(MATH3D_SSE)
+  __m128 row0 = _mm_load_ps(&input1[0x00]), row1 = _mm_load_ps(&input1[0x04]);
+  __m128 row2 = _mm_load_ps(&input1[0x08]), row3 = _mm_load_ps(&input1[0x0C]);
+  __m128 work[4], v; int loop0;
+
+  for (loop0=0;loop0<4;loop0++) {
+   v = _mm_load_ps(&input0[loop0 * 4]);
+   work[loop0] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(row0, MATH3D_SPLAT(v, 0)), _mm_mul_ps(row1, MATH3D_SPLAT(v, 1))), _mm_mul_ps(row2, MATH3D_SPLAT(v, 2))), _mm_mul_ps(row3, MATH3D_SPLAT(v, 3)));
+  }
+
+  for (loop0=0;loop0<4;loop0++) {
+   _mm_store_ps(&output[loop0 * 4], work[loop0]);
+  }
+#else
+  MATRIX work; int loop0, loop1;
+
+  for (loop0=0;loop0<16;loop0+=4) {
+   for (loop1=0;loop1<4;loop1++) {
+    work[loop0 + loop1] = (((input1[0x00 + loop1] * input0[loop0 + 0]) + (input1[0x04 + loop1] * input0[loop0 + 1])) + (input1[0x08 + loop1] * input0[loop0 + 2])) + (input1[0x0C + loop1] * input0[loop0 + 3]);
+   }
+  }
+
+  matrix_copy(output, work);
+#endif
  }
 
  void matrix_rotate(MATRIX output, MATRIX input0, VECTOR input1) {
@@ -438,6 +529,7 @@
  /* CALCULATE FUNCTIONS */
 
  void calculate_normals(VECTOR *output, int count, VECTOR *normals, MATRIX local_light) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%3)  \n"
@@ -457,6 +549,7 @@
    "addi       %0, 0x10    \n"
    "addi       %2, 0x10    \n"
    "addi       %1, -1      \n"
+   "bne            $0, %1, 1b  \n"
 #else
    "lqc2		vf1, 0x00(%3)	\n"
    "lqc2		vf2, 0x10(%3)	\n"
@@ -479,6 +572,28 @@
 #endif
    : : "r" (output), "r" (count), "r" (normals), "r" (local_light)
   );
+#elif defined(MATH3D_SSE)
+  __m128 row0 = _mm_load_ps(&local_light[0x00]), row1 = _mm_load_ps(&local_light[0x04]);
+  __m128 row2 = _mm_load_ps(&local_light[0x08]), row3 = _mm_load_ps(&local_light[0x0C]);
+  __m128 v; int loop0;
+
+  for (loop0=0;loop0<count;loop0++) {
+   v = _mm_load_ps(normals[loop0]);
+   v = math3d_apply_sse(MATH3D_SPLAT(v, 0), MATH3D_SPLAT(v, 1), MATH3D_SPLAT(v, 2), row0, row1, row2, row3);
+   _mm_store_ps(output[loop0], _mm_mul_ps(v, _mm_div_ps(_mm_set1_ps(1.00f), MATH3D_SPLAT(v, 3))));
+  }
+#else
+  VECTOR work; float q; int loop0;
+
+  for (loop0=0;loop0<count;loop0++) {
+   math3d_apply(work, normals[loop0], local_light);
+   q = 1.00f / work[3];
+   output[loop0][0] = work[0] * q;
+   output[loop0][1] = work[1] * q;
+   output[loop0][2] = work[2] * q;
+   output[loop0][3] = work[3] * q;
+  }
+#endif
  }
 
  void calculate_lights(VECTOR *output, int count, VECTOR *normals, VECTOR *light_direction, VECTOR *light_colour, int *light_type, int light_count) {
@@ -547,6 +662,7 @@
  }
 
  void calculate_vertices(VECTOR *output, int count, VECTOR *vertices, MATRIX local_screen) {
+#if defined(MATH3D_VU0)
   asm __volatile__ (
 #if __GNUC__ > 3
    "lqc2   $vf1, 0x00(%3)  \n"
@@ -559,8 +675,9 @@
    "vmaddax    $ACC, $vf1, $vf6  \n"
    "vmadday    $ACC, $vf2, $vf6  \n"
    "vmaddz   $vf7, $vf3, $vf6  \n"
-   "vclipw.xyz   $vf7, $vf7  \n" // FIXME: Clip detection is still kinda broken.
-   "cfc2       $10, $18    \n"
+   "vclipw.xyz   $vf7, $vf7  \n"
+   "cfc2       $10, $18    \n" // The clip flags keep the previous judgements, only check this one.
+   "andi       $10, $10, 0x3f  \n"
    "beq            $10, $0, 3f \n"
    "2:                 \n"
    "sqc2   $0, 0x00(%0)  \n"
@@ -581,8 +698,9 @@
    "vmaddax		ACC, vf1, vf6	\n"
    "vmadday		ACC, vf2, vf6	\n"
    "vmaddz		vf7, vf3, vf6	\n"
-   "vclipw.xyz		vf7, vf7	\n" // FIXME: Clip detection is still kinda broken.
-   "cfc2		$10, $18	\n"
+   "vclipw.xyz		vf7, vf7	\n"
+   "cfc2		$10, $18	\n" // The clip flags keep the previous judgements, only check this one.
+   "andi		$10, $10, 0x3f	\n"
    "beq			$10, $0, 3f	\n"
    "2:					\n"
    "sqc2		vi00, 0x00(%0)	\n"
@@ -600,4 +718,268 @@
    "bne			$0, %1, 1b	\n"
    : : "r" (output), "r" (count), "r" (vertices), "r" (local_screen) : "$10"
   );
+#elif defined(MATH3D_SSE)
+  __m128 row0 = _mm_load_ps(&local_screen[0x00]), row1 = _mm_load_ps(&local_screen[0x04]);
+  __m128 row2 = _mm_load_ps(&local_screen[0x08]), row3 = _mm_load_ps(&local_screen[0x0C]);
+  __m128 sign = _mm_set1_ps(-0.00f);
+  __m128 v, w; int loop0;
+
+  for (loop0=0;loop0<count;loop0++) {
+   v = _mm_load_ps(vertices[loop0]);
+   v = math3d_apply_sse(MATH3D_SPLAT(v, 0), MATH3D_SPLAT(v, 1), MATH3D_SPLAT(v, 2), row0, row1, row2, row3);
+   w = MATH3D_SPLAT(v, 3);
+
+   // Vertices outside of the clipping volume are set to vf0, which is (0,0,0,1).
+   if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, v), _mm_andnot_ps(sign, w))) & 7) {
+    _mm_store_ps(output[loop0], _mm_setr_ps(0.00f, 0.00f, 0.00f, 1.00f));
+   } else {
+    // Divide xyz, keeping w.
+    w = _mm_mul_ps(v, _mm_div_ps(_mm_set1_ps(1.00f), w));
+    _mm_store_ps(output[loop0], _mm_shuffle_ps(w, _mm_shuffle_ps(w, v, _MM_SHUFFLE(3, 3, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0)));
+   }
+  }
+#else
+  VECTOR work; float q, w; int loop0;
+
+  for (loop0=0;loop0<count;loop0++) {
+   math3d_apply(work, vertices[loop0], local_screen);
+   w = fabsf(work[3]);
+
+   // Vertices outside of the clipping volume are set to vf0, which is (0,0,0,1).
+   if ((fabsf(work[0]) > w) || (fabsf(work[1]) > w) || (fabsf(work[2]) > w)) {
+    output[loop0][0] = 0.00f;
+    output[loop0][1] = 0.00f;
+    output[loop0][2] = 0.00f;
+    output[loop0][3] = 1.00f;
+   } else {
+    q = 1.00f / work[3];
+    output[loop0][0] = work[0] * q;
+    output[loop0][1] = work[1] * q;
+    output[loop0][2] = work[2] * q;
+    output[loop0][3] = work[3];
+   }
+  }
+#endif
+ }
+
+ /* STREAM FUNCTIONS */
+
+ static void math3d_stream_apply(VECTOR output, VECTOR_STREAM *input0, int index, MATRIX input1) {
+  VECTOR work;
+
+  work[0] = input0->x[index];
+  work[1] = input0->y[index];
+  work[2] = input0->z[index];
+  work[3] = 1.00f;
+
+  math3d_apply(output, work, input1);
+
+ }
+
+ static void math3d_stream_store(VECTOR_STREAM *output, int index, VECTOR input0) {
+
+  output->x[index] = input0[0];
+  output->y[index] = input0[1];
+  output->z[index] = input0[2];
+  if (output->w) { output->w[index] = input0[3]; }
+
+ }
+
+#if defined(MATH3D_SSE)
+ typedef struct { __m128 row[4][4]; } MATH3D_SSE_MATRIX;
+
+ // Every element of the matrix in its own register, for transforming four vertices at once.
+ static void math3d_sse_matrix(MATH3D_SSE_MATRIX *output, MATRIX input0) {
+  int loop0, loop1;
+
+  for (loop0=0;loop0<4;loop0++) {
+   for (loop1=0;loop1<4;loop1++) {
+    output->row[loop0][loop1] = _mm_set1_ps(input0[(loop0 * 4) + loop1]);
+   }
+  }
+
+ }
+
+ static void math3d_sse_apply(__m128 *output, VECTOR_STREAM *input0, int index, MATH3D_SSE_MATRIX *input1) {
+  __m128 x = _mm_loadu_ps(&input0->x[index]), y = _mm_loadu_ps(&input0->y[index]), z = _mm_loadu_ps(&input0->z[index]);
+  int loop0;
+
+  for (loop0=0;loop0<4;loop0++) {
+   output[loop0] = math3d_apply_sse(x, y, z, input1->row[0][loop0], input1->row[1][loop0], input1->row[2][loop0], input1->row[3][loop0]);
+  }
+
+ }
+
+ static void math3d_sse_store(VECTOR_STREAM *output, int index, __m128 *input0) {
+
+  _mm_storeu_ps(&output->x[index], input0[0]);
+  _mm_storeu_ps(&output->y[index], input0[1]);
+  _mm_storeu_ps(&output->z[index], input0[2]);
+  if (output->w) { _mm_storeu_ps(&output->w[index], input0[3]); }
+
+ }
+#endif
+
+ void calculate_normals_stream(VECTOR_STREAM *output, int count, VECTOR_STREAM *normals, MATRIX local_light) {
+  VECTOR work; float q; int loop0 = 0;
+#if defined(MATH3D_SSE)
+  MATH3D_SSE_MATRIX matrix; __m128 v[4], r;
+
+  math3d_sse_matrix(&matrix, local_light);
+
+  for (;loop0+4<=count;loop0+=4) {
+   math3d_sse_apply(v, normals, loop0, &matrix);
+   r = _mm_div_ps(_mm_set1_ps(1.00f), v[3]);
+   v[0] = _mm_mul_ps(v[0], r); v[1] = _mm_mul_ps(v[1], r);
+   v[2] = _mm_mul_ps(v[2], r); v[3] = _mm_mul_ps(v[3], r);
+   math3d_sse_store(output, loop0, v);
+  }
+#endif
+
+  for (;loop0<count;loop0++) {
+   math3d_stream_apply(work, normals, loop0, local_light);
+   q = 1.00f / work[3];
+   work[0] *= q; work[1] *= q; work[2] *= q; work[3] *= q;
+   math3d_stream_store(output, loop0, work);
+  }
+
+ }
+
+ void calculate_lights_stream(VECTOR_STREAM *output, int count, VECTOR_STREAM *normals, VECTOR *light_direction, VECTOR *light_colour, int *light_type, int light_count) {
+  VECTOR work, normal, direction; float intensity; int loop0 = 0, loop1;
+#if defined(MATH3D_SSE)
+  __m128 v[4], n[3], d[3], c, sign = _mm_set1_ps(-0.00f), one = _mm_set1_ps(1.00f), zero = _mm_setzero_ps();
+
+  for (;loop0+4<=count;loop0+=4) {
+   v[0] = v[1] = v[2] = v[3] = zero;
+   c = normals->w ? _mm_loadu_ps(&normals->w[loop0]) : one;
+   n[0] = _mm_div_ps(_mm_loadu_ps(&normals->x[loop0]), c);
+   n[1] = _mm_div_ps(_mm_loadu_ps(&normals->y[loop0]), c);
+   n[2] = _mm_div_ps(_mm_loadu_ps(&normals->z[loop0]), c);
+
+   for (loop1=0;loop1<light_count;loop1++) {
+    if (light_type[loop1] == LIGHT_AMBIENT) {
+     v[0] = _mm_add_ps(v[0], _mm_set1_ps(light_colour[loop1][0]));
+     v[1] = _mm_add_ps(v[1], _mm_set1_ps(light_colour[loop1][1]));
+     v[2] = _mm_add_ps(v[2], _mm_set1_ps(light_colour[loop1][2]));
+     v[3] = one;
+    } else if (light_type[loop1] == LIGHT_DIRECTIONAL) {
+     d[0] = _mm_set1_ps(light_direction[loop1][0] / light_direction[loop1][3]);
+     d[1] = _mm_set1_ps(light_direction[loop1][1] / light_direction[loop1][3]);
+     d[2] = _mm_set1_ps(light_direction[loop1][2] / light_direction[loop1][3]);
+     c = _mm_xor_ps(sign, _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], d[0]), _mm_mul_ps(n[1], d[1])), _mm_mul_ps(n[2], d[2])));
+
+     // Only the lit normals get the light value.
+     c = _mm_and_ps(c, _mm_cmpgt_ps(c, zero));
+     v[0] = _mm_add_ps(v[0], _mm_mul_ps(_mm_set1_ps(light_colour[loop1][0]), c));
+     v[1] = _mm_add_ps(v[1], _mm_mul_ps(_mm_set1_ps(light_colour[loop1][1]), c));
+     v[2] = _mm_add_ps(v[2], _mm_mul_ps(_mm_set1_ps(light_colour[loop1][2]), c));
+     v[3] = _mm_or_ps(v[3], _mm_and_ps(one, _mm_cmpgt_ps(c, zero)));
+    }
+   }
+
+   math3d_sse_store(output, loop0, v);
+  }
+#endif
+
+  for (;loop0<count;loop0++) {
+   intensity = normals->w ? normals->w[loop0] : 1.00f;
+   normal[0] = normals->x[loop0] / intensity;
+   normal[1] = normals->y[loop0] / intensity;
+   normal[2] = normals->z[loop0] / intensity;
+   memset(work, 0, sizeof(VECTOR));
+
+   for (loop1=0;loop1<light_count;loop1++) {
+    if (light_type[loop1] == LIGHT_AMBIENT) {
+     intensity = 1.00f;
+    } else if (light_type[loop1] == LIGHT_DIRECTIONAL) {
+     direction[0] = light_direction[loop1][0] / light_direction[loop1][3];
+     direction[1] = light_direction[loop1][1] / light_direction[loop1][3];
+     direction[2] = light_direction[loop1][2] / light_direction[loop1][3];
+     intensity = -((normal[0] * direction[0]) + (normal[1] * direction[1]) + (normal[2] * direction[2]));
+    } else { intensity = 0.00f; }
+
+    if (intensity > 0.00f) {
+     work[0] += (light_colour[loop1][0] * intensity);
+     work[1] += (light_colour[loop1][1] * intensity);
+     work[2] += (light_colour[loop1][2] * intensity);
+     work[3] = 1.00f;
+    }
+   }
+
+   math3d_stream_store(output, loop0, work);
+  }
+
+ }
+
+ int calculate_vertices_stream(VECTOR_STREAM *output, u8 *clip, int count, VECTOR_STREAM *vertices, MATRIX local_screen) {
+  VECTOR work; float q, w; int loop0 = 0, flags, clipped = 0;
+#if defined(MATH3D_SSE)
+  MATH3D_SSE_MATRIX matrix; __m128 v[4], a, b, mask, planes[6]; int bits[6], loop1, loop2;
+
+  math3d_sse_matrix(&matrix, local_screen);
+
+  for (;loop0+4<=count;loop0+=4) {
+   math3d_sse_apply(v, vertices, loop0, &matrix);
+   a = _mm_andnot_ps(_mm_set1_ps(-0.00f), v[3]);
+   b = _mm_xor_ps(_mm_set1_ps(-0.00f), a);
+   mask = _mm_setzero_ps();
+
+   for (loop1=0;loop1<3;loop1++) {
+    planes[(loop1 * 2) + 0] = _mm_cmpgt_ps(v[loop1], a);
+    planes[(loop1 * 2) + 1] = _mm_cmplt_ps(v[loop1], b);
+    mask = _mm_or_ps(mask, _mm_or_ps(planes[(loop1 * 2) + 0], planes[(loop1 * 2) + 1]));
+   }
+
+   // Gather the judgements of each vertex, which is rarely needed.
+   if ((loop1 = _mm_movemask_ps(mask))) {
+    clipped += (loop1 & 1) + ((loop1 >> 1) & 1) + ((loop1 >> 2) & 1) + ((loop1 >> 3) & 1);
+
+    for (loop2=0;loop2<6;loop2++) {
+     bits[loop2] = _mm_movemask_ps(planes[loop2]);
+    }
+
+    for (loop1=0;loop1<4;loop1++) {
+     for (flags=0, loop2=0;loop2<6;loop2++) {
+      flags |= ((bits[loop2] >> loop1) & 1) << loop2;
+     }
+     if (clip) { clip[loop0 + loop1] = flags; }
+    }
+   } else if (clip) {
+    memset(&clip[loop0], 0, 4);
+   }
+
+   // Clipped vertices are set to (0,0,0,1), the others are divided by w.
+   a = _mm_div_ps(_mm_set1_ps(1.00f), v[3]);
+   v[0] = _mm_andnot_ps(mask, _mm_mul_ps(v[0], a));
+   v[1] = _mm_andnot_ps(mask, _mm_mul_ps(v[1], a));
+   v[2] = _mm_andnot_ps(mask, _mm_mul_ps(v[2], a));
+   v[3] = _mm_or_ps(_mm_and_ps(mask, _mm_set1_ps(1.00f)), _mm_andnot_ps(mask, v[3]));
+   math3d_sse_store(output, loop0, v);
+  }
+#endif
+
+  for (;loop0<count;loop0++) {
+   math3d_stream_apply(work, vertices, loop0, local_screen);
+   w = fabsf(work[3]);
+
+   // The same judgements as vclipw.xyz.
+   flags  = (work[0] > w) << 0; flags |= (work[0] < -w) << 1;
+   flags |= (work[1] > w) << 2; flags |= (work[1] < -w) << 3;
+   flags |= (work[2] > w) << 4; flags |= (work[2] < -w) << 5;
+   if (clip) { clip[loop0] = flags; }
+
+   if (flags) {
+    work[0] = 0.00f; work[1] = 0.00f; work[2] = 0.00f; work[3] = 1.00f;
+    clipped++;
+   } else {
+    q = 1.00f / work[3];
+    work[0] *= q; work[1] *= q; work[2] *= q;
+   }
+
+   math3d_stream_store(output, loop0, work);
+  }
+
+  return clipped;
+
  }
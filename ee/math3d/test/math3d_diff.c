@@ -0,0 +1,205 @@
+/*
+ * Host differential test and microbenchmark for the math3d backends.
+ *
+ * Checks, for the backend that math3d.c is built with:
+ *  - the stream functions give bit-identical results to the VECTOR functions,
+ *    including which vertices are clipped;
+ *  - matrix_multiply, vector_apply and calculate_vertices agree with a double
+ *    precision reference within a relative error of 1e-5.
+ * All results are also written to the output file, so that the SSE and the
+ * portable C backends can be compared bit for bit with cmp. The benchmark
+ * prints nanoseconds per vertex for the VECTOR and stream functions.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   F="-O2 -D_EE -Icommon/include -Iee/kernel/include -Iee/graph/include -Iee/math3d/include"
+ *   gcc $F ee/math3d/test/math3d_diff.c ee/math3d/src/math3d.c -lm -o math3d_sse
+ *   gcc $F -DMATH3D_NO_SSE ee/math3d/test/math3d_diff.c ee/math3d/src/math3d.c -lm -o math3d_c
+ *   ./math3d_sse sse.bin && ./math3d_c c.bin && cmp sse.bin c.bin
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <math3d.h>
+
+#define COUNT 4099
+#define RUNS 200
+
+static VECTOR vertices[COUNT], normals[COUNT];
+static VECTOR out_vertices[COUNT], out_normals[COUNT], out_lights[COUNT];
+
+static float sx[COUNT], sy[COUNT], sz[COUNT];
+static float ox[COUNT], oy[COUNT], oz[COUNT], ow[COUNT];
+static float lx[COUNT], ly[COUNT], lz[COUNT], lw[COUNT];
+static u8 clip[COUNT];
+
+static int errors = 0;
+
+static float random_float(float scale)
+{
+ return ((rand() / (float)RAND_MAX) * 4 - 2) * scale;
+}
+
+static double seconds(void)
+{
+ struct timespec t;
+
+ clock_gettime(CLOCK_MONOTONIC, &t);
+
+ return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int is_clipped(VECTOR v)
+{
+ return (v[0] == 0.0f) && (v[1] == 0.0f) && (v[2] == 0.0f) && (v[3] == 1.0f);
+}
+
+// Counts the elements of the AoS output that differ from the stream output.
+static int compare_stream(VECTOR *aos, float *x, float *y, float *z, float *w)
+{
+ int i, bad = 0;
+
+ for (i=0;i<COUNT;i++) {
+  if (memcmp(&x[i], &aos[i][0], 4) || memcmp(&y[i], &aos[i][1], 4) || memcmp(&z[i], &aos[i][2], 4) || memcmp(&w[i], &aos[i][3], 4)) { bad++; }
+ }
+
+ return bad;
+}
+
+static void check(const char *what, int bad)
+{
+ printf("%s: %d differences\n", what, bad);
+ if (bad) { errors++; }
+}
+
+static int close_enough(double reference, float value)
+{
+ return fabs(reference - value) <= 1e-5 * (fabs(reference) + 1.0);
+}
+
+// Checks matrix_multiply, vector_apply and calculate_vertices against double precision.
+static void check_reference(MATRIX local_screen, MATRIX local_light)
+{
+ MATRIX m; VECTOR v; double r, w; int i, j, k, bad = 0;
+
+ matrix_multiply(m, local_screen, local_light);
+ for (i=0;i<4;i++) {
+  for (j=0;j<4;j++) {
+   for (r=0,k=0;k<4;k++) { r += (double)local_screen[i*4+k] * local_light[k*4+j]; }
+   if (!close_enough(r, m[i*4+j])) { bad++; }
+  }
+ }
+
+ vector_apply(v, vertices[5], local_screen);
+ for (j=0;j<4;j++) {
+  for (r=0,k=0;k<4;k++) { r += (double)vertices[5][k] * local_screen[k*4+j]; }
+  if (!close_enough(r, v[j])) { bad++; }
+ }
+
+ for (i=0;i<COUNT;i++) {
+  if (is_clipped(out_vertices[i])) { continue; }
+  for (w=0,k=0;k<3;k++) { w += (double)vertices[i][k] * local_screen[k*4+3]; }
+  w += local_screen[15];
+  for (j=0;j<3;j++) {
+   for (r=0,k=0;k<3;k++) { r += (double)vertices[i][k] * local_screen[k*4+j]; }
+   r += local_screen[12+j];
+   if (!close_enough(r / w, out_vertices[i][j])) { bad++; }
+  }
+ }
+
+ check("double precision reference", bad);
+}
+
+int main(int argc, char **argv)
+{
+ MATRIX local_world, world_view, view_screen, local_screen, local_light, m;
+ VECTOR translation = { 0.0f, 0.0f, -6.0f, 1.0f }, rotation = { 0.3f, 0.7f, 0.1f, 1.0f };
+ VECTOR camera_position = { 0.0f, 0.0f, 0.0f, 1.0f }, camera_rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+ VECTOR light_direction[3] = { { 1.0f, -1.0f, -1.0f, 1.0f }, { -0.5f, 0.2f, 1.0f, 2.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } };
+ VECTOR light_colour[3] = { { 0.5f, 0.4f, 0.3f, 1.0f }, { 0.2f, 0.9f, 0.1f, 1.0f }, { 0.1f, 0.1f, 0.1f, 1.0f } };
+ int light_type[3] = { LIGHT_DIRECTIONAL, LIGHT_DIRECTIONAL, LIGHT_AMBIENT };
+ VECTOR_STREAM in = { sx, sy, sz, NULL }, out = { ox, oy, oz, ow }, lights = { lx, ly, lz, lw };
+ VECTOR v; double t0, t1, t2, t3, t4; int i, clipped, stream_clipped, bad;
+ FILE *f;
+
+ if (argc < 2) { printf("usage: %s output-file\n", argv[0]); return 1; }
+ if ((f = fopen(argv[1], "wb")) == NULL) { perror(argv[1]); return 1; }
+
+ srand(3);
+ for (i=0;i<COUNT;i++) {
+  vertices[i][0] = random_float(1.5f); vertices[i][1] = random_float(1.5f); vertices[i][2] = random_float(2.0f); vertices[i][3] = 1.0f;
+  normals[i][0] = random_float(1.0f); normals[i][1] = random_float(1.0f); normals[i][2] = random_float(1.0f); normals[i][3] = 1.0f;
+ }
+
+ create_local_world(local_world, translation, rotation);
+ create_world_view(world_view, camera_position, camera_rotation);
+ create_view_screen(view_screen, 4.0f/3.0f, -3.0f, 3.0f, -3.0f, 3.0f, 1.0f, 2000.0f);
+ create_local_screen(local_screen, local_world, world_view, view_screen);
+ create_local_light(local_light, rotation);
+ fwrite(local_screen, sizeof(MATRIX), 1, f);
+
+ // Vertices
+ calculate_vertices(out_vertices, COUNT, vertices, local_screen);
+ fwrite(out_vertices, sizeof(out_vertices), 1, f);
+
+ for (i=0;i<COUNT;i++) { sx[i] = vertices[i][0]; sy[i] = vertices[i][1]; sz[i] = vertices[i][2]; }
+ stream_clipped = calculate_vertices_stream(&out, clip, COUNT, &in, local_screen);
+ fwrite(ox, sizeof(ox), 1, f);
+ fwrite(clip, sizeof(clip), 1, f);
+
+ bad = compare_stream(out_vertices, ox, oy, oz, ow);
+ for (i=0,clipped=0;i<COUNT;i++) {
+  if (is_clipped(out_vertices[i])) { clipped++; }
+  if ((clip[i] != 0) != is_clipped(out_vertices[i])) { bad++; }
+ }
+ if (clipped != stream_clipped) { bad++; }
+ printf("%d of %d vertices clipped\n", clipped, COUNT);
+ check("calculate_vertices_stream", bad);
+
+ // Normals
+ calculate_normals(out_normals, COUNT, normals, local_light);
+ fwrite(out_normals, sizeof(out_normals), 1, f);
+
+ for (i=0;i<COUNT;i++) { sx[i] = normals[i][0]; sy[i] = normals[i][1]; sz[i] = normals[i][2]; }
+ calculate_normals_stream(&out, COUNT, &in, local_light);
+ check("calculate_normals_stream", compare_stream(out_normals, ox, oy, oz, ow));
+
+ // Lights, from the transformed normals
+ calculate_lights(out_lights, COUNT, out_normals, light_direction, light_colour, light_type, 3);
+ fwrite(out_lights, sizeof(out_lights), 1, f);
+
+ calculate_lights_stream(&lights, COUNT, &out, light_direction, light_colour, light_type, 3);
+ check("calculate_lights_stream", compare_stream(out_lights, lx, ly, lz, lw));
+
+ // Single vector and matrix functions
+ matrix_multiply(m, local_screen, local_light); fwrite(m, sizeof(MATRIX), 1, f);
+ vector_apply(v, vertices[5], local_screen); fwrite(v, sizeof(VECTOR), 1, f);
+ vector_normalize(v, vertices[7]); fwrite(v, sizeof(VECTOR), 1, f);
+ vector_outerproduct(v, vertices[1], vertices[2]); fwrite(v, sizeof(VECTOR), 1, f);
+ fclose(f);
+
+ check_reference(local_screen, local_light);
+
+ // Benchmark
+ for (i=0;i<COUNT;i++) { sx[i] = vertices[i][0]; sy[i] = vertices[i][1]; sz[i] = vertices[i][2]; }
+ t0 = seconds();
+ for (i=0;i<RUNS;i++) { calculate_vertices(out_vertices, COUNT, vertices, local_screen); }
+ t1 = seconds();
+ for (i=0;i<RUNS;i++) { calculate_vertices_stream(&out, clip, COUNT, &in, local_screen); }
+ t2 = seconds();
+ for (i=0;i<RUNS;i++) { calculate_lights(out_lights, COUNT, out_normals, light_direction, light_colour, light_type, 3); }
+ t3 = seconds();
+ for (i=0;i<RUNS;i++) { calculate_lights_stream(&lights, COUNT, &out, light_direction, light_colour, light_type, 3); }
+ t4 = seconds();
+
+ printf("ns per vertex: calculate_vertices %.2f, stream %.2f; calculate_lights %.2f, stream %.2f\n",
+  (t1 - t0) / RUNS / COUNT * 1e9, (t2 - t1) / RUNS / COUNT * 1e9, (t3 - t2) / RUNS / COUNT * 1e9, (t4 - t3) / RUNS / COUNT * 1e9);
+
+ printf(errors ? "FAIL\n" : "OK\n");
+
+ return errors ? 1 : 0;
+}
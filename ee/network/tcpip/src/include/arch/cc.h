@@ -52,4 +52,8 @@ typedef u32_t mem_ptr_t;
 #define lwip_htons(x) PP_HTONS(x)
 #define lwip_htonl(x) PP_HTONL(x)
 
+/* Checksum routines for LWIP_CHKSUM and LWIP_CHKSUM_COPY */
+u16_t ps2ip_chksum(const void *dataptr, int len);
+u16_t ps2ip_chksum_copy(void *dst, const void *src, u16_t len);
+
 #endif /* __CC_H__ */
@@ -244,6 +244,12 @@
  */
 #define LWIP_CHECKSUM_ON_COPY	1
 
+/**
+ * LWIP_CHKSUM, LWIP_CHKSUM_COPY: Quadword checksum routines (ps2ip_chksum.c).
+ */
+#define LWIP_CHKSUM			ps2ip_chksum
+#define LWIP_CHKSUM_COPY(dst, src, len)	ps2ip_chksum_copy(dst, src, len)
+
 /*
    ------------------------------------
    ---------- Socket options ----------
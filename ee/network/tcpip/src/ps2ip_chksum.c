@@ -0,0 +1,211 @@
+/*
+# _____     ___ ____     ___ ____
+#  ____|   |    ____|   |        | |____|
+# |     ___|   |____ ___|    ____| |    \    PS2DEV Open Source Project.
+#-----------------------------------------------------------------------
+# Copyright 2001-2004, ps2dev - http://www.ps2dev.org
+# Licenced under Academic Free License version 2.0
+# Review ps2sdk README & LICENSE files for further details.
+*/
+
+/*
+	Internet checksum routines for LWIP_CHKSUM and LWIP_CHKSUM_COPY.
+
+	Like lwip_standard_chksum(), the data is summed as 16-bit words at even addresses and
+	a buffer that starts at an odd address has its sum swapped at the end. The bulk of the
+	data is summed one quadword at a time, as 32-bit words into a 64-bit accumulator that is
+	only folded at the end.
+
+	Copies whose source and destination are aligned alike go through the same loop, which stores
+	each quadword after loading it. Other copies use unaligned 64-bit loads and aligned stores.
+*/
+
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/arch.h"
+
+typedef unsigned long long chksum_acc_t;
+
+#define FOLD_U32(sum)	(((sum) >> 16) + ((sum) & 0xFFFF))
+#define FOLD_U64(sum)	(((sum) >> 32) + ((sum) & 0xFFFFFFFF))
+#define SWAP_U16(w)	((((w) & 0xFF) << 8) | (((w) >> 8) & 0xFF))
+
+/* Sums qwc quadwords at p, which must be 16-byte aligned. */
+static u32_t chksum_qw(const void *p, u32_t qwc)
+{
+	const u32_t *pw = (const u32_t *)p;
+	chksum_acc_t acc = 0;
+
+	for(; qwc > 0; qwc--, pw += 4)
+		acc += (chksum_acc_t)pw[0] + pw[1] + pw[2] + pw[3];
+
+	acc = FOLD_U64(acc);
+	acc = FOLD_U64(acc);
+
+	return (u32_t)acc;
+}
+
+/* Copies and sums qwc quadwords, both src and dst must be 16-byte aligned. */
+static u32_t chksum_copy_qw(void *dst, const void *src, u32_t qwc)
+{
+	const u32_t *s = (const u32_t *)src;
+	u32_t *d = (u32_t *)dst;
+	chksum_acc_t acc = 0;
+
+	for(; qwc > 0; qwc--, s += 4, d += 4)
+	{
+		d[0] = s[0];
+		d[1] = s[1];
+		d[2] = s[2];
+		d[3] = s[3];
+		acc += (chksum_acc_t)s[0] + s[1] + s[2] + s[3];
+	}
+
+	acc = FOLD_U64(acc);
+	acc = FOLD_U64(acc);
+
+	return (u32_t)acc;
+}
+
+/* Copies and sums 8 bytes at a time, dst must be 8-byte aligned. The unaligned loads compile to LDL/LDR pairs. */
+static u32_t chksum_copy_dw(void *dst, const void *src, u32_t dwc)
+{
+	const u8_t *s = (const u8_t *)src;
+	chksum_acc_t *d = (chksum_acc_t *)dst;
+	chksum_acc_t acc = 0, data;
+
+	for(; dwc > 0; dwc--, s += 8, d++)
+	{
+		memcpy(&data, s, sizeof(data));
+		*d = data;
+		acc += (data & 0xFFFFFFFF) + (data >> 32);
+	}
+
+	acc = FOLD_U64(acc);
+	acc = FOLD_U64(acc);
+
+	return (u32_t)acc;
+}
+
+static u16_t chksum_finish(u32_t sum, int odd)
+{
+	sum = FOLD_U32(sum);
+	sum = FOLD_U32(sum);
+
+	//Swap if alignment was odd
+	if(odd)
+		sum = SWAP_U16(sum);
+
+	return (u16_t)sum;
+}
+
+/** Returns the Internet sum of the data (not inverted), in the same byte order as lwip_standard_chksum(). */
+u16_t ps2ip_chksum(const void *dataptr, int len)
+{
+	const u8_t *p = (const u8_t *)dataptr;
+	u16_t t = 0;
+	u32_t sum = 0, qwc;
+	int odd = ((mem_ptr_t)p & 1);
+
+	//Get aligned to u16_t
+	if(odd && len > 0)
+	{
+		((u8_t *)&t)[1] = *p++;
+		len--;
+	}
+
+	//Get aligned to a quadword
+	while(((mem_ptr_t)p & 15) && len > 1)
+	{
+		sum += *(const u16_t *)p;
+		p += 2;
+		len -= 2;
+	}
+
+	//Add the bulk of the data
+	if((qwc = len / 16) > 0)
+	{
+		sum = FOLD_U32(sum) + FOLD_U32(chksum_qw(p, qwc));
+		p += qwc * 16;
+		len -= qwc * 16;
+	}
+
+	while(len > 1)
+	{
+		sum += *(const u16_t *)p;
+		p += 2;
+		len -= 2;
+	}
+
+	//Consume left-over byte, if any
+	if(len > 0)
+		((u8_t *)&t)[0] = *p;
+
+	return chksum_finish(sum + t, odd);
+}
+
+/** Copies len bytes from src to dst and returns the Internet sum of the data, like ps2ip_chksum(dst, len). */
+u16_t ps2ip_chksum_copy(void *dst, const void *src, u16_t len)
+{
+	u8_t *d = (u8_t *)dst;
+	const u8_t *s = (const u8_t *)src;
+	u16_t t = 0, w;
+	u32_t sum = 0, n;
+	int odd = ((mem_ptr_t)d & 1);
+	int same = ((((mem_ptr_t)d ^ (mem_ptr_t)s) & 15) == 0);
+
+	//Get dst aligned to u16_t
+	if(odd && len > 0)
+	{
+		((u8_t *)&t)[1] = *d++ = *s++;
+		len--;
+	}
+
+	//Get dst aligned to a quadword for the quadword loop, or to a doubleword otherwise
+	while(((mem_ptr_t)d & (same ? 15 : 7)) && len > 1)
+	{
+		((u8_t *)&w)[0] = d[0] = s[0];
+		((u8_t *)&w)[1] = d[1] = s[1];
+		sum += w;
+		d += 2;
+		s += 2;
+		len -= 2;
+	}
+
+	//Copy the bulk of the data
+	if(same)
+	{
+		if((n = len / 16) > 0)
+		{
+			sum = FOLD_U32(sum) + FOLD_U32(chksum_copy_qw(d, s, n));
+			d += n * 16;
+			s += n * 16;
+			len -= n * 16;
+		}
+	} else {
+		if((n = len / 8) > 0)
+		{
+			sum = FOLD_U32(sum) + FOLD_U32(chksum_copy_dw(d, s, n));
+			d += n * 8;
+			s += n * 8;
+			len -= n * 8;
+		}
+	}
+
+	while(len > 1)
+	{
+		((u8_t *)&w)[0] = d[0] = s[0];
+		((u8_t *)&w)[1] = d[1] = s[1];
+		sum += w;
+		d += 2;
+		s += 2;
+		len -= 2;
+	}
+
+	//Copy left-over byte, if any
+	if(len > 0)
+		((u8_t *)&t)[0] = *d = *s;
+
+	return chksum_finish(sum + t, odd);
+}
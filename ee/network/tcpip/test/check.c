@@ -0,0 +1,137 @@
+/*
+	Host stand-in for the check unit test framework, see host/check.h. A failed assertion
+	jumps back to srunner_run_all(), which runs the teardown and goes on with the next test.
+*/
+
+#include <stdlib.h>
+#include <check.h>
+
+jmp_buf ck_jmp;
+const char *ck_test;
+
+Suite *suite_create(const char *name)
+{
+	Suite *s = calloc(1, sizeof(Suite));
+
+	s->name = name;
+	return s;
+}
+
+TCase *tcase_create(const char *name)
+{
+	TCase *tc = calloc(1, sizeof(TCase));
+
+	tc->name = name;
+	return tc;
+}
+
+void tcase_add_checked_fixture(TCase *tc, SFun setup, SFun teardown)
+{
+	tc->setup = setup;
+	tc->teardown = teardown;
+}
+
+void _tcase_add_test(TCase *tc, TFun test, const char *name, int signal, int exit_value, int start, int end)
+{
+	(void)signal;
+	(void)exit_value;
+	(void)start;
+	(void)end;
+
+	if(tc->count >= CK_MAX_TESTS)
+	{
+		printf("too many tests in %s\n", tc->name);
+		exit(1);
+	}
+
+	tc->tests[tc->count] = test;
+	tc->names[tc->count] = name;
+	tc->count++;
+}
+
+void suite_add_tcase(Suite *s, TCase *tc)
+{
+	TCase **p;
+
+	for(p = &s->tcases; *p != NULL; p = &(*p)->next);
+	*p = tc;
+}
+
+SRunner *srunner_create(Suite *s)
+{
+	SRunner *sr = calloc(1, sizeof(SRunner));
+
+	sr->suites = s;
+	return sr;
+}
+
+void srunner_add_suite(SRunner *sr, Suite *s)
+{
+	Suite **p;
+
+	for(p = &sr->suites; *p != NULL; p = &(*p)->next);
+	*p = s;
+}
+
+void srunner_set_fork_status(SRunner *sr, int status)
+{
+	(void)sr;
+	(void)status;
+}
+
+/* Runs a test, in its own function so that the caller's variables are not live across setjmp(). Returns 0 if it passed. */
+static int run_test(TFun test)
+{
+	if(setjmp(ck_jmp) != 0)
+		return 1;
+
+	test(0);
+	return 0;
+}
+
+void srunner_run_all(SRunner *sr, int mode)
+{
+	Suite *s;
+	TCase *tc;
+	int i;
+
+	(void)mode;
+
+	for(s = sr->suites; s != NULL; s = s->next)
+	{
+		for(tc = s->tcases; tc != NULL; tc = tc->next)
+		{
+			for(i = 0; i < tc->count; i++)
+			{
+				ck_test = tc->names[i];
+				sr->run++;
+
+				if(tc->setup != NULL)
+					tc->setup();
+
+				sr->failed += run_test(tc->tests[i]);
+
+				if(tc->teardown != NULL)
+					tc->teardown();
+			}
+		}
+	}
+
+	printf("%d tests, %d failed\n", sr->run, sr->failed);
+}
+
+int srunner_ntests_failed(SRunner *sr)
+{
+	return sr->failed;
+}
+
+void srunner_free(SRunner *sr)
+{
+	(void)sr;
+}
+
+/* The unit tests run with NO_SYS, and lwIP's timers are driven by the tests themselves. */
+unsigned int sys_now(void)
+{
+	return 0;
+}
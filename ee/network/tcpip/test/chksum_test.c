@@ -0,0 +1,132 @@
+/*
+	Host comparison and benchmark of the checksum routines in ps2ip_chksum.c.
+
+	ps2ip_chksum() must give the same sum as lwIP's lwip_standard_chksum() for 200000 random
+	lengths (0 to 65535) and source offsets (0 to 31). ps2ip_chksum_copy() must also copy the data
+	to a random destination offset, without writing outside of it, and return the sum of the copy.
+	The throughput of both routines is then compared with lwip_standard_chksum(), and with a
+	memcpy() followed by it.
+
+	Build and run from the root of the tree, together with lwIP's test/unit suites, which are run
+	with the stock checksum and then with these routines as LWIP_CHKSUM and LWIP_CHKSUM_COPY. The
+	sources are the .c files under src/core and under the suite directories of test/unit:
+
+	L=common/tcpip/lwip-2.0.0; S=$L/src; U=$L/test/unit; T=ee/network/tcpip/test
+	F="-O1 -Wall -Wextra -DLWIP_UNITTESTS_NOFORK -I$T/host -I$U -I$S/include"
+	SRCS="$(find $S/core -name '*.c') $S/netif/ethernet.c $S/apps/mdns/mdns.c $T/check.c"
+	SRCS="$SRCS $U/lwip_unittests.c $(find $U -mindepth 2 -name '*.c')"
+	gcc $F $SRCS -o lwip_unittests && ./lwip_unittests
+	gcc $F -DPS2IP_CHKSUM $SRCS ee/network/tcpip/src/ps2ip_chksum.c -o lwip_unittests_ps2ip && ./lwip_unittests_ps2ip
+	gcc -O2 -Wall -Wextra -I$T/host -I$U -I$S/include $T/chksum_test.c $S/core/inet_chksum.c $S/core/def.c ee/network/tcpip/src/ps2ip_chksum.c -o chksum_test
+	./chksum_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lwip/opt.h"
+#include "lwip/inet_chksum.h"
+
+//Defined in inet_chksum.c, which only declares it for itself.
+u16_t lwip_standard_chksum(const void *dataptr, int len);
+
+#define BUFFER_SIZE	(65536 + 64)
+#define CASES		200000
+
+static u8_t src[BUFFER_SIZE] __attribute__((aligned(64)));
+static u8_t dst[BUFFER_SIZE] __attribute__((aligned(64)));
+static u8_t expected[BUFFER_SIZE];
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int fail(const char *what, int len, int src_offset, int dst_offset)
+{
+	printf("FAIL: %s, length %d, source offset %d, destination offset %d\n", what, len, src_offset, dst_offset);
+	return 1;
+}
+
+static void benchmark(int len)
+{
+	volatile u32_t sink = 0;
+	long i, runs = 400000000L / len;
+	double t0, t1, t2, t3, t4, mb = (double)runs * len / 1e6;
+
+	t0 = seconds();
+	for(i = 0; i < runs; i++)
+		sink += lwip_standard_chksum(src + 2, len);
+	t1 = seconds();
+	for(i = 0; i < runs; i++)
+		sink += ps2ip_chksum(src + 2, len);
+	t2 = seconds();
+	for(i = 0; i < runs; i++)
+	{
+		memcpy(dst + 6, src + 2, len);
+		sink += lwip_standard_chksum(dst + 6, len);
+	}
+	t3 = seconds();
+	for(i = 0; i < runs; i++)
+		sink += ps2ip_chksum_copy(dst + 6, src + 2, len);
+	t4 = seconds();
+
+	printf("%5d bytes: checksum %5.0f -> %5.0f MB/s, copy and checksum %5.0f -> %5.0f MB/s\n",
+		len, mb / (t1 - t0), mb / (t2 - t1), mb / (t3 - t2), mb / (t4 - t3));
+}
+
+int main(void)
+{
+	int i, len, src_offset, dst_offset;
+	u16_t sum;
+
+	srand(7);
+	for(i = 0; i < BUFFER_SIZE; i++)
+		src[i] = rand();
+
+	for(i = 0; i < CASES; i++)
+	{
+		//All the short lengths first, then mostly frame-sized ones.
+		len = (i < 1000) ? i : ((rand() % 3 == 0) ? rand() % 65536 : rand() % 2000);
+		src_offset = rand() % 32;
+		dst_offset = rand() % 32;
+
+		sum = lwip_standard_chksum(src + src_offset, len);
+		if(ps2ip_chksum(src + src_offset, len) != sum)
+			return fail("ps2ip_chksum", len, src_offset, dst_offset);
+
+		memset(dst, 0xA5, len + 64);
+		memcpy(expected, dst, len + 64);
+		memcpy(expected + dst_offset, src + src_offset, len);
+
+		sum = ps2ip_chksum_copy(dst + dst_offset, src + src_offset, len);
+		if(memcmp(dst, expected, len + 64) != 0)
+			return fail("ps2ip_chksum_copy data", len, src_offset, dst_offset);
+		if(sum != lwip_standard_chksum(dst + dst_offset, len))
+			return fail("ps2ip_chksum_copy sum", len, src_offset, dst_offset);
+	}
+
+	//The largest sum, which must not overflow the accumulator.
+	memset(src, 0xFF, BUFFER_SIZE);
+	if(ps2ip_chksum(src, 65535) != lwip_standard_chksum(src, 65535))
+		return fail("ps2ip_chksum of 0xFF bytes", 65535, 0, 0);
+
+	printf("%d random cases match lwip_standard_chksum\n", CASES);
+
+	srand(7);
+	for(i = 0; i < BUFFER_SIZE; i++)
+		src[i] = rand();
+
+	benchmark(64);
+	benchmark(1460);
+	benchmark(32768);
+
+	printf("OK\n");
+
+	return 0;
+}
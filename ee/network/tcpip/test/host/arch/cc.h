@@ -0,0 +1,23 @@
+/* Host stand-in for the arch/cc.h of the EE port, with the same checksum routines. */
+#ifndef __CC_H__
+#define __CC_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define PACK_STRUCT_STRUCT __attribute((packed))
+
+/* Assertions are reported without stopping, like on the EE. Some of the unit tests trigger them on purpose. */
+#define LWIP_PLATFORM_DIAG(args) do { printf args; } while(0)
+#define LWIP_PLATFORM_ASSERT(msg) do { printf("Assertion \"%s\" failed at line %d in %s\n", msg, __LINE__, __FILE__); } while(0)
+
+#define LWIP_RAND() ((u32_t)rand())
+
+/* Checksum routines for LWIP_CHKSUM and LWIP_CHKSUM_COPY */
+uint16_t ps2ip_chksum(const void *dataptr, int len);
+uint16_t ps2ip_chksum_copy(void *dst, const void *src, uint16_t len);
+
+#endif /* __CC_H__ */
@@ -0,0 +1,61 @@
+/* Host stand-in for the check unit test framework: just enough to run lwIP's test/unit suites, without forking. */
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdio.h>
+#include <setjmp.h>
+
+#define CK_MAX_TESTS	64
+
+typedef void (*TFun)(int);
+typedef void (*SFun)(void);
+
+typedef struct TCase {
+	const char *name;
+	SFun setup, teardown;
+	TFun tests[CK_MAX_TESTS];
+	const char *names[CK_MAX_TESTS];
+	int count;
+	struct TCase *next;
+} TCase;
+
+typedef struct Suite {
+	const char *name;
+	TCase *tcases;
+	struct Suite *next;
+} Suite;
+
+typedef struct {
+	Suite *suites;
+	int run, failed;
+} SRunner;
+
+enum { CK_NOFORK, CK_FORK, CK_NORMAL };
+
+extern jmp_buf ck_jmp;
+extern const char *ck_test;
+
+#define START_TEST(name)	static void name(int _i) { (void)_i;
+#define END_TEST		}
+
+#define ck_fail(msg)		do { printf("FAIL: %s: %s:%d: %s\n", ck_test, __FILE__, __LINE__, msg); longjmp(ck_jmp, 1); } while(0)
+#define fail_unless(expr, ...)	do { if(!(expr)) ck_fail(#expr); } while(0)
+#define fail_if(expr, ...)	do { if(expr) ck_fail(#expr); } while(0)
+#define fail(...)		ck_fail("fail()")
+#define mark_point()
+
+Suite *suite_create(const char *name);
+TCase *tcase_create(const char *name);
+void tcase_add_checked_fixture(TCase *tc, SFun setup, SFun teardown);
+void _tcase_add_test(TCase *tc, TFun test, const char *name, int signal, int exit_value, int start, int end);
+#define tcase_add_test(tc, test)	_tcase_add_test(tc, test, #test, 0, 0, 0, 1)
+void suite_add_tcase(Suite *s, TCase *tc);
+
+SRunner *srunner_create(Suite *s);
+void srunner_add_suite(SRunner *sr, Suite *s);
+void srunner_set_fork_status(SRunner *sr, int status);
+void srunner_run_all(SRunner *sr, int mode);
+int srunner_ntests_failed(SRunner *sr);
+void srunner_free(SRunner *sr);
+
+#endif /* __CHECK_H__ */
@@ -0,0 +1 @@
+/* Host stand-in for the config.h of the check framework, included by lwip_check.h. */
@@ -0,0 +1,8 @@
+/* Host options: those of lwIP's test/unit, with the checksum routines of the EE port if PS2IP_CHKSUM is defined. */
+#include_next <lwipopts.h>
+
+#ifdef PS2IP_CHKSUM
+#define LWIP_CHECKSUM_ON_COPY		1
+#define LWIP_CHKSUM			ps2ip_chksum
+#define LWIP_CHKSUM_COPY(dst, src, len)	ps2ip_chksum_copy(dst, src, len)
+#endif
@@ -0,0 +1,76 @@
+/**
+ * @file
+ * Packet ring functions, for building dma chains while earlier ones are sent.
+ */
+
+#ifndef __PACKET_RING_H__
+#define __PACKET_RING_H__
+
+#include <tamtypes.h>
+
+#include <packet.h>
+
+/** Maximum number of packets in a ring. */
+#define PACKET_RING_MAX 4
+
+typedef struct {
+	/** Chains kicked */
+	u32 kicks;
+	/** Qwords kicked */
+	u32 qwords;
+	/** Times packet_ring_begin() or packet_ring_flush() had to wait for the dma channel */
+	u32 stalls;
+	/** Cpu ticks spent waiting for the dma channel */
+	u32 stall_ticks;
+} packet_ring_stats_t;
+
+typedef struct {
+	packet_t *packets[PACKET_RING_MAX];
+	u8 state[PACKET_RING_MAX];
+	u8 queue[PACKET_RING_MAX];	// kicked packets that aren't sent yet, oldest first
+	int queued;
+	int count;
+	int current;				// packet that is built next
+	int sending;				// packet the dma channel is reading, -1 if none
+	int channel;
+	packet_ring_stats_t stats;
+} packet_ring_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocates a ring of count packets of qwords each, sent to the dma channel as chains.
+ * Scratchpad rings split the scratchpad between their packets.
+ */
+packet_ring_t *packet_ring_init(int count, int qwords, int type, int channel);
+
+/** Waits for the ring's transfers to finish and frees it. */
+void packet_ring_free(packet_ring_t *ring);
+
+/**
+ * Returns the packet to build the next chain in. Only waits for the dma channel if the
+ * packet is still queued or being sent. The packet's data is not cleared.
+ */
+packet_t *packet_ring_begin(packet_ring_t *ring);
+
+/**
+ * Kicks the chain built from the start of the current packet up to q and moves on to the
+ * next packet. The chain is queued if the channel is busy, and queued chains are sent by the
+ * next packet_ring call that finds the channel ready. Nothing else may be sent to the channel
+ * until packet_ring_flush() is called.
+ */
+void packet_ring_kick(packet_ring_t *ring, qword_t *q);
+
+/** Sends all queued chains and waits for the channel to finish. */
+void packet_ring_flush(packet_ring_t *ring);
+
+/** Retrieves the statistics, usually once per frame, and resets them. */
+void packet_ring_get_stats(packet_ring_t *ring, packet_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PACKET_RING_H__ */
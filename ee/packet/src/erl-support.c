@@ -15,5 +15,7 @@
 char * erl_id = "libpacket";
 char * erl_dependancies[] = {
     "libc",
+    "libdma",
+    "libkernel",
     0
 };
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+
+#include <dma.h>
+#include <timer.h>
+
+#include <packet_ring.h>
+
+#define SPR_BEGIN 0x70000000
+#define SPR_QWORDS 1024
+
+#define PACKET_RING_FREE    0
+#define PACKET_RING_QUEUED  1
+#define PACKET_RING_SENDING 2
+
+static void packet_ring_send(packet_ring_t *ring, packet_t *packet)
+{
+
+	if (packet->type == PACKET_UCAB)
+	{
+
+		dma_channel_send_chain_ucab(ring->channel, packet->data, packet->qwc, 0);
+
+	}
+	else
+	{
+
+		dma_channel_send_chain(ring->channel, packet->data, packet->qwc, 0, packet->type == PACKET_SPR);
+
+	}
+
+}
+
+// Retires the finished transfer and starts the next queued one.
+static void packet_ring_poll(packet_ring_t *ring)
+{
+
+	int i;
+
+	if ((ring->sending >= 0) && !dma_channel_busy(ring->channel))
+	{
+
+		ring->state[ring->sending] = PACKET_RING_FREE;
+		ring->sending = -1;
+
+	}
+
+	if ((ring->sending < 0) && (ring->queued > 0))
+	{
+
+		ring->sending = ring->queue[0];
+		ring->state[ring->sending] = PACKET_RING_SENDING;
+
+		ring->queued--;
+
+		for (i = 0; i < ring->queued; i++)
+		{
+			ring->queue[i] = ring->queue[i+1];
+		}
+
+		packet_ring_send(ring, ring->packets[ring->sending]);
+
+	}
+
+}
+
+// Waits for the channel and moves on to the next queued chain.
+static void packet_ring_stall(packet_ring_t *ring)
+{
+
+	u32 start = cpu_ticks();
+
+	dma_channel_wait(ring->channel, -1);
+	packet_ring_poll(ring);
+
+	ring->stats.stalls++;
+	ring->stats.stall_ticks += cpu_ticks() - start;
+
+}
+
+packet_ring_t *packet_ring_init(int count, int qwords, int type, int channel)
+{
+
+	int i;
+	packet_ring_t *ring;
+
+	if ((count < 1) || (count > PACKET_RING_MAX))
+	{
+		return NULL;
+	}
+
+	// Every packet needs its own part of the scratchpad.
+	if ((type == PACKET_SPR) && (count * qwords > SPR_QWORDS))
+	{
+		return NULL;
+	}
+
+	if ((ring = (packet_ring_t*)calloc(1,sizeof(packet_ring_t))) == NULL)
+	{
+		return NULL;
+	}
+
+	ring->sending = -1;
+	ring->channel = channel;
+
+	for (i = 0; i < count; i++)
+	{
+
+		if ((ring->packets[i] = packet_init(qwords, type)) == NULL)
+		{
+
+			ring->count = i;
+			packet_ring_free(ring);
+			return NULL;
+
+		}
+
+		if (type == PACKET_SPR)
+		{
+			ring->packets[i]->data = (qword_t *)(SPR_BEGIN + ((i * qwords) << 4));
+		}
+
+		ring->packets[i]->qwc = 0;
+		ring->state[i] = PACKET_RING_FREE;
+
+	}
+
+	ring->count = count;
+
+	return ring;
+
+}
+
+void packet_ring_free(packet_ring_t *ring)
+{
+
+	int i;
+
+	packet_ring_flush(ring);
+
+	for (i = 0; i < ring->count; i++)
+	{
+		packet_free(ring->packets[i]);
+	}
+
+	free(ring);
+
+}
+
+packet_t *packet_ring_begin(packet_ring_t *ring)
+{
+
+	packet_t *packet = ring->packets[ring->current];
+
+	packet_ring_poll(ring);
+
+	while (ring->state[ring->current] != PACKET_RING_FREE)
+	{
+		packet_ring_stall(ring);
+	}
+
+	// The data gets overwritten, so there's no need to clear it.
+	packet->qwc = 0;
+
+	return packet;
+
+}
+
+void packet_ring_kick(packet_ring_t *ring, qword_t *q)
+{
+
+	packet_t *packet = ring->packets[ring->current];
+
+	packet->qwc = q - packet->data;
+
+	ring->stats.kicks++;
+	ring->stats.qwords += packet->qwc;
+
+	ring->state[ring->current] = PACKET_RING_QUEUED;
+	ring->queue[ring->queued++] = ring->current;
+
+	if (++ring->current == ring->count)
+	{
+		ring->current = 0;
+	}
+
+	packet_ring_poll(ring);
+
+}
+
+void packet_ring_flush(packet_ring_t *ring)
+{
+
+	packet_ring_poll(ring);
+
+	while (ring->sending >= 0)
+	{
+		packet_ring_stall(ring);
+	}
+
+}
+
+void packet_ring_get_stats(packet_ring_t *ring, packet_ring_stats_t *stats)
+{
+
+	*stats = ring->stats;
+
+	ring->stats.kicks = 0;
+	ring->stats.qwords = 0;
+	ring->stats.stalls = 0;
+	ring->stats.stall_ticks = 0;
+
+}
@@ -0,0 +1,233 @@
+/*
+ * Host simulation of the packet ring in packet_ring.c against a mocked dma channel.
+ *
+ * Time is counted in ticks: building a frame costs the cpu a given number of
+ * ticks, and a transfer keeps the channel busy for one tick per qword. The
+ * mock checks that no packet is handed out while it is still queued or being
+ * read by the dma, and that no transfer is started on a busy channel. Each run
+ * prints the total time and the stall statistics of the ring.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   gcc -O2 -D_EE -Icommon/include -Iee/kernel/include -Iee/packet/include \
+ *       -Iee/dma/include ee/packet/test/ring_sim.c ee/packet/src/packet_ring.c -o ring_sim
+ *   ./ring_sim                          # rings of 1 to 4 packets, cpu and dma-bound
+ *   ./ring_sim packets build transfer   # a single run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dma.h>
+#include <timer.h>
+#include <packet_ring.h>
+
+#define FRAMES 100
+
+static u32 now;
+static u32 busy_until;
+static int sends;
+static int errors;
+
+// Packets that were kicked and are not finished yet, with the time their transfer ends (0 if not started).
+static void *pending[PACKET_RING_MAX];
+static u32 pending_end[PACKET_RING_MAX];
+static int pending_count;
+
+u32 cpu_ticks(void)
+{
+
+	return now;
+
+}
+
+int dma_channel_busy(int channel)
+{
+
+	return now < busy_until;
+
+}
+
+int dma_channel_wait(int channel, int timeout)
+{
+
+	if (now < busy_until)
+	{
+		now = busy_until;
+	}
+
+	return 0;
+
+}
+
+static void start_transfer(void *data, int qwc)
+{
+
+	int i;
+
+	if (now < busy_until)
+	{
+		printf("error: transfer started on a busy channel at %u\n", now);
+		errors++;
+	}
+
+	busy_until = now + qwc;
+	sends++;
+
+	for (i = 0; i < pending_count; i++)
+	{
+		if ((pending[i] == data) && (pending_end[i] == 0))
+		{
+			pending_end[i] = busy_until;
+			return;
+		}
+	}
+
+	printf("error: a packet was sent that wasn't kicked\n");
+	errors++;
+
+}
+
+int dma_channel_send_chain(int channel, void *data, int qwc, int flags, int spr)
+{
+
+	start_transfer(data, qwc);
+
+	return 0;
+
+}
+
+int dma_channel_send_chain_ucab(int channel, void *data, int qwc, int flags)
+{
+
+	start_transfer(data, qwc);
+
+	return 0;
+
+}
+
+packet_t *packet_init(int qwords, int type)
+{
+
+	packet_t *packet = calloc(1, sizeof(packet_t));
+
+	packet->data = malloc(qwords * sizeof(qword_t));
+	packet->qwords = qwords;
+	packet->type = type;
+
+	return packet;
+
+}
+
+void packet_free(packet_t *packet)
+{
+
+	free(packet->data);
+	free(packet);
+
+}
+
+// Forgets the finished transfers and checks that data is not owned by the dma.
+static void check_owner(void *data)
+{
+
+	int i, j;
+
+	for (i = 0, j = 0; i < pending_count; i++)
+	{
+
+		if ((pending_end[i] != 0) && (pending_end[i] <= now))
+		{
+			continue;
+		}
+
+		if (pending[i] == data)
+		{
+			printf("error: packet handed out at %u while the dma still owns it\n", now);
+			errors++;
+		}
+
+		pending[j] = pending[i];
+		pending_end[j] = pending_end[i];
+		j++;
+
+	}
+
+	pending_count = j;
+
+}
+
+static int run(int count, int build, int transfer)
+{
+
+	packet_ring_t *ring;
+	packet_ring_stats_t stats;
+	packet_t *packet;
+	int frame;
+
+	now = busy_until = 0;
+	sends = errors = pending_count = 0;
+
+	ring = packet_ring_init(count, 1000, PACKET_NORMAL, DMA_CHANNEL_GIF);
+
+	for (frame = 0; frame < FRAMES; frame++)
+	{
+
+		packet = packet_ring_begin(ring);
+		check_owner(packet->data);
+
+		// Build the chain, kick it, then do the rest of the frame's work.
+		now += build;
+
+		pending[pending_count] = packet->data;
+		pending_end[pending_count] = 0;
+		pending_count++;
+
+		packet_ring_kick(ring, packet->data + transfer);
+
+		now += build / 2;
+
+	}
+
+	packet_ring_flush(ring);
+	packet_ring_get_stats(ring, &stats);
+
+	if (dma_channel_busy(DMA_CHANNEL_GIF) || (sends != FRAMES))
+	{
+		printf("error: %d of %d chains were sent\n", sends, FRAMES);
+		errors++;
+	}
+
+	printf("%d packets, build %3d, transfer %3d: %5u ticks, %u kicks, %u qwords, %3u stalls, %5u stall ticks\n",
+		count, build, transfer, now, stats.kicks, stats.qwords, stats.stalls, stats.stall_ticks);
+
+	packet_ring_free(ring);
+
+	return errors;
+
+}
+
+int main(int argc, char **argv)
+{
+
+	static const int loads[][2] = { { 200, 100 }, { 100, 100 }, { 100, 200 }, { 50, 200 } };
+	int count, i, errors = 0;
+
+	if (argc > 3)
+	{
+		return run(atoi(argv[1]), atoi(argv[2]), atoi(argv[3])) ? 1 : 0;
+	}
+
+	for (i = 0; i < 4; i++)
+	{
+		for (count = 1; count <= PACKET_RING_MAX; count++)
+		{
+			errors += run(count, loads[i][0], loads[i][1]);
+		}
+	}
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return errors ? 1 : 0;
+
+}
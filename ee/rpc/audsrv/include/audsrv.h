@@ -253,6 +253,22 @@ int audsrv_ch_play_adpcm(int ch, audsrv_adpcm_t *adpcm);
  */
 int audsrv_on_cdda_stop(audsrv_callback_t cb, void *arg);
 
+/** Starts queueing calls instead of sending them
+ * @returns AUDSRV_ERR_NOERROR
+ *
+ * The calls that take one or two integers, like audsrv_set_volume(),
+ * audsrv_adpcm_set_volume() and audsrv_ch_play_adpcm(), are queued until
+ * audsrv_batch_end() and return AUDSRV_ERR_NOERROR meanwhile, so only calls
+ * whose results are not needed should be made in between. The queued calls
+ * are sent in one RPC, or in a few if there are many.
+ */
+int audsrv_batch_begin();
+
+/** Sends the calls queued since audsrv_batch_begin()
+ * @returns the first negative value returned by one of them, or AUDSRV_ERR_NOERROR
+ */
+int audsrv_batch_end();
+
 #ifdef __cplusplus
 }
 #endif
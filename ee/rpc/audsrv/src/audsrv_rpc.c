@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <kernel.h>
 #include <sifrpc.h>
+#include <sifrpc_batch.h>
 #include <tamtypes.h>
 #include <string.h>
 #include <iopheap.h>
@@ -32,6 +33,13 @@ static struct t_SifRpcDataQueue cb_queue;
 static struct t_SifRpcServerData cb_srv;
 static unsigned char rpc_server_stack[0x1800] __attribute__((aligned (16)));
 
+/* calls queued between audsrv_batch_begin() and audsrv_batch_end() */
+static unsigned int batch_buff[512] __attribute__((aligned (64)));
+static unsigned int batch_rbuff[256] __attribute__((aligned (64)));
+static SifRpcBatch_t batch;
+static int batching = 0;
+static int batch_error;
+
 extern void *_gp;
 
 static int initialized = 0;
@@ -68,19 +76,63 @@ int audsrv_get_error()
 	return audsrv_error;
 }
 
+/** Internal function to send the queued calls, called with completion_sema held
+ * @returns the first negative value returned by one of them, or AUDSRV_ERR_NOERROR
+ */
+static int send_batch()
+{
+	int i, count, ret = AUDSRV_ERR_NOERROR;
+
+	count = SifRpcBatchCount(&batch);
+	if (count > 0)
+	{
+		SifCallRpcBatch(&cd0, 0, &batch, batch_rbuff, NULL, NULL);
+
+		/* every result takes 16 bytes of the reply */
+		for (i = 0; i < count; i++)
+		{
+			if ((int)batch_rbuff[i*4] < 0 && ret == AUDSRV_ERR_NOERROR)
+			{
+				ret = batch_rbuff[i*4];
+			}
+		}
+	}
+
+	SifRpcBatchInit(&batch, batch_buff, sizeof(batch_buff));
+	return ret;
+}
+
 /** Internal function to simplify RPC calling
  * @param func    procedure to invoke
- * @param arg     optional argument
- * @returns value returned by RPC server
-*/
-static int call_rpc_1(int func, int arg)
+ * @param args    arguments
+ * @param count   number of arguments
+ * @returns value returned by RPC server, or AUDSRV_ERR_NOERROR if the call was queued
+ */
+static int call_rpc(int func, const int *args, int count)
 {
 	int ret;
 
 	WaitSema(completion_sema);
 
-	sbuff[0] = arg;
-	SifCallRpc(&cd0, func, 0, sbuff, 1*4, sbuff, 4, NULL, NULL);
+	if (batching)
+	{
+		if (SifRpcBatchAdd(&batch, func, args, count*4, 4, NULL) < 0)
+		{
+			ret = send_batch();
+			if (batch_error == AUDSRV_ERR_NOERROR)
+			{
+				batch_error = ret;
+			}
+
+			SifRpcBatchAdd(&batch, func, args, count*4, 4, NULL);
+		}
+
+		SignalSema(completion_sema);
+		return AUDSRV_ERR_NOERROR;
+	}
+
+	memcpy(sbuff, args, count*4);
+	SifCallRpc(&cd0, func, 0, sbuff, count*4, sbuff, 4, NULL, NULL);
 
 	ret = sbuff[0];
 	SignalSema(completion_sema);
@@ -90,6 +142,16 @@ static int call_rpc_1(int func, int arg)
 	return ret;
 }
 
+/** Internal function to simplify RPC calling
+ * @param func    procedure to invoke
+ * @param arg     optional argument
+ * @returns value returned by RPC server
+*/
+static int call_rpc_1(int func, int arg)
+{
+	return call_rpc(func, &arg, 1);
+}
+
 /** Internal function to simplify RPC calling
  * @param func    procedure to invoke
  * @param arg1    optional argument
@@ -97,16 +159,48 @@ static int call_rpc_1(int func, int arg)
  * @returns value returned by RPC server
 */
 static int call_rpc_2(int func, int arg1, int arg2)
+{
+	int args[2];
+
+	args[0] = arg1;
+	args[1] = arg2;
+	return call_rpc(func, args, 2);
+}
+
+int audsrv_batch_begin()
+{
+	WaitSema(completion_sema);
+
+	if (!batching)
+	{
+		SifRpcBatchInit(&batch, batch_buff, sizeof(batch_buff));
+		batch_error = AUDSRV_ERR_NOERROR;
+		batching = 1;
+	}
+
+	SignalSema(completion_sema);
+	return AUDSRV_ERR_NOERROR;
+}
+
+int audsrv_batch_end()
 {
 	int ret;
 
 	WaitSema(completion_sema);
 
-	sbuff[0] = arg1;
-	sbuff[1] = arg2;
-	SifCallRpc(&cd0, func, 0, sbuff, 2*4, sbuff, 4, NULL, NULL);
+	if (!batching)
+	{
+		SignalSema(completion_sema);
+		return AUDSRV_ERR_NOERROR;
+	}
 
-	ret = sbuff[0];
+	ret = send_batch();
+	if (batch_error != AUDSRV_ERR_NOERROR)
+	{
+		ret = batch_error;
+	}
+
+	batching = 0;
 	SignalSema(completion_sema);
 
 	set_error(ret);
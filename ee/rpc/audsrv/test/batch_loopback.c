@@ -0,0 +1,355 @@
+/*
+ * Host test of the batched audsrv calls in audsrv_rpc.c, with a loopback IOP.
+ *
+ * SifCallRpc() copies the request into the receive buffer of a fake audsrv server, runs its RPC
+ * function and copies the reply back. The server logs every call with its arguments and answers
+ * with a value made from them, and hands SIF_RPC_BATCH to SifRpcBatchDispatch() like the IOP
+ * module does. Playing a sample on channels 96 to 99 is refused with a different negative
+ * answer for each.
+ *
+ * - Calls made one at a time must each be one RPC, and return the server's answer.
+ * - Calls made between audsrv_batch_begin() and audsrv_batch_end() must return
+ *   AUDSRV_ERR_NOERROR, reach the server in order with the same arguments, and take one RPC per
+ *   63 calls. audsrv_batch_end() must return the first negative answer, and an empty batch
+ *   must not make an RPC.
+ * - Calls per frame: frames of 1 to 256 calls are made both ways, and the SIF time of each frame
+ *   is modelled from the RPCs and bytes that were sent. Every RPC costs two SIF transfers of
+ *   20us, one for the request and one for the reply, and the data goes at 15MB/s.
+ *
+ * Build and run from the root of the tree. audsrv_rpc.c passes EE addresses to the IOP as int,
+ * hence the -Wno options:
+ *
+ *   gcc -O2 -Wall -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -D_EE \
+ *       -Iee/rpc/audsrv/test/host -Iee/rpc/audsrv/include -Icommon/include -Iee/rpc/audsrv/src \
+ *       ee/rpc/audsrv/test/batch_loopback.c -o batch_loopback
+ *   ./batch_loopback
+ */
+
+#include "audsrv_rpc.c"
+
+#include <stdlib.h>
+
+#define MAX_CALLS	4096
+#define CASES		200
+#define CALLS_PER_BATCH	63	/* (sizeof(batch_buff) - header) / (entry + 16 bytes of arguments) */
+
+#define RPC_COST	40e-6
+#define BYTES_PER_SEC	15e6
+#define FRAME		(1.0 / 60)
+
+typedef struct {
+	int func;
+	int args[2];
+	int nargs;
+} call_t;
+
+void *_gp;
+
+static unsigned int iop_buffer[18000/4];
+static call_t calls[MAX_CALLS];
+static int call_count = 0;
+static int rpcs = 0, bytes = 0;
+static int sema_held = 0;
+static audsrv_adpcm_t samples[4];
+static int errors = 0;
+
+static void error(const char *what, int n)
+{
+	if (errors++ < 10)
+	{
+		printf("error: %s, %d\n", what, n);
+	}
+}
+
+int CreateSema(ee_sema_t *sema) { return 1; }
+int DeleteSema(int sema_id) { return 0; }
+
+int WaitSema(int sema_id)
+{
+	if (sema_held)
+	{
+		error("completion_sema is taken twice", call_count);
+	}
+
+	sema_held = 1;
+	return sema_id;
+}
+
+int SignalSema(int sema_id)
+{
+	if (!sema_held)
+	{
+		error("completion_sema is released but not taken", call_count);
+	}
+
+	sema_held = 0;
+	return sema_id;
+}
+
+int CreateThread(ee_thread_t *thread) { return 2; }
+int StartThread(int thread_id, void *args) { return 0; }
+int TerminateThread(int thread_id) { return 0; }
+int DeleteThread(int thread_id) { return 0; }
+int GetThreadId(void) { return 2; }
+
+u32 SifSetDma(SifDmaTransfer_t *sdd, s32 len) { return 1; }
+int SifDmaStat(u32 id) { return -1; }
+
+int SifInitIopHeap(void) { return 0; }
+void *SifAllocIopHeap(int size) { return NULL; }
+int SifFreeIopHeap(void *addr) { return 0; }
+
+SifRpcServerData_t *SifRegisterRpc(SifRpcServerData_t *srv, int sid, SifRpcFunc_t func, void *buff,
+	SifRpcFunc_t cfunc, void *cbuff, SifRpcDataQueue_t *qd) { return srv; }
+SifRpcServerData_t *SifRemoveRpc(SifRpcServerData_t *sd, SifRpcDataQueue_t *qd) { return sd; }
+SifRpcDataQueue_t *SifSetRpcQueue(SifRpcDataQueue_t *q, int thread_id) { return q; }
+SifRpcDataQueue_t *SifRemoveRpcQueue(SifRpcDataQueue_t *qd) { return qd; }
+void SifRpcLoop(SifRpcDataQueue_t *q) { }
+
+int SifBindRpc(SifRpcClientData_t *client, int rpc_number, int mode)
+{
+	client->server = iop_buffer;
+	return 0;
+}
+
+/* The server's answer to a call, negative for channels 96 to 99.  */
+static int answer(int func, const int *args, int nargs)
+{
+	if (func == AUDSRV_PLAY_ADPCM && args[0] >= 96)
+	{
+		return 95 - args[0];
+	}
+
+	return func * 1000 + (nargs > 0 ? args[0] & 0xff : 0) + (nargs > 1 ? (args[1] & 0xff) << 12 : 0);
+}
+
+/* The audsrv server: logs the calls and answers them like rpc_command() in rpc_server.c.  */
+static void *iop_rpc_command(int func, unsigned *data, int size)
+{
+	call_t *call;
+
+	if (func == SIF_RPC_BATCH)
+	{
+		return SifRpcBatchDispatch((SifRpcFunc_t)iop_rpc_command, data, size, sizeof(iop_buffer));
+	}
+
+	if (func == AUDSRV_INIT)
+	{
+		data[0] = 0;
+		return data;
+	}
+
+	if (call_count >= MAX_CALLS)
+	{
+		error("too many calls", call_count);
+		data[0] = -1;
+		return data;
+	}
+
+	call = &calls[call_count++];
+	call->func = func;
+	call->nargs = size / 4;
+	call->args[0] = size >= 4 ? data[0] : 0;
+	call->args[1] = size >= 8 ? data[1] : 0;
+
+	data[0] = answer(func, call->args, call->nargs);
+	return data;
+}
+
+int SifCallRpc(SifRpcClientData_t *client, int rpc_number, int mode, void *send, int ssize, void *receive, int rsize,
+	SifRpcEndFunc_t end_function, void *end_param)
+{
+	void *reply;
+
+	if (ssize > (int)sizeof(iop_buffer))
+	{
+		error("request larger than the server's buffer", ssize);
+		return -1;
+	}
+
+	memcpy(iop_buffer, send, ssize);
+	reply = iop_rpc_command(rpc_number, (unsigned *)iop_buffer, ssize);
+	memcpy(receive, reply, rsize);
+
+	rpcs++;
+	bytes += ssize + rsize;
+
+	return 0;
+}
+
+/* Makes a random call that goes through call_rpc_1() or call_rpc_2(), and fills in what the server should see.  */
+static int random_call(call_t *expected)
+{
+	int n = rand() % 6, ch = rand() % 24, volume = rand() % 101;
+
+	/* One call in 50 plays on a channel from 96 to 99, which the server refuses.  */
+	if (rand() % 50 == 0)
+	{
+		n = 2;
+		ch = 96 + rand() % 4;
+	}
+
+	switch (n)
+	{
+		case 0:
+		*expected = (call_t){ AUDSRV_SET_VOLUME, { vol_values[volume/4], 0 }, 1 };
+		return audsrv_set_volume(volume);
+
+		case 1:
+		*expected = (call_t){ AUDSRV_ADPCM_SET_VOLUME, { ch, vol_values[volume/4] }, 2 };
+		return audsrv_adpcm_set_volume(ch, volume);
+
+		case 2:
+		*expected = (call_t){ AUDSRV_PLAY_ADPCM, { ch, (int)(u32)&samples[ch & 3] }, 2 };
+		return audsrv_ch_play_adpcm(ch, &samples[ch & 3]);
+
+		case 3:
+		*expected = (call_t){ AUDSRV_PLAY_SECTORS, { ch * 1000, ch * 1000 + volume }, 2 };
+		return audsrv_play_sectors(ch * 1000, ch * 1000 + volume);
+
+		case 4:
+		*expected = (call_t){ AUDSRV_GET_TRACKOFFSET, { ch, 0 }, 1 };
+		return audsrv_get_track_offset(ch);
+
+		default:
+		*expected = (call_t){ AUDSRV_STOP_CD, { 0, 0 }, 1 };
+		return audsrv_stop_cd();
+	}
+}
+
+static int same_call(const call_t *a, const call_t *b)
+{
+	return a->func == b->func && a->nargs == b->nargs && a->args[0] == b->args[0] &&
+		(a->nargs < 2 || a->args[1] == b->args[1]);
+}
+
+static void single_calls(void)
+{
+	call_t expected;
+	int i, ret;
+
+	for (i = 0; i < CASES; i++)
+	{
+		call_count = 0;
+		rpcs = 0;
+
+		ret = random_call(&expected);
+
+		if (rpcs != 1 || call_count != 1)
+			error("a single call is not one RPC", i);
+		else if (!same_call(&calls[0], &expected))
+			error("a single call reached the server with other arguments", i);
+		else if (ret != answer(expected.func, expected.args, expected.nargs))
+			error("a single call returned something else than the server's answer", i);
+	}
+}
+
+static void batched_calls(int count)
+{
+	static call_t expected[MAX_CALLS];
+	int i, ret, first_error = AUDSRV_ERR_NOERROR;
+
+	call_count = 0;
+	rpcs = 0;
+
+	audsrv_batch_begin();
+
+	for (i = 0; i < count; i++)
+	{
+		if (random_call(&expected[i]) != AUDSRV_ERR_NOERROR)
+			error("a queued call did not return AUDSRV_ERR_NOERROR", i);
+
+		ret = answer(expected[i].func, expected[i].args, expected[i].nargs);
+		if (ret < 0 && first_error == AUDSRV_ERR_NOERROR)
+			first_error = ret;
+	}
+
+	ret = audsrv_batch_end();
+
+	if (call_count != count)
+	{
+		error("the server did not get every queued call", count);
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (!same_call(&calls[i], &expected[i]))
+		{
+			error("a queued call reached the server out of order or with other arguments", i);
+			return;
+		}
+	}
+
+	if (rpcs != (count + CALLS_PER_BATCH - 1) / CALLS_PER_BATCH)
+		error("the batch was not sent in the fewest RPCs", count);
+
+	if (ret != first_error || audsrv_get_error() != first_error)
+		error("audsrv_batch_end did not return the first negative answer", count);
+}
+
+static void frames(void)
+{
+	static const int sizes[5] = { 1, 4, 16, 64, 256 };
+	call_t expected;
+	double single, batched;
+	int i, n;
+
+	printf("calls per frame   RPCs   SIF time per frame       RPCs   batched\n");
+
+	for (n = 0; n < 5; n++)
+	{
+		rpcs = 0;
+		bytes = 0;
+		for (i = 0; i < sizes[n]; i++)
+			random_call(&expected);
+		printf("%15d %6d %8.0fus %5.1f%%", sizes[n], rpcs, (rpcs * RPC_COST + bytes / BYTES_PER_SEC) * 1e6,
+			100 * (rpcs * RPC_COST + bytes / BYTES_PER_SEC) / FRAME);
+		single = rpcs * RPC_COST + bytes / BYTES_PER_SEC;
+
+		rpcs = 0;
+		bytes = 0;
+		audsrv_batch_begin();
+		for (i = 0; i < sizes[n]; i++)
+			random_call(&expected);
+		audsrv_batch_end();
+		batched = rpcs * RPC_COST + bytes / BYTES_PER_SEC;
+		printf(" %10d %8.0fus %5.1f%%  %4.1fx\n", rpcs, batched * 1e6, 100 * batched / FRAME, single / batched);
+	}
+}
+
+int main(void)
+{
+	int i;
+
+	srand(9);
+
+	if (audsrv_init() != 0)
+	{
+		printf("FAIL: audsrv_init\n");
+		return 1;
+	}
+
+	single_calls();
+
+	for (i = 0; i < CASES; i++)
+		batched_calls(rand() % 300);
+	batched_calls(CALLS_PER_BATCH);
+	batched_calls(CALLS_PER_BATCH + 1);
+
+	/* An empty batch makes no RPC.  */
+	rpcs = 0;
+	audsrv_batch_begin();
+	if (audsrv_batch_end() != AUDSRV_ERR_NOERROR || rpcs != 0)
+		error("an empty batch made an RPC", 0);
+
+	/* Without a batch, audsrv_batch_end() does nothing.  */
+	if (audsrv_batch_end() != AUDSRV_ERR_NOERROR || rpcs != 0)
+		error("audsrv_batch_end without a batch made an RPC", 0);
+
+	frames();
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+/* Host stand-in for the EE iopheap.h, with the calls used by audsrv_rpc.c. */
+
+#ifndef __IOPHEAP_H__
+#define __IOPHEAP_H__
+
+int SifInitIopHeap(void);
+void *SifAllocIopHeap(int size);
+int SifFreeIopHeap(void *addr);
+
+#endif /* __IOPHEAP_H__ */
@@ -0,0 +1,52 @@
+/* Host stand-in for the EE kernel.h, with the calls used by audsrv_rpc.c. */
+
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <tamtypes.h>
+
+typedef struct {
+	int	count;
+	int	max_count;
+	int	init_count;
+	int	wait_threads;
+	u32	attr;
+	u32	option;
+} ee_sema_t;
+
+typedef struct {
+	int	status;
+	void	*func;
+	void	*stack;
+	int	stack_size;
+	void	*gp_reg;
+	int	initial_priority;
+	int	current_priority;
+	u32	attr;
+	u32	option;
+} ee_thread_t;
+
+typedef struct {
+	void	*src;
+	void	*dest;
+	int	size;
+	int	attr;
+} SifDmaTransfer_t;
+
+static inline void nopdelay(void) { }
+
+int CreateSema(ee_sema_t *sema);
+int DeleteSema(int sema_id);
+int WaitSema(int sema_id);
+int SignalSema(int sema_id);
+
+int CreateThread(ee_thread_t *thread);
+int StartThread(int thread_id, void *args);
+int TerminateThread(int thread_id);
+int DeleteThread(int thread_id);
+int GetThreadId(void);
+
+u32 SifSetDma(SifDmaTransfer_t *sdd, s32 len);
+int SifDmaStat(u32 id);
+
+#endif /* __KERNEL_H__ */
@@ -0,0 +1,32 @@
+/* Host stand-in for the EE sifrpc.h, with the client and server calls used by audsrv_rpc.c. */
+
+#ifndef __SIFRPC_H__
+#define __SIFRPC_H__
+
+typedef void *(*SifRpcFunc_t)(int fno, void *buffer, int length);
+typedef void (*SifRpcEndFunc_t)(void *end_param);
+
+typedef struct t_SifRpcClientData {
+	void	*server;
+} SifRpcClientData_t;
+
+typedef struct t_SifRpcServerData {
+	int	sid;
+} SifRpcServerData_t;
+
+typedef struct t_SifRpcDataQueue {
+	int	thread_id;
+} SifRpcDataQueue_t;
+
+int SifBindRpc(SifRpcClientData_t *client, int rpc_number, int mode);
+int SifCallRpc(SifRpcClientData_t *client, int rpc_number, int mode, void *send, int ssize, void *receive, int rsize,
+	SifRpcEndFunc_t end_function, void *end_param);
+
+SifRpcServerData_t *SifRegisterRpc(SifRpcServerData_t *srv, int sid, SifRpcFunc_t func, void *buff,
+	SifRpcFunc_t cfunc, void *cbuff, SifRpcDataQueue_t *qd);
+SifRpcServerData_t *SifRemoveRpc(SifRpcServerData_t *sd, SifRpcDataQueue_t *qd);
+SifRpcDataQueue_t *SifSetRpcQueue(SifRpcDataQueue_t *q, int thread_id);
+SifRpcDataQueue_t *SifRemoveRpcQueue(SifRpcDataQueue_t *qd);
+void SifRpcLoop(SifRpcDataQueue_t *q);
+
+#endif /* __SIFRPC_H__ */
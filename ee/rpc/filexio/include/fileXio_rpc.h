@@ -30,6 +30,9 @@
 #define FXIO_COMPLETE	1
 #define FXIO_INCOMPLETE	0
 
+/** Maximum number of async requests that can be queued or running at the same time. */
+#define FXIO_ASYNC_MAX_REQUESTS	32
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -69,6 +72,28 @@ int fileXioDevctl(const char *name, int cmd, void *arg, unsigned int arglen, voi
 int fileXioIoctl(int fd, int cmd, void *arg);
 int fileXioIoctl2(int fd, int command, void *arg, unsigned int arglen, void *buf, unsigned int buflen);
 int fileXioSetRWBufferSize(int size);
+/** Sets the size of the IOP-side read/write buffer and the number of chunks it is split into.
+ * Reads and writes are pipelined across the chunks, so the device is accessed while the previous chunk is transferred.
+ * A count of 1 disables pipelining, 0 keeps the current count.
+ */
+int fileXioSetRWBuffers(int size, int count);
+
+/** Async request queue.
+ * Unlike the FXIO_NOWAIT block mode, several requests can be outstanding at the same time. They are processed by a pool
+ * of IOP-side workers, so requests on different files run in parallel, while requests on the same file are processed
+ * in submission order. Queued requests that could not be started yet are started by the next fileXioAsync* call.
+ * The submit functions return a token for fileXioAsyncPoll, fileXioAsyncWait and fileXioAsyncCancel, or a negative
+ * error code. The buffer must remain valid until the request has completed.
+ */
+int fileXioAsyncRead(int fd, void *buf, int size);
+int fileXioAsyncWrite(int fd, const void *buf, int size);
+int fileXioAsyncLseek(int fd, int offset, int whence);
+/** Returns FXIO_COMPLETE and stores the result of the request in retVal, or FXIO_INCOMPLETE. The token is released on completion. */
+int fileXioAsyncPoll(int token, int *retVal);
+/** Waits for the request to complete, then behaves like fileXioAsyncPoll. */
+int fileXioAsyncWait(int token, int *retVal);
+/** Removes a request that has not been started yet. Returns -EBUSY if it is already running or has completed. */
+int fileXioAsyncCancel(int token);
 
 #ifdef __cplusplus
 }
@@ -41,6 +41,42 @@ static void _fxio_intr(void)
 	iSignalSema(fileXioCompletionSema);
 }
 
+/* Async request queue.
+ * Each IOP-side async worker processes one request at a time. Requests that cannot be started yet, because all workers
+ * are busy or an earlier request on the same file is still running, stay queued and are started in submission order
+ * by later fileXioAsync* calls. */
+#define FXIO_ASYNC_FREE		0
+#define FXIO_ASYNC_PENDING	1
+#define FXIO_ASYNC_RUNNING	2
+#define FXIO_ASYNC_DONE		3
+
+struct fxio_async_request {
+	volatile int state;
+	unsigned int seq;	// Incremented whenever the slot is reused, to detect stale tokens
+	int cmd;
+	int fd;
+	void *buf;
+	int size;
+	int whence;
+	volatile int result;
+	struct fxio_async_request *next;	// Next pending request
+};
+
+struct fxio_async_worker {
+	unsigned int sbuff[32];	// Largest request is fxio_write_packet
+	int intr_data[48];	// rests_pkt for reads
+	SifRpcClientData_t cd;
+	struct fxio_async_request * volatile req;	// Running request, NULL if idle
+} __attribute__((aligned(64)));
+
+static struct fxio_async_request asyncRequests[FXIO_ASYNC_MAX_REQUESTS];
+static struct fxio_async_worker asyncWorkers[FILEXIO_ASYNC_WORKERS];
+static struct fxio_async_request *asyncPendingHead, *asyncPendingTail;
+static int asyncWorkerCount = -1;	// Number of bound workers, -1 if not bound yet
+static int asyncLockSema = -1;
+static int asyncDoneSema = -1;	// Signalled once for every waiting thread when a request completes
+static volatile int asyncWaiters;
+
 static int _lock_sema_id = -1;
 static inline int _lock(void)
 {
@@ -186,6 +222,8 @@ int fileXioInit(void)
 	{
 		_rb_count = _iop_reboot_count;
 
+		// The async requests that were running were lost with the IOP reboot, there is nothing to wait for.
+		asyncWorkerCount = -1;
 		fileXioExit();
 	}
 
@@ -212,6 +250,20 @@ int fileXioInit(void)
 	if (fileXioCompletionSema < 0)
 		return -1;
 
+	sp.init_count = 1;
+	sp.max_count = 1;
+	sp.option = 0;
+	asyncLockSema = CreateSema(&sp);
+
+	sp.init_count = 0;
+	sp.max_count = FXIO_ASYNC_MAX_REQUESTS;
+	sp.option = 0;
+	asyncDoneSema = CreateSema(&sp);
+	if (asyncLockSema < 0 || asyncDoneSema < 0)
+		return -1;
+
+	asyncWorkerCount = -1;
+
 	fileXioInited = 1;
 	fileXioBlockMode = FXIO_WAIT;
 
@@ -238,12 +290,27 @@ int fileXioInit(void)
 
 void fileXioExit(void)
 {
+	int i;
+
 	if(fileXioInited)
 	{
+		// Running async requests still complete in _fxio_async_intr(), which needs the workers. Pending requests are dropped.
+		for(i = 0; i < asyncWorkerCount; i++)
+		{
+			while(SifCheckStatRpc(&asyncWorkers[i].cd))
+				nopdelay();
+		}
+
 		if(_lock_sema_id >= 0) DeleteSema(_lock_sema_id);
 		if(fileXioCompletionSema >= 0) DeleteSema(fileXioCompletionSema);
+		if(asyncLockSema >= 0) DeleteSema(asyncLockSema);
+		if(asyncDoneSema >= 0) DeleteSema(asyncDoneSema);
 
 		memset(&cd0, 0, sizeof(cd0));
+		memset(asyncWorkers, 0, sizeof(asyncWorkers));
+		memset(asyncRequests, 0, sizeof(asyncRequests));
+		asyncPendingHead = asyncPendingTail = NULL;
+		asyncWorkerCount = -1;
 
 		fileXioInited = 0;
 	}
@@ -1137,6 +1204,10 @@ void fileXioSetBlockMode(int blocking)
 }
 
 int fileXioSetRWBufferSize(int size){
+	return fileXioSetRWBuffers(size, 0);
+}
+
+int fileXioSetRWBuffers(int size, int count){
 	struct fxio_rwbuff *packet = (struct fxio_rwbuff *)sbuff;
 	int rv;
 
@@ -1147,6 +1218,7 @@ int fileXioSetRWBufferSize(int size){
 	WaitSema(fileXioCompletionSema);
 
 	packet->size = size;
+	packet->count = count;
 
 	if((rv = SifCallRpc(&cd0, FILEXIO_SETRWBUFFSIZE, 0, packet, sizeof(struct fxio_rwbuff), sbuff, 4, (void *)&_fxio_intr, NULL)) >= 0)
 	{
@@ -1159,3 +1231,348 @@ int fileXioSetRWBufferSize(int size){
 	return(rv);
 }
 
+static void _fxio_async_intr(void *data)
+{
+	struct fxio_async_worker *worker = (struct fxio_async_worker *)data;
+	struct fxio_async_request *req = worker->req;
+	rests_pkt *rests;
+	int i;
+
+	if(req->cmd == FILEXIO_READ)
+	{
+		rests = UNCACHED_SEG(worker->intr_data);
+
+		if(rests->ssize) memcpy(rests->sbuf, rests->sbuffer, rests->ssize);
+		if(rests->esize) memcpy(rests->ebuf, rests->ebuffer, rests->esize);
+	}
+
+	req->result = *(int *)UNCACHED_SEG(&worker->sbuff[0]);
+	req->state = FXIO_ASYNC_DONE;
+	worker->req = NULL;
+
+	for(i = 0; i < asyncWaiters; i++)
+		iSignalSema(asyncDoneSema);
+}
+
+static int fileXioAsyncBind(void)
+{
+	int i;
+
+	asyncWorkerCount = 0;
+	for(i = 0; i < FILEXIO_ASYNC_WORKERS; i++)
+	{
+		// The workers are registered before the main server, so an unbound worker is not supported by the IOP module.
+		if(SifBindRpc(&asyncWorkers[i].cd, FILEXIO_ASYNC_IRX + i, 0) < 0 || asyncWorkers[i].cd.server == NULL)
+			break;
+		asyncWorkers[i].req = NULL;
+		asyncWorkerCount++;
+	}
+
+	return asyncWorkerCount;
+}
+
+static void fileXioAsyncStart(struct fxio_async_worker *worker, struct fxio_async_request *req)
+{
+	struct fxio_read_packet *rpacket = (struct fxio_read_packet *)worker->sbuff;
+	struct fxio_write_packet *wpacket = (struct fxio_write_packet *)worker->sbuff;
+	struct fxio_lseek_packet *lpacket = (struct fxio_lseek_packet *)worker->sbuff;
+	unsigned int miss;
+	int size, rv;
+
+	switch(req->cmd)
+	{
+		case FILEXIO_READ:
+			rpacket->fd = req->fd;
+			rpacket->buffer = req->buf;
+			rpacket->size = req->size;
+			rpacket->intrData = worker->intr_data;
+			size = sizeof(struct fxio_read_packet);
+			break;
+		case FILEXIO_WRITE:
+			if((unsigned int)req->buf & 0x3F)
+			{
+				miss = 64 - ((unsigned int)req->buf & 0x3F);
+				if(miss > req->size) miss = req->size;
+			} else {
+				miss = 0;
+			}
+
+			wpacket->fd = req->fd;
+			wpacket->buffer = req->buf;
+			wpacket->size = req->size;
+			wpacket->unalignedDataLen = miss;
+			memcpy(wpacket->unalignedData, req->buf, miss);
+			size = sizeof(struct fxio_write_packet);
+			break;
+		default:	// FILEXIO_LSEEK
+			lpacket->fd = req->fd;
+			lpacket->offset = (u32)req->size;
+			lpacket->whence = req->whence;
+			size = sizeof(struct fxio_lseek_packet);
+	}
+
+	req->state = FXIO_ASYNC_RUNNING;
+	worker->req = req;
+
+	if((rv = SifCallRpc(&worker->cd, req->cmd, SIF_RPC_M_NOWAIT, worker->sbuff, size, worker->sbuff, 4, &_fxio_async_intr, worker)) < 0)
+	{
+		worker->req = NULL;
+		req->result = rv;
+		req->state = FXIO_ASYNC_DONE;
+	}
+}
+
+// Starts pending requests on idle workers. Must be called with asyncLockSema held.
+static void fileXioAsyncDispatch(void)
+{
+	struct fxio_async_request *req, *prev, *next;
+	struct fxio_async_worker *worker;
+	struct fxio_async_request *running[FILEXIO_ASYNC_WORKERS];	// Request on each worker, NULL if idle
+	int skipped[FXIO_ASYNC_MAX_REQUESTS];	// fds of the pending requests that were left in the queue
+	int i, busy, skipCount;
+
+	// Requests complete in interrupt context, so the workers are looked at once. A worker that becomes idle during
+	// the walk is used by the next dispatch.
+	DI();
+	for(i = 0; i < asyncWorkerCount; i++)
+		running[i] = asyncWorkers[i].req;
+	EI();
+
+	prev = NULL;
+	skipCount = 0;
+	for(req = asyncPendingHead; req != NULL; req = next)
+	{
+		next = req->next;
+
+		worker = NULL;
+		busy = 0;
+		for(i = 0; i < asyncWorkerCount; i++)
+		{
+			if(running[i] == NULL)
+			{
+				if(worker == NULL)
+					worker = &asyncWorkers[i];
+			}
+			else if(running[i]->fd == req->fd)
+				busy = 1;
+		}
+
+		if(worker == NULL)
+			break;
+
+		// Requests on the same file are processed in submission order, so one that waits for an earlier request
+		// also holds back the later ones.
+		for(i = 0; i < skipCount && !busy; i++)
+		{
+			if(skipped[i] == req->fd)
+				busy = 1;
+		}
+
+		if(busy)
+		{
+			skipped[skipCount++] = req->fd;
+			prev = req;
+			continue;
+		}
+
+		if(prev != NULL)
+			prev->next = next;
+		else
+			asyncPendingHead = next;
+		if(asyncPendingTail == req)
+			asyncPendingTail = prev;
+
+		running[worker - asyncWorkers] = req;
+		fileXioAsyncStart(worker, req);
+	}
+}
+
+static int fileXioAsyncSubmit(int cmd, int fd, void *buf, int size, int whence)
+{
+	struct fxio_async_request *req;
+	int i, token;
+
+	if(fileXioInit() < 0)
+		return -ENOPKG;
+
+	WaitSema(asyncLockSema);
+
+	if(asyncWorkerCount < 0)
+		fileXioAsyncBind();
+
+	if(asyncWorkerCount == 0)
+	{
+		SignalSema(asyncLockSema);
+		return -ENOSYS;
+	}
+
+	for(i = 0; i < FXIO_ASYNC_MAX_REQUESTS; i++)
+	{
+		if(asyncRequests[i].state == FXIO_ASYNC_FREE)
+			break;
+	}
+
+	if(i == FXIO_ASYNC_MAX_REQUESTS)
+	{
+		SignalSema(asyncLockSema);
+		return -EAGAIN;
+	}
+
+	req = &asyncRequests[i];
+	req->seq++;
+	req->cmd = cmd;
+	req->fd = fd;
+	req->buf = buf;
+	req->size = size;
+	req->whence = whence;
+	req->next = NULL;
+	req->state = FXIO_ASYNC_PENDING;
+	token = (int)(((req->seq << 8) | i) & 0x7FFFFFFF);
+
+	if((cmd == FILEXIO_READ || cmd == FILEXIO_WRITE) && !IS_UNCACHED_SEG(buf))
+		SifWriteBackDCache(buf, size);
+
+	if(asyncPendingTail != NULL)
+		asyncPendingTail->next = req;
+	else
+		asyncPendingHead = req;
+	asyncPendingTail = req;
+
+	fileXioAsyncDispatch();
+
+	SignalSema(asyncLockSema);
+
+	return token;
+}
+
+static struct fxio_async_request *fileXioAsyncLookup(int token)
+{
+	struct fxio_async_request *req;
+
+	if(token < 0 || (token & 0xFF) >= FXIO_ASYNC_MAX_REQUESTS)
+		return NULL;
+
+	req = &asyncRequests[token & 0xFF];
+	if(req->state == FXIO_ASYNC_FREE || ((req->seq << 8) & 0x7FFFFFFF) != ((unsigned int)token & ~0xFF))
+		return NULL;
+
+	return req;
+}
+
+int fileXioAsyncRead(int fd, void *buf, int size)
+{
+	return fileXioAsyncSubmit(FILEXIO_READ, fd, buf, size, 0);
+}
+
+int fileXioAsyncWrite(int fd, const void *buf, int size)
+{
+	return fileXioAsyncSubmit(FILEXIO_WRITE, fd, (void *)buf, size, 0);
+}
+
+int fileXioAsyncLseek(int fd, int offset, int whence)
+{
+	return fileXioAsyncSubmit(FILEXIO_LSEEK, fd, NULL, offset, whence);
+}
+
+static int fileXioAsyncCheck(int token, int *retVal, int wait)
+{
+	struct fxio_async_request *req;
+	int done;
+
+	if(fileXioInit() < 0)
+		return -ENOPKG;
+
+	while(1)
+	{
+		WaitSema(asyncLockSema);
+
+		if((req = fileXioAsyncLookup(token)) == NULL)
+		{
+			SignalSema(asyncLockSema);
+			return -ENOENT;
+		}
+
+		// Register as a waiter before checking, so that a completion in between still wakes this thread up.
+		if(wait)
+		{
+			DI();
+			asyncWaiters++;
+			EI();
+		}
+
+		fileXioAsyncDispatch();
+
+		done = (req->state == FXIO_ASYNC_DONE);
+		if(done)
+		{
+			if(retVal != NULL)
+				*retVal = req->result;
+			req->state = FXIO_ASYNC_FREE;
+		}
+
+		SignalSema(asyncLockSema);
+
+		if(wait)
+		{
+			if(!done)
+				WaitSema(asyncDoneSema);
+
+			DI();
+			asyncWaiters--;
+			EI();
+		}
+
+		if(done)
+			return FXIO_COMPLETE;
+		if(!wait)
+			return FXIO_INCOMPLETE;
+	}
+}
+
+int fileXioAsyncPoll(int token, int *retVal)
+{
+	return fileXioAsyncCheck(token, retVal, 0);
+}
+
+int fileXioAsyncWait(int token, int *retVal)
+{
+	return fileXioAsyncCheck(token, retVal, 1);
+}
+
+int fileXioAsyncCancel(int token)
+{
+	struct fxio_async_request *req, *prev;
+	int rv;
+
+	if(fileXioInit() < 0)
+		return -ENOPKG;
+
+	WaitSema(asyncLockSema);
+
+	if((req = fileXioAsyncLookup(token)) == NULL)
+		rv = -ENOENT;
+	else if(req->state != FXIO_ASYNC_PENDING)
+		rv = -EBUSY;
+	else
+	{
+		if(asyncPendingHead == req)
+		{
+			prev = NULL;
+			asyncPendingHead = req->next;
+		}
+		else
+		{
+			for(prev = asyncPendingHead; prev->next != req; prev = prev->next);
+			prev->next = req->next;
+		}
+		if(asyncPendingTail == req)
+			asyncPendingTail = prev;
+
+		req->state = FXIO_ASYNC_FREE;
+		rv = 0;
+	}
+
+	SignalSema(asyncLockSema);
+
+	return rv;
+}
@@ -0,0 +1,524 @@
+/*
+ * Host test of the fileXio async request queue in fileXio_rpc.c, with a loopback IOP.
+ *
+ * The SIF RPC calls are served by a fake IOP that keeps a file in memory for each fd. Every file is
+ * on a device of its own that costs 1ms per request plus 10MB/s, so requests on different files
+ * overlap and complete out of order. A call completes, and its end function runs like an interrupt,
+ * when the EE waits for it or, while the ordering is checked, when another call is started.
+ *
+ * - Ordering: blocks are appended to four files with up to 24 requests queued. Each block holds its
+ *   index, so a request that overtook an earlier one on the same file leaves a block out of place.
+ *   Two requests on the same file must never run at the same time.
+ * - Cancellation: only pending requests can be cancelled, they never reach the IOP, and their
+ *   tokens, like those of completed requests, are rejected afterwards.
+ * - Without workers every request fails with -ENOSYS, and fileXioExit() waits for the running
+ *   requests.
+ * - Throughput: the four files are read in 64KB requests, with fileXioRead() one after the other,
+ *   then with two async requests per file in flight and one to four workers.
+ *
+ * Build and run from the root of the tree. fileXio_rpc.c keeps EE addresses in u32 and ignores
+ * the result of one call, hence the -Wno options:
+ *
+ *   gcc -O2 -Wall -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -Wno-unused-but-set-variable -D_EE \
+ *       -Iee/rpc/filexio/test/host -Iee/rpc/filexio/include -Icommon/include -Iee/rpc/filexio/src \
+ *       ee/rpc/filexio/test/async_loopback.c -o async_loopback
+ *   ./async_loopback
+ */
+
+#include "fileXio_rpc.c"
+
+#include <stdlib.h>
+
+#define FILES		4
+#define FILE_SIZE	(4 * 1024 * 1024)
+#define BLOCK		4096
+#define CHUNK		65536
+#define MAX_SEMAS	8
+
+#define CALL_COST	1e-3
+#define BYTES_PER_SEC	10e6
+
+#define MIN(a, b)	(((a) < (b)) ? (a) : (b))
+
+struct iop_call {
+	SifRpcClientData_t *cd;
+	int rpc_number;
+	void *send;
+	void *receive;
+	SifRpcEndFunc_t end_function;
+	void *end_param;
+	int fd;
+	double done;
+};
+
+int _iop_reboot_count = 0;
+
+int (*_ps2sdk_close)(int);
+int (*_ps2sdk_open)(const char*, int, ...);
+int (*_ps2sdk_read)(int, void*, int);
+int (*_ps2sdk_lseek)(int, int, int);
+int (*_ps2sdk_write)(int, const void*, int);
+int (*_ps2sdk_ioctl)(int, int, void*);
+int (*_ps2sdk_remove)(const char*);
+int (*_ps2sdk_rename)(const char*, const char*);
+int (*_ps2sdk_mkdir)(const char*, int);
+int (*_ps2sdk_rmdir)(const char*);
+int (*_ps2sdk_stat)(const char *path, struct stat *buf);
+DIR * (*_ps2sdk_opendir)(const char *path);
+struct dirent * (*_ps2sdk_readdir)(DIR *dir);
+void (*_ps2sdk_rewinddir)(DIR *dir);
+int (*_ps2sdk_closedir)(DIR *dir);
+
+static u8 files[FILES][FILE_SIZE];
+static int filePos[FILES];
+static u8 data[FILES][FILE_SIZE];	// What is written to the files, and where they are read to
+static int boundWorkers;	// Workers that the IOP module provides
+static int completeOnCall;	// Completes another call whenever one is started
+static int interruptsDisabled;
+static double now, deviceFree[FILES];
+static struct iop_call calls[FILEXIO_ASYNC_WORKERS];	// Calls in progress on each worker
+static int semaCount[MAX_SEMAS], semaUsed[MAX_SEMAS];
+static int errors;
+
+static void error(const char *what, int value)
+{
+	if(errors++ < 10)
+		printf("error: %s (%d)\n", what, value);
+}
+
+int DI(void)
+{
+	interruptsDisabled = 1;
+	return 1;
+}
+
+int EI(void)
+{
+	interruptsDisabled = 0;
+	return 0;
+}
+
+void SifWriteBackDCache(void *ptr, int size) { }
+
+//---------------------------------------------------------------------------
+static int iop_execute(struct iop_call *call)
+{
+	struct fxio_read_packet *rpacket = call->send;
+	struct fxio_write_packet *wpacket = call->send;
+	struct fxio_lseek_packet *lpacket = call->send;
+	rests_pkt *rests;
+	int fd = call->fd, size;
+
+	switch(call->rpc_number)
+	{
+		case FILEXIO_READ:
+			size = MIN(rpacket->size, FILE_SIZE - filePos[fd]);
+			memcpy(rpacket->buffer, files[fd] + filePos[fd], size);
+			filePos[fd] += size;
+			rests = rpacket->intrData;
+			rests->ssize = rests->esize = 0;
+			return size;
+		case FILEXIO_WRITE:
+			size = MIN(wpacket->size, FILE_SIZE - filePos[fd]);
+			memcpy(files[fd] + filePos[fd], wpacket->buffer, size);
+			filePos[fd] += size;
+			return size;
+		case FILEXIO_LSEEK:
+			filePos[fd] = lpacket->offset;
+			return filePos[fd];
+		default:
+			error("unexpected RPC", call->rpc_number);
+			return -EIO;
+	}
+}
+
+static int iop_busy(void)
+{
+	int i, count = 0;
+
+	for(i = 0; i < FILEXIO_ASYNC_WORKERS; i++)
+		count += (calls[i].cd != NULL);
+
+	return count;
+}
+
+// The call that finishes first is completed and its end function is run, as the SIF interrupt does.
+static int iop_complete(void)
+{
+	struct iop_call *call = NULL;
+	int i;
+
+	if(interruptsDisabled)
+		error("completion with interrupts disabled", 0);
+
+	for(i = 0; i < FILEXIO_ASYNC_WORKERS; i++)
+	{
+		if(calls[i].cd != NULL && (call == NULL || calls[i].done < call->done))
+			call = &calls[i];
+	}
+
+	if(call == NULL)
+		return 0;
+
+	if(call->done > now)
+		now = call->done;
+	*(int *)call->receive = iop_execute(call);
+	call->cd->busy = 0;
+	call->cd = NULL;
+	call->end_function(call->end_param);
+
+	return 1;
+}
+
+int SifBindRpc(SifRpcClientData_t *cd, int rpc_number, int mode)
+{
+	static int server;
+
+	if(rpc_number == FILEXIO_IRX || (rpc_number >= FILEXIO_ASYNC_IRX && rpc_number < FILEXIO_ASYNC_IRX + boundWorkers))
+		cd->server = &server;
+	else
+		cd->server = NULL;
+	cd->busy = 0;
+
+	return 0;
+}
+
+int SifCallRpc(SifRpcClientData_t *cd, int rpc_number, int mode, void *send, int ssize, void *receive, int rsize,
+	SifRpcEndFunc_t end_function, void *end_param)
+{
+	struct iop_call call;
+	int i;
+
+	call.cd = cd;
+	call.rpc_number = rpc_number;
+	call.send = send;
+	call.receive = receive;
+	call.end_function = end_function;
+	call.end_param = end_param;
+	call.fd = ((struct fxio_read_packet *)send)->fd;	// All of the served packets start with the fd
+
+	if(cd->busy || call.fd < 0 || call.fd >= FILES)
+	{
+		error("bad call", call.fd);
+		return -1;
+	}
+
+	if(completeOnCall && rand() % 2)
+		iop_complete();
+
+	if(call.rpc_number == FILEXIO_LSEEK)
+		call.done = (deviceFree[call.fd] > now ? deviceFree[call.fd] : now);
+	else
+		call.done = (deviceFree[call.fd] > now ? deviceFree[call.fd] : now) + CALL_COST +
+			((struct fxio_read_packet *)send)->size / BYTES_PER_SEC;
+	deviceFree[call.fd] = call.done;
+
+	// The main server processes one call at a time.
+	if(cd == &cd0)
+	{
+		if(mode & SIF_RPC_M_NOWAIT)
+			error("fileXio was not in blocking mode", mode);
+		now = call.done;
+		*(int *)receive = iop_execute(&call);
+		end_function(end_param);
+		return 0;
+	}
+
+	for(i = 0; i < FILEXIO_ASYNC_WORKERS; i++)
+	{
+		if(calls[i].cd != NULL && calls[i].fd == call.fd)
+			error("two requests on the same file at once", call.fd);
+	}
+
+	for(i = 0; &asyncWorkers[i].cd != cd; i++);
+	cd->busy = 1;
+	calls[i] = call;
+
+	return 0;
+}
+
+int SifCheckStatRpc(SifRpcClientData_t *cd)
+{
+	// Time passes while the EE polls.
+	if(cd->busy)
+		iop_complete();
+
+	return cd->busy;
+}
+
+//---------------------------------------------------------------------------
+int CreateSema(ee_sema_t *sema)
+{
+	int i;
+
+	for(i = 0; i < MAX_SEMAS; i++)
+	{
+		if(!semaUsed[i])
+		{
+			semaUsed[i] = 1;
+			semaCount[i] = sema->init_count;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int DeleteSema(int sema_id)
+{
+	semaUsed[sema_id] = 0;
+	return 0;
+}
+
+// The EE thread blocks until the IOP has completed enough calls to signal the semaphore.
+int WaitSema(int sema_id)
+{
+	while(semaCount[sema_id] == 0)
+	{
+		if(!iop_complete())
+		{
+			error("deadlock", sema_id);
+			return -1;
+		}
+	}
+
+	semaCount[sema_id]--;
+	return sema_id;
+}
+
+int PollSema(int sema_id)
+{
+	if(semaCount[sema_id] == 0)
+		return -1;
+
+	semaCount[sema_id]--;
+	return sema_id;
+}
+
+int SignalSema(int sema_id)
+{
+	semaCount[sema_id]++;
+	return sema_id;
+}
+
+int iSignalSema(int sema_id)
+{
+	return SignalSema(sema_id);
+}
+
+//---------------------------------------------------------------------------
+static void reset(int workers)
+{
+	int fd;
+
+	fileXioExit();
+	boundWorkers = workers;
+	memset(files, 0, sizeof(files));
+	for(fd = 0; fd < FILES; fd++)
+		filePos[fd] = 0;
+	if(fileXioInit() < 0)
+		error("fileXioInit failed", workers);
+}
+
+static void stamp(int fd, int block)
+{
+	int *words = (int *)(data[fd] + block * BLOCK);
+
+	words[0] = fd;
+	words[1] = block;
+}
+
+static int wait_request(int token, int expected)
+{
+	int result = -1;
+
+	if(fileXioAsyncWait(token, &result) != FXIO_COMPLETE)
+		error("request not completed", token);
+	else if(result != expected)
+		error("wrong result", result);
+
+	return result;
+}
+
+static void test_order(void)
+{
+	int tokens[24], count = 0, blocks[FILES] = {0}, token, fd, i, j;
+
+	reset(FILEXIO_ASYNC_WORKERS);
+	completeOnCall = 1;
+
+	for(i = 0; i < 2000; i++)
+	{
+		fd = rand() % FILES;
+		stamp(fd, blocks[fd]);
+		if((token = fileXioAsyncWrite(fd, data[fd] + blocks[fd] * BLOCK, BLOCK)) < 0)
+		{
+			error("fileXioAsyncWrite failed", token);
+			break;
+		}
+		blocks[fd]++;
+		tokens[count++] = token;
+
+		// Sometimes the oldest request is waited for, sometimes a random one.
+		while(count == 24 || (count > 0 && rand() % 4 == 0))
+		{
+			j = (rand() % 2) ? 0 : rand() % count;
+			wait_request(tokens[j], BLOCK);
+			tokens[j] = tokens[--count];
+		}
+	}
+
+	for(j = 0; j < count; j++)
+		wait_request(tokens[j], BLOCK);
+	completeOnCall = 0;
+
+	for(fd = 0; fd < FILES; fd++)
+	{
+		for(i = 0; i < blocks[fd]; i++)
+		{
+			if(((int *)(files[fd] + i * BLOCK))[1] != i || ((int *)(files[fd] + i * BLOCK))[0] != fd)
+			{
+				error("a request overtook an earlier one on the same file", fd);
+				break;
+			}
+		}
+	}
+}
+
+static void test_cancel(void)
+{
+	int t1, t2, t3, t4, result;
+
+	reset(1);
+	stamp(0, 0);
+	stamp(0, 1);
+	stamp(1, 0);
+
+	t1 = fileXioAsyncWrite(0, data[0], BLOCK);	// Runs
+	t2 = fileXioAsyncWrite(1, data[1], BLOCK);	// Waits for the worker
+	t3 = fileXioAsyncWrite(0, data[0] + BLOCK, BLOCK);	// Waits for t1
+
+	if(fileXioAsyncCancel(t2) != 0)
+		error("a pending request was not cancelled", t2);
+	if(fileXioAsyncCancel(t1) != -EBUSY)
+		error("a running request was cancelled", t1);
+	if(fileXioAsyncPoll(t2, &result) != -ENOENT || fileXioAsyncCancel(t2) != -ENOENT)
+		error("the token of a cancelled request is still valid", t2);
+
+	wait_request(t1, BLOCK);
+	wait_request(t3, BLOCK);
+	if(fileXioAsyncCancel(t1) != -ENOENT)
+		error("the token of a completed request is still valid", t1);
+
+	// The slots of t1 and t2 are used again, under new tokens.
+	t4 = fileXioAsyncLseek(1, 0, SEEK_SET);
+	if(t4 == t1 || t4 == t2 || fileXioAsyncPoll(t1, &result) != -ENOENT)
+		error("a reused slot accepts its old token", t4);
+	wait_request(t4, 0);
+
+	if(filePos[1] != 0 || ((int *)files[1])[1] != 0 || filePos[0] != 2 * BLOCK || ((int *)files[0])[BLOCK / 4 + 1] != 1)
+		error("the files don't match after the cancellation", 0);
+}
+
+static void test_no_workers(void)
+{
+	int i;
+
+	reset(0);
+	for(i = 0; i < 2; i++)
+	{
+		if(fileXioAsyncRead(0, data[0], BLOCK) != -ENOSYS)
+			error("a request was accepted without workers", i);
+	}
+}
+
+static void test_exit(void)
+{
+	reset(2);
+	fileXioAsyncRead(0, data[0], BLOCK);
+	fileXioAsyncRead(1, data[1], BLOCK);
+	fileXioAsyncRead(0, data[0] + BLOCK, BLOCK);	// Pending, dropped
+
+	fileXioExit();
+	if(iop_busy())
+	{
+		error("fileXioExit() returned with requests running", iop_busy());
+		memset(calls, 0, sizeof(calls));
+	}
+}
+
+static void benchmark(int workers)
+{
+	int tokens[FILES][2], offset, fd, i;
+	double start;
+
+	reset(workers);
+	for(fd = 0; fd < FILES; fd++)
+	{
+		for(i = 0; i < FILE_SIZE; i++)
+			files[fd][i] = rand();
+		deviceFree[fd] = now;
+	}
+	memset(data, 0, sizeof(data));
+
+	start = now;
+	if(workers == 0)
+	{
+		for(offset = 0; offset < FILE_SIZE; offset += CHUNK)
+		{
+			for(fd = 0; fd < FILES; fd++)
+			{
+				if(fileXioRead(fd, data[fd] + offset, CHUNK) != CHUNK)
+					error("fileXioRead failed", fd);
+			}
+		}
+	} else {
+		for(fd = 0; fd < FILES; fd++)
+		{
+			tokens[fd][0] = fileXioAsyncRead(fd, data[fd], CHUNK);
+			tokens[fd][1] = fileXioAsyncRead(fd, data[fd] + CHUNK, CHUNK);
+		}
+
+		for(offset = 2 * CHUNK; offset < FILE_SIZE + 2 * CHUNK; offset += CHUNK)
+		{
+			for(fd = 0; fd < FILES; fd++)
+			{
+				wait_request(tokens[fd][0], CHUNK);
+				tokens[fd][0] = tokens[fd][1];
+				if(offset < FILE_SIZE)
+					tokens[fd][1] = fileXioAsyncRead(fd, data[fd] + offset, CHUNK);
+			}
+		}
+	}
+
+	for(fd = 0; fd < FILES; fd++)
+	{
+		if(memcmp(files[fd], data[fd], FILE_SIZE) != 0)
+			error("the data read doesn't match the file", fd);
+	}
+
+	if(workers == 0)
+		printf("fileXioRead:     %5.1fMB/s\n", FILES * FILE_SIZE / 1e6 / (now - start));
+	else
+		printf("async, %d worker%s %5.1fMB/s\n", workers, workers > 1 ? "s:" : ": ", FILES * FILE_SIZE / 1e6 / (now - start));
+}
+
+int main(void)
+{
+	int workers;
+
+	srand(7);
+
+	test_order();
+	test_cancel();
+	test_no_workers();
+	test_exit();
+
+	benchmark(0);
+	for(workers = 1; workers <= FILEXIO_ASYNC_WORKERS; workers *= 2)
+		benchmark(workers);
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return(errors ? 1 : 0);
+}
@@ -0,0 +1,33 @@
+/* Host stand-in for the EE kernel.h, with the calls used by fileXio_rpc.c. */
+
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <tamtypes.h>
+
+#define UNCACHED_SEG(x)		((void *)(x))
+#define IS_UNCACHED_SEG(x)	0
+
+typedef struct {
+	int	count;
+	int	max_count;
+	int	init_count;
+	int	wait_threads;
+	u32	attr;
+	u32	option;
+} ee_sema_t;
+
+int DI(void);
+int EI(void);
+static inline void nopdelay(void) { }
+
+int CreateSema(ee_sema_t *sema);
+int DeleteSema(int sema_id);
+int WaitSema(int sema_id);
+int PollSema(int sema_id);
+int SignalSema(int sema_id);
+int iSignalSema(int sema_id);
+
+void SifWriteBackDCache(void *ptr, int size);
+
+#endif /* __KERNEL_H__ */
@@ -0,0 +1,41 @@
+/* Host stand-in for the EE ps2sdkapi.h, with the newlib DIR that fileXio_rpc.c fills in. */
+
+#ifndef __PS2SDKAPI_H__
+#define __PS2SDKAPI_H__
+
+#include <sys/stat.h>
+#include <time.h>
+
+typedef struct {
+	int	dd_fd;
+	int	dd_loc;
+	int	dd_size;
+	char	*dd_buf;
+	int	dd_len;
+	long	dd_seek;
+} DIR;
+
+struct dirent {
+	long	d_ino;
+	long	d_off;
+	unsigned short	d_reclen;
+	char	d_name[256];
+};
+
+extern int (*_ps2sdk_close)(int);
+extern int (*_ps2sdk_open)(const char*, int, ...);
+extern int (*_ps2sdk_read)(int, void*, int);
+extern int (*_ps2sdk_lseek)(int, int, int);
+extern int (*_ps2sdk_write)(int, const void*, int);
+extern int (*_ps2sdk_ioctl)(int, int, void*);
+extern int (*_ps2sdk_remove)(const char*);
+extern int (*_ps2sdk_rename)(const char*, const char*);
+extern int (*_ps2sdk_mkdir)(const char*, int);
+extern int (*_ps2sdk_rmdir)(const char*);
+extern int (*_ps2sdk_stat)(const char *path, struct stat *buf);
+extern DIR * (*_ps2sdk_opendir)(const char *path);
+extern struct dirent * (*_ps2sdk_readdir)(DIR *dir);
+extern void (*_ps2sdk_rewinddir)(DIR *dir);
+extern int (*_ps2sdk_closedir)(DIR *dir);
+
+#endif /* __PS2SDKAPI_H__ */
@@ -0,0 +1,20 @@
+/* Host stand-in for the EE sifrpc.h, with the client calls used by fileXio_rpc.c. */
+
+#ifndef __SIFRPC_H__
+#define __SIFRPC_H__
+
+#define SIF_RPC_M_NOWAIT	0x01
+
+typedef void (*SifRpcEndFunc_t)(void *end_param);
+
+typedef struct {
+	void	*server;
+	int	busy;	// A call is in progress
+} SifRpcClientData_t;
+
+int SifBindRpc(SifRpcClientData_t *client, int rpc_number, int mode);
+int SifCallRpc(SifRpcClientData_t *client, int rpc_number, int mode, void *send, int ssize, void *receive, int rsize,
+	SifRpcEndFunc_t end_function, void *end_param);
+int SifCheckStatRpc(SifRpcClientData_t *client);
+
+#endif /* __SIFRPC_H__ */
@@ -37,6 +37,8 @@ int sendto(int s, void *dataptr, int size, unsigned int flags, struct sockaddr *
 int socket(int domain, int type, int protocol);
 int ps2ip_setconfig(t_ip_info *ip_info);
 int ps2ip_getconfig(char *netif_name, t_ip_info *ip_info);
+/** Retrieves the data path statistics of the RPC server and resets them. Returns 0 on success. */
+int ps2ip_getstats(t_ps2ips_stats *stats);
 int select(int maxfdp1, struct fd_set *readset, struct fd_set *writeset, struct fd_set *exceptset, struct timeval *timeout);
 int ioctlsocket(int s, long cmd, void *argp);
 int getsockname(int s, struct sockaddr* name, int* namelen);
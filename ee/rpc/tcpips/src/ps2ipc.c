@@ -35,6 +35,7 @@ static struct {
 		send_pkt send_pkt;
 		socket_pkt socket_pkt;
 		t_ip_info ip_info;
+		t_ps2ips_stats stats;
 		char netif_name[8];
 		select_pkt select_pkt;
 		ioctl_pkt ioctl_pkt;
@@ -472,6 +473,25 @@ int ps2ip_getconfig(char *netif_name, t_ip_info *ip_info)
 	return 1;
 }
 
+int ps2ip_getstats(t_ps2ips_stats *stats)
+{
+	if(!_init_check) return -1;
+
+	WaitSema(lock_sema);
+
+	if (SifCallRpc(&_ps2ip, PS2IPS_ID_GETSTATS, 0, NULL, 0, (void*)&_rpc_buffer.stats, sizeof(t_ps2ips_stats), NULL, NULL) < 0)
+	{
+		SignalSema(lock_sema);
+		return -1;
+	}
+
+	memcpy(stats, &_rpc_buffer.stats, sizeof(t_ps2ips_stats));
+
+	SignalSema(lock_sema);
+
+	return 0;
+}
+
 int select(int maxfdp1, struct fd_set *readset, struct fd_set *writeset, struct fd_set *exceptset, struct timeval *timeout)
 {
 	int result;
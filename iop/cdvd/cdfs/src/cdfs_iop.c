@@ -18,7 +18,12 @@
 #define CdSpinNom 1  // Starts reading data at maximum rotational velocity and if a read error occurs, the rotational velocity is reduced.
 #define CdSpinStm 0  // Recommended stream rotation speed.
 
-#define MAX_DIR_CACHE_SECTORS 32
+#define MAX_DIR_CACHE_SECTORS 16
+#define DEF_DIR_CACHE_ENTRIES 1    // Number of directories kept in the directory cache, unless set with "dircache=<n>"
+#define MAX_DIR_CACHE_ENTRIES 8
+#define DEF_PATH_CACHE_ENTRIES 16  // Number of files kept in the path lookup cache, unless set with "pathcache=<n>"
+#define MAX_PATH_CACHE_ENTRIES 64
+#define MAX_PATH_CACHE_PATHLEN 256
 
 struct DirTocEntry
 {
@@ -53,6 +58,18 @@ struct CacheInfoDir
     unsigned int cache_size;    // The size of the cached directory area (in sectors)
 
     char *cache;  // The actual cached data
+
+    unsigned int lru;  // Last use of this cache entry, the least recently used entry is replaced
+};
+
+struct CacheInfoPath
+{
+    char pathname[MAX_PATH_CACHE_PATHLEN];  // The normalised pathname of the file
+    unsigned int hash;                      // Hash of pathname
+    int next;                               // Next entry in the same hash chain, -1 if none
+    unsigned int valid;                     // TRUE if the entry is valid, FALSE if not
+
+    struct TocEntry tocEntry;
 };
 
 struct RootDirTocHeader
@@ -129,7 +146,15 @@ enum PathMatch {
     SUBDIR
 };
 
-static struct CacheInfoDir cacheInfoDir;
+static struct CacheInfoDir *cacheDirs;
+static struct CacheInfoDir *cacheInfoDir;  // The directory that is currently being worked on
+static int cacheDirCount;
+static unsigned int cacheDirTick;
+
+static struct CacheInfoPath *cachePaths;
+static int *cachePathHash;  // First entry of each hash chain, -1 if none
+static int cachePathCount;  // 0 if the path lookup cache is off
+static int cachePathNext;   // Next entry to be replaced
 static struct CDVolDesc cdVolDesc;
 static sceCdRMode cdReadMode;
 
@@ -221,8 +246,25 @@ static void copyToTocEntry(struct TocEntry *tocEntry, struct DirTocEntry *intern
 }
 
 
+// Invalidate all cached directories and file paths (i.e. when the disc may have been changed)
+static void cdfs_invalidateCaches(void) {
+    int i;
+
+    DPRINTF("cdfs_invalidateCaches called\n\n");
+
+    for (i = 0; i < cacheDirCount; i++)
+        cacheDirs[i].valid = FALSE;
+
+    for (i = 0; i < cachePathCount; i++) {
+        cachePaths[i].valid = FALSE;
+        cachePathHash[i] = -1;
+    }
+
+    cachePathNext = 0;
+}
+
 // findPath should use the current directory cache to start it's search (in this case the root)
-// and should change cacheInfoDir.pathname, to the path of the dir it finds
+// and should change cacheInfoDir->pathname, to the path of the dir it finds
 // it should also cache the first chunk of directory sectors,
 // and fill the contents of the other elements of cacheInfoDir appropriately
 
@@ -247,41 +289,41 @@ static int findPath(char *pathname) {
     while (dirname != NULL) {
         found_dir = FALSE;
 
-        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
 
         // Always skip the first entry (self-refencing entry)
         tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length);
 
         dir_entry = 0;
 
-        for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
+        for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
             // If we have a null toc entry, then we've either reached the end of the dir, or have reached a sector boundary
             if (tocEntryPointer->length == 0) {
                 DPRINTF("Got a null pointer entry, so either reached end of dir, or end of sector\n\n");
-                tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir.cache + (((((char *)tocEntryPointer - cacheInfoDir.cache) / 2048) + 1) * 2048));
+                tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir->cache + (((((char *)tocEntryPointer - cacheInfoDir->cache) / 2048) + 1) * 2048));
             }
 
-            if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048))) {
+            if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048))) {
                 // If we've gone past the end of the cache
                 // then check if there are more sectors to load into the cache
 
-                if ((cacheInfoDir.cache_offset + cacheInfoDir.cache_size) < cacheInfoDir.sector_num) {
+                if ((cacheInfoDir->cache_offset + cacheInfoDir->cache_size) < cacheInfoDir->sector_num) {
                     // If there are more sectors to load, then load them
-                    cacheInfoDir.cache_offset += cacheInfoDir.cache_size;
-                    cacheInfoDir.cache_size = cacheInfoDir.sector_num - cacheInfoDir.cache_offset;
+                    cacheInfoDir->cache_offset += cacheInfoDir->cache_size;
+                    cacheInfoDir->cache_size = cacheInfoDir->sector_num - cacheInfoDir->cache_offset;
 
-                    if (cacheInfoDir.cache_size > MAX_DIR_CACHE_SECTORS)
-                        cacheInfoDir.cache_size = MAX_DIR_CACHE_SECTORS;
+                    if (cacheInfoDir->cache_size > MAX_DIR_CACHE_SECTORS)
+                        cacheInfoDir->cache_size = MAX_DIR_CACHE_SECTORS;
 
-                    if (!cdfs_readSect(cacheInfoDir.sector_start + cacheInfoDir.cache_offset, cacheInfoDir.cache_size, cacheInfoDir.cache)) {
+                    if (!cdfs_readSect(cacheInfoDir->sector_start + cacheInfoDir->cache_offset, cacheInfoDir->cache_size, cacheInfoDir->cache)) {
                         DPRINTF("Couldn't Read from CD !\n\n");
-                        cacheInfoDir.valid = FALSE;  // should we completely invalidate just because we couldnt read time?
+                        cacheInfoDir->valid = FALSE;  // should we completely invalidate just because we couldnt read time?
                         return FALSE;
                     }
 
-                    tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+                    tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
                 } else {
-                    cacheInfoDir.valid = FALSE;
+                    cacheInfoDir->valid = FALSE;
                     return FALSE;
                 }
             }
@@ -293,7 +335,7 @@ static int findPath(char *pathname) {
 
                 // If it's the link to the parent directory, then give it the name ".."
                 if (dir_entry == 0) {
-                    if (cacheInfoDir.path_depth != 0) {
+                    if (cacheInfoDir->path_depth != 0) {
                         DPRINTF("First directory entry in dir, so name it '..'\n\n");
                         strcpy(localTocEntry.filename, "..");
                     }
@@ -308,15 +350,15 @@ static int findPath(char *pathname) {
                         // We've matched with the parent directory
                         // so truncate the pathname by one level
 
-                        if (cacheInfoDir.path_depth > 0)
-                            cacheInfoDir.path_depth--;
+                        if (cacheInfoDir->path_depth > 0)
+                            cacheInfoDir->path_depth--;
 
-                        if (cacheInfoDir.path_depth == 0) {
+                        if (cacheInfoDir->path_depth == 0) {
                             // If at root then just clear the path to root
                             // (simpler than finding the colon seperator etc)
-                            cacheInfoDir.pathname[0] = 0;
+                            cacheInfoDir->pathname[0] = 0;
                         } else {
-                            seperator = strrchr(cacheInfoDir.pathname, '/');
+                            seperator = strrchr(cacheInfoDir->pathname, '/');
 
                             if (seperator != NULL)
                                 *seperator = 0;
@@ -324,10 +366,10 @@ static int findPath(char *pathname) {
                     } else {
                         // otherwise append a seperator, and the matched directory
                         // to the pathname
-                        strcat(cacheInfoDir.pathname, "/");
-                        DPRINTF("Adding '%s' to cached pathname - path depth = %d\n\n", dirname, cacheInfoDir.path_depth);
-                        strcat(cacheInfoDir.pathname, dirname);
-                        cacheInfoDir.path_depth++;
+                        strcat(cacheInfoDir->pathname, "/");
+                        DPRINTF("Adding '%s' to cached pathname - path depth = %d\n\n", dirname, cacheInfoDir->path_depth);
+                        strcat(cacheInfoDir->pathname, dirname);
+                        cacheInfoDir->path_depth++;
                     }
 
                     // Exit out of the search loop
@@ -345,36 +387,36 @@ static int findPath(char *pathname) {
 
         // if we've reached here, without finding the directory, then it's not there
         if (!found_dir) {
-            cacheInfoDir.valid = FALSE;
+            cacheInfoDir->valid = FALSE;
             return FALSE;
         }
 
         // find name of next dir
         dirname = strtok(NULL, "\\/");
 
-        cacheInfoDir.sector_start = localTocEntry.fileLBA;
-        cacheInfoDir.sector_num = (localTocEntry.fileSize >> 11) + ((cdVolDesc.rootToc.tocSize & 2047) != 0);
+        cacheInfoDir->sector_start = localTocEntry.fileLBA;
+        cacheInfoDir->sector_num = (localTocEntry.fileSize >> 11) + ((cdVolDesc.rootToc.tocSize & 2047) != 0);
 
         // Cache the start of the found directory
         // (used in searching if this isn't the last dir,
         // or used by whatever requested the cache in the first place if it is the last dir)
-        cacheInfoDir.cache_offset = 0;
-        cacheInfoDir.cache_size = cacheInfoDir.sector_num;
+        cacheInfoDir->cache_offset = 0;
+        cacheInfoDir->cache_size = cacheInfoDir->sector_num;
 
-        if (cacheInfoDir.cache_size > MAX_DIR_CACHE_SECTORS)
-            cacheInfoDir.cache_size = MAX_DIR_CACHE_SECTORS;
+        if (cacheInfoDir->cache_size > MAX_DIR_CACHE_SECTORS)
+            cacheInfoDir->cache_size = MAX_DIR_CACHE_SECTORS;
 
-        if (!cdfs_readSect(cacheInfoDir.sector_start + cacheInfoDir.cache_offset, cacheInfoDir.cache_size, cacheInfoDir.cache)) {
+        if (!cdfs_readSect(cacheInfoDir->sector_start + cacheInfoDir->cache_offset, cacheInfoDir->cache_size, cacheInfoDir->cache)) {
             DPRINTF("Couldn't Read from CD, trying to read %d sectors, starting at sector %d !\n\n",
-                   cacheInfoDir.cache_size, cacheInfoDir.sector_start + cacheInfoDir.cache_offset);
-            cacheInfoDir.valid = FALSE;  // should we completely invalidate just because we couldnt read time?
+                   cacheInfoDir->cache_size, cacheInfoDir->sector_start + cacheInfoDir->cache_offset);
+            cacheInfoDir->valid = FALSE;  // should we completely invalidate just because we couldnt read time?
             return FALSE;
         }
     }
 
 // If we've got here then we found the requested directory
     DPRINTF("findPath found the path\n\n");
-    cacheInfoDir.valid = TRUE;
+    cacheInfoDir->valid = TRUE;
     return TRUE;
 }
 
@@ -391,7 +433,11 @@ static int cdfs_getVolumeDescriptor(void) {
         if (strncmp(localVolDesc.volID, "CD001", 5) == 0) {
             if ((localVolDesc.filesystemType == 1) ||
                 (localVolDesc.filesystemType == 2)) {
-                memcpy(&cdVolDesc, &localVolDesc, sizeof(struct CDVolDesc));
+                // A different volume means that the disc was changed
+                if (memcmp(&cdVolDesc, &localVolDesc, sizeof(struct CDVolDesc)) != 0) {
+                    cdfs_invalidateCaches();
+                    memcpy(&cdVolDesc, &localVolDesc, sizeof(struct CDVolDesc));
+                }
             }
         } else
             break;
@@ -418,14 +464,14 @@ static enum PathMatch comparePath(const char *path) {
     int length;
     int i;
 
-    length = strlen(cacheInfoDir.pathname);
+    length = strlen(cacheInfoDir->pathname);
 
     for (i = 0; i < length; i++) {
         // check if character matches
-        if (path[i] != cacheInfoDir.pathname[i]) {
+        if (path[i] != cacheInfoDir->pathname[i]) {
             // if not, then is it just because of different path seperator ?
             if ((path[i] == '/') || (path[i] == '\\')) {
-                if ((cacheInfoDir.pathname[i] == '/') || (cacheInfoDir.pathname[i] == '\\')) {
+                if ((cacheInfoDir->pathname[i] == '/') || (cacheInfoDir->pathname[i] == '\\')) {
                     continue;
                 }
             }
@@ -448,6 +494,156 @@ static enum PathMatch comparePath(const char *path) {
         return NOT_MATCH;
 }
 
+// If the requested directory is in the directory cache, then make it the current one
+static int cdfs_findCachedDir(const char *pathname) {
+    struct CacheInfoDir *current;
+    int i;
+
+    current = cacheInfoDir;
+
+    for (i = 0; i < cacheDirCount; i++) {
+        cacheInfoDir = &cacheDirs[i];
+
+        if ((cacheInfoDir->valid) && (comparePath(pathname) == MATCH)) {
+            cacheInfoDir->lru = ++cacheDirTick;
+            return TRUE;
+        }
+    }
+
+    cacheInfoDir = current;
+    return FALSE;
+}
+
+// Select the directory cache entry to use for the requested directory.
+// If it isn't cached, then the least recently used entry is replaced,
+// starting from a copy of the deepest cached parent directory (if there is one)
+static void cdfs_selectDir(const char *pathname) {
+    struct CacheInfoDir *parent, *victim;
+    char *cache;
+    int i;
+
+    if (cdfs_findCachedDir(pathname))
+        return;
+
+    parent = NULL;
+    for (i = 0; i < cacheDirCount; i++) {
+        cacheInfoDir = &cacheDirs[i];
+
+        if ((cacheInfoDir->valid) && (comparePath(pathname) == SUBDIR)) {
+            if ((parent == NULL) || (cacheInfoDir->path_depth > parent->path_depth))
+                parent = cacheInfoDir;
+        }
+    }
+
+    victim = NULL;
+    for (i = 0; i < cacheDirCount; i++) {
+        if (&cacheDirs[i] == parent)
+            continue;
+
+        if (!cacheDirs[i].valid) {
+            victim = &cacheDirs[i];
+            break;
+        }
+
+        if ((victim == NULL) || (cacheDirs[i].lru < victim->lru))
+            victim = &cacheDirs[i];
+    }
+
+    if (victim == NULL) {
+        // Only one cache entry, so search from the parent directory itself
+        victim = parent;
+    } else if (parent != NULL) {
+        DPRINTF("cdfs_selectDir: starting from cached parent %s\n", parent->pathname);
+
+        cache = victim->cache;
+        *victim = *parent;
+        victim->cache = cache;
+        memcpy(victim->cache, parent->cache, parent->cache_size * 2048);
+    } else
+        victim->valid = FALSE;
+
+    victim->lru = ++cacheDirTick;
+    cacheInfoDir = victim;
+}
+
+// Convert the pathname to the form used by the path cache, and return its hash
+static int cdfs_hashPath(const char *path, char *key, unsigned int *hash) {
+    unsigned int h;
+    int i;
+
+    h = 0;
+    for (i = 0; path[i] != '\0'; i++) {
+        if (i >= MAX_PATH_CACHE_PATHLEN - 1)
+            return FALSE;
+
+        key[i] = (path[i] == '\\') ? '/' : tolower(path[i]);
+        h = (h * 31) + (unsigned char)key[i];
+    }
+
+    key[i] = 0;
+    *hash = h;
+
+    return TRUE;
+}
+
+static int cdfs_lookupPath(const char *fname, struct TocEntry *tocEntry) {
+    static char key[MAX_PATH_CACHE_PATHLEN];
+    unsigned int hash;
+    int i;
+
+    if (cachePathCount == 0)
+        return FALSE;
+
+    if (!cdfs_hashPath(fname, key, &hash))
+        return FALSE;
+
+    for (i = cachePathHash[hash % cachePathCount]; i >= 0; i = cachePaths[i].next) {
+        if ((cachePaths[i].hash == hash) && (strcmp(cachePaths[i].pathname, key) == 0)) {
+            DPRINTF("cdfs_lookupPath: %s found in path cache\n", fname);
+            memcpy(tocEntry, &cachePaths[i].tocEntry, sizeof(struct TocEntry));
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void cdfs_cachePath(const char *fname, const struct TocEntry *tocEntry) {
+    struct CacheInfoPath *entry;
+    unsigned int hash;
+    int i, *link;
+
+    if (cachePathCount == 0)
+        return;
+
+    entry = &cachePaths[cachePathNext];
+
+    // Remove the entry that is being replaced from its hash chain
+    if (entry->valid) {
+        for (link = &cachePathHash[entry->hash % cachePathCount]; *link >= 0; link = &cachePaths[*link].next) {
+            if (*link == cachePathNext) {
+                *link = entry->next;
+                break;
+            }
+        }
+
+        entry->valid = FALSE;
+    }
+
+    if (!cdfs_hashPath(fname, entry->pathname, &hash))
+        return;
+
+    i = hash % cachePathCount;
+
+    memcpy(&entry->tocEntry, tocEntry, sizeof(struct TocEntry));
+    entry->hash = hash;
+    entry->next = cachePathHash[i];
+    entry->valid = TRUE;
+    cachePathHash[i] = cachePathNext;
+
+    cachePathNext = (cachePathNext + 1) % cachePathCount;
+}
+
 // Check if a TOC Entry matches our extension list
 static int compareTocEntry(char *filename, const char *extensions) {
     static char ext_list[129];
@@ -488,22 +684,25 @@ static int cdfs_cacheDir(const char *pathname, enum Cache_getMode getMode) {
     int path_len;
     DPRINTF("Attempting to find, and cache, directory: %s\n", pathname);
 
+    if (getMode == CACHE_START)
+        cdfs_selectDir(pathname);
+
     // only take any notice of the existing cache, if it's valid
-    if (cacheInfoDir.valid) {
+    if (cacheInfoDir->valid) {
         // Check if the requested path is already cached
-        //		if (strcasecmp(pathname,cacheInfoDir.pathname)==0)
+        //		if (strcasecmp(pathname,cacheInfoDir->pathname)==0)
         if (comparePath(pathname) == MATCH) {
             DPRINTF("CacheDir: The requested path is already cached\n");
             // If so, is the request ot cache the start of the directory, or to resume the next block ?
             if (getMode == CACHE_START) {
                 DPRINTF("          and requested cache from start of dir\n");
 
-                if (cacheInfoDir.cache_offset == 0) {
+                if (cacheInfoDir->cache_offset == 0) {
 // requested cache of start of the directory, and thats what's already cached
 // so sit back and do nothing
                     DPRINTF("          and start of dir is already cached so nothing to do :o)\n");
 
-                    cacheInfoDir.valid = TRUE;
+                    cacheInfoDir->valid = TRUE;
                     return TRUE;
                 } else {
 // Requested cache of start of the directory, but thats not what's cached
@@ -511,48 +710,48 @@ static int cdfs_cacheDir(const char *pathname, enum Cache_getMode getMode) {
                     DPRINTF("          but dir isn't cached from start, so re-cache existing dir from start\n");
 
                     // reset cache data to start of existing directory
-                    cacheInfoDir.cache_offset = 0;
-                    cacheInfoDir.cache_size = cacheInfoDir.sector_num;
+                    cacheInfoDir->cache_offset = 0;
+                    cacheInfoDir->cache_size = cacheInfoDir->sector_num;
 
-                    if (cacheInfoDir.cache_size > MAX_DIR_CACHE_SECTORS)
-                        cacheInfoDir.cache_size = MAX_DIR_CACHE_SECTORS;
+                    if (cacheInfoDir->cache_size > MAX_DIR_CACHE_SECTORS)
+                        cacheInfoDir->cache_size = MAX_DIR_CACHE_SECTORS;
 
                     // Now fill the cache with the specified sectors
-                    if (!cdfs_readSect(cacheInfoDir.sector_start + cacheInfoDir.cache_offset, cacheInfoDir.cache_size, cacheInfoDir.cache)) {
+                    if (!cdfs_readSect(cacheInfoDir->sector_start + cacheInfoDir->cache_offset, cacheInfoDir->cache_size, cacheInfoDir->cache)) {
                         DPRINTF("Couldn't Read from CD !\n");
 
-                        cacheInfoDir.valid = FALSE;  // should we completely invalidate just because we couldnt read first time?
+                        cacheInfoDir->valid = FALSE;  // should we completely invalidate just because we couldnt read first time?
                         return FALSE;
                     }
 
-                    cacheInfoDir.valid = TRUE;
+                    cacheInfoDir->valid = TRUE;
                     return TRUE;
                 }
             } else  { 
                 // getMode == CACHE_NEXT 
                 // So get the next block of the existing directory
-                cacheInfoDir.cache_offset += cacheInfoDir.cache_size;
-                cacheInfoDir.cache_size = cacheInfoDir.sector_num - cacheInfoDir.cache_offset;
+                cacheInfoDir->cache_offset += cacheInfoDir->cache_size;
+                cacheInfoDir->cache_size = cacheInfoDir->sector_num - cacheInfoDir->cache_offset;
 
-                if (cacheInfoDir.cache_size > MAX_DIR_CACHE_SECTORS)
-                    cacheInfoDir.cache_size = MAX_DIR_CACHE_SECTORS;
+                if (cacheInfoDir->cache_size > MAX_DIR_CACHE_SECTORS)
+                    cacheInfoDir->cache_size = MAX_DIR_CACHE_SECTORS;
 
                 // Now fill the cache with the specified sectors
-                if (!cdfs_readSect(cacheInfoDir.sector_start + cacheInfoDir.cache_offset, cacheInfoDir.cache_size, cacheInfoDir.cache)) {
+                if (!cdfs_readSect(cacheInfoDir->sector_start + cacheInfoDir->cache_offset, cacheInfoDir->cache_size, cacheInfoDir->cache)) {
                     DPRINTF("Couldn't Read from CD !\n");
 
-                    cacheInfoDir.valid = FALSE;  // should we completely invalidate just because we couldnt read first time?
+                    cacheInfoDir->valid = FALSE;  // should we completely invalidate just because we couldnt read first time?
                     return FALSE;
                 }
 
-                cacheInfoDir.valid = TRUE;
+                cacheInfoDir->valid = TRUE;
                 return TRUE;
             }
         } else  {
             // requested directory is not the cached directory (but cache is still valid)
             DPRINTF("Cache is valid, but cached directory, is not the requested one\n"
                    "so check if the requested directory is a sub-dir of the cached one\n");
-            DPRINTF("Requested Path = %s , Cached Path = %s\n", pathname, cacheInfoDir.pathname);
+            DPRINTF("Requested Path = %s , Cached Path = %s\n", pathname, cacheInfoDir->pathname);
 
             if (comparePath(pathname) == SUBDIR) {
 // If so then we can start our search for the path, from the currently cached directory
@@ -560,26 +759,26 @@ static int cdfs_cacheDir(const char *pathname, enum Cache_getMode getMode) {
                        "so start search from current cached dir\n");
                 // if the cached chunk, is not the start of the dir,
                 // then we will need to re-load it before starting search
-                if (cacheInfoDir.cache_offset != 0) {
-                    cacheInfoDir.cache_offset = 0;
-                    cacheInfoDir.cache_size = cacheInfoDir.sector_num;
-                    if (cacheInfoDir.cache_size > MAX_DIR_CACHE_SECTORS)
-                        cacheInfoDir.cache_size = MAX_DIR_CACHE_SECTORS;
+                if (cacheInfoDir->cache_offset != 0) {
+                    cacheInfoDir->cache_offset = 0;
+                    cacheInfoDir->cache_size = cacheInfoDir->sector_num;
+                    if (cacheInfoDir->cache_size > MAX_DIR_CACHE_SECTORS)
+                        cacheInfoDir->cache_size = MAX_DIR_CACHE_SECTORS;
 
                     // Now fill the cache with the specified sectors
-                    if (!cdfs_readSect(cacheInfoDir.sector_start + cacheInfoDir.cache_offset, cacheInfoDir.cache_size, cacheInfoDir.cache)) {
+                    if (!cdfs_readSect(cacheInfoDir->sector_start + cacheInfoDir->cache_offset, cacheInfoDir->cache_size, cacheInfoDir->cache)) {
                         DPRINTF("Couldn't Read from CD !\n");
-                        cacheInfoDir.valid = FALSE;  // should we completely invalidate just because we couldnt read time?
+                        cacheInfoDir->valid = FALSE;  // should we completely invalidate just because we couldnt read time?
                         return FALSE;
                     }
                 }
 
                 // start the search, with the path after the current directory
-                path_len = strlen(cacheInfoDir.pathname);
+                path_len = strlen(cacheInfoDir->pathname);
                 strcpy(dirname, pathname + path_len);
 
                 // findPath should use the current directory cache to start it's search
-                // and should change cacheInfoDir.pathname, to the path of the dir it finds
+                // and should change cacheInfoDir->pathname, to the path of the dir it finds
                 // it should also cache the first chunk of directory sectors,
                 // and fill the contents of the other elements of cacheInfoDir appropriately
 
@@ -608,22 +807,22 @@ static int cdfs_cacheDir(const char *pathname, enum Cache_getMode getMode) {
 
     DPRINTF("Read the CD Volume Descriptor\n\n");
 
-    cacheInfoDir.path_depth = 0;
-    strcpy(cacheInfoDir.pathname, "");
+    cacheInfoDir->path_depth = 0;
+    strcpy(cacheInfoDir->pathname, "");
 
     // Setup the lba and sector size, for retrieving the root toc
-    cacheInfoDir.cache_offset = 0;
-    cacheInfoDir.sector_start = cdVolDesc.rootToc.tocLBA;
-    cacheInfoDir.sector_num = (cdVolDesc.rootToc.tocSize >> 11) + ((cdVolDesc.rootToc.tocSize & 2047) != 0);
-    cacheInfoDir.cache_size = cacheInfoDir.sector_num;
+    cacheInfoDir->cache_offset = 0;
+    cacheInfoDir->sector_start = cdVolDesc.rootToc.tocLBA;
+    cacheInfoDir->sector_num = (cdVolDesc.rootToc.tocSize >> 11) + ((cdVolDesc.rootToc.tocSize & 2047) != 0);
+    cacheInfoDir->cache_size = cacheInfoDir->sector_num;
 
-    if (cacheInfoDir.cache_size > MAX_DIR_CACHE_SECTORS)
-        cacheInfoDir.cache_size = MAX_DIR_CACHE_SECTORS;
+    if (cacheInfoDir->cache_size > MAX_DIR_CACHE_SECTORS)
+        cacheInfoDir->cache_size = MAX_DIR_CACHE_SECTORS;
 
     // Now fill the cache with the specified sectors
-    if (!cdfs_readSect(cacheInfoDir.sector_start + cacheInfoDir.cache_offset, cacheInfoDir.cache_size, cacheInfoDir.cache)) {
+    if (!cdfs_readSect(cacheInfoDir->sector_start + cacheInfoDir->cache_offset, cacheInfoDir->cache_size, cacheInfoDir->cache)) {
         DPRINTF("Couldn't Read from CD !\n");
-        cacheInfoDir.valid = FALSE;  // should we completely invalidate just because we couldnt read time?
+        cacheInfoDir->valid = FALSE;  // should we completely invalidate just because we couldnt read time?
         return FALSE;
     }
 
@@ -672,19 +871,65 @@ static void splitPath(const char *constpath, char *dir, char *fname) {
 *                                              *
 ***********************************************/
 
-int cdfs_prepare(void) {
+int cdfs_prepare(int dirEntries, int pathEntries) {
+    char *cache;
+    int i;
 
-    // Initialise the directory cache
-    strcpy(cacheInfoDir.pathname, "");  // The pathname of the cached directory
-    cacheInfoDir.valid = FALSE;         // Cache is not valid
-    cacheInfoDir.path_depth = 0;        // 0 = root)
-    cacheInfoDir.sector_start = 0;      // The start sector (LBA) of the cached directory
-    cacheInfoDir.sector_num = 0;        // The total size of the directory (in sectors)
-    cacheInfoDir.cache_offset = 0;      // The offset from sector_start of the cached area
-    cacheInfoDir.cache_size = 0;        // The size of the cached directory area (in sectors)
+    if (dirEntries < 1)
+        dirEntries = DEF_DIR_CACHE_ENTRIES;
+    else if (dirEntries > MAX_DIR_CACHE_ENTRIES)
+        dirEntries = MAX_DIR_CACHE_ENTRIES;
+
+    if (pathEntries < 0)
+        pathEntries = DEF_PATH_CACHE_ENTRIES;
+    else if (pathEntries > MAX_PATH_CACHE_ENTRIES)
+        pathEntries = MAX_PATH_CACHE_ENTRIES;
+
+    // Initialise the directory cache, with fewer entries if there isn't enough memory for all of them.
+    // The sector buffers come first in the block, followed by the entries.
+    if (cacheDirs == NULL) {
+        for (cache = NULL; dirEntries > 0; dirEntries--) {
+            cache = (char *)AllocSysMemory(0, dirEntries * (MAX_DIR_CACHE_SECTORS * 2048 + sizeof(struct CacheInfoDir)), NULL);
+            if (cache != NULL)
+                break;
+        }
 
-    if (cacheInfoDir.cache == NULL)
-        cacheInfoDir.cache = (char *)AllocSysMemory(0, MAX_DIR_CACHE_SECTORS * 2048, NULL);
+        if (cache == NULL) {
+            printf("CDFS: cannot allocate the directory cache\n");
+            return -1;
+        }
+
+        cacheDirCount = dirEntries;
+        cacheDirs = (struct CacheInfoDir *)(cache + cacheDirCount * MAX_DIR_CACHE_SECTORS * 2048);
+    } else
+        cache = cacheDirs[0].cache;
+
+    for (i = 0; i < cacheDirCount; i++) {
+        cacheInfoDir = &cacheDirs[i];
+        strcpy(cacheInfoDir->pathname, "");  // The pathname of the cached directory
+        cacheInfoDir->valid = FALSE;         // Cache is not valid
+        cacheInfoDir->path_depth = 0;        // 0 = root)
+        cacheInfoDir->sector_start = 0;      // The start sector (LBA) of the cached directory
+        cacheInfoDir->sector_num = 0;        // The total size of the directory (in sectors)
+        cacheInfoDir->cache_offset = 0;      // The offset from sector_start of the cached area
+        cacheInfoDir->cache_size = 0;        // The size of the cached directory area (in sectors)
+        cacheInfoDir->cache = cache + (i * MAX_DIR_CACHE_SECTORS * 2048);
+        cacheInfoDir->lru = 0;
+    }
+
+    cacheInfoDir = &cacheDirs[0];
+    cacheDirTick = 0;
+
+    // Initialise the path lookup cache, it is left off if there isn't enough memory for it
+    if ((cachePaths == NULL) && (pathEntries > 0)) {
+        cachePaths = (struct CacheInfoPath *)AllocSysMemory(0, pathEntries * (sizeof(struct CacheInfoPath) + sizeof(int)), NULL);
+        if (cachePaths != NULL) {
+            cachePathHash = (int *)&cachePaths[pathEntries];
+            cachePathCount = pathEntries;
+        }
+    }
+
+    cdfs_invalidateCaches();
 
      // setup the cdReadMode structure
     cdReadMode.trycount = 0;
@@ -699,9 +944,20 @@ int cdfs_start(void) {
 }
 
 int cdfs_finish(void) {
-    if (cacheInfoDir.cache)
-        FreeSysMemory(cacheInfoDir.cache);
-    
+    if (cacheDirs) {
+        FreeSysMemory(cacheDirs[0].cache);
+        cacheDirs = NULL;
+        cacheInfoDir = NULL;
+        cacheDirCount = 0;
+    }
+
+    if (cachePaths) {
+        FreeSysMemory(cachePaths);
+        cachePaths = NULL;
+        cachePathHash = NULL;
+        cachePathCount = 0;
+    }
+
     return 0;
 }
 
@@ -713,22 +969,32 @@ int cdfs_findfile(const char *fname, struct TocEntry *tocEntry) {
 
     DPRINTF("cdfs_findfile called\n\n");
 
+    // Files that were found before need no disc access at all,
+    // as long as the disc wasn't taken out in the meantime
+    if (!isValidDisc()) {
+        cdfs_invalidateCaches();
+        return FALSE;
+    }
+
+    if (cdfs_lookupPath(fname, tocEntry))
+        return TRUE;
+
     splitPath(fname, pathname, filename);
     DPRINTF("Trying to find file: %s in directory: %s\n", filename, pathname);
 
-    if ((cacheInfoDir.valid) && (comparePath(pathname) == MATCH)) {
+    if (cdfs_findCachedDir(pathname)) {
         // the directory is already cached, so check through the currently
         // cached chunk of the directory first
 
-        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
 
-        for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
+        for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
             if (tocEntryPointer->length == 0) {
                 DPRINTF("Got a null pointer entry, so either reached end of dir, or end of sector\n");
-                tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir.cache + (((((char *)tocEntryPointer - cacheInfoDir.cache) / 2048) + 1) * 2048));
+                tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir->cache + (((((char *)tocEntryPointer - cacheInfoDir->cache) / 2048) + 1) * 2048));
             }
 
-            if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048))) {
+            if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048))) {
                 // reached the end of the cache block
                 break;
             }
@@ -737,16 +1003,17 @@ int cdfs_findfile(const char *fname, struct TocEntry *tocEntry) {
 
             if (strcasecmp(tocEntry->filename, filename) == 0) {
                // and it matches !!
+               cdfs_cachePath(fname, tocEntry);
                return TRUE;
             }
         }  // end of for loop
 
         // If that was the only dir block, and we havent found it, then fail
-        if (cacheInfoDir.cache_size == cacheInfoDir.sector_num)
+        if (cacheInfoDir->cache_size == cacheInfoDir->sector_num)
             return FALSE;
 
         // Otherwise there is more dir to check
-        if (cacheInfoDir.cache_offset == 0) {
+        if (cacheInfoDir->cache_offset == 0) {
             // If that was the first block then continue with the next block
             if (!cdfs_cacheDir(pathname, CACHE_NEXT))
                 return FALSE;
@@ -766,21 +1033,21 @@ int cdfs_findfile(const char *fname, struct TocEntry *tocEntry) {
 
     // If we've got here, then we have a block of the directory cached, and want to check
     // from this point, to the end of the dir
-    DPRINTF("cache_size = %d\n", cacheInfoDir.cache_size);
-    while (cacheInfoDir.cache_size > 0) {
-        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+    DPRINTF("cache_size = %d\n", cacheInfoDir->cache_size);
+    while (cacheInfoDir->cache_size > 0) {
+        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
 
-        if (cacheInfoDir.cache_offset == 0)
+        if (cacheInfoDir->cache_offset == 0)
             tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length);
 
-        for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
+        for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
             if (tocEntryPointer->length == 0) {
                 DPRINTF("Got a null pointer entry, so either reached end of dir, or end of sector\n");
-                DPRINTF("Offset into cache = %d bytes\n", (char *)tocEntryPointer - cacheInfoDir.cache);
-                tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir.cache + (((((char *)tocEntryPointer - cacheInfoDir.cache) / 2048) + 1) * 2048));
+                DPRINTF("Offset into cache = %d bytes\n", (char *)tocEntryPointer - cacheInfoDir->cache);
+                tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir->cache + (((((char *)tocEntryPointer - cacheInfoDir->cache) / 2048) + 1) * 2048));
             }
 
-            if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048))) {
+            if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048))) {
                 // reached the end of the cache block
                 break;
             }
@@ -790,6 +1057,7 @@ int cdfs_findfile(const char *fname, struct TocEntry *tocEntry) {
             if (strcasecmp(tocEntry->filename, filename) == 0) {
                 DPRINTF("Found a matching file\n\n");
                 // and it matches !!
+                cdfs_cachePath(fname, tocEntry);
                 return TRUE;
             }
 
@@ -873,21 +1141,21 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
         return -1;
     }
 
-    DPRINTF("requested directory is %d sectors\n", cacheInfoDir.sector_num);
+    DPRINTF("requested directory is %d sectors\n", cacheInfoDir->sector_num);
 
     if ((getMode == CDFS_GET_DIRS_ONLY) || (getMode == CDFS_GET_FILES_AND_DIRS)) {
         // Cache the start of the requested directory
-        if (!cdfs_cacheDir(cacheInfoDir.pathname, CACHE_START)) {
+        if (!cdfs_cacheDir(cacheInfoDir->pathname, CACHE_START)) {
             DPRINTF("cdfs_getDir - Call of cdfs_cacheDir failed\n\n");
             return -1;
         }
 
-        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
         // skip the first self-referencing entry
         tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length);
 
         // skip the parent entry if this is the root
-        if (cacheInfoDir.path_depth == 0)
+        if (cacheInfoDir->path_depth == 0)
             tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length);
 
         dir_entry = 0;
@@ -896,16 +1164,16 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
             DPRINTF("cdfs_getDir - inside while-loop\n\n");
 
             // parse the current cache block
-            for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
+            for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
                 if (tocEntryPointer->length == 0) {
                     // if we have a toc entry length of zero,
                     // then we've either reached the end of the sector, or the end of the dir
                     // so point to next sector (if there is one - will be checked by next condition)
 
-                    tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir.cache + (((((char *)tocEntryPointer - cacheInfoDir.cache) / 2048) + 1) * 2048));
+                    tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir->cache + (((((char *)tocEntryPointer - cacheInfoDir->cache) / 2048) + 1) * 2048));
                 }
 
-                if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048))) {
+                if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048))) {
                     // we've reached the end of the current cache block (which may be end of entire dir
                     // so just break the loop
                     break;
@@ -917,7 +1185,7 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
                     copyToTocEntry(&localTocEntry, tocEntryPointer);
 
                     if (dir_entry == 0) {
-                        if (cacheInfoDir.path_depth != 0) {
+                        if (cacheInfoDir->path_depth != 0) {
                             DPRINTF("It's the first directory entry, so name it '..'\n\n");
                             strcpy(localTocEntry.filename, "..");
                         }
@@ -938,8 +1206,8 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
             }  // end of the current cache block
 
             // if there is more dir to load, then load next chunk, else finish
-            if ((cacheInfoDir.cache_offset + cacheInfoDir.cache_size) < cacheInfoDir.sector_num) {
-                if (!cdfs_cacheDir(cacheInfoDir.pathname, CACHE_NEXT)) {
+            if ((cacheInfoDir->cache_offset + cacheInfoDir->cache_size) < cacheInfoDir->sector_num) {
+                if (!cdfs_cacheDir(cacheInfoDir->pathname, CACHE_NEXT)) {
                     // failed to cache next block (should return TRUE even if
                     // there is no more directory, as long as a CD read didnt fail
                     return -1;
@@ -947,25 +1215,25 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
             } else
                 break;
 
-            tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+            tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
         }
     }
 
     // Next do files
     if ((getMode == CDFS_GET_FILES_ONLY) || (getMode == CDFS_GET_FILES_AND_DIRS)) {
         // Cache the start of the requested directory
-        if (!cdfs_cacheDir(cacheInfoDir.pathname, CACHE_START)) {
+        if (!cdfs_cacheDir(cacheInfoDir->pathname, CACHE_START)) {
             DPRINTF("cdfs_getDir - Call of cdfs_cacheDir failed\n\n");
             return -1;
         }
 
-        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+        tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
 
         // skip the first self-referencing entry
         tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length);
 
         // skip the parent entry if this is the root
-        if (cacheInfoDir.path_depth == 0)
+        if (cacheInfoDir->path_depth == 0)
             tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length);
 
         dir_entry = 0;
@@ -974,16 +1242,16 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
             DPRINTF("cdfs_getDir - inside while-loop\n\n");
 
             // parse the current cache block
-            for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
+            for (; tocEntryPointer < (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048)); tocEntryPointer = (struct DirTocEntry *)((u8 *)tocEntryPointer + tocEntryPointer->length)) {
                 if (tocEntryPointer->length == 0) {
                     // if we have a toc entry length of zero,
                     // then we've either reached the end of the sector, or the end of the dir
                     // so point to next sector (if there is one - will be checked by next condition)
 
-                    tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir.cache + (((((char *)tocEntryPointer - cacheInfoDir.cache) / 2048) + 1) * 2048));
+                    tocEntryPointer = (struct DirTocEntry *)(cacheInfoDir->cache + (((((char *)tocEntryPointer - cacheInfoDir->cache) / 2048) + 1) * 2048));
                 }
 
-                if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir.cache + (cacheInfoDir.cache_size * 2048))) {
+                if (tocEntryPointer >= (struct DirTocEntry *)(cacheInfoDir->cache + (cacheInfoDir->cache_size * 2048))) {
                     // we've reached the end of the current cache block (which may be end of entire dir
                     // so just break the loop
                     break;
@@ -1023,8 +1291,8 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
 
 
             // if there is more dir to load, then load next chunk, else finish
-            if ((cacheInfoDir.cache_offset + cacheInfoDir.cache_size) < cacheInfoDir.sector_num) {
-                if (!cdfs_cacheDir(cacheInfoDir.pathname, CACHE_NEXT)) {
+            if ((cacheInfoDir->cache_offset + cacheInfoDir->cache_size) < cacheInfoDir->sector_num) {
+                if (!cdfs_cacheDir(cacheInfoDir->pathname, CACHE_NEXT)) {
                     // failed to cache next block (should return TRUE even if
                     // there is no more directory, as long as a CD read didnt fail
                     return -1;
@@ -1032,7 +1300,7 @@ int cdfs_getDir(const char *pathname, const char *extensions, enum CDFS_getMode
             } else
                 break;
 
-            tocEntryPointer = (struct DirTocEntry *)cacheInfoDir.cache;
+            tocEntryPointer = (struct DirTocEntry *)cacheInfoDir->cache;
         }
     }
     // reached the end of the dir, before filling up the requested entries
@@ -23,7 +23,7 @@ enum CDFS_getMode {
     CDFS_GET_FILES_AND_DIRS = 3
 };
 
-int cdfs_prepare(void);
+int cdfs_prepare(int dirEntries, int pathEntries);
 int cdfs_start(void);
 int cdfs_finish(void);
 int cdfs_findfile(const char *fname, struct TocEntry *tocEntry);
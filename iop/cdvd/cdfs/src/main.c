@@ -428,9 +428,19 @@ static iop_device_ops_t fio_ops = {
 int _start(int argc, char **argv)
 {
     static iop_device_t fio_driver;
+    int i, dirEntries = 0, pathEntries = -1;
+
+    // "dircache=<n>" sets the number of directories kept in the directory cache (32KB each),
+    // "pathcache=<n>" the number of files kept in the path lookup cache (0 turns it off)
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "dircache=", 9) == 0)
+            dirEntries = strtol(&argv[i][9], NULL, 10);
+        else if (strncmp(argv[i], "pathcache=", 10) == 0)
+            pathEntries = strtol(&argv[i][10], NULL, 10);
+    }
 
     // Prepare cache and read mode
-    cdfs_prepare();
+    if (cdfs_prepare(dirEntries, pathEntries) != 0) { return(-1); }
 
     char driverDesc[50];
     sprintf(driverDesc, "%s Filedriver v%i", DRIVER_UNIT_NAME, DRIVER_UNIT_VERSION);
@@ -0,0 +1,151 @@
+/*
+ * Host harness for the cdfs directory and path caches.
+ *
+ * cdfs_iop.c runs against an ISO9660 image file in place of the disc, and the
+ * harness counts the sceCdRead calls of a few open patterns. Every file that is
+ * found is checked to start with its own LBA, as written by mkiso.py.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   python3 iop/cdvd/cdfs/test/mkiso.py test.iso
+ *   gcc -O2 -Iiop/cdvd/cdfs/test/host -Iiop/cdvd/cdfs/src \
+ *       iop/cdvd/cdfs/test/cdfs_replay.c iop/cdvd/cdfs/src/cdfs_iop.c -o cdfs_replay
+ *   ./cdfs_replay test.iso [dircache [pathcache [memory KB]]]
+ *
+ * dircache and pathcache are passed to cdfs_prepare() like the module arguments
+ * of the same names. With a memory limit, AllocSysMemory fails for larger blocks,
+ * to check that cdfs falls back to smaller caches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libcdvd-common.h>
+
+#include "cdfs_iop.h"
+
+static FILE *iso;
+static int reads, sectors, diskType = SCECdPS2DVD;
+static int memLimit = -1, memUsed;
+
+int sceCdGetDiskType(void) { return diskType; }
+int sceCdDiskReady(int mode) { return 2; }
+int sceCdSync(int mode) { return 0; }
+int sceCdGetError(void) { return 0; }
+int sceCdInit(int mode) { return 1; }
+
+int sceCdRead(u32 lsn, u32 count, void *buf, sceCdRMode *mode)
+{
+    reads++;
+    sectors += count;
+
+    memset(buf, 0, count * 2048);
+    fseek(iso, lsn * 2048L, SEEK_SET);
+    fread(buf, 2048, count, iso);
+    return 1;
+}
+
+void *AllocSysMemory(int mode, int size, void *ptr)
+{
+    if ((memLimit >= 0) && (memUsed + size > memLimit))
+        return NULL;
+
+    memUsed += size;
+    return malloc(size);
+}
+
+int FreeSysMemory(void *ptr)
+{
+    free(ptr);
+    return 0;
+}
+
+static void check(const char *path, int expected)
+{
+    struct TocEntry tocEntry;
+    u32 first;
+    int found;
+
+    found = cdfs_findfile(path, &tocEntry);
+    if (found != expected) {
+        printf("FAIL: %s %s\n", path, found ? "found" : "not found");
+        exit(1);
+    }
+
+    if (found && (tocEntry.fileSize != 0)) {
+        fseek(iso, tocEntry.fileLBA * 2048L, SEEK_SET);
+        if ((fread(&first, 4, 1, iso) != 1) || (first != tocEntry.fileLBA)) {
+            printf("FAIL: %s has the wrong LBA %u\n", path, tocEntry.fileLBA);
+            exit(1);
+        }
+    }
+}
+
+static void alternate(const char *label)
+{
+    char path[64];
+    int i;
+
+    reads = sectors = 0;
+    for (i = 0; i < 200; i++) {
+        sprintf(path, "\\DATA\\F%03d.DAT", i % 50);
+        check(path, 1);
+        sprintf(path, "\\SOUND\\S%03d.ADP", (i * 37) % 120);
+        check(path, 1);
+    }
+    printf("%s, 400 opens: %d reads (%d sectors)\n", label, reads, sectors);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct TocEntry entries[1024];
+    int dirEntries, pathEntries, n;
+
+    if (argc < 2) {
+        printf("usage: %s image.iso [dircache [pathcache [memory KB]]]\n", argv[0]);
+        return 1;
+    }
+
+    if ((iso = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    dirEntries = (argc > 2) ? atoi(argv[2]) : 0;
+    pathEntries = (argc > 3) ? atoi(argv[3]) : -1;
+    if (argc > 4)
+        memLimit = atoi(argv[4]) * 1024;
+
+    if (cdfs_prepare(dirEntries, pathEntries) != 0) {
+        printf("cdfs_prepare failed\n");
+        return 1;
+    }
+    printf("%d bytes of cache memory\n", memUsed);
+
+    alternate("alternating DATA and SOUND");
+    alternate("the same opens again");
+
+    reads = 0;
+    check("\\DATA\\SUB\\X.BIN", 1);
+    check("/data/sub/x.bin", 1);
+    check("\\BOOT.ELF", 1);
+    check("\\DATA\\NOPE", 0);
+    check("\\NODIR\\A", 0);
+    check("\\DATA\\SUB\\..\\F001.DAT", 1);
+    printf("nested, case and missing paths: %d reads\n", reads);
+
+    diskType = SCECdNODISC;
+    check("\\BOOT.ELF", 0);
+    diskType = SCECdPS2DVD;
+    reads = 0;
+    check("\\BOOT.ELF", 1);
+    printf("after the disc was taken out: %d reads\n", reads);
+
+    n = cdfs_getDir("\\SOUND", "", CDFS_GET_FILES_AND_DIRS, entries, 1024);
+    printf("getDir SOUND: %d entries\n", n);
+    n = cdfs_getDir("\\DATA", "", CDFS_GET_FILES_AND_DIRS, entries, 1024);
+    printf("getDir DATA: %d entries\n", n);
+
+    cdfs_finish();
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,39 @@
+/* Host stand-in for the cdvdman definitions used by cdfs_iop.c. */
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+typedef struct
+{
+    u8 trycount;
+    u8 spindlctrl;
+    u8 datapattern;
+    u8 pad;
+} sceCdRMode;
+
+enum {
+    SCECdNODISC = 0x00,
+    SCECdPSCD = 0x10,
+    SCECdPSCDDA,
+    SCECdPS2CD,
+    SCECdPS2CDDA,
+    SCECdPS2DVD
+};
+
+#define SCECdSpinStm 0
+#define SCECdSecS2048 0
+#define SCECdINoD 0
+
+int sceCdGetDiskType(void);
+int sceCdDiskReady(int mode);
+int sceCdRead(u32 lsn, u32 sectors, void *buf, sceCdRMode *mode);
+int sceCdSync(int mode);
+int sceCdGetError(void);
+int sceCdInit(int mode);
+
+// cdfs_iop.c has its own strcasecmp
+#define strcasecmp cdfs_strcasecmp
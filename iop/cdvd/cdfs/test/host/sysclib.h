@@ -0,0 +1 @@
+/* Host stand-in, the host C library provides the string functions. */
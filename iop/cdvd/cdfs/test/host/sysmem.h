@@ -0,0 +1,3 @@
+/* Host stand-in for the sysmem allocator, see cdfs_replay.c. */
+void *AllocSysMemory(int mode, int size, void *ptr);
+int FreeSysMemory(void *ptr);
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# Writes a small ISO9660 image for cdfs_replay:
+#   /BOOT.ELF, /DATA/F000.DAT..F049.DAT, /DATA/SUB/X.BIN and /SOUND/S000.ADP..
+# The number of files in /SOUND is the optional second argument (default 120),
+# so that /SOUND can be made larger than one directory cache entry (16 sectors).
+# The first word of every file is its own LBA, which cdfs_replay checks.
+
+import struct
+import sys
+
+SECTOR = 2048
+
+
+def both16(v):
+    return struct.pack('<H', v) + struct.pack('>H', v)
+
+
+def both32(v):
+    return struct.pack('<I', v) + struct.pack('>I', v)
+
+
+def record(name, lba, size, isdir):
+    n = name if isinstance(name, bytes) else name.encode()
+    length = 33 + len(n)
+    length += length & 1
+    r = bytes([length, 0]) + both32(lba) + both32(size) + bytes(7) + bytes([2 if isdir else 0, 0, 0]) + both16(1) + bytes([len(n)]) + n
+    return r + bytes(length - len(r))
+
+
+def layout(tree):
+    info = {'children': {}}
+    for name, v in tree.items():
+        info['children'][name] = layout(v) if isinstance(v, dict) else {'size': v}
+    return info
+
+
+def dir_sectors(info):
+    sizes = [34, 34] + [33 + len(k) + (0 if 'children' in c else 2) for k, c in info['children'].items()]
+    sectors, used = 1, 0
+    for r in sizes:
+        r += r & 1
+        if used + r > SECTOR:
+            sectors, used = sectors + 1, 0
+        used += r
+    return sectors
+
+
+def alloc_dirs(info, next_lba):
+    info['secs'] = dir_sectors(info)
+    info['lba'] = next_lba
+    next_lba += info['secs']
+    for c in info['children'].values():
+        if 'children' in c:
+            next_lba = alloc_dirs(c, next_lba)
+    return next_lba
+
+
+def alloc_files(info, next_lba):
+    for c in info['children'].values():
+        if 'children' in c:
+            next_lba = alloc_files(c, next_lba)
+        else:
+            c['lba'] = next_lba
+            next_lba += max((c['size'] + SECTOR - 1) // SECTOR, 1)
+    return next_lba
+
+
+def write_dir(data, info, parent):
+    recs = [record(b'\0', info['lba'], info['secs'] * SECTOR, True),
+            record(b'\1', parent['lba'], parent['secs'] * SECTOR, True)]
+    for name in sorted(info['children']):
+        c = info['children'][name]
+        if 'children' in c:
+            recs.append(record(name, c['lba'], c['secs'] * SECTOR, True))
+        else:
+            recs.append(record(name + ';1', c['lba'], c['size'], False))
+
+    off, used = info['lba'] * SECTOR, 0
+    for r in recs:
+        if used + len(r) > SECTOR:
+            off, used = off + SECTOR - used, 0
+        data[off:off + len(r)] = r
+        off += len(r)
+        used += len(r)
+
+    for c in info['children'].values():
+        if 'children' in c:
+            write_dir(data, c, info)
+        else:
+            data[c['lba'] * SECTOR:c['lba'] * SECTOR + 4] = struct.pack('<I', c['lba'])
+
+
+def main():
+    sounds = int(sys.argv[2]) if len(sys.argv) > 2 else 120
+    tree = {
+        'DATA': dict({'SUB': {'X.BIN': 100}}, **{'F%03d.DAT' % i: 3000 + i for i in range(50)}),
+        'SOUND': {'S%03d.ADP' % i: 5000 for i in range(sounds)},
+        'BOOT.ELF': 777,
+    }
+
+    root = layout(tree)
+    total = alloc_files(root, alloc_dirs(root, 20))
+    data = bytearray(total * SECTOR)
+    write_dir(data, root, root)
+
+    pvd = bytearray(SECTOR)
+    pvd[0] = 1
+    pvd[1:6] = b'CD001'
+    pvd[6] = 1
+    pvd[80:88] = both32(total)
+    pvd[156:190] = record(b'\0', root['lba'], root['secs'] * SECTOR, True)
+    data[16 * SECTOR:17 * SECTOR] = pvd
+
+    term = bytearray(SECTOR)
+    term[0] = 255
+    term[1:6] = b'CD001'
+    data[17 * SECTOR:18 * SECTOR] = term
+
+    with open(sys.argv[1], 'wb') as f:
+        f.write(data)
+
+
+if __name__ == '__main__':
+    main()
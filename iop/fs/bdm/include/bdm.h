@@ -51,6 +51,24 @@ struct file_system {
     void (*disconnect_bd)(struct block_device* bd);
 };
 
+/** Statistics of the BDM cache layer of a physical device (and its partitions). */
+struct bdm_cache_stats {
+    /** Read calls received from the file system. */
+    u32 read_requests;
+    /** Read calls served entirely from the read-ahead buffer. */
+    u32 read_hits;
+    /** Read calls issued to the device. */
+    u32 dev_reads;
+    /** Sectors read ahead of the requested range. */
+    u32 readahead_sectors;
+    /** Write calls received from the file system. */
+    u32 write_requests;
+    /** Write calls merged into a pending write. */
+    u32 write_merged;
+    /** Write calls issued to the device. */
+    u32 dev_writes;
+};
+
 typedef void (*bdm_cb)(int event);
 
 // Exported functions
@@ -60,6 +78,8 @@ void bdm_connect_fs(struct file_system* fs);
 void bdm_disconnect_fs(struct file_system* fs);
 void bdm_get_bd(struct block_device** pbd, unsigned int count);
 void bdm_RegisterCallback(bdm_cb cb);
+/** Returns 0 and fills in stats if the device is cached, -1 otherwise. */
+int bdm_get_cache_stats(struct block_device* bd, struct bdm_cache_stats* stats);
 
 #define bdm_IMPORTS_start DECLARE_IMPORT_TABLE(bdm, 1, 0)
 #define bdm_IMPORTS_end END_IMPORT_TABLE
@@ -70,5 +90,6 @@ void bdm_RegisterCallback(bdm_cb cb);
 #define I_bdm_disconnect_fs DECLARE_IMPORT(7, bdm_disconnect_fs)
 #define I_bdm_get_bd DECLARE_IMPORT(8, bdm_get_bd)
 #define I_bdm_RegisterCallback DECLARE_IMPORT(9, bdm_RegisterCallback)
+#define I_bdm_get_cache_stats DECLARE_IMPORT(10, bdm_get_cache_stats)
 
 #endif
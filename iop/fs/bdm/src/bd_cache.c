@@ -0,0 +1,340 @@
+#include <bdm.h>
+#include <intrman.h>
+#include <stdio.h>
+#include <sysclib.h>
+#include <sysmem.h>
+#include <thsemap.h>
+
+//#define DEBUG  //comment out this line when not debugging
+#include "module_debug.h"
+
+/*  Block device cache layer.
+    Sits between a physical block device and the file system (or partition driver) mounted on it.
+    - Sequential reads are detected per device and serviced with one larger read into a read-ahead buffer.
+    - Adjacent writes are collected into a write-behind buffer and written to the device with a single call.
+      Pending writes are written back on flush(), stop(), before a read of the same sectors and before any
+      non-adjacent write. A write error on the delayed write-back is returned by the call that triggered it.
+    The cache is off unless a buffer size in KB is given to bd_cache_init() (the "cache=" module argument). Each cached
+    device uses two buffers of that size. Devices for which they can't be allocated are used directly. */
+
+#define BD_CACHE_BUFFER_MAX (256 * 1024) // largest size of each of the read-ahead and write-behind buffers
+#define MAX_CACHED_DEVICES  4
+
+struct bd_cache {
+    struct block_device* bd; // underlying device, NULL if unused
+    int sema;
+
+    u8* rbuf;        // read-ahead buffer
+    u32 rsector;     // first sector in the read-ahead buffer
+    u16 rcount;      // number of valid sectors in the read-ahead buffer, 0 if empty
+    u32 nextSector;  // sector following the last read, for detecting sequential access
+
+    u8* wbuf;        // write-behind buffer
+    u32 wsector;     // first sector in the write-behind buffer
+    u16 wcount;      // number of pending sectors, 0 if none
+
+    u16 bufSectors;  // capacity of each buffer, in sectors
+
+    struct bdm_cache_stats stats;
+};
+
+static struct bd_cache g_cache[MAX_CACHED_DEVICES];
+static struct block_device g_cache_bd[MAX_CACHED_DEVICES];
+static u32 g_cache_buffer_size = 0; // size of each of the read-ahead and write-behind buffers, 0 if the cache is off
+
+static void* bd_cache_alloc(int size)
+{
+    void* result;
+    int OldState;
+
+    CpuSuspendIntr(&OldState);
+    result = AllocSysMemory(ALLOC_FIRST, size, NULL);
+    CpuResumeIntr(OldState);
+
+    return result;
+}
+
+static void bd_cache_free(void* ptr)
+{
+    int OldState;
+
+    CpuSuspendIntr(&OldState);
+    FreeSysMemory(ptr);
+    CpuResumeIntr(OldState);
+}
+
+//---------------------------------------------------------------------------
+static int bd_cache_writeback(struct bd_cache* c)
+{
+    int ret;
+
+    if (c->wcount == 0)
+        return 0;
+
+    M_DEBUG("%s: sector=%u, count=%u\n", __func__, c->wsector, c->wcount);
+
+    c->stats.dev_writes++;
+    ret       = c->bd->write(c->bd, c->wsector, c->wbuf, c->wcount);
+    c->wcount = 0;
+
+    return (ret < 0) ? ret : 0;
+}
+
+static inline int bd_cache_overlaps(u32 start1, u32 count1, u32 start2, u32 count2)
+{
+    return (start1 < start2 + count2) && (start2 < start1 + count1);
+}
+
+//
+// Block device interface
+//
+static int bd_cache_read(struct block_device* bd, u32 sector, void* buffer, u16 count)
+{
+    struct bd_cache* c = (struct bd_cache*)bd->priv;
+    u32 end;
+    u16 n;
+    int ret;
+
+    M_DEBUG("%s: sector=%u, count=%u\n", __func__, sector, count);
+
+    if ((c == NULL) || (c->bd == NULL))
+        return -1;
+
+    WaitSema(c->sema);
+    c->stats.read_requests++;
+
+    // Pending writes to these sectors must reach the device first.
+    if (c->wcount > 0 && bd_cache_overlaps(sector, count, c->wsector, c->wcount)) {
+        if ((ret = bd_cache_writeback(c)) < 0) {
+            SignalSema(c->sema);
+            return ret;
+        }
+    }
+
+    if (c->rcount > 0 && sector >= c->rsector && sector + count <= c->rsector + c->rcount) {
+        // Entirely within the read-ahead buffer.
+        memcpy(buffer, c->rbuf + (sector - c->rsector) * bd->sectorSize, count * bd->sectorSize);
+        c->stats.read_hits++;
+        ret = count;
+    } else if (sector == c->nextSector && count < c->bufSectors) {
+        // Sequential access: read a full buffer ahead of the consumer.
+        end = bd->sectorOffset + bd->sectorCount;
+        n   = (end - sector < c->bufSectors) ? end - sector : c->bufSectors;
+        if (n < count)
+            n = count;
+
+        // The same goes for the sectors that are read ahead of the request.
+        if (c->wcount > 0 && bd_cache_overlaps(sector, n, c->wsector, c->wcount)) {
+            if ((ret = bd_cache_writeback(c)) < 0) {
+                SignalSema(c->sema);
+                return ret;
+            }
+        }
+
+        c->stats.dev_reads++;
+        ret = c->bd->read(c->bd, sector, c->rbuf, n);
+        if (ret >= 0) {
+            c->rsector = sector;
+            c->rcount  = n;
+            c->stats.readahead_sectors += n - count;
+            memcpy(buffer, c->rbuf, count * bd->sectorSize);
+            ret = count;
+        } else
+            c->rcount = 0;
+    } else {
+        c->stats.dev_reads++;
+        ret = c->bd->read(c->bd, sector, buffer, count);
+    }
+
+    c->nextSector = sector + count;
+    SignalSema(c->sema);
+
+    return ret;
+}
+
+static int bd_cache_write(struct block_device* bd, u32 sector, const void* buffer, u16 count)
+{
+    struct bd_cache* c = (struct bd_cache*)bd->priv;
+    int ret;
+
+    M_DEBUG("%s: sector=%u, count=%u\n", __func__, sector, count);
+
+    if ((c == NULL) || (c->bd == NULL))
+        return -1;
+
+    WaitSema(c->sema);
+    c->stats.write_requests++;
+
+    // Drop stale read-ahead data.
+    if (c->rcount > 0 && bd_cache_overlaps(sector, count, c->rsector, c->rcount))
+        c->rcount = 0;
+
+    if (c->wcount > 0 && sector == c->wsector + c->wcount && c->wcount + count <= c->bufSectors) {
+        // Adjacent to the pending write: merge.
+        memcpy(c->wbuf + c->wcount * bd->sectorSize, buffer, count * bd->sectorSize);
+        c->wcount += count;
+        c->stats.write_merged++;
+        ret = count;
+    } else if ((ret = bd_cache_writeback(c)) >= 0) {
+        if (count < c->bufSectors) {
+            memcpy(c->wbuf, buffer, count * bd->sectorSize);
+            c->wsector = sector;
+            c->wcount  = count;
+            ret        = count;
+        } else {
+            c->stats.dev_writes++;
+            ret = c->bd->write(c->bd, sector, buffer, count);
+        }
+    }
+
+    SignalSema(c->sema);
+
+    return ret;
+}
+
+static void bd_cache_flush(struct block_device* bd)
+{
+    struct bd_cache* c = (struct bd_cache*)bd->priv;
+
+    M_DEBUG("%s\n", __func__);
+
+    if ((c == NULL) || (c->bd == NULL))
+        return;
+
+    WaitSema(c->sema);
+    bd_cache_writeback(c);
+    SignalSema(c->sema);
+
+    c->bd->flush(c->bd);
+}
+
+static int bd_cache_stop(struct block_device* bd)
+{
+    struct bd_cache* c = (struct bd_cache*)bd->priv;
+
+    M_DEBUG("%s\n", __func__);
+
+    if ((c == NULL) || (c->bd == NULL))
+        return -1;
+
+    WaitSema(c->sema);
+    bd_cache_writeback(c);
+    SignalSema(c->sema);
+
+    return (c->bd->stop != NULL) ? c->bd->stop(c->bd) : 0;
+}
+
+//---------------------------------------------------------------------------
+struct block_device* bd_cache_create(struct block_device* bd)
+{
+    struct bd_cache* c;
+    struct block_device* cbd;
+    iop_sema_t sema;
+    int i;
+
+    M_DEBUG("%s\n", __func__);
+
+    // Partitions are read through the cache of the device that they are on.
+    if (bd->parNr != 0 || g_cache_buffer_size / bd->sectorSize < 2)
+        return bd;
+
+    for (i = 0; i < MAX_CACHED_DEVICES; ++i) {
+        if (g_cache[i].bd == NULL)
+            break;
+    }
+
+    if (i == MAX_CACHED_DEVICES) {
+        M_DEBUG("no free cache for %s%d, using device directly\n", bd->name, bd->devNr);
+        return bd;
+    }
+
+    c   = &g_cache[i];
+    cbd = &g_cache_bd[i];
+
+    sema.attr    = 0;
+    sema.option  = 0;
+    sema.initial = 1;
+    sema.max     = 1;
+    if ((c->sema = CreateSema(&sema)) < 0)
+        return bd;
+
+    if ((c->rbuf = bd_cache_alloc(g_cache_buffer_size * 2)) == NULL) {
+        M_PRINTF("unable to allocate cache for %s%d, using device directly\n", bd->name, bd->devNr);
+        DeleteSema(c->sema);
+        return bd;
+    }
+    c->wbuf = c->rbuf + g_cache_buffer_size;
+
+    c->bd         = bd;
+    c->rcount     = 0;
+    c->wcount     = 0;
+    c->nextSector = 0xFFFFFFFF;
+    c->bufSectors = g_cache_buffer_size / bd->sectorSize;
+    memset(&c->stats, 0, sizeof(c->stats));
+
+    cbd->priv         = c;
+    cbd->name         = bd->name;
+    cbd->devNr        = bd->devNr;
+    cbd->parNr        = bd->parNr;
+    cbd->sectorSize   = bd->sectorSize;
+    cbd->sectorOffset = bd->sectorOffset;
+    cbd->sectorCount  = bd->sectorCount;
+    cbd->read         = bd_cache_read;
+    cbd->write        = bd_cache_write;
+    cbd->flush        = bd_cache_flush;
+    cbd->stop         = bd_cache_stop;
+
+    return cbd;
+}
+
+/*  Called after the device was disconnected, so pending writes cannot be written back anymore. */
+void bd_cache_destroy(struct block_device* cbd)
+{
+    struct bd_cache* c = (struct bd_cache*)cbd->priv;
+
+    M_DEBUG("%s\n", __func__);
+
+    if (cbd < &g_cache_bd[0] || cbd >= &g_cache_bd[MAX_CACHED_DEVICES] || c->bd == NULL)
+        return;
+
+    if (c->wcount > 0)
+        M_PRINTF("%s%d: %u unwritten sectors lost\n", cbd->name, cbd->devNr, c->wcount);
+
+    bd_cache_free(c->rbuf);
+    DeleteSema(c->sema);
+    c->bd = NULL;
+}
+
+int bdm_get_cache_stats(struct block_device* bd, struct bdm_cache_stats* stats)
+{
+    struct bd_cache* c;
+    int i;
+
+    for (i = 0; i < MAX_CACHED_DEVICES; ++i) {
+        c = &g_cache[i];
+        // Also matches the partitions of the cached device.
+        if (c->bd != NULL && c->bd->name == bd->name && c->bd->devNr == bd->devNr) {
+            memcpy(stats, &c->stats, sizeof(*stats));
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void bd_cache_init(int buffer_kb)
+{
+    int i;
+
+    M_DEBUG("%s: buffer_kb=%d\n", __func__, buffer_kb);
+
+    if (buffer_kb <= 0)
+        g_cache_buffer_size = 0;
+    else if (buffer_kb > BD_CACHE_BUFFER_MAX / 1024)
+        g_cache_buffer_size = BD_CACHE_BUFFER_MAX;
+    else
+        g_cache_buffer_size = buffer_kb * 1024;
+
+    for (i = 0; i < MAX_CACHED_DEVICES; ++i)
+        g_cache[i].bd = NULL;
+}
@@ -7,7 +7,8 @@
 #include "module_debug.h"
 
 struct bdm_mounts {
-    struct block_device* bd;
+    struct block_device* bd;  // device as connected by the driver
+    struct block_device* cbd; // device as presented to file systems, possibly through the cache layer
     struct file_system* fs;
 };
 
@@ -23,6 +24,9 @@ static int bdm_thread_id = -1;
 #define BDM_EVENT_CB_UMOUNT 0x02
 #define BDM_EVENT_MOUNT 0x04
 
+extern struct block_device* bd_cache_create(struct block_device* bd);
+extern void bd_cache_destroy(struct block_device* cbd);
+
 void bdm_RegisterCallback(bdm_cb cb)
 {
     int i;
@@ -51,7 +55,8 @@ void bdm_connect_bd(struct block_device* bd)
 
     for (i = 0; i < MAX_CONNECTIONS; ++i) {
         if (g_mount[i].bd == NULL) {
-            g_mount[i].bd = bd;
+            g_mount[i].bd  = bd;
+            g_mount[i].cbd = bd_cache_create(bd);
             // New block device, try to mount it to a filesystem
             SetEventFlag(bdm_event, BDM_EVENT_MOUNT);
             break;
@@ -67,10 +72,13 @@ void bdm_disconnect_bd(struct block_device* bd)
 
     for (i = 0; i < MAX_CONNECTIONS; ++i) {
         if (g_mount[i].bd == bd) {
-            g_mount[i].fs->disconnect_bd(bd);
+            g_mount[i].fs->disconnect_bd(g_mount[i].cbd);
             M_PRINTF("%s%dp%d unmounted from %s\n", bd->name, bd->devNr, bd->parNr, g_mount[i].fs->name);
-            g_mount[i].bd = NULL;
-            g_mount[i].fs = NULL;
+            if (g_mount[i].cbd != bd)
+                bd_cache_destroy(g_mount[i].cbd);
+            g_mount[i].bd  = NULL;
+            g_mount[i].cbd = NULL;
+            g_mount[i].fs  = NULL;
             if (g_cb != NULL)
                 SetEventFlag(bdm_event, BDM_EVENT_CB_UMOUNT);
         }
@@ -126,7 +134,7 @@ void bdm_get_bd(struct block_device** pbd, unsigned int count)
 
     // Fill pointer array with block device pointers
     for (i = 0; i < count && i < MAX_CONNECTIONS; i++)
-        pbd[i] = g_mount[i].bd;
+        pbd[i] = g_mount[i].cbd;
 }
 
 static void bdm_try_mount(struct bdm_mounts* mount)
@@ -137,7 +145,7 @@ static void bdm_try_mount(struct bdm_mounts* mount)
 
     for (i = 0; i < MAX_CONNECTIONS; ++i) {
         if (g_fs[i] != NULL) {
-            if (g_fs[i]->connect_bd(mount->bd) == 0) {
+            if (g_fs[i]->connect_bd(mount->cbd) == 0) {
                 M_PRINTF("%s%dp%d mounted to %s\n", mount->bd->name, mount->bd->devNr, mount->bd->parNr, g_fs[i]->name);
                 mount->fs = g_fs[i];
                 if (g_cb != NULL)
@@ -189,9 +197,10 @@ int bdm_init()
     M_DEBUG("%s\n", __func__);
 
     for (i = 0; i < MAX_CONNECTIONS; ++i) {
-        g_mount[i].bd = NULL;
-        g_mount[i].fs = NULL;
-        g_fs[i]       = NULL;
+        g_mount[i].bd  = NULL;
+        g_mount[i].cbd = NULL;
+        g_mount[i].fs  = NULL;
+        g_fs[i]        = NULL;
     }
 
     EventFlagData.attr   = 0;
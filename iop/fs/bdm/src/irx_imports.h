@@ -17,9 +17,13 @@
 
 /* Please keep these in alphabetical order!  */
 #include <bdm.h>
+#include <intrman.h>
 #include <loadcore.h>
 #include <stdio.h>
+#include <sysclib.h>
+#include <sysmem.h>
 #include <thbase.h>
 #include <thevent.h>
+#include <thsemap.h>
 
 #endif /* IOP_IRX_IMPORTS_H */
@@ -2,21 +2,26 @@
 #include <irx.h>
 #include <loadcore.h>
 #include <stdio.h>
+#include <sysclib.h>
 
 //#define DEBUG  //comment out this line when not debugging
 #include "module_debug.h"
 
 #define MAJOR_VER 1
-#define MINOR_VER 1
+#define MINOR_VER 2
 
 IRX_ID("bdm", MAJOR_VER, MINOR_VER);
 
 extern struct irx_export_table _exp_bdm;
 extern int bdm_init();
+extern void bd_cache_init(int buffer_kb);
 extern void part_init();
 
 int _start(int argc, char* argv[])
 {
+    int cache_kb = 0;
+    int i;
+
     printf("Block Device Manager (BDM) v%d.%d\n", MAJOR_VER, MINOR_VER);
 
     if (RegisterLibraryEntries(&_exp_bdm) != 0) {
@@ -24,6 +29,15 @@ int _start(int argc, char* argv[])
         return MODULE_NO_RESIDENT_END;
     }
 
+    // "cache=<KB>" turns on the block device cache layer, with read-ahead and write-behind buffers of that size
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "cache=", 6) == 0)
+            cache_kb = strtol(&argv[i][6], NULL, 10);
+    }
+
+    // initialize the block device cache layer, it is off by default
+    bd_cache_init(cache_kb);
+
     // initialize the block device manager
     if (bdm_init() < 0) {
         M_PRINTF("ERROR: BDM init failed!\n");
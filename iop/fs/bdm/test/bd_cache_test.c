@@ -0,0 +1,256 @@
+/*
+ * Host test and benchmark of the BDM cache layer (bd_cache.c).
+ *
+ * The cache is put on top of a RAM disk. A random mix of sequential and random
+ * reads and writes, with flushes in between, runs in a small area of the disk
+ * so that the read-ahead and write-behind buffers overlap often. Every read is
+ * checked against a shadow copy of the disk, and the disk must match the shadow
+ * copy after the final flush. The statistics must count every call.
+ *
+ * The RAM disk also models a USB mass storage device: each call costs 1ms and
+ * the data moves at 20MB/s. Streaming 16MB in 4KB requests is then timed
+ * without the cache and with buffers of 16KB to 256KB.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   gcc -O2 -Wall -Iiop/fs/bdm/test/host -Iiop/fs/bdm/include -Iiop/fs/bdm/src/include \
+ *       iop/fs/bdm/test/bd_cache_test.c iop/fs/bdm/src/bd_cache.c -o bd_cache_test
+ *   ./bd_cache_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bdm.h>
+
+#define SECTOR_SIZE   512
+#define DISK_SECTORS  (64 * 1024) // 32MB
+#define AREA_SECTORS  2048        // area of the random workload
+#define OPERATIONS    200000
+#define STREAM_BYTES  (16 * 1024 * 1024)
+#define STREAM_COUNT  8           // 4KB requests
+
+#define CALL_COST     1e-3
+#define BYTES_PER_SEC 20e6
+
+extern struct block_device* bd_cache_create(struct block_device* bd);
+extern void bd_cache_destroy(struct block_device* cbd);
+extern void bd_cache_init(int buffer_kb);
+
+static u8 *disk, *shadow;
+static unsigned int devReads, devWrites, devFlushes;
+static double devTime;
+static int errors;
+
+static void error(const char* what, u32 sector, u16 count)
+{
+    if (errors++ < 10)
+        printf("error: %s, sector %u, count %u\n", what, sector, count);
+}
+
+//---------------------------------------------------------------------------
+static int ram_read(struct block_device* bd, u32 sector, void* buffer, u16 count)
+{
+    if (count == 0 || sector + count > DISK_SECTORS) {
+        error("device read out of range", sector, count);
+        return -1;
+    }
+
+    memcpy(buffer, disk + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+    devReads++;
+    devTime += CALL_COST + count * SECTOR_SIZE / BYTES_PER_SEC;
+    return count;
+}
+
+static int ram_write(struct block_device* bd, u32 sector, const void* buffer, u16 count)
+{
+    if (count == 0 || sector + count > DISK_SECTORS) {
+        error("device write out of range", sector, count);
+        return -1;
+    }
+
+    memcpy(disk + sector * SECTOR_SIZE, buffer, count * SECTOR_SIZE);
+    devWrites++;
+    devTime += CALL_COST + count * SECTOR_SIZE / BYTES_PER_SEC;
+    return count;
+}
+
+static void ram_flush(struct block_device* bd)
+{
+    devFlushes++;
+}
+
+static int ram_stop(struct block_device* bd)
+{
+    return 0;
+}
+
+static struct block_device ram = {
+    NULL, "ram", 0, 0, SECTOR_SIZE, 0, DISK_SECTORS, ram_read, ram_write, ram_flush, ram_stop};
+
+//---------------------------------------------------------------------------
+static void check_read(struct block_device* bd, u32 sector, u16 count)
+{
+    static u8 buffer[256 * SECTOR_SIZE];
+
+    if (bd->read(bd, sector, buffer, count) != count)
+        error("read failed", sector, count);
+    else if (memcmp(buffer, shadow + sector * SECTOR_SIZE, count * SECTOR_SIZE) != 0)
+        error("read returned the wrong data", sector, count);
+}
+
+static void do_write(struct block_device* bd, u32 sector, u16 count, u32 stamp)
+{
+    u8* data = shadow + sector * SECTOR_SIZE;
+    u16 i;
+
+    for (i = 0; i < count; i++)
+        memcpy(data + i * SECTOR_SIZE, &stamp, sizeof(stamp));
+
+    if (bd->write(bd, sector, data, count) != count)
+        error("write failed", sector, count);
+}
+
+/*  One read stream and one write stream run through the area, mixed with random reads and writes.
+    The streams restart at random places, so that reads catch up with pending writes and writes
+    land in the read-ahead buffer.  */
+static void random_workload(int buffer_kb)
+{
+    struct block_device* bd;
+    struct bdm_cache_stats stats;
+    u32 readPos = 0, writePos = 0, sector, reads = 0, writes = 0;
+    u16 count;
+    int i;
+
+    memcpy(shadow, disk, DISK_SECTORS * SECTOR_SIZE);
+    bd_cache_init(buffer_kb);
+    if ((bd = bd_cache_create(&ram)) == &ram) {
+        error("the cache wasn't created", 0, buffer_kb);
+        return;
+    }
+
+    for (i = 0; i < OPERATIONS; i++) {
+        count = 1 + rand() % 16;
+        switch (rand() % 8) {
+            case 0:
+            case 1:
+            case 2:
+                if (readPos + count > AREA_SECTORS || rand() % 50 == 0)
+                    readPos = rand() % (AREA_SECTORS - count);
+                check_read(bd, readPos, count);
+                readPos += count;
+                reads++;
+                break;
+            case 3:
+            case 4:
+                if (writePos + count > AREA_SECTORS || rand() % 50 == 0)
+                    writePos = rand() % (AREA_SECTORS - count);
+                do_write(bd, writePos, count, i);
+                writePos += count;
+                writes++;
+                break;
+            case 5:
+                check_read(bd, rand() % (AREA_SECTORS - count), count);
+                reads++;
+                break;
+            case 6:
+                do_write(bd, rand() % (AREA_SECTORS - count), count, i);
+                writes++;
+                break;
+            default:
+                // Requests larger than the buffers bypass them.
+                count  = (rand() % 2) ? 255 : count;
+                sector = rand() % (AREA_SECTORS - count);
+                if (rand() % 2) {
+                    check_read(bd, sector, count);
+                    reads++;
+                } else {
+                    do_write(bd, sector, count, i);
+                    writes++;
+                }
+                break;
+        }
+
+        if (rand() % 1000 == 0)
+            bd->flush(bd);
+    }
+
+    bd->flush(bd);
+    if (memcmp(disk, shadow, DISK_SECTORS * SECTOR_SIZE) != 0)
+        error("the disk doesn't match after the flush", 0, 0);
+
+    if (bdm_get_cache_stats(&ram, &stats) != 0)
+        error("no statistics for the cached device", 0, 0);
+    else {
+        if (stats.read_requests != reads || stats.write_requests != writes)
+            error("the statistics don't count every call", 0, 0);
+        if (stats.dev_reads != devReads || stats.dev_writes != devWrites)
+            error("the statistics don't count every device call", 0, 0);
+        printf("%3dKB buffers: %u reads, %u hits, %u device reads, %u writes, %u merged, %u device writes\n",
+               buffer_kb, stats.read_requests, stats.read_hits, stats.dev_reads, stats.write_requests,
+               stats.write_merged, stats.dev_writes);
+    }
+
+    bd_cache_destroy(bd);
+}
+
+static void stream(int buffer_kb)
+{
+    struct block_device* bd;
+    static u8 buffer[STREAM_COUNT * SECTOR_SIZE];
+    double readTime;
+    u32 sector;
+
+    bd_cache_init(buffer_kb);
+    bd       = bd_cache_create(&ram);
+    devReads = devWrites = 0;
+    devTime  = 0;
+
+    for (sector = 0; sector < STREAM_BYTES / SECTOR_SIZE; sector += STREAM_COUNT) {
+        if (bd->read(bd, sector, buffer, STREAM_COUNT) != STREAM_COUNT ||
+            memcmp(buffer, disk + sector * SECTOR_SIZE, sizeof(buffer)) != 0)
+            error("stream read returned the wrong data", sector, STREAM_COUNT);
+    }
+    readTime = devTime;
+
+    devTime = 0;
+    for (sector = 0; sector < STREAM_BYTES / SECTOR_SIZE; sector += STREAM_COUNT)
+        bd->write(bd, sector, disk + sector * SECTOR_SIZE, STREAM_COUNT);
+    bd->flush(bd);
+
+    printf("%3dKB buffers: read %5u calls %5.1fMB/s, write %5u calls %5.1fMB/s\n", buffer_kb, devReads,
+           STREAM_BYTES / 1e6 / readTime, devWrites, STREAM_BYTES / 1e6 / devTime);
+
+    if (bd != &ram)
+        bd_cache_destroy(bd);
+}
+
+int main(void)
+{
+    static const int sizes[] = {16, 64, 256};
+    unsigned int i;
+
+    disk   = malloc(DISK_SECTORS * SECTOR_SIZE);
+    shadow = malloc(DISK_SECTORS * SECTOR_SIZE);
+    if (disk == NULL || shadow == NULL)
+        return 1;
+
+    srand(7);
+    for (i = 0; i < DISK_SECTORS * SECTOR_SIZE; i++)
+        disk[i] = rand();
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        devReads = devWrites = 0;
+        random_workload(sizes[i]);
+    }
+
+    stream(0);
+    stream(16);
+    stream(64);
+    stream(128);
+    stream(256);
+
+    printf(errors ? "FAIL\n" : "OK\n");
+
+    return (errors ? 1 : 0);
+}
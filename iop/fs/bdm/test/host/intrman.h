@@ -0,0 +1,8 @@
+/* Host stand-in for the IOP intrman.h: there are no interrupts to disable. */
+#ifndef __INTRMAN_H__
+#define __INTRMAN_H__
+
+static inline int CpuSuspendIntr(int *state) { *state = 0; return 0; }
+static inline int CpuResumeIntr(int state) { return 0; }
+
+#endif
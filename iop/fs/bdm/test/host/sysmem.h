@@ -0,0 +1,12 @@
+/* Host stand-in for the IOP sysmem.h, backed by malloc(). */
+#ifndef __SYSMEM_H__
+#define __SYSMEM_H__
+
+#include <stdlib.h>
+
+#define ALLOC_FIRST 0
+
+static inline void *AllocSysMemory(int mode, int size, void *ptr) { return malloc(size); }
+static inline int FreeSysMemory(void *ptr) { free(ptr); return 0; }
+
+#endif
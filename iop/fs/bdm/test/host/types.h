@@ -0,0 +1,7 @@
+/* Host stand-in for the IOP types.h. */
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
@@ -19,6 +19,11 @@
 #define NUM_DRIVES 10
 static fat_driver* g_fatd[NUM_DRIVES];
 
+static fat_extent_map g_extentMaps[FAT_EXTENT_MAPS];
+
+//maximum number of sectors to read from the device with a single call
+#define FAT_MAX_READ_SECTORS 0x8000
+
 //---------------------------------------------------------------------------
 int InitFAT(void)
 {
@@ -29,6 +34,12 @@ int InitFAT(void)
     for (i = 0; i < NUM_DRIVES; ++i)
         g_fatd[i] = NULL;
 
+    for (i = 0; i < FAT_EXTENT_MAPS; ++i) {
+        g_extentMaps[i].fatd         = NULL;
+        g_extentMaps[i].startCluster = 0;
+        g_extentMaps[i].refCount     = 0;
+    }
+
     return 0;
 }
 
@@ -258,7 +269,130 @@ int fat_getClusterChain(fat_driver* fatd, unsigned int cluster, unsigned int* bu
 //---------------------------------------------------------------------------
 void fat_invalidateLastChainResult(fat_driver* fatd)
 {
+    int i;
+
     fatd->lastChainCluster = 0;
+
+    //The FAT was modified, so the extent maps of this partition have to be rebuilt.
+    for (i = 0; i < FAT_EXTENT_MAPS; i++) {
+        if (g_extentMaps[i].fatd == fatd)
+            g_extentMaps[i].state = FAT_EXTENT_MAP_STALE;
+    }
+}
+
+//---------------------------------------------------------------------------
+/* Returns the extent map of the file that starts at startCluster, for sharing between all handles to the file.
+   The map is only built on first use. Returns NULL if no map is available, in which case the FAT is walked instead. */
+fat_extent_map* fat_getExtentMap(fat_driver* fatd, unsigned int startCluster)
+{
+    fat_extent_map* map;
+    int i;
+
+    M_DEBUG("%s\n", __func__);
+
+    if (startCluster < 2)
+        return NULL;
+
+    map = NULL;
+    for (i = 0; i < FAT_EXTENT_MAPS; i++) {
+        if (g_extentMaps[i].fatd == fatd && g_extentMaps[i].startCluster == startCluster) {
+            map = &g_extentMaps[i];
+            break;
+        }
+        //Prefer an unused record, then any record that is not in use by an open file.
+        if (g_extentMaps[i].refCount == 0 && (map == NULL || g_extentMaps[i].startCluster == 0))
+            map = &g_extentMaps[i];
+    }
+
+    if (map == NULL)
+        return NULL;
+
+    if (map->fatd != fatd || map->startCluster != startCluster) {
+        map->fatd         = fatd;
+        map->startCluster = startCluster;
+        map->state        = FAT_EXTENT_MAP_STALE;
+    }
+    map->refCount++;
+
+    return map;
+}
+
+//---------------------------------------------------------------------------
+void fat_putExtentMap(fat_extent_map* map)
+{
+    if (map != NULL && map->refCount > 0)
+        map->refCount--;
+}
+
+//---------------------------------------------------------------------------
+static int fat_buildExtentMap(fat_driver* fatd, fat_extent_map* map)
+{
+    unsigned int i, cluster, fileCluster, clusterChainStart;
+    fat_extent* extent;
+    int chainSize;
+
+    M_DEBUG("%s\n", __func__);
+
+    //Do not reuse a chain that was memorized from a call with a different startFlag.
+    fatd->lastChainCluster = 0;
+
+    map->extentCount  = 0;
+    extent            = NULL;
+    cluster           = map->startCluster;
+    fileCluster       = 0;
+    clusterChainStart = 0;
+
+    do {
+        if ((chainSize = fat_getClusterChain(fatd, cluster, fatd->cbuf, MAX_DIR_CLUSTER, 1)) < 0) {
+            map->state = FAT_EXTENT_MAP_STALE;
+            return chainSize;
+        }
+
+        for (i = clusterChainStart; i < chainSize; i++, fileCluster++) {
+            if (extent != NULL && fatd->cbuf[i] == extent->cluster + extent->count) {
+                extent->count++;
+            } else {
+                if (map->extentCount >= FAT_MAX_EXTENTS) {
+                    M_DEBUG("extent map overflow, cluster %u\n", map->startCluster);
+                    map->state = FAT_EXTENT_MAP_OVERFLOW;
+                    return 0;
+                }
+                extent              = &map->extent[map->extentCount++];
+                extent->fileCluster = fileCluster;
+                extent->cluster     = fatd->cbuf[i];
+                extent->count       = 1;
+            }
+        }
+
+        //the chain is full, but more chain parts exist. The last cluster is returned again as the first record.
+        cluster           = fatd->cbuf[MAX_DIR_CLUSTER - 1];
+        clusterChainStart = 1;
+    } while (chainSize >= MAX_DIR_CLUSTER);
+
+    map->state = FAT_EXTENT_MAP_VALID;
+    return 0;
+}
+
+//---------------------------------------------------------------------------
+//Returns the extent that contains the specified cluster of the file, or NULL if the file is shorter.
+static fat_extent* fat_findExtent(fat_extent_map* map, unsigned int fileCluster)
+{
+    unsigned int low, high, mid;
+
+    low  = 0;
+    high = map->extentCount;
+    while (high - low > 1) {
+        mid = (low + high) / 2;
+        if (map->extent[mid].fileCluster <= fileCluster)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    if (map->extentCount == 0 || fileCluster >= map->extent[low].fileCluster + map->extent[low].count)
+        return NULL;
+
+    return &map->extent[low];
 }
 
 //---------------------------------------------------------------------------
@@ -596,6 +730,7 @@ static void fat_setFatDir(fat_driver* fatd, fat_dir* fatDir, unsigned int parent
 
     fatDir->parentDirCluster = parentDirCluster;
     fatDir->startCluster     = dir->cluster;
+    fatDir->extentMap        = NULL;
 }
 
 //---------------------------------------------------------------------------
@@ -771,6 +906,72 @@ void fat_getClusterAtFilePos(fat_driver* fatd, fat_dir* fatDir, unsigned int fil
     *clusterPos = (fatDir->chain[j].index * blockSize);
 }
 
+//---------------------------------------------------------------------------
+/* Reads through the extent map. Partial sectors, and any sector for a buffer that is not word-aligned, go through the sector cache,
+   while whole sectors within a run of contiguous clusters are read from the device with a single call. */
+static int fat_readFileExtents(fat_driver* fatd, fat_extent_map* map, unsigned int filePos, unsigned char* buffer, unsigned int size)
+{
+    unsigned int clusterBytes, sectorSize, runOffset, runBytes, sector, dataSkip, n;
+    unsigned int bufferPos;
+    fat_extent* extent;
+    int ret;
+
+    M_DEBUG("%s\n", __func__);
+
+    sectorSize   = fatd->partBpb.sectorSize;
+    clusterBytes = fatd->partBpb.clusterSize * sectorSize;
+    bufferPos    = 0;
+
+    while (size > 0) {
+        if ((extent = fat_findExtent(map, filePos / clusterBytes)) == NULL)
+            break;
+
+        runOffset = filePos - (extent->fileCluster * clusterBytes);
+        runBytes  = (extent->count * clusterBytes) - runOffset;
+        sector    = fat_cluster2sector(&fatd->partBpb, extent->cluster) + (runOffset / sectorSize);
+        dataSkip  = filePos % sectorSize;
+
+        if (dataSkip != 0 || size < sectorSize || ((u32)(buffer + bufferPos) & 3)) {
+            unsigned char* sbuf = NULL; //sector buffer
+
+            ret = READ_SECTOR(fatd, sector, sbuf);
+            if (ret < 0) {
+                M_DEBUG("Read sector failed ! sector=%u\n", sector);
+                return bufferPos;
+            }
+
+            n = sectorSize - dataSkip;
+            if (n > size)
+                n = size;
+            memcpy(buffer + bufferPos, sbuf + dataSkip, n);
+        } else {
+            n = (size < runBytes) ? size : runBytes;
+            n -= n % sectorSize;
+            if (n / sectorSize > FAT_MAX_READ_SECTORS)
+                n = FAT_MAX_READ_SECTORS * sectorSize;
+
+            //Dirty sectors must reach the device before reading around the sector cache.
+            ret = scache_flushRange(fatd->cache, sector, n / sectorSize);
+            if (ret < 0) {
+                M_DEBUG("Flush of sectors failed ! sector=%u count=%u\n", sector, n / sectorSize);
+                return bufferPos;
+            }
+
+            ret = fatd->bd->read(fatd->bd, sector, buffer + bufferPos, n / sectorSize);
+            if (ret < 0) {
+                M_DEBUG("Read sectors failed ! sector=%u count=%u\n", sector, n / sectorSize);
+                return bufferPos;
+            }
+        }
+
+        filePos += n;
+        bufferPos += n;
+        size -= n;
+    }
+
+    return bufferPos;
+}
+
 //---------------------------------------------------------------------------
 int fat_readFile(fat_driver* fatd, fat_dir* fatDir, unsigned int filePos, unsigned char* buffer, unsigned int size)
 {
@@ -782,6 +983,15 @@ int fat_readFile(fat_driver* fatd, fat_dir* fatDir, unsigned int filePos, unsign
 
     M_DEBUG("%s\n", __func__);
 
+    if (fatDir->extentMap != NULL) {
+        if (fatDir->extentMap->state == FAT_EXTENT_MAP_STALE && fat_buildExtentMap(fatd, fatDir->extentMap) < 0) {
+            //The FAT couldn't be read: stop using the map for this handle and walk the chain instead.
+            fat_putExtentMap(fatDir->extentMap);
+            fatDir->extentMap = NULL;
+        } else if (fatDir->extentMap->state == FAT_EXTENT_MAP_VALID)
+            return fat_readFileExtents(fatd, fatDir->extentMap, filePos, buffer, size);
+    }
+
     fat_getClusterAtFilePos(fatd, fatDir, filePos, &fileCluster, &clusterPos);
     sectorSkip  = (filePos - clusterPos) / fatd->partBpb.sectorSize;
     clusterSkip = sectorSkip / fatd->partBpb.clusterSize;
@@ -1015,12 +1225,19 @@ int fat_mount(struct block_device* bd)
 //---------------------------------------------------------------------------
 void fat_forceUnmount(struct block_device* bd)
 {
-    unsigned int i;
+    unsigned int i, j;
 
     M_DEBUG("%s\n", __func__);
 
     for (i = 0; i < NUM_DRIVES; ++i) {
         if (g_fatd[i] != NULL && g_fatd[i]->bd == bd) {
+            for (j = 0; j < FAT_EXTENT_MAPS; ++j) {
+                if (g_extentMaps[j].fatd == g_fatd[i]) {
+                    g_extentMaps[j].fatd         = NULL;
+                    g_extentMaps[j].startCluster = 0;
+                    g_extentMaps[j].refCount     = 0;
+                }
+            }
             scache_kill(g_fatd[i]->cache);
             free(g_fatd[i]);
             g_fatd[i] = NULL;
@@ -319,6 +319,8 @@ static int fs_open(iop_file_t* fd, const char* name, int flags, int mode)
         rec->filePos = rec->dirent.fatdir.size;
     }
 
+    rec->dirent.fatdir.extentMap = fat_getExtentMap(fatd, rec->dirent.fatdir.startCluster);
+
     //store the slot to user parameters
     fd->privdata = rec;
 
@@ -347,6 +349,9 @@ static int fs_close(iop_file_t* fd)
     rec->dirent.file_flag = -1;
     fd->privdata          = NULL;
 
+    fat_putExtentMap(rec->dirent.fatdir.extentMap);
+    rec->dirent.fatdir.extentMap = NULL;
+
     fatd = fat_getData(fd->unit);
     if (fatd == NULL) {
         _fs_unlock();
@@ -842,6 +847,7 @@ int fs_rename(iop_file_t *fd, const char *path, const char *newpath)
 
 static int fs_devctl(iop_file_t *fd, const char *name, int cmd, void *arg, unsigned int arglen, void *buf, unsigned int buflen)
 {
+    fat_driver* fatd;
     int ret;
 
     _fs_lock();
@@ -855,6 +861,34 @@ static int fs_devctl(iop_file_t *fd, const char *name, int cmd, void *arg, unsig
             fat_stopAll();
             ret = 0;
             break;
+        case USBMASS_DEVCTL_GET_CACHE_STATS:
+            fatd = fat_getData(fd->unit);
+            if (fatd == NULL)
+                ret = -ENODEV;
+            else if (buf == NULL || buflen < sizeof(struct usbmass_cache_stats))
+                ret = -EINVAL;
+            else {
+                scache_getStats(fatd->cache, buf);
+                ret = 0;
+            }
+            break;
+        case USBMASS_DEVCTL_RESET_CACHE_STATS:
+            fatd = fat_getData(fd->unit);
+            if (fatd != NULL) {
+                scache_resetStats(fatd->cache);
+                ret = 0;
+            } else
+                ret = -ENODEV;
+            break;
+        case USBMASS_DEVCTL_SET_CACHE_SIZE:
+            fatd = fat_getData(fd->unit);
+            if (fatd == NULL)
+                ret = -ENODEV;
+            else if (arg == NULL || arglen < sizeof(unsigned int))
+                ret = -EINVAL;
+            else
+                ret = scache_setSize(fatd->cache, *(unsigned int*)arg);
+            break;
         default:
             ret = -ENXIO;
     }
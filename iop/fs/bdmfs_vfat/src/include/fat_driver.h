@@ -26,6 +26,31 @@ typedef struct _fat_dir_chain_record {
     unsigned int index;
 } fat_dir_chain_record;
 
+struct _fat_driver;
+
+//Extent maps: the cluster chain of an open file, stored as runs of contiguous clusters.
+#define FAT_EXTENT_MAPS 8  //number of files that can have a map at the same time
+#define FAT_MAX_EXTENTS 64 //files with more fragments fall back to walking the FAT
+
+#define FAT_EXTENT_MAP_STALE    0 //not built yet, or the FAT was modified since
+#define FAT_EXTENT_MAP_VALID    1
+#define FAT_EXTENT_MAP_OVERFLOW 2 //too fragmented
+
+typedef struct _fat_extent {
+    unsigned int fileCluster; //index of the first cluster of the run, within the file
+    unsigned int cluster;     //first cluster of the run
+    unsigned int count;       //number of contiguous clusters
+} fat_extent;
+
+typedef struct _fat_extent_map {
+    struct _fat_driver* fatd;
+    unsigned int startCluster; //first cluster of the file, 0 if unused
+    unsigned int refCount;     //number of open handles
+    int state;
+    unsigned int extentCount;
+    fat_extent extent[FAT_MAX_EXTENTS];
+} fat_extent_map;
+
 typedef struct _fat_dir {
     unsigned char attr; //attributes (bits:5-Archive 4-Directory 3-Volume Label 2-System 1-Hidden 0-Read Only)
     char name[FAT_MAX_NAME];
@@ -41,6 +66,7 @@ typedef struct _fat_dir {
     //Stuff here are used for caching and might not be filled.
     unsigned int lastCluster;
     fat_dir_chain_record chain[DIR_CHAIN_SIZE]; //cluser/offset cache - for seeking purpose
+    fat_extent_map* extentMap;                  //shared extent map, only for open files. May be NULL.
 } fat_dir;
 
 typedef struct _fat_bpb {
@@ -97,6 +123,8 @@ int fat_mount(struct block_device* bd);
 void fat_forceUnmount(struct block_device* bd);
 void fat_setFatDirChain(fat_driver* fatd, fat_dir* fatDir);
 int fat_readFile(fat_driver* fatd, fat_dir* fatDir, unsigned int filePos, unsigned char* buffer, unsigned int size);
+fat_extent_map* fat_getExtentMap(fat_driver* fatd, unsigned int startCluster);
+void fat_putExtentMap(fat_extent_map* map);
 int fat_getFirstDirentry(fat_driver* fatd, const char* dirName, fat_dir_list* fatdlist, fat_dir* fatDir_host, fat_dir* fatDir);
 int fat_getNextDirentry(fat_driver* fatd, fat_dir_list* fatdlist, fat_dir* fatDir);
 
@@ -2,13 +2,17 @@
 #define _SCACHE_H
 
 #include <bdm.h>
+#include <usbhdfsd-common.h>
 
-//number of cache slots (1 slot = block)
+//default number of cache slots (1 slot = block)
 #define CACHE_SIZE 32
+//maximum number of cache slots, settable with USBMASS_DEVCTL_SET_CACHE_SIZE
+#define CACHE_SIZE_MAX 256
 
 typedef struct _cache_record {
     unsigned int sector;
-    int tax;
+    short hnext; //next slot in the same hash chain
+    char ref;    //referenced since the clock hand last passed
     char writeDirty;
 } cache_record;
 
@@ -16,14 +20,19 @@ typedef struct _cache_set {
     struct block_device* bd;
     unsigned int sectorSize;
     unsigned int indexLimit;
-    unsigned char* sectorBuf;     // = NULL;		//sector content - the cache buffer
-    cache_record rec[CACHE_SIZE]; //cache info record
+    unsigned char* sectorBuf; // = NULL;		//sector content - the cache buffer
+    cache_record* rec;        //cache info records
+    short* hash;              //hash chain heads, keyed by block number
+    unsigned int cacheSize;   //number of slots
+    unsigned int hashMask;
+    unsigned int clockHand; //next slot to be considered for replacement
 
-#ifdef SCACHE_RECORD_STATS
     //statistical information
     unsigned int cacheAccess;
     unsigned int cacheHits;
-#endif
+    unsigned int cacheEvictions;
+    unsigned int cacheWritebacks;
+
     unsigned int writeFlag;
 } cache_set;
 
@@ -34,7 +43,11 @@ void scache_kill(cache_set* cache); //dlanor: added for disconnection events (fl
 int scache_readSector(cache_set* cache, unsigned int sector, void** buf);
 int scache_writeSector(cache_set* cache, unsigned int sector);
 int scache_flushSectors(cache_set* cache);
+int scache_flushRange(cache_set* cache, unsigned int sector, unsigned int count);
+int scache_setSize(cache_set* cache, unsigned int size);
 
 void scache_getStat(cache_set* cache, unsigned int* access, unsigned int* hits);
+void scache_getStats(cache_set* cache, struct usbmass_cache_stats* stats);
+void scache_resetStats(cache_set* cache);
 
 #endif
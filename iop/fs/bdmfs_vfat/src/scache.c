@@ -9,6 +9,7 @@
  * See the file LICENSE included with this distribution for licensing terms.
  */
 //---------------------------------------------------------------------------
+#include <errno.h>
 #include <stdio.h>
 
 #ifdef WIN32
@@ -21,8 +22,6 @@
 #include <tamtypes.h>
 #endif
 
-//#define SCACHE_RECORD_STATS	1
-
 #include "common.h"
 #include "scache.h"
 
@@ -38,17 +37,61 @@
 //when the flushCounter reaches FLUSH_TRIGGER then flushSectors is called
 //#define FLUSH_TRIGGER 16
 
+#define SECTOR_INVALID 0xFFFFFFF0
+#define SLOT_NONE      -1
+
+//---------------------------------------------------------------------------
+static unsigned int getHash(cache_set* cache, unsigned int alignedSector)
+{
+    unsigned int block;
+
+    block = alignedSector / cache->indexLimit;
+    return (block ^ (block >> 8)) & cache->hashMask;
+}
+
+//---------------------------------------------------------------------------
+static void hashRemove(cache_set* cache, int index)
+{
+    short* link;
+
+    if (cache->rec[index].sector == SECTOR_INVALID)
+        return;
+
+    for (link = &cache->hash[getHash(cache, cache->rec[index].sector)]; *link != SLOT_NONE; link = &cache->rec[*link].hnext) {
+        if (*link == index) {
+            *link = cache->rec[index].hnext;
+            break;
+        }
+    }
+    cache->rec[index].hnext = SLOT_NONE;
+}
+
+//---------------------------------------------------------------------------
+static void hashInsert(cache_set* cache, int index)
+{
+    short* head;
+
+    head                    = &cache->hash[getHash(cache, cache->rec[index].sector)];
+    cache->rec[index].hnext = *head;
+    *head                   = index;
+}
+
 //---------------------------------------------------------------------------
 static void initRecords(cache_set* cache)
 {
     unsigned int i;
 
-    for (i = 0; i < CACHE_SIZE; i++) {
-        cache->rec[i].sector     = 0xFFFFFFF0;
-        cache->rec[i].tax        = 0;
+    for (i = 0; i < cache->cacheSize; i++) {
+        cache->rec[i].sector     = SECTOR_INVALID;
+        cache->rec[i].hnext      = SLOT_NONE;
+        cache->rec[i].ref        = 0;
         cache->rec[i].writeDirty = 0;
     }
 
+    for (i = 0; i <= cache->hashMask; i++)
+        cache->hash[i] = SLOT_NONE;
+
+    cache->clockHand = 0;
     cache->writeFlag = 0;
 }
 
@@ -58,10 +101,12 @@ static void initRecords(cache_set* cache)
  */
 static int getSlot(cache_set* cache, unsigned int sector)
 {
+    unsigned int alignedSector;
     int i;
 
-    for (i = 0; i < CACHE_SIZE; i++) {
-        if (sector >= cache->rec[i].sector && sector < (cache->rec[i].sector + cache->indexLimit)) {
+    alignedSector = (sector / cache->indexLimit) * cache->indexLimit;
+    for (i = cache->hash[getHash(cache, alignedSector)]; i != SLOT_NONE; i = cache->rec[i].hnext) {
+        if (cache->rec[i].sector == alignedSector) {
             return i;
         }
     }
@@ -72,38 +117,31 @@ static int getSlot(cache_set* cache, unsigned int sector)
 /* search cache records for the sector number stored in cache */
 static int getIndexRead(cache_set* cache, unsigned int sector)
 {
-    unsigned int i;
-    int index = -1;
-
-    for (i = 0; i < CACHE_SIZE; i++) {
-        if (sector >= cache->rec[i].sector && sector < (cache->rec[i].sector + cache->indexLimit)) {
-            if (cache->rec[i].tax < 0)
-                cache->rec[i].tax = 0;
-            cache->rec[i].tax += 2;
-            index = i;
-        }
-        if (cache->rec[i].tax > 1)
-            cache->rec[i].tax--; //apply tax penalty
-    }
+    int index;
+
+    index = getSlot(cache, sector);
     if (index < 0)
         return index;
-    else
-        return ((index * cache->indexLimit) + (sector - cache->rec[index].sector));
+
+    cache->rec[index].ref = 1;
+    return ((index * cache->indexLimit) + (sector - cache->rec[index].sector));
 }
 
 //---------------------------------------------------------------------------
-/* select the best record where to store new sector */
+/* select the best record where to store new sector (CLOCK replacement) */
 static int getIndexWrite(cache_set* cache, unsigned int sector)
 {
     int ret;
-    int minTax = 0x0FFFFFFF;
-    unsigned int i, index = 0;
+    unsigned int index;
 
-    for (i = 0; i < CACHE_SIZE; i++) {
-        if (cache->rec[i].tax < minTax) {
-            index  = i;
-            minTax = cache->rec[i].tax;
-        }
+    //Give every referenced slot a second chance. Terminates within two sweeps.
+    for (;;) {
+        index            = cache->clockHand;
+        cache->clockHand = (cache->clockHand + 1) % cache->cacheSize;
+
+        if (!cache->rec[index].ref)
+            break;
+        cache->rec[index].ref = 0;
     }
 
     //this sector is dirty - we need to flush it first
@@ -116,9 +154,17 @@ static int getIndexWrite(cache_set* cache, unsigned int sector)
         }
 
         cache->rec[index].writeDirty = 0;
+        cache->cacheWritebacks++;
+    }
+
+    if (cache->rec[index].sector != SECTOR_INVALID) {
+        cache->cacheEvictions++;
+        hashRemove(cache, index);
     }
-    cache->rec[index].tax += 2;
+
+    cache->rec[index].ref    = 1;
     cache->rec[index].sector = sector;
+    hashInsert(cache, index);
 
     return index * cache->indexLimit;
 }
@@ -140,7 +186,7 @@ int scache_flushSectors(cache_set* cache)
         return 0;
     }
 
-    for (i = 0; i < CACHE_SIZE; i++) {
+    for (i = 0; i < cache->cacheSize; i++) {
         if (cache->rec[i].writeDirty) {
             M_DEBUG("scache: flushSectors dirty index=%d sector=%u \n", i, cache->rec[i].sector);
             ret = WRITE_SECTOR(cache, cache->rec[i].sector, cache->sectorBuf + (i * BLOCK_SIZE), BLOCK_SIZE / cache->sectorSize);
@@ -150,10 +196,47 @@ int scache_flushSectors(cache_set* cache)
             }
 
             cache->rec[i].writeDirty = 0;
+            cache->cacheWritebacks++;
             counter++;
         }
     }
     cache->writeFlag = 0;
+
+    //let the block device write back anything that it has buffered
+    cache->bd->flush(cache->bd);
+    return counter;
+}
+
+//---------------------------------------------------------------------------
+/* Writes back the dirty blocks that overlap the given sectors, before they are read from the device directly.
+   Returns the number of blocks written, or a negative value on error. */
+int scache_flushRange(cache_set* cache, unsigned int sector, unsigned int count)
+{
+    unsigned int i;
+    int counter = 0, ret;
+
+    M_DEBUG("scache: flushRange sector=%u count=%u writeFlag=%d\n", sector, count, cache->writeFlag);
+
+    //no write operation occured since last flush
+    if (cache->writeFlag == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < cache->cacheSize; i++) {
+        if (cache->rec[i].writeDirty && cache->rec[i].sector < sector + count && sector < cache->rec[i].sector + cache->indexLimit) {
+            M_DEBUG("scache: flushRange dirty index=%d sector=%u \n", i, cache->rec[i].sector);
+            ret = WRITE_SECTOR(cache, cache->rec[i].sector, cache->sectorBuf + (i * BLOCK_SIZE), BLOCK_SIZE / cache->sectorSize);
+            if (ret < 0) {
+                M_PRINTF("scache: ERROR writing sector to disk! sector=%u\n", cache->rec[i].sector);
+                return ret;
+            }
+
+            cache->rec[i].writeDirty = 0;
+            cache->cacheWritebacks++;
+            counter++;
+        }
+    }
+
     return counter;
 }
 
@@ -170,15 +253,11 @@ int scache_readSector(cache_set* cache, unsigned int sector, void** buf)
         return -1;
     }
 
-#ifdef SCACHE_RECORD_STATS
     cache->cacheAccess++;
-#endif
     index = getIndexRead(cache, sector);
     M_DEBUG("scache: indexRead=%i \n", index);
     if (index >= 0) { //sector found in cache
-#ifdef SCACHE_RECORD_STATS
         cache->cacheHits++;
-#endif
         *buf = cache->sectorBuf + (index * cache->sectorSize);
         M_DEBUG("scache: hit and done reading sector \n");
 
@@ -255,8 +334,7 @@ int scache_writeSector(cache_set* cache, unsigned int sector)
     }
     M_DEBUG("scache: slotFound=%i \n", index);
 
-    //prefere written sectors to stay in cache longer than read sectors
-    cache->rec[index].tax += 2;
+    cache->rec[index].ref = 1;
 
     //set dirty status
     cache->rec[index].writeDirty = 1;
@@ -273,6 +351,56 @@ int scache_writeSector(cache_set* cache, unsigned int sector)
     return cache->sectorSize;
 }
 
+//---------------------------------------------------------------------------
+static void freeSlots(cache_set* cache)
+{
+    if (cache->sectorBuf != NULL) {
+        free(cache->sectorBuf);
+        cache->sectorBuf = NULL;
+    }
+    if (cache->rec != NULL) {
+        free(cache->rec);
+        cache->rec = NULL;
+    }
+}
+
+//---------------------------------------------------------------------------
+/* Allocates the slots for a cache of the given size, then releases the previous ones. On failure,
+   the cache keeps its previous slots and contents. */
+static int allocSlots(cache_set* cache, unsigned int size)
+{
+    unsigned char* sectorBuf;
+    cache_record* rec;
+    unsigned int hashSize;
+
+    for (hashSize = 16; hashSize < size * 2; hashSize <<= 1)
+        ;
+
+    sectorBuf = (unsigned char*)malloc(BLOCK_SIZE * size);
+    if (sectorBuf == NULL) {
+        M_PRINTF("scache: can't alloate memory of size:%d \n", BLOCK_SIZE * size);
+        return -1;
+    }
+    M_DEBUG("scache: allocated memory at:%p of size:%d \n", sectorBuf, BLOCK_SIZE * size);
+
+    rec = (cache_record*)malloc(sizeof(cache_record) * size + sizeof(short) * hashSize);
+    if (rec == NULL) {
+        M_PRINTF("scache: can't alloate cache records\n");
+        free(sectorBuf);
+        return -1;
+    }
+
+    freeSlots(cache);
+    cache->sectorBuf = sectorBuf;
+    cache->rec       = rec;
+    cache->hash      = (short*)(rec + size);
+
+    cache->cacheSize = size;
+    cache->hashMask  = hashSize - 1;
+    initRecords(cache);
+    return 0;
+}
+
 //---------------------------------------------------------------------------
 cache_set* scache_init(struct block_device* bd)
 {
@@ -286,44 +414,75 @@ cache_set* scache_init(struct block_device* bd)
     }
 
     M_DEBUG("scache init!\n");
-    cache->bd = bd;
+    cache->bd        = bd;
+    cache->sectorBuf = NULL;
+    cache->rec       = NULL;
 
-    cache->sectorBuf = (unsigned char*)malloc(BLOCK_SIZE * CACHE_SIZE);
-    if (cache->sectorBuf == NULL) {
-        M_PRINTF("scache: can't alloate memory of size:%d \n", BLOCK_SIZE * CACHE_SIZE);
+    //added by Hermes
+    cache->sectorSize      = bd->sectorSize;
+    cache->indexLimit      = BLOCK_SIZE / cache->sectorSize; //number of sectors per 1 cache slot
+    cache->cacheAccess     = 0;
+    cache->cacheHits       = 0;
+    cache->cacheEvictions  = 0;
+    cache->cacheWritebacks = 0;
+
+    if (allocSlots(cache, CACHE_SIZE) != 0) {
         free(cache);
         return NULL;
     }
-    M_DEBUG("scache: allocated memory at:%p of size:%d \n", cache->sectorBuf, BLOCK_SIZE * CACHE_SIZE);
-
-    //added by Hermes
-    cache->sectorSize = bd->sectorSize;
-    cache->indexLimit = BLOCK_SIZE / cache->sectorSize; //number of sectors per 1 cache slot
-#ifdef SCACHE_RECORD_STATS
-    cache->cacheAccess = 0;
-    cache->cacheHits   = 0;
-#endif
-    initRecords(cache);
     return cache;
 }
 
-#ifdef SCACHE_RECORD_STATS
+//---------------------------------------------------------------------------
+/* Changes the number of cache slots. Dirty blocks are written back and the cache is emptied.
+   If the new size cannot be allocated, the cache keeps its previous size. */
+int scache_setSize(cache_set* cache, unsigned int size)
+{
+    int ret;
+
+    if (size < 1 || size > CACHE_SIZE_MAX)
+        return -EINVAL;
+
+    if ((ret = scache_flushSectors(cache)) < 0)
+        return ret;
+
+    if (allocSlots(cache, size) != 0)
+        return -ENOMEM;
+
+    return 0;
+}
+
 //---------------------------------------------------------------------------
 void scache_getStat(cache_set* cache, unsigned int* access, unsigned int* hits)
 {
     *access = cache->cacheAccess;
     *hits   = cache->cacheHits;
 }
-#endif
+
+//---------------------------------------------------------------------------
+void scache_getStats(cache_set* cache, struct usbmass_cache_stats* stats)
+{
+    stats->size       = cache->cacheSize;
+    stats->accesses   = cache->cacheAccess;
+    stats->hits       = cache->cacheHits;
+    stats->evictions  = cache->cacheEvictions;
+    stats->writebacks = cache->cacheWritebacks;
+}
+
+//---------------------------------------------------------------------------
+void scache_resetStats(cache_set* cache)
+{
+    cache->cacheAccess     = 0;
+    cache->cacheHits       = 0;
+    cache->cacheEvictions  = 0;
+    cache->cacheWritebacks = 0;
+}
 
 //---------------------------------------------------------------------------
 void scache_kill(cache_set* cache) //dlanor: added for disconnection events (flush impossible)
 {
     M_DEBUG("scache: kill devId = %i \n", cache->bd->devNr);
-    if (cache->sectorBuf != NULL) {
-        free(cache->sectorBuf);
-        cache->sectorBuf = NULL;
-    }
+    freeSlots(cache);
     free(cache);
 }
 //---------------------------------------------------------------------------
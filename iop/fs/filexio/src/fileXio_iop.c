@@ -31,7 +31,7 @@
 #include <fileXio.h>
 
 #define MODNAME "IOX/File_Manager_Rpc"
-IRX_ID(MODNAME, 1, 2);
+IRX_ID(MODNAME, 1, 3);
 
 #define TRUE	1
 #define FALSE	0
@@ -40,8 +40,35 @@ IRX_ID(MODNAME, 1, 2);
 #define RDOWN_64(a)	((unsigned int)(a)&~0x3F)
 
 #define DEFAULT_RWSIZE	16384
-static void *rwbuf = NULL;
-static unsigned int RWBufferSize=DEFAULT_RWSIZE;
+#define DEFAULT_RWCOUNT	2
+#define MAX_RWCOUNT	8
+
+// A RW buffer is split into count chunks that are used in rotation by the read and write RPCs,
+// so that the device can be accessed while the previous chunk is still being transferred over the SIF.
+struct fileXio_rwbuffer {
+	u8 *buf;
+	unsigned int size;
+	unsigned int count;
+	unsigned int chunkSize;
+	int dma[MAX_RWCOUNT];	// ID of the last DMA transfer from each chunk
+	rests_pkt rests;
+};
+
+static struct fileXio_rwbuffer rwmain;	// Used by the main RPC server
+
+// Each async worker serves read, write and seek requests with its own RPC server and RW buffer,
+// so that requests on different files can be processed in parallel.
+#define ASYNC_RWSIZE	8192
+#define ASYNC_RWCOUNT	2
+
+struct fileXio_worker {
+	struct t_SifRpcDataQueue qd;
+	struct t_SifRpcServerData sd;
+	struct fileXio_rwbuffer rw;
+	unsigned int rpc_buffer[32] __attribute__((aligned(16)));	// Largest request is fxio_write_packet
+};
+
+static struct fileXio_worker workers[FILEXIO_ASYNC_WORKERS];
 
 // 0x4800 bytes for DirEntry structures
 // 0x400 bytes for the filename string
@@ -49,13 +76,11 @@ static unsigned char fileXio_rpc_buffer[0x4C00]; // RPC send/receive buffer
 struct t_SifRpcDataQueue qd;
 struct t_SifRpcServerData sd0;
 
-static rests_pkt rests;
-
 /* RPC exported functions */
 static int fileXio_GetDeviceList_RPC(struct fileXioDevice* ee_devices, int eecount);
 static int fileXio_CopyFile_RPC(const char *src, const char *dest, int mode);
-static int fileXio_Read_RPC(int infd, char *read_buf, int read_size, void *intr_data);
-static int fileXio_Write_RPC(int outfd, const char *write_buf, int write_size, int mis,u8 *misbuf);
+static int fileXio_Read_RPC(struct fileXio_rwbuffer *rw, int infd, char *read_buf, int read_size, void *intr_data);
+static int fileXio_Write_RPC(struct fileXio_rwbuffer *rw, int outfd, const char *write_buf, int write_size, int mis,u8 *misbuf);
 static int fileXio_GetDir_RPC(const char* pathname, struct fileXioDirEntry dirEntry[], unsigned int req_entries);
 static int fileXio_Mount_RPC(const char* mountstring, const char* mountpoint, int flag);
 static int fileXio_chstat_RPC(char *filename, void* eeptr, int mask);
@@ -78,8 +103,8 @@ static void* fileXioRpc_ReadLink(unsigned int* sbuff);
 static void* fileXioRpc_ChDir(unsigned int* sbuff);
 static void* fileXioRpc_Open(unsigned int* sbuff);
 static void* fileXioRpc_Close(unsigned int* sbuff);
-static void* fileXioRpc_Read(unsigned int* sbuff);
-static void* fileXioRpc_Write(unsigned int* sbuff);
+static void* fileXioRpc_Read(struct fileXio_rwbuffer *rw, unsigned int* sbuff);
+static void* fileXioRpc_Write(struct fileXio_rwbuffer *rw, unsigned int* sbuff);
 static void* fileXioRpc_Lseek(unsigned int* sbuff);
 static void* fileXioRpc_Lseek64(unsigned int* sbuff);
 static void* fileXioRpc_ChStat(unsigned int* sbuff);
@@ -95,12 +120,16 @@ static void* fileXioRpc_Dopen(unsigned int* sbuff);
 static void* fileXioRpc_Dread(unsigned int* sbuff);
 static void* fileXioRpc_Dclose(unsigned int* sbuff);
 static void* filexioRpc_SetRWBufferSize(void *sbuff);
+static int fileXio_AllocRWBuffer(struct fileXio_rwbuffer *rw, unsigned int size, unsigned int count);
+static void fileXio_WaitRWBuffer(struct fileXio_rwbuffer *rw);
 static void* fileXioRpc_Getdir(unsigned int* sbuff);
 static void DirEntryCopy(struct fileXioDirEntry* dirEntry, iox_dirent_t* internalDirEntry);
 
 // RPC server
 static void* fileXio_rpc_server(int fno, void *data, int size);
+static void* fileXio_async_server(int fno, void *data, int size);
 static void fileXio_Thread(void* param);
+static void fileXio_WorkerThread(void* param);
 
 int _start( int argc, char **argv)
 {
@@ -176,13 +205,14 @@ static int fileXio_CopyFile_RPC(const char *src, const char *dest, int mode)
   if (!size)
     return retval;
 
-  remain = size % RWBufferSize;
-  for (i = 0; i < (size / RWBufferSize); i++) {
-    read(infd, rwbuf, RWBufferSize);
-    write(outfd, rwbuf, RWBufferSize);
+  fileXio_WaitRWBuffer(&rwmain);
+  remain = size % rwmain.size;
+  for (i = 0; i < (size / rwmain.size); i++) {
+    read(infd, rwmain.buf, rwmain.size);
+    write(outfd, rwmain.buf, rwmain.size);
   }
-  read(infd, rwbuf, remain);
-  write(outfd, rwbuf, remain);
+  read(infd, rwmain.buf, remain);
+  write(outfd, rwmain.buf, remain);
   close(infd);
   close(outfd);
 
@@ -192,7 +222,7 @@ static int fileXio_CopyFile_RPC(const char *src, const char *dest, int mode)
   return size;
 }
 
-static int fileXio_Read_RPC(int infd, char *read_buf, int read_size, void *intr_data)
+static int fileXio_Read_RPC(struct fileXio_rwbuffer *rw, int infd, char *read_buf, int read_size, void *intr_data)
 {
      int srest;
      int erest;
@@ -201,7 +231,8 @@ static int fileXio_Read_RPC(int infd, char *read_buf, int read_size, void *intr_
      int rlen;
      int total;
      int readlen;
-     int status;
+     unsigned int chunk;
+     u8 *rbuf;
      struct t_SifDmaTransfer dmaStruct;
      void *buffer;
      void *aebuffer;
@@ -229,7 +260,7 @@ static int fileXio_Read_RPC(int infd, char *read_buf, int read_size, void *intr_
 	}
 	if (srest>0)
 	{
-		if (srest!=(rlen=read(infd, rests.sbuffer, srest)))
+		if (srest!=(rlen=read(infd, rw->rests.sbuffer, srest)))
 		{
 			total += srest = (rlen>0 ? rlen:0);
 			goto EXIT;
@@ -238,22 +269,24 @@ static int fileXio_Read_RPC(int infd, char *read_buf, int read_size, void *intr_
 			total += srest;
 	}
 
-	status=0;
+	chunk=0;
 	while (asize>0)
 	{
-		readlen=MIN(RWBufferSize, asize);
+		readlen=MIN(rw->chunkSize, asize);
+		rbuf=rw->buf + chunk * rw->chunkSize;
 
-		while(SifDmaStat(status)>=0);
+		// Only the chunk about to be reused has to be idle, transfers from the other chunks continue during the read.
+		while(SifDmaStat(rw->dma[chunk])>=0);
 
-		rlen=read(infd, rwbuf, readlen);
+		rlen=read(infd, rbuf, readlen);
 		if (readlen!=rlen){
 			if (rlen<=0)goto EXIT;
 			dmaStruct.dest=(void *)abuffer;
 			dmaStruct.size=rlen;
 			dmaStruct.attr=0;
-			dmaStruct.src =rwbuf;
+			dmaStruct.src =rbuf;
 			CpuSuspendIntr(&intStatus);
-			SifSetDma(&dmaStruct, 1);
+			rw->dma[chunk]=SifSetDma(&dmaStruct, 1);
 			CpuResumeIntr(intStatus);
 			total	+=rlen;
 			goto EXIT;
@@ -264,23 +297,26 @@ static int fileXio_Read_RPC(int infd, char *read_buf, int read_size, void *intr_
 			abuffer +=rlen;
 			dmaStruct.size=rlen;
 			dmaStruct.attr=0;
-			dmaStruct.src =rwbuf;
+			dmaStruct.src =rbuf;
 			CpuSuspendIntr(&intStatus);
-			status=SifSetDma(&dmaStruct, 1);
+			rw->dma[chunk]=SifSetDma(&dmaStruct, 1);
 			CpuResumeIntr(intStatus);
 		}
+
+		if (++chunk >= rw->count)
+			chunk=0;
 	}
 	if (erest>0)
 	{
-		rlen = read(infd, rests.ebuffer, erest);
+		rlen = read(infd, rw->rests.ebuffer, erest);
 		total += (rlen>0 ? rlen : 0);
 	}
 EXIT:
-	rests.ssize=srest;
-	rests.esize=erest;
-	rests.sbuf =buffer;
-	rests.ebuf =aebuffer;
-      dmaStruct.src =&rests;
+	rw->rests.ssize=srest;
+	rw->rests.esize=erest;
+	rw->rests.sbuf =buffer;
+	rw->rests.ebuf =aebuffer;
+      dmaStruct.src =&rw->rests;
 	dmaStruct.size=sizeof(rests_pkt);
 	dmaStruct.attr=0;
 	dmaStruct.dest=intr_data;
@@ -290,7 +326,7 @@ EXIT:
 	return (total);
 }
 
-static int fileXio_Write_RPC(int outfd, const char *write_buf, int write_size, int mis,u8 *misbuf)
+static int fileXio_Write_RPC(struct fileXio_rwbuffer *rw, int outfd, const char *write_buf, int write_size, int mis,u8 *misbuf)
 {
      SifRpcReceiveData_t rdata;
      int left;
@@ -298,6 +334,9 @@ static int fileXio_Write_RPC(int outfd, const char *write_buf, int write_size, i
      int writelen;
      int pos;
      int total;
+     int prefetched;
+     unsigned int chunk;
+     u8 *wbuf;
 
 	left  = write_size;
 	total = 0;
@@ -315,17 +354,40 @@ static int fileXio_Write_RPC(int outfd, const char *write_buf, int write_size, i
 
 	left-=mis;
 	pos=(int)write_buf+mis;
+	if (left <= 0)
+		return (total);
+
+	fileXio_WaitRWBuffer(rw);
+
+	chunk=0;
+	prefetched=FALSE;
 	while(left){
-		writelen = MIN(RWBufferSize, left);
-		SifRpcGetOtherData(&rdata, (void *)pos, rwbuf, writelen, 0);
-		wlen=write(outfd, rwbuf, writelen);
+		writelen = MIN(rw->chunkSize, left);
+		wbuf = rw->buf + chunk * rw->chunkSize;
+		if (!prefetched)
+			SifRpcGetOtherData(&rdata, (void *)pos, wbuf, writelen, 0);
+		left -=writelen;
+		pos  +=writelen;
+
+		// Fetch the next chunk from EE RAM into another buffer while the current one is being written.
+		prefetched = (left > 0 && rw->count > 1);
+		if (prefetched)
+		{
+			if (++chunk >= rw->count)
+				chunk=0;
+			SifRpcGetOtherData(&rdata, (void *)pos, rw->buf + chunk * rw->chunkSize, MIN(rw->chunkSize, left), SIF_RPC_M_NOWAIT);
+		}
+
+		wlen=write(outfd, wbuf, writelen);
+
+		if (prefetched)
+			while(SifCheckStatRpc((SifRpcClientData_t *)&rdata));
+
 		if (wlen != writelen){
 			if (wlen>0)
 				total+=wlen;
 			return (total);
 		}
-		left -=writelen;
-		pos  +=writelen;
 		total+=writelen;
 	}
 	return (total);
@@ -714,7 +776,7 @@ static void* fileXioRpc_Close(unsigned int* sbuff)
 // Send:   Offset 4 = pointer to buffer in EE mem
 // Send:   Offset 8 = buffer size (int)
 // Send:   Offset 12 = pointer to intr_data in EE mem
-static void* fileXioRpc_Read(unsigned int* sbuff)
+static void* fileXioRpc_Read(struct fileXio_rwbuffer *rw, unsigned int* sbuff)
 {
 	int ret;
 	struct fxio_read_packet *packet=(struct fxio_read_packet*)sbuff;
@@ -722,7 +784,7 @@ static void* fileXioRpc_Read(unsigned int* sbuff)
 	#ifdef DEBUG
 		printf("RPC Read Request\n");
 	#endif
-	ret=fileXio_Read_RPC(packet->fd, packet->buffer, packet->size, packet->intrData);
+	ret=fileXio_Read_RPC(rw, packet->fd, packet->buffer, packet->size, packet->intrData);
 	sbuff[0] = ret;
 	return sbuff;
 }
@@ -732,7 +794,7 @@ static void* fileXioRpc_Read(unsigned int* sbuff)
 // Send:   Offset 8 = buffer size (int)
 // Send:   Offset 12 = misaligned buffer size (int)
 // Send:   Offset 16 = misaligned buffer (16)
-static void* fileXioRpc_Write(unsigned int* sbuff)
+static void* fileXioRpc_Write(struct fileXio_rwbuffer *rw, unsigned int* sbuff)
 {
 	int ret;
 	struct fxio_write_packet *packet=(struct fxio_write_packet*)sbuff;
@@ -740,7 +802,7 @@ static void* fileXioRpc_Write(unsigned int* sbuff)
 	#ifdef DEBUG
 		printf("RPC Write Request\n");
 	#endif
-	ret=fileXio_Write_RPC(packet->fd, packet->buffer, packet->size,
+	ret=fileXio_Write_RPC(rw, packet->fd, packet->buffer, packet->size,
                             packet->unalignedDataLen, packet->unalignedData);
 	sbuff[0] = ret;
 	return sbuff;
@@ -885,7 +947,7 @@ static void* fileXioRpc_Sync(unsigned int* sbuff)
 static void* fileXioRpc_Devctl(unsigned int* sbuff)
 {
 	struct fxio_devctl_packet *packet = (struct fxio_devctl_packet *)sbuff;
-	struct fxio_ctl_return_pkt *ret_buf = (struct fxio_ctl_return_pkt *)rwbuf;
+	struct fxio_ctl_return_pkt *ret_buf = (struct fxio_ctl_return_pkt *)rwmain.buf;
 	SifDmaTransfer_t dmatrans;
 	int intStatus;
 	int ret;
@@ -894,6 +956,7 @@ static void* fileXioRpc_Devctl(unsigned int* sbuff)
 		printf("RPC Devctl Request\n");
 	#endif
 
+	fileXio_WaitRWBuffer(&rwmain);
 	ret = devctl(packet->name, packet->cmd, packet->arg, packet->arglen, ret_buf->buf, packet->buflen);
 
 	// Transfer buffer back to EE
@@ -913,7 +976,7 @@ static void* fileXioRpc_Devctl(unsigned int* sbuff)
 			ret_buf->len = 0;
 
 		CpuSuspendIntr(&intStatus);
-		SifSetDma(&dmatrans, 1);
+		rwmain.dma[0] = SifSetDma(&dmatrans, 1);
 		CpuResumeIntr(intStatus);
 	}
 
@@ -940,7 +1003,7 @@ static void* fileXioRpc_Ioctl(unsigned int* sbuff)
 static void* fileXioRpc_Ioctl2(unsigned int* sbuff)
 {
 	struct fxio_ioctl2_packet *packet = (struct fxio_ioctl2_packet *)sbuff;
-	struct fxio_ctl_return_pkt *ret_buf = (struct fxio_ctl_return_pkt *)rwbuf;
+	struct fxio_ctl_return_pkt *ret_buf = (struct fxio_ctl_return_pkt *)rwmain.buf;
 	SifDmaTransfer_t dmatrans;
 	int intStatus;
 	int ret;
@@ -949,6 +1012,7 @@ static void* fileXioRpc_Ioctl2(unsigned int* sbuff)
 		printf("RPC ioctl2 Request\n");
 	#endif
 
+	fileXio_WaitRWBuffer(&rwmain);
 	ret = ioctl2(packet->fd, packet->cmd, packet->arg, packet->arglen, ret_buf->buf, packet->buflen);
 
 	// Transfer buffer back to EE
@@ -968,7 +1032,7 @@ static void* fileXioRpc_Ioctl2(unsigned int* sbuff)
 			ret_buf->len = 0;
 
 		CpuSuspendIntr(&intStatus);
-		SifSetDma(&dmatrans, 1);
+		rwmain.dma[0] = SifSetDma(&dmatrans, 1);
 		CpuResumeIntr(intStatus);
 	}
 
@@ -1022,7 +1086,8 @@ static void* fileXioRpc_Dclose(unsigned int* sbuff)
 
 static void fileXio_Thread(void* param)
 {
-	int OldState;
+	struct _iop_thread thread;
+	int i, th;
 
 	printf("fileXio: fileXio RPC Server v1.00\nCopyright (c) 2003 adresd\n");
 	#ifdef DEBUG
@@ -1031,11 +1096,7 @@ static void fileXio_Thread(void* param)
 
 	SifInitRpc(0);
 
-	RWBufferSize=DEFAULT_RWSIZE;
-	CpuSuspendIntr(&OldState);
-	rwbuf = AllocSysMemory(ALLOC_FIRST, RWBufferSize, NULL);
-	CpuResumeIntr(OldState);
-	if (rwbuf == NULL)
+	if (fileXio_AllocRWBuffer(&rwmain, DEFAULT_RWSIZE, DEFAULT_RWCOUNT) < 0)
 	{
 		#ifdef DEBUG
   			printf("Failed to allocate memory for RW buffer!\n");
@@ -1044,27 +1105,85 @@ static void fileXio_Thread(void* param)
 		SleepThread();
 	}
 
+	thread.attr         = TH_C;
+	thread.thread       = (void*)fileXio_WorkerThread;
+	thread.priority     = 40;
+	thread.stacksize    = 0x1000;
+	thread.option       = 0;
+
+	// The workers are registered before the main server, so they are available once the EE can bind to it.
+	for (i = 0; i < FILEXIO_ASYNC_WORKERS; i++)
+	{
+		if ((th = CreateThread(&thread)) > 0)
+		{
+			SifSetRpcQueue(&workers[i].qd, th);
+			SifRegisterRpc(&workers[i].sd, FILEXIO_ASYNC_IRX + i, &fileXio_async_server, workers[i].rpc_buffer, NULL, NULL, &workers[i].qd);
+			StartThread(th, &workers[i]);
+		}
+	}
+
 	SifSetRpcQueue(&qd, GetThreadId());
 	SifRegisterRpc(&sd0, FILEXIO_IRX, &fileXio_rpc_server, fileXio_rpc_buffer, NULL, NULL, &qd);
 	SifRpcLoop(&qd);
 }
 
-static void* filexioRpc_SetRWBufferSize(void *sbuff)
+static void fileXio_WorkerThread(void* param)
+{
+	struct fileXio_worker *worker = (struct fileXio_worker*)param;
+
+	SifRpcLoop(&worker->qd);
+}
+
+// Waits for all outstanding transfers from the RW buffer to complete.
+static void fileXio_WaitRWBuffer(struct fileXio_rwbuffer *rw)
+{
+	unsigned int i;
+
+	for (i = 0; i < rw->count; i++)
+	{
+		while(SifDmaStat(rw->dma[i])>=0);
+		rw->dma[i] = 0;
+	}
+}
+
+// (Re)allocates the RW buffer, after waiting for all transfers from the previous buffer to complete.
+static int fileXio_AllocRWBuffer(struct fileXio_rwbuffer *rw, unsigned int size, unsigned int count)
 {
 	int OldState;
 
-	if(rwbuf!=NULL){
+	if(rw->buf!=NULL){
+		fileXio_WaitRWBuffer(rw);
+
 		CpuSuspendIntr(&OldState);
-		FreeSysMemory(rwbuf);
+		FreeSysMemory(rw->buf);
 		CpuResumeIntr(OldState);
 	}
 
-	RWBufferSize=((struct fxio_rwbuff*)sbuff)->size;
+	rw->size=size;
+	rw->count=count;
+	rw->chunkSize=RDOWN_64(size / count);
+	memset(rw->dma, 0, sizeof(rw->dma));
 	CpuSuspendIntr(&OldState);
-	rwbuf=AllocSysMemory(ALLOC_FIRST, RWBufferSize, NULL);
+	rw->buf=AllocSysMemory(ALLOC_FIRST, size, NULL);
 	CpuResumeIntr(OldState);
 
-	((int*)sbuff)[0] = rwbuf!=NULL?0:-ENOMEM;
+	return rw->buf!=NULL?0:-ENOMEM;
+}
+
+static void* filexioRpc_SetRWBufferSize(void *sbuff)
+{
+	struct fxio_rwbuff *packet = (struct fxio_rwbuff*)sbuff;
+	unsigned int count;
+
+	count = packet->count > 0 ? packet->count : rwmain.count;
+	// Each chunk must hold at least one 64-byte block for the SIF DMA.
+	if (count > MAX_RWCOUNT || packet->size < (int)(count * 64))
+	{
+		((int*)sbuff)[0] = -EINVAL;
+		return sbuff;
+	}
+
+	((int*)sbuff)[0] = fileXio_AllocRWBuffer(&rwmain, packet->size, count);
 	return sbuff;
 }
 
@@ -1103,9 +1222,9 @@ static void* fileXio_rpc_server(int fno, void *data, int size)
 		case FILEXIO_CLOSE:
 			return fileXioRpc_Close((unsigned*)data);
 		case FILEXIO_READ:
-			return fileXioRpc_Read((unsigned*)data);
+			return fileXioRpc_Read(&rwmain, (unsigned*)data);
 		case FILEXIO_WRITE:
-			return fileXioRpc_Write((unsigned*)data);
+			return fileXioRpc_Write(&rwmain, (unsigned*)data);
 		case FILEXIO_LSEEK:
 			return fileXioRpc_Lseek((unsigned*)data);
 		case FILEXIO_IOCTL:
@@ -1135,11 +1254,39 @@ static void* fileXio_rpc_server(int fno, void *data, int size)
 		case FILEXIO_GETDEVICELIST:
 			return fileXioRpc_GetDeviceList((unsigned*)data);
 		case FILEXIO_SETRWBUFFSIZE:
+			// Older clients only send the size.
+			if (size < (int)sizeof(struct fxio_rwbuff))
+				((struct fxio_rwbuff*)data)->count = 0;
 			return filexioRpc_SetRWBufferSize(data);
 	}
 	return NULL;
 }
 
+// RPC server of the async workers. Only file I/O on already opened files is supported.
+static void* fileXio_async_server(int fno, void *data, int size)
+{
+	struct fileXio_worker *worker;
+
+	for (worker = workers; (void*)worker->rpc_buffer != data; worker++);
+
+	switch(fno) {
+		case FILEXIO_READ:
+		case FILEXIO_WRITE:
+			// The RW buffer is allocated on first use, so that idle workers only take up their stack.
+			if (worker->rw.buf == NULL && fileXio_AllocRWBuffer(&worker->rw, ASYNC_RWSIZE, ASYNC_RWCOUNT) < 0)
+			{
+				((int*)data)[0] = -ENOMEM;
+				return data;
+			}
+			return fno == FILEXIO_READ ? fileXioRpc_Read(&worker->rw, (unsigned*)data) : fileXioRpc_Write(&worker->rw, (unsigned*)data);
+		case FILEXIO_LSEEK:
+			return fileXioRpc_Lseek((unsigned*)data);
+		case FILEXIO_LSEEK64:
+			return fileXioRpc_Lseek64((unsigned*)data);
+	}
+	return NULL;
+}
+
 
 // Copy a DIR Entry from the native format to our format
 static void DirEntryCopy(struct fileXioDirEntry* dirEntry, iox_dirent_t* internalDirEntry)
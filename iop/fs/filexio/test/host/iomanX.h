@@ -0,0 +1,79 @@
+/* Host stand-in for the IOP iomanX.h. The file I/O calls go to the simulated device, the others fail with -ENODEV. */
+#ifndef __IOMANX_H__
+#define __IOMANX_H__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <iox_stat.h>
+
+typedef struct _iop_device {
+	const char *name;
+	unsigned int type;
+	unsigned int version;
+	const char *desc;
+	void *ops;
+} iop_device_t;
+
+int sim_open(const char *name, int flags, ...);
+int sim_close(int fd);
+int sim_read(int fd, void *ptr, int size);
+int sim_write(int fd, void *ptr, int size);
+int sim_lseek(int fd, int offset, int mode);
+
+#define open	sim_open
+#define close	sim_close
+#define read	sim_read
+#define write	sim_write
+#define lseek	sim_lseek
+
+#define SIM_UNSUPPORTED(type, name, ...)	static inline type sim_##name(__VA_ARGS__) { return -ENODEV; }
+
+SIM_UNSUPPORTED(s64, lseek64, int fd, s64 offset, int whence)
+SIM_UNSUPPORTED(int, ioctl, int fd, int cmd, void *param)
+SIM_UNSUPPORTED(int, ioctl2, int fd, int cmd, void *arg, unsigned int arglen, void *buf, unsigned int buflen)
+SIM_UNSUPPORTED(int, remove, const char *name)
+SIM_UNSUPPORTED(int, mkdir, const char *path, int mode)
+SIM_UNSUPPORTED(int, rmdir, const char *path)
+SIM_UNSUPPORTED(int, dopen, const char *path)
+SIM_UNSUPPORTED(int, dclose, int fd)
+SIM_UNSUPPORTED(int, dread, int fd, iox_dirent_t *buf)
+SIM_UNSUPPORTED(int, getstat, const char *name, iox_stat_t *stat)
+SIM_UNSUPPORTED(int, chstat, const char *name, iox_stat_t *stat, unsigned int statmask)
+SIM_UNSUPPORTED(int, format, const char *dev, const char *blockdev, void *arg, int arglen)
+SIM_UNSUPPORTED(int, rename, const char *old, const char *new)
+SIM_UNSUPPORTED(int, chdir, const char *name)
+SIM_UNSUPPORTED(int, sync, const char *dev, int flag)
+SIM_UNSUPPORTED(int, mount, const char *fsname, const char *devname, int flag, void *arg, int arglen)
+SIM_UNSUPPORTED(int, umount, const char *fsname)
+SIM_UNSUPPORTED(int, devctl, const char *name, int cmd, void *arg, unsigned int arglen, void *buf, unsigned int buflen)
+SIM_UNSUPPORTED(int, symlink, const char *old, const char *new)
+SIM_UNSUPPORTED(int, readlink, const char *path, char *buf, unsigned int buflen)
+SIM_UNSUPPORTED(int, AddDrv, iop_device_t *device)
+SIM_UNSUPPORTED(int, DelDrv, const char *name)
+
+#define lseek64		sim_lseek64
+#define ioctl		sim_ioctl
+#define ioctl2		sim_ioctl2
+#define remove		sim_remove
+#define mkdir		sim_mkdir
+#define rmdir		sim_rmdir
+#define dopen		sim_dopen
+#define dclose		sim_dclose
+#define dread		sim_dread
+#define getstat		sim_getstat
+#define chstat		sim_chstat
+#define format		sim_format
+#define rename		sim_rename
+#define chdir		sim_chdir
+#define sync		sim_sync
+#define mount		sim_mount
+#define umount		sim_umount
+#define devctl		sim_devctl
+#define symlink		sim_symlink
+#define readlink	sim_readlink
+#define AddDrv		sim_AddDrv
+#define DelDrv		sim_DelDrv
+
+static inline iop_device_t **GetDeviceList(void) { return NULL; }
+
+#endif
@@ -0,0 +1,10 @@
+/* Host stand-in for the IOP loadcore.h. */
+#ifndef __LOADCORE_H__
+#define __LOADCORE_H__
+
+#define IRX_ID(name, major, minor)	static const char *const irx_name __attribute__((unused)) = name
+
+#define MODULE_RESIDENT_END	0
+#define MODULE_NO_RESIDENT_END	1
+
+#endif
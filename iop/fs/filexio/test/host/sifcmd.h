@@ -0,0 +1,33 @@
+/* Host stand-in for the IOP sifcmd.h. SifRpcGetOtherData() is modelled by the simulation. */
+#ifndef __SIFCMD_H__
+#define __SIFCMD_H__
+
+#define SIF_RPC_M_NOWAIT	0x01
+
+// Both start with the time at which the last transfer is done, which SifCheckStatRpc() checks.
+typedef struct {
+	double done;
+} SifRpcClientData_t;
+
+typedef struct {
+	double done;
+} SifRpcReceiveData_t;
+
+struct t_SifRpcDataQueue {
+	int thread_id;
+};
+
+struct t_SifRpcServerData {
+	int rpc_number;
+};
+
+int SifRpcGetOtherData(SifRpcReceiveData_t *rd, void *src, void *dest, int size, int mode);
+int SifCheckStatRpc(SifRpcClientData_t *cd);
+
+static inline void SifInitRpc(int mode) { }
+static inline void SifSetRpcQueue(struct t_SifRpcDataQueue *q, int thread_id) { }
+static inline void SifRpcLoop(struct t_SifRpcDataQueue *q) { }
+static inline void SifRegisterRpc(struct t_SifRpcServerData *sd, int rpc_number, void *(*func)(int, void *, int),
+	void *buf, void *cfunc, void *cbuf, struct t_SifRpcDataQueue *q) { }
+
+#endif
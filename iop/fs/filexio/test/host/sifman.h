@@ -0,0 +1,15 @@
+/* Host stand-in for the IOP sifman.h. The SIF DMA is modelled by the simulation. */
+#ifndef __SIFMAN_H__
+#define __SIFMAN_H__
+
+typedef struct t_SifDmaTransfer {
+	void *src;
+	void *dest;
+	int size;
+	int attr;
+} SifDmaTransfer_t;
+
+int SifSetDma(SifDmaTransfer_t *dmat, int count);
+int SifDmaStat(int id);
+
+#endif
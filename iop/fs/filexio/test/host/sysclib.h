@@ -0,0 +1,2 @@
+/* Host stand-in for the IOP sysclib.h. */
+#include <string.h>
@@ -0,0 +1,20 @@
+/* Host stand-in for the IOP thbase.h: the server code runs on the simulation's thread. */
+#ifndef __THBASE_H__
+#define __THBASE_H__
+
+#define TH_C	0x02000000
+
+typedef struct _iop_thread {
+	unsigned int attr;
+	unsigned int option;
+	void (*thread)(void *);
+	unsigned int stacksize;
+	unsigned int priority;
+} iop_thread_t;
+
+static inline int CreateThread(iop_thread_t *thread) { return -1; }
+static inline int StartThread(int thid, void *arg) { return -1; }
+static inline int SleepThread(void) { return 0; }
+static inline int GetThreadId(void) { return 1; }
+
+#endif
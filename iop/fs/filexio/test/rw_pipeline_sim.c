@@ -0,0 +1,370 @@
+/*
+	Host simulation of the read and write RPCs of fileXio_iop.c, with device and SIF latencies.
+
+	The server code is built into this program and called the way the RPC loop calls it. The device
+	is a file in memory that costs 100us per call plus 12MB/s, except for one call in four that takes
+	no time while the data is checked. The SIF DMA to the EE costs 20us per
+	transfer plus 15MB/s, runs in the background and copies the data from the IOP buffer only once it
+	is done, so a buffer that is reused too early hands the EE the wrong data. Fetching data from the
+	EE with SifRpcGetOtherData() is modelled the same way, so a buffer that is written to the device
+	before the fetch is done is written with stale data. Every RPC returns once its last transfer
+	to the EE is done.
+
+	Reads and writes of random sizes, offsets and EE buffer alignments are checked against a copy of
+	the file, then 4MB are streamed in 64KB calls for each RW buffer chunk count. A single chunk
+	behaves like the RW buffer from before the pipelining, which is also built for comparison.
+
+	Build and run from the root of the tree. The IOP code passes EE addresses around as int, hence
+	the two -Wno options:
+
+	F="-O2 -Wall -Wno-int-to-pointer-cast -Wno-pointer-to-int-cast -D_IOP -Iiop/fs/filexio/test/host -idirafter common/include"
+	gcc $F -Iiop/fs/filexio/src iop/fs/filexio/test/rw_pipeline_sim.c -o rw_pipeline_sim
+	mkdir -p filexio_old && git show 22ecac1:iop/fs/filexio/src/fileXio_iop.c > filexio_old/fileXio_iop.c
+	gcc $F -DOLD_RWBUFFER -Ifilexio_old iop/fs/filexio/test/rw_pipeline_sim.c -o rw_pipeline_sim_old
+	./rw_pipeline_sim && ./rw_pipeline_sim_old
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _start fileXio_start
+#include "fileXio_iop.c"
+
+#define FILE_SIZE	(4 * 1024 * 1024)
+#define EE_BASE		0x00100000	// EE addresses start here, so that none of them is NULL
+#define EE_SIZE		(FILE_SIZE + 0x10000)
+#define SIM_FD		3
+#define CASES		2000
+#define STREAM_CALL	(64 * 1024)
+
+#define DEVICE_CALL	100e-6
+#define DEVICE_BPS	12e6
+#define SIF_CALL	20e-6
+#define SIF_BPS		15e6
+#define MAX_DMA		1024	// Transfers in progress at the same time
+
+struct sim_dma {
+	const void *src;
+	void *dest;
+	int size;
+	double done;
+};
+
+static u8 file[FILE_SIZE], expected[FILE_SIZE], noise[FILE_SIZE], ee_ram[EE_SIZE];
+static int filePos;
+static double now, deviceTime, sif0Busy, sif1Busy;
+static struct sim_dma dma[MAX_DMA];
+static struct sim_dma fetch;	// Transfer from the EE in progress, if its size isn't 0
+static int dmaCount, dmaFirst;	// Transfers dmaFirst + 1 to dmaCount are in progress, transfer n is at dma[n % MAX_DMA]
+static int jitter;	// Some device calls take no time, so that the SIF transfers finish in any order
+static int errors;
+
+static void error(const char *what, int offset, int size, int align)
+{
+	if(errors++ < 10)
+		printf("error: %s, offset %d, size %d, EE alignment %d\n", what, offset, size, align);
+}
+
+static void *ee_addr(unsigned int offset)
+{
+	return (void *)(EE_BASE + offset);
+}
+
+static u8 *ee_ptr(const void *addr)
+{
+	return ee_ram + ((unsigned int)addr - EE_BASE);
+}
+
+// Lets time pass, completing the transfers to the EE that are done by then.
+static void advance(double time)
+{
+	if(time > now)
+		now = time;
+
+	while(dmaFirst < dmaCount && dma[(dmaFirst + 1) % MAX_DMA].done <= now)
+	{
+		struct sim_dma *d = &dma[(dmaFirst + 1) % MAX_DMA];
+
+		memcpy(ee_ptr(d->dest), d->src, d->size);
+		dmaFirst++;
+	}
+
+	if(fetch.size != 0 && fetch.done <= now)
+	{
+		memcpy(fetch.dest, ee_ptr(fetch.src), fetch.size);
+		fetch.size = 0;
+	}
+}
+
+int SifSetDma(SifDmaTransfer_t *dmat, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+	{
+		if(dmaCount - dmaFirst >= MAX_DMA)
+		{
+			error("too many DMA transfers", 0, dmat[i].size, 0);
+			return 0;
+		}
+
+		sif0Busy = (sif0Busy > now ? sif0Busy : now) + SIF_CALL + dmat[i].size / SIF_BPS;
+		dmaCount++;
+		dma[dmaCount % MAX_DMA].src = dmat[i].src;
+		dma[dmaCount % MAX_DMA].dest = dmat[i].dest;
+		dma[dmaCount % MAX_DMA].size = dmat[i].size;
+		dma[dmaCount % MAX_DMA].done = sif0Busy;
+	}
+
+	return dmaCount;
+}
+
+int SifDmaStat(int id)
+{
+	if(id <= dmaFirst || id > dmaCount)
+		return -1;
+
+	advance(dma[id % MAX_DMA].done);
+	return 0;
+}
+
+int SifRpcGetOtherData(SifRpcReceiveData_t *rd, void *src, void *dest, int size, int mode)
+{
+	advance(fetch.size != 0 ? fetch.done : now);
+
+	sif1Busy = (sif1Busy > now ? sif1Busy : now) + SIF_CALL + size / SIF_BPS;
+	fetch.src = src;
+	fetch.dest = dest;
+	fetch.size = size;
+	fetch.done = rd->done = sif1Busy;
+
+	if(!(mode & SIF_RPC_M_NOWAIT))
+		advance(sif1Busy);
+
+	return 0;
+}
+
+int SifCheckStatRpc(SifRpcClientData_t *cd)
+{
+	if(cd->done <= now)
+		return 0;
+
+	advance(cd->done);
+	return 1;
+}
+
+int sim_open(const char *name, int flags, ...)
+{
+	return SIM_FD;
+}
+
+int sim_close(int fd)
+{
+	return 0;
+}
+
+int sim_lseek(int fd, int offset, int mode)
+{
+	filePos = offset;
+	return offset;
+}
+
+static double device_time(int size)
+{
+	if(jitter && rand() % 4 == 0)
+		return 0;
+
+	return DEVICE_CALL + size / DEVICE_BPS;
+}
+
+int sim_read(int fd, void *ptr, int size)
+{
+	double time = device_time(size);
+
+	if(size > FILE_SIZE - filePos)
+		size = FILE_SIZE - filePos;
+
+	// The device fills the buffer from the start of the call.
+	advance(now);
+	memcpy(ptr, file + filePos, size);
+	filePos += size;
+	deviceTime += time;
+	advance(now + time);
+
+	return size;
+}
+
+int sim_write(int fd, void *ptr, int size)
+{
+	double time = device_time(size);
+
+	if(size > FILE_SIZE - filePos)
+		size = FILE_SIZE - filePos;
+
+	memcpy(file + filePos, ptr, size);
+	filePos += size;
+	deviceTime += time;
+	advance(now + time);
+
+	return size;
+}
+
+// Calls the server like the RPC loop does, then waits for the transfers to the EE like the EE does.
+static int call(int fno, void *packet, int size)
+{
+	int result;
+
+	result = *(int *)fileXio_rpc_server(fno, packet, size);
+	advance(sif0Busy);
+
+	return result;
+}
+
+static void set_rw_buffers(int size, int count)
+{
+	struct fxio_rwbuff packet;
+
+	packet.size = size;
+	packet.count = count;
+	if(call(FILEXIO_SETRWBUFFSIZE, &packet, sizeof(packet)) != 0)
+		error("the RW buffer was not allocated", 0, size, count);
+}
+
+// Reads into EE RAM and completes the unaligned ends from the rests packet, like _fxio_intr() does.
+static int ee_read(unsigned int offset, unsigned int ee_offset, int size)
+{
+	union { struct fxio_read_packet p; unsigned int words[16]; } packet;
+	unsigned int rests_offset = EE_SIZE - sizeof(rests_pkt);
+	rests_pkt *rests;
+	int result;
+
+	filePos = offset;
+	packet.p.fd = SIM_FD;
+	packet.p.buffer = ee_addr(ee_offset);
+	packet.p.size = size;
+	packet.p.intrData = ee_addr(rests_offset);
+	result = call(FILEXIO_READ, &packet, sizeof(packet.p));
+
+	rests = (rests_pkt *)(ee_ram + rests_offset);
+	if(rests->ssize)
+		memcpy(ee_ptr(rests->sbuf), rests->sbuffer, rests->ssize);
+	if(rests->esize)
+		memcpy(ee_ptr(rests->ebuf), rests->ebuffer, rests->esize);
+
+	return result;
+}
+
+// Writes from EE RAM, sending the bytes before the first 64-byte boundary in the packet like fileXioWrite() does.
+static int ee_write(unsigned int offset, unsigned int ee_offset, int size)
+{
+	union { struct fxio_write_packet p; unsigned int words[32]; } packet;
+	unsigned int miss;
+
+	miss = (ee_offset & 0x3F) ? 64 - (ee_offset & 0x3F) : 0;
+	if(miss > size)
+		miss = size;
+
+	filePos = offset;
+	packet.p.fd = SIM_FD;
+	packet.p.buffer = ee_addr(ee_offset);
+	packet.p.size = size;
+	packet.p.unalignedDataLen = miss;
+	memcpy(packet.p.unalignedData, ee_ram + ee_offset, miss);
+
+	return call(FILEXIO_WRITE, &packet, sizeof(packet.p));
+}
+
+static void random_cases(int count)
+{
+	int i, offset, size, align, result;
+
+	set_rw_buffers(16384, count);
+
+	jitter = 1;
+	for(i = 0; i < CASES; i++)
+	{
+		size = (rand() % 4 == 0) ? rand() % 128 : rand() % (256 * 1024);
+		offset = rand() % (FILE_SIZE - size);
+		align = rand() % 128;
+
+		if(rand() % 2)
+		{
+			memset(ee_ram, 0xA5, align + size + 64);
+			if((result = ee_read(offset, align, size)) != size)
+				error("short read", offset, size, align);
+			else if(memcmp(ee_ram + align, expected + offset, size) != 0)
+				error("read returned the wrong data", offset, size, align);
+		} else {
+			memcpy(ee_ram + align, noise + rand() % (FILE_SIZE - size), size);
+			memcpy(expected + offset, ee_ram + align, size);
+			if((result = ee_write(offset, align, size)) != size)
+				error("short write", offset, size, align);
+			else if(memcmp(file + offset, expected + offset, size) != 0)
+				error("write stored the wrong data", offset, size, align);
+		}
+	}
+	jitter = 0;
+}
+
+static void stream(int count)
+{
+	double start, readTime;
+	int offset;
+
+	set_rw_buffers(16384, count);
+
+	start = now;
+	deviceTime = 0;
+	for(offset = 0; offset < FILE_SIZE; offset += STREAM_CALL)
+	{
+		if(ee_read(offset, offset, STREAM_CALL) != STREAM_CALL)
+			error("short read", offset, STREAM_CALL, 0);
+	}
+	readTime = now - start;
+	if(memcmp(ee_ram, file, FILE_SIZE) != 0)
+		error("streamed read returned the wrong data", 0, FILE_SIZE, 0);
+
+	printf("%d x %5d bytes: read %5.2fMB/s (device busy %3.0f%%)", count, 16384 / count,
+		FILE_SIZE / 1e6 / readTime, 100 * deviceTime / readTime);
+
+	start = now;
+	deviceTime = 0;
+	for(offset = 0; offset < FILE_SIZE; offset += STREAM_CALL)
+	{
+		if(ee_write(offset, offset, STREAM_CALL) != STREAM_CALL)
+			error("short write", offset, STREAM_CALL, 0);
+	}
+	printf(", write %5.2fMB/s (device busy %3.0f%%)\n", FILE_SIZE / 1e6 / (now - start), 100 * deviceTime / (now - start));
+}
+
+int main(void)
+{
+	int i;
+
+	srand(7);
+	for(i = 0; i < FILE_SIZE; i++)
+	{
+		file[i] = rand();
+		noise[i] = rand();
+	}
+	memcpy(expected, file, FILE_SIZE);
+
+#ifdef OLD_RWBUFFER
+	// There is a single buffer, the count is ignored.
+	random_cases(1);
+	stream(1);
+#else
+	random_cases(1);
+	random_cases(2);
+	random_cases(8);
+	stream(1);
+	stream(2);
+	stream(4);
+	stream(8);
+#endif
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return(errors ? 1 : 0);
+}
@@ -15,15 +15,23 @@
  * IO subsystem and provides access to HTTP.
  *
  * For each open request a file handle is allocated and any read request
- * is directed to the socket.  After close has been called the file
- * handle slot is free'd for the next request.
+ * is served from its receive buffer or directed to the socket.  After close
+ * has been called the file handle slot is free'd for the next request.
+ *
+ * Requests ask the server to keep the connection open. When a file is closed
+ * after its response was read completely, the connection is kept and reused
+ * by the next open of a file on the same server.
  *
  * No header information normally returned from a HTTP request is returned.
  * The client must know the content of the data stream and how to deal with it.
  *
- * lseek is currently only supported in order to get the size of a file. With
- * the current implimentation, it is not possible to seek to different positions
- * in a file.
+ * lseek moves the read position anywhere in the file. Reads after a seek are
+ * served from the receive buffer if possible, otherwise a new request with a
+ * Range header is sent for the data from the new position on.
+ *
+ * The receive buffer of each file is 1KB by default. For sequential streaming
+ * with small reads, a larger read-ahead buffer can be set with the module
+ * argument "readahead=<bytes>".
  *
  * With the current implimentation, hostnames may only be specified as an IP
  * address. This will change once we get a DNS resolver up & running with lwip.
@@ -36,6 +44,7 @@
 #include <sysclib.h>
 #include <ioman_mod.h>
 #include <sysmem.h>
+#include <intrman.h>
 
 #include "ps2ip.h"
 
@@ -47,13 +56,46 @@
 #define DBG_printf(args...) do { } while(0)
 #endif
 
+// Size of the receive buffer when no read-ahead size is given, it has to hold a header line.
+#define HTTP_BUFF_SIZE		1024
+// Forward seeks up to this far are read through instead of issuing a new request.
+#define HTTP_SKIP_MAX		16384
+// Persistent connections that are kept open between files.
+#define HTTP_MAX_IDLE		2
+
 typedef struct
 {
 	int sockFd;
 	int fileSize;
 	int filePos;
+	int sizeKnown;
+
+	// The response that is being received on sockFd
+	int streamPos;	// File position of the next byte from the socket.
+	int bodyEnd;	// File position after the last byte of the response, -1 if unknown.
+	int keepAlive;	// The connection can be reused once the response has been read.
+	int noRange;	// The server ignored a Range request and sent the whole file.
+
+	// The receive buffer, the bytes from bufBody to bufLen are the file data before streamPos.
+	u8 *buffer;
+	int bufSize;
+	int bufBody;
+	int bufLen;
+
+	struct sockaddr_in server;
+	char hostAddr[100];
+	char *url;
 } t_fioPrivData;
 
+typedef struct
+{
+	int sockFd;
+	struct sockaddr_in server;
+} t_httpIdleConn;
+
+static t_httpIdleConn idleConns[HTTP_MAX_IDLE];
+static int readAheadSize = HTTP_BUFF_SIZE;
+
 
 // example of basic HTTP 1.0 protocol request.
 char strTest[] = "GET /blah HTTP/1.0\n\n";
@@ -62,10 +104,12 @@ char HTTPGET[] = "GET ";
 char HTTPHOST[] = "Host: ";
 char HTTPGETEND[] = " HTTP/1.0\r\n";
 char HTTPUSERAGENT[] = "User-Agent: PS2IP HTTP Client\r\n";
+char HTTPKEEPALIVE[] = "Connection: keep-alive\r\n";
+char HTTPRANGE[] = "Range: bytes=";
 char HTTPENDHEADER[] = "\r\n";
 
-/** 
- * This function will parse the Content-Length header line and return the file size 
+/**
+ * This function will parse the Content-Length header line and return the file size
  */
 int parseContentLength(char *mimeBuffer)
 {
@@ -80,152 +124,53 @@ int parseContentLength(char *mimeBuffer)
 	return (int)strtol(line,NULL, 10);
 }
 
-/** 
- * This function will parse the initial response header line and return 0 for a "200 OK",
- * or return the error code in the event of an error (such as 404 - not found)
+/**
+ * This function will parse the Content-Range header line of a partial response,
+ * "bytes first-last/total". It returns the first byte and sets *total to the
+ * file size, or to -1 if the server doesn't know it.
  */
-int isErrorHeader(char *mimeBuffer)
+int parseContentRange(char *mimeBuffer, int *total)
 {
 	char *line;
-	int i;
-	int code;
+	int first;
 
-	line = strstr(mimeBuffer, "HTTP/1.");
-	line += strlen("HTTP/1.");
-
-	// Advance past minor protocol version number
-	line++;
+	line = strstr(mimeBuffer, "CONTENT-RANGE:");
+	line += strlen("CONTENT-RANGE:");
 
-	// Advance past any whitespace characters
+	// Advance past any whitespace characters and the unit
+	while((*line == ' ') || (*line == '\t')) line++;
+	if(strncmp(line, "BYTES", 5) == 0) line += 5;
 	while((*line == ' ') || (*line == '\t')) line++;
 
-	// Terminate string after status code
-	for(i = 0; ((line[i] != ' ') && (line[i] != '\t')); i++);
-	line[i] = '\0';
-
-	code = (int)strtol(line,NULL, 10);
-	if( code == 200 )
-		return 0;
-	else
-		return code;
-}
-
-/** 
- * When a request has been sent, we can expect mime headers to be
- * before the data.  We need to read exactly to the end of the headers
- * and no more data.  This readline reads a single char at a time.
- */
-int readLine( int socket, char * buffer, int size )
-{
-	char * ptr = buffer;
-	int count = 0;
-	int rc;
-
-	// Keep reading until we fill the buffer.
-
-	while ( count < size )
-	{
-		rc = recv( socket, ptr, 1, 0 );
-
-		if ( rc <= 0 ) return rc;
-
-		if ( (*ptr == '\n') ) break;
+	first = (int)strtol(line, NULL, 10);
 
-		// increment after check for cr.  Don't want to count the cr.
-		count++;
-		ptr++;
-	}
+	*total = -1;
+	if((line = strchr(line, '/')) != NULL && (line[1] != '*'))
+		*total = (int)strtol(line + 1, NULL, 10);
 
-	// Terminate string
-	*ptr = '\0';
-
-	// return how many bytes read.
-	return count;
+	return first;
 }
 
-
 /**
- * This is the main HTTP client connect work.  Makes the connection
- * and handles the protocol and reads the return headers.  Needs
- * to leave the stream at the start of the real data.
+ * This function will parse the initial response header line and return the status
+ * code, such as 200 for "200 OK" or 404 for "404 Not Found". *minor is set to the
+ * minor protocol version number.
  */
-int httpConnect( struct sockaddr_in * server, char *hostAddr, const char * url, t_fioPrivData *pHandle )
+int parseStatusCode(char *mimeBuffer, int *minor)
 {
-	int sockHandle;
-	int peerHandle;
-	int rc;
-	char mimeBuffer[100];
-
-#ifdef DEBUG
-	printf( "create socket\n" );
-#endif
-
-	if((sockHandle = socket( PF_INET, SOCK_STREAM, IPPROTO_TCP )) < 0)
-	{
-		printf( "HTTP: SOCKET FAILED\n" );
-		return -1;
-	}
-
-	DBG_printf( "connect\n" );
-
-	rc = connect( sockHandle, (struct sockaddr *) server, sizeof(*server));
-	if ( rc < 0 )
-	{
-		printf( "HTTP: CONNECT FAILED %i\n", sockHandle );
-		return -1;
-	}
-	peerHandle = sockHandle;
-
-	DBG_printf( "send\n" );
-
-	// Needs more error checking here.....
-	rc = send( peerHandle, HTTPGET,  sizeof( HTTPGET ) - 1, 0 );
-	rc = send( peerHandle, (void*) url, strlen( url ), 0 );
-	rc = send( peerHandle, HTTPGETEND, sizeof( HTTPGETEND ) - 1, 0 );
-
-	rc = send( peerHandle, HTTPHOST,  sizeof( HTTPHOST ) - 1, 0 );
-	rc = send( peerHandle, hostAddr, strlen( hostAddr ), 0 );
-	rc = send( peerHandle, HTTPENDHEADER, sizeof( HTTPENDHEADER ) - 1, 0 ); // "\r\n"
-
-	rc = send( peerHandle, HTTPUSERAGENT, sizeof( HTTPUSERAGENT ) - 1, 0 );
-	rc = send( peerHandle, HTTPENDHEADER, sizeof( HTTPENDHEADER ) - 1, 0 );
-
-	// We now need to read the header information
-	while ( 1 )
-	{
-		int i;
-
-		// read a line from the header information.
-		rc = readLine( peerHandle, mimeBuffer, 100 );
-
-		DBG_printf(">> %s", mimeBuffer);
-
-		if ( rc < 0 ) return rc;
-
-		// End of headers is a blank line.  exit.
-		if ( rc == 0 ) break;
-		if ( (rc == 1) && (mimeBuffer[0] == '\r') ) break;
+	char *line;
 
-		// Convert mimeBuffer to upper case, so we can do string comps
-		for(i = 0; i < strlen(mimeBuffer); i++)
-			mimeBuffer[i] = toupper(mimeBuffer[i]);
+	line = strstr(mimeBuffer, "HTTP/1.");
+	line += strlen("HTTP/1.");
 
-		if(strstr(mimeBuffer, "HTTP/1.")) // First line of header, contains status code. Check for an error code
-			if((rc = isErrorHeader(mimeBuffer))) {
-				printf("HTTP: status code = %d!\n", rc);
-				return -rc;
-			}
+	// Advance past minor protocol version number
+	*minor = *line - '0';
+	line++;
 
-		if(strstr(mimeBuffer, "CONTENT-LENGTH:"))
-		{
-			pHandle->fileSize = parseContentLength(mimeBuffer);
-			DBG_printf("fileSize = %d\n", pHandle->fileSize);
-		}
-	}
+	// Advance past any whitespace characters
+	while((*line == ' ') || (*line == '\t')) line++;
 
-	// We've sent the request, and read the headers.  SockHandle is
-	// now at the start of the main data read for a file io read.
-	return peerHandle;
+	return (int)strtol(line,NULL, 10);
 }
 
 char *strnchr(char *str, char ch, int max) {
@@ -352,6 +297,306 @@ const char *resolveAddress( struct sockaddr_in *server, const char * url, char *
 #endif
 }
 
+/**
+ * Persistent connections are kept in a small list when a file is closed after
+ * its response was read completely, and picked up again by the next request
+ * to the same server.
+ */
+int takeIdleConnection(struct sockaddr_in *server)
+{
+	int i, sockFd, state;
+
+	sockFd = -1;
+
+	CpuSuspendIntr(&state);
+	for(i = 0; i < HTTP_MAX_IDLE; i++)
+	{
+		if((idleConns[i].sockFd >= 0) &&
+		   (idleConns[i].server.sin_addr.s_addr == server->sin_addr.s_addr) &&
+		   (idleConns[i].server.sin_port == server->sin_port))
+		{
+			sockFd = idleConns[i].sockFd;
+			idleConns[i].sockFd = -1;
+			break;
+		}
+	}
+	CpuResumeIntr(state);
+
+	return sockFd;
+}
+
+void putIdleConnection(int sockFd, struct sockaddr_in *server)
+{
+	int i, state;
+
+	CpuSuspendIntr(&state);
+	for(i = 0; i < HTTP_MAX_IDLE; i++)
+	{
+		if(idleConns[i].sockFd < 0)
+		{
+			idleConns[i].sockFd = sockFd;
+			idleConns[i].server = *server;
+			break;
+		}
+	}
+	CpuResumeIntr(state);
+
+	// No free slot, the connection can't be kept.
+	if(i == HTTP_MAX_IDLE)
+		lwip_close(sockFd);
+}
+
+/**
+ * Appends a string to the request being built in the receive buffer, sending
+ * the buffer whenever it fills up. Returns the new length of the request.
+ */
+int appendRequest(t_fioPrivData *pHandle, int len, const char *str)
+{
+	while(*str != '\0')
+	{
+		if(len == pHandle->bufSize)
+		{
+			if(send(pHandle->sockFd, pHandle->buffer, len, 0) != len)
+				return -1;
+			len = 0;
+		}
+
+		pHandle->buffer[len++] = *str++;
+	}
+
+	return len;
+}
+
+/**
+ * Sends the GET request for the file, starting at offset. The request is sent with
+ * as few calls to send as possible, so that it normally goes out in one segment.
+ */
+int sendRequest(t_fioPrivData *pHandle, int offset)
+{
+	char range[16];
+	int len = 0;
+
+	len = appendRequest(pHandle, len, HTTPGET);
+	if(len >= 0) len = appendRequest(pHandle, len, pHandle->url);
+	if(len >= 0) len = appendRequest(pHandle, len, HTTPGETEND);
+
+	if(len >= 0) len = appendRequest(pHandle, len, HTTPHOST);
+	if(len >= 0) len = appendRequest(pHandle, len, pHandle->hostAddr);
+	if(len >= 0) len = appendRequest(pHandle, len, HTTPENDHEADER); // "\r\n"
+
+	if(len >= 0) len = appendRequest(pHandle, len, HTTPUSERAGENT);
+	if(len >= 0) len = appendRequest(pHandle, len, HTTPKEEPALIVE);
+
+	if(offset > 0)
+	{
+		sprintf(range, "%d-\r\n", offset);
+		if(len >= 0) len = appendRequest(pHandle, len, HTTPRANGE);
+		if(len >= 0) len = appendRequest(pHandle, len, range);
+	}
+
+	if(len >= 0) len = appendRequest(pHandle, len, HTTPENDHEADER);
+
+	if(len < 0)
+		return -1;
+
+	return (send(pHandle->sockFd, pHandle->buffer, len, 0) == len) ? 0 : -1;
+}
+
+/**
+ * When a request has been sent, we can expect mime headers to be
+ * before the data. The headers are received into the receive buffer,
+ * as much as the socket has at a time, and any data after them is
+ * left there as the start of the body. Returns -1 if the connection
+ * failed, or the negated status code in the event of an HTTP error.
+ */
+int readHeaders(t_fioPrivData *pHandle, int offset)
+{
+	char *line, *end;
+	int rc, i, minor;
+	int status = 0, overlong = 0;
+	int length = -1, first = offset, total = -1;
+
+	pHandle->bufBody = 0;
+	pHandle->bufLen = 0;
+	pHandle->keepAlive = 0;
+
+	while(1)
+	{
+		line = (char *)&pHandle->buffer[pHandle->bufBody];
+
+		if((end = strnchr(line, '\n', pHandle->bufLen - pHandle->bufBody)) == NULL)
+		{
+			// Incomplete line, move it to the start of the buffer and receive more.
+			if(pHandle->bufBody == 0 && pHandle->bufLen == pHandle->bufSize)
+			{
+				// The line doesn't fit, skip it.
+				pHandle->bufLen = 0;
+				overlong = 1;
+			}
+			else if(pHandle->bufBody > 0)
+			{
+				memmove(pHandle->buffer, line, pHandle->bufLen - pHandle->bufBody);
+				pHandle->bufLen -= pHandle->bufBody;
+				pHandle->bufBody = 0;
+			}
+
+			rc = recv(pHandle->sockFd, &pHandle->buffer[pHandle->bufLen], pHandle->bufSize - pHandle->bufLen, 0);
+			if(rc <= 0) return -1;
+
+			pHandle->bufLen += rc;
+			continue;
+		}
+
+		pHandle->bufBody += end - line + 1;
+
+		// Terminate the line, without the cr.
+		*end = '\0';
+		if((end > line) && (end[-1] == '\r')) end[-1] = '\0';
+
+		DBG_printf(">> %s\n", line);
+
+		if(overlong)
+		{
+			overlong = 0;
+			continue;
+		}
+
+		// End of headers is a blank line.  exit.
+		if(line[0] == '\0') break;
+
+		// Convert the line to upper case, so we can do string comps
+		for(i = 0; line[i] != '\0'; i++)
+			line[i] = toupper(line[i]);
+
+		if(!status)
+		{
+			// First line of header, contains status code. Check for an error code
+			if(strstr(line, "HTTP/1.") == NULL)
+				return -1;
+
+			status = parseStatusCode(line, &minor);
+			if((status != 200) && (status != 206)) {
+				printf("HTTP: status code = %d!\n", status);
+				return -status;
+			}
+
+			// HTTP/1.1 servers keep the connection open unless they say otherwise.
+			pHandle->keepAlive = (minor >= 1);
+			continue;
+		}
+
+		if(strstr(line, "CONTENT-LENGTH:"))
+			length = parseContentLength(line);
+		else if(strstr(line, "CONTENT-RANGE:"))
+			first = parseContentRange(line, &total);
+		else if(strstr(line, "CONNECTION:"))
+		{
+			if(strstr(line, "KEEP-ALIVE"))
+				pHandle->keepAlive = 1;
+			else if(strstr(line, "CLOSE"))
+				pHandle->keepAlive = 0;
+		}
+	}
+
+	if(!status)
+		return -1;
+
+	if(status == 200)
+	{
+		// The whole file, also when the server ignored a Range request.
+		first = 0;
+		total = length;
+		if(offset > 0)
+			pHandle->noRange = 1;
+	}
+	else if(total < 0 && length >= 0)
+		total = first + length;
+
+	if(total >= 0)
+	{
+		pHandle->fileSize = total;
+		pHandle->sizeKnown = 1;
+		DBG_printf("fileSize = %d\n", pHandle->fileSize);
+	}
+
+	// Without a length, the end of the response is only known when the server closes the connection.
+	pHandle->bodyEnd = (length >= 0) ? first + length : -1;
+	if(pHandle->bodyEnd < 0)
+		pHandle->keepAlive = 0;
+
+	pHandle->streamPos = first + pHandle->bufLen - pHandle->bufBody;
+
+	return 0;
+}
+
+/**
+ * This is the main HTTP client connect work.  Makes the connection
+ * (or reuses the current or an idle one to the same server), sends
+ * the request for the data from offset on and reads the return headers.
+ */
+int httpConnect( t_fioPrivData *pHandle, int offset )
+{
+	int rc, reused;
+
+	// The current connection can only be used again if its response has been read completely.
+	if((pHandle->sockFd >= 0) && !(pHandle->keepAlive && (pHandle->streamPos == pHandle->bodyEnd)))
+	{
+		lwip_close(pHandle->sockFd);
+		pHandle->sockFd = -1;
+	}
+
+	while(1)
+	{
+		reused = 1;
+
+		if(pHandle->sockFd < 0)
+			pHandle->sockFd = takeIdleConnection(&pHandle->server);
+
+		if(pHandle->sockFd < 0)
+		{
+			reused = 0;
+
+			DBG_printf( "create socket\n" );
+
+			if((pHandle->sockFd = socket( PF_INET, SOCK_STREAM, IPPROTO_TCP )) < 0)
+			{
+				printf( "HTTP: SOCKET FAILED\n" );
+				return -1;
+			}
+
+			DBG_printf( "connect\n" );
+
+			rc = connect( pHandle->sockFd, (struct sockaddr *) &pHandle->server, sizeof(pHandle->server));
+			if ( rc < 0 )
+			{
+				printf( "HTTP: CONNECT FAILED %i\n", pHandle->sockFd );
+				lwip_close(pHandle->sockFd);
+				pHandle->sockFd = -1;
+				return -1;
+			}
+		}
+
+		DBG_printf( "send\n" );
+
+		if((rc = sendRequest(pHandle, offset)) == 0)
+			rc = readHeaders(pHandle, offset);
+
+		if(rc == 0)
+			break;
+
+		lwip_close(pHandle->sockFd);
+		pHandle->sockFd = -1;
+
+		// A persistent connection may have been closed by the server in the meantime, retry on a new one.
+		if(!reused || rc != -1)
+			return rc;
+	}
+
+	// We've sent the request, and read the headers. The start of the
+	// data, from file position offset on, is in the receive buffer.
+	return 0;
+}
+
 /**
  * Any calls we don't implement calls dummy.
  */
@@ -371,15 +616,15 @@ int httpInitialize(iop_io_device_t *driver)
 /**
  * Open has the most work to do in the file driver.  It must:
  *
- *  1. Find a free file Handle.
+ *  1. Allocate a file Handle and its receive buffer.
  *  2. Check we have a valid IP address and URL.
- *  3. Try and connect to the remote server.
+ *  3. Try and connect to the remote server, or reuse an idle connection to it.
  *  4. Send a GET request to the server
  *  5. Parse the GET response header from the server
  */
 int httpOpen(iop_io_file_t *f, const char *name, int mode)
 {
-	int peerHandle = 0;
+	int rc;
 	struct sockaddr_in server;
 	const char *getName;
 	t_fioPrivData *privData;
@@ -389,78 +634,171 @@ int httpOpen(iop_io_file_t *f, const char *name, int mode)
 	printf("httpOpen(-, %s, %d)\n", name, mode);
 #endif
 
-	if((privData = AllocSysMemory(ALLOC_FIRST, sizeof(t_fioPrivData), NULL)) == NULL)
-		return -1;
-
-	f->privdata = privData;
-
-	privData->fileSize = 0;
-	privData->filePos = 0;
-
 	memset(&server, 0, sizeof(server));
 	// Check valid IP address and URL
 	if((getName = resolveAddress( &server, name, hostAddr )) == NULL)
-	{
-		FreeSysMemory(privData);
 		return -2;
-	}
+
+	// The handle, the receive buffer and the URL for later requests in one block.
+	if((privData = AllocSysMemory(ALLOC_FIRST, sizeof(t_fioPrivData) + readAheadSize + strlen(getName) + 1, NULL)) == NULL)
+		return -1;
+
+	f->privdata = privData;
+
+	memset(privData, 0, sizeof(t_fioPrivData));
+	privData->sockFd = -1;
+	privData->bodyEnd = -1;
+	privData->buffer = (u8 *)(privData + 1);
+	privData->bufSize = readAheadSize;
+	privData->url = (char *)&privData->buffer[readAheadSize];
+	privData->server = server;
+	strcpy(privData->hostAddr, hostAddr);
+	strcpy(privData->url, getName);
 
 	// Now we connect and initiate the transfer by sending a
 	// request header to the server, and receiving the response header
-	if((peerHandle = httpConnect( &server, hostAddr, getName, privData )) < 0)
+	if((rc = httpConnect( privData, 0 )) < 0)
 	{
-        printf("HTTP: failed to connect to '%s'!\n", hostAddr);
+		printf("HTTP: failed to connect to '%s'!\n", hostAddr);
 		FreeSysMemory(privData);
-		return peerHandle;
+		return rc;
 	}
 
-	// http connect returns valid socket.  Save in handle list.
-	privData->sockFd = peerHandle;
-
 	// return success.  We got it all ready. :)
 	return 0;
 }
 
+/**
+ * Called when the socket returned rc <= 0 while receiving the body.
+ */
+void httpStreamEnd(t_fioPrivData *privData, int rc)
+{
+	if((rc == 0) && (privData->bodyEnd < 0))
+	{
+		// The server closed the connection at the end of a response without a length.
+		privData->fileSize = privData->streamPos;
+		privData->sizeKnown = 1;
+		privData->bodyEnd = privData->streamPos;
+	}
+
+	// The next read needs a new request.
+	lwip_close(privData->sockFd);
+	privData->sockFd = -1;
+}
 
 /**
- * Read is simple.  It simply needs to find the socket no
- * based on the file handle and call recv.
+ * Read serves data from the receive buffer and the socket at the file position.
+ * Small reads are filled from the buffer, which is refilled with as much data as
+ * the socket has, while reads larger than the buffer go straight to the caller.
+ * If the position was moved outside of the buffered data, the data in between is
+ * read through for short forward seeks, otherwise a new request is sent for the
+ * rest of the file from the position on.
  */
 int httpRead(iop_io_file_t *f, void *buffer, int size)
 {
-	int bytesRead = 0;
 	t_fioPrivData *privData = (t_fioPrivData *)f->privdata;
 	int left = size;
 	int totalRead = 0;
+	int n, rc;
 
 #ifdef DEBUG
 	printf("httpRead(-, 0x%X, %d)\n", (int)buffer, size);
 #endif
 
+	if(privData->sizeKnown)
+	{
+		if(privData->filePos >= privData->fileSize)
+			return 0;
+		if(left > privData->fileSize - privData->filePos)
+			left = privData->fileSize - privData->filePos;
+	}
+
 	// Read until: there is an error, we've read "size" bytes or the remote
 	//             side has closed the connection.
-	do {
+	while(left > 0)
+	{
+		if((privData->filePos < privData->streamPos) &&
+		   (privData->filePos >= privData->streamPos - (privData->bufLen - privData->bufBody)))
+		{
+			// The data is in the receive buffer.
+			n = privData->streamPos - privData->filePos;
+			if(n > left) n = left;
 
-		bytesRead = recv( privData->sockFd, buffer + totalRead, left, 0 );
+			memcpy(buffer + totalRead, &privData->buffer[privData->bufLen - (privData->streamPos - privData->filePos)], n);
+
+			privData->filePos += n;
+			left -= n;
+			totalRead += n;
+			continue;
+		}
+
+		if((privData->sockFd < 0) || (privData->filePos < privData->streamPos) ||
+		   (!privData->noRange && (privData->filePos - privData->streamPos > HTTP_SKIP_MAX)) ||
+		   ((privData->bodyEnd >= 0) && (privData->streamPos >= privData->bodyEnd)))
+		{
+			if(privData->sizeKnown && (privData->filePos >= privData->fileSize))
+				break;
+
+			// Ask for the data from the file position on.
+			if((rc = httpConnect(privData, privData->filePos)) < 0)
+				return (totalRead > 0) ? totalRead : rc;
+
+			continue;
+		}
+
+		n = privData->bufSize;
+		if((privData->bodyEnd >= 0) && (n > privData->bodyEnd - privData->streamPos))
+			n = privData->bodyEnd - privData->streamPos;
+
+		if((privData->filePos == privData->streamPos) && (left >= n))
+		{
+			// Large reads go straight to the caller's buffer.
+			if((privData->bodyEnd >= 0) && (left > privData->bodyEnd - privData->streamPos))
+				n = privData->bodyEnd - privData->streamPos;
+			else
+				n = left;
+
+			rc = recv(privData->sockFd, buffer + totalRead, n, 0);
 
 #ifdef DEBUG
-//		printf("bytesRead = %d\n", bytesRead);
+//			printf("bytesRead = %d\n", rc);
 #endif
 
-		if(bytesRead <= 0) break;
+			if(rc <= 0)
+			{
+				httpStreamEnd(privData, rc);
+				break;
+			}
+
+			privData->bufBody = privData->bufLen = 0;
+			privData->streamPos += rc;
+			privData->filePos += rc;
+			left -= rc;
+			totalRead += rc;
+			continue;
+		}
 
-		left -= bytesRead;
-		totalRead += bytesRead;
+		// Refill the buffer, this also reads through the data before the file position.
+		rc = recv(privData->sockFd, privData->buffer, n, 0);
+		if(rc <= 0)
+		{
+			httpStreamEnd(privData, rc);
+			break;
+		}
 
-	} while(left);
+		privData->bufBody = 0;
+		privData->bufLen = rc;
+		privData->streamPos += rc;
+	}
 
 	return totalRead;
 }
 
 
 /**
- * Close finds the correct handle and
- * calls disconnect.
+ * Close finds the correct handle and calls disconnect, unless the
+ * response was read completely and the connection can be kept for
+ * the next file from the same server.
  */
 int httpClose(iop_io_file_t *f)
 {
@@ -470,20 +808,27 @@ int httpClose(iop_io_file_t *f)
 	printf("httpClose(-)\n");
 #endif
 
-	lwip_close(privData->sockFd);
+	if(privData->sockFd >= 0)
+	{
+		if(privData->keepAlive && (privData->streamPos == privData->bodyEnd))
+			putIdleConnection(privData->sockFd, &privData->server);
+		else
+			lwip_close(privData->sockFd);
+	}
+
 	FreeSysMemory(privData);
 
 	return 0;
 }
 
 /**
- * lseek is only supported in order to get the size of a file. Allough the function
- * does modify the filePos member, this does not have any effect on the read position
- * of the file in the current implimentation.
+ * lseek only sets the file position, the next read continues from the buffered data
+ * or requests the data from the new position with a Range request.
  */
 int httpLseek(iop_io_file_t *f, int offset, int mode)
 {
 	t_fioPrivData *privData = (t_fioPrivData *)f->privdata;
+	int pos;
 
 #ifdef DEBUG
 	printf("httpLseek(-, %d, %d)\n", (int)offset, mode);
@@ -492,21 +837,26 @@ int httpLseek(iop_io_file_t *f, int offset, int mode)
 	switch(mode)
 	{
 		case SEEK_SET:
-			privData->filePos = offset;
+			pos = offset;
 			break;
 
 		case SEEK_CUR:
-			privData->filePos += offset;
+			pos = privData->filePos + offset;
 			break;
 
 		case SEEK_END:
-			privData->filePos = privData->fileSize + offset;
+			pos = privData->fileSize + offset;
 			break;
 
 		default:
 			return -1;
 	}
 
+	if(pos < 0)
+		return -1;
+
+	privData->filePos = pos;
+
 	return privData->filePos;
 }
 
@@ -531,8 +881,24 @@ iop_io_device_t ps2httpDev = {
  */
 int _start( int argc, char **argv)
 {
+	int i;
+
 	printf("PS2HTTP: Module Loaded\n");
 
+	// "readahead=<bytes>" sets the size of the receive buffer of each file.
+	for(i = 1; i < argc; i++)
+	{
+		if(strncmp(argv[i], "readahead=", 10) == 0)
+			readAheadSize = (int)strtol(&argv[i][10], NULL, 10);
+	}
+
+	if(readAheadSize < HTTP_BUFF_SIZE)
+		readAheadSize = HTTP_BUFF_SIZE;
+	readAheadSize = (readAheadSize + 3) & ~3;
+
+	for(i = 0; i < HTTP_MAX_IDLE; i++)
+		idleConns[i].sockFd = -1;
+
 	printf("PS2HTTP: Adding 'http' driver into io system\n");
 	io_DelDrv( "http");
 	io_AddDrv(&ps2httpDev);
@@ -0,0 +1,4 @@
+/* Host stand-in for the IOP intrman.h. */
+
+static inline int CpuSuspendIntr(int *state) { return 0; }
+static inline int CpuResumeIntr(int state) { return 0; }
@@ -0,0 +1,38 @@
+/* Host stand-in for the IOP ioman_mod.h, with what ps2http.c uses. */
+
+typedef struct {
+	void	*privdata;
+} iop_io_file_t;
+
+typedef struct {
+	void	*io_init;
+	void	*io_deinit;
+	void	*io_format;
+	void	*io_open;
+	void	*io_close;
+	void	*io_read;
+	void	*io_write;
+	void	*io_lseek;
+	void	*io_ioctl;
+	void	*io_remove;
+	void	*io_mkdir;
+	void	*io_rmdir;
+	void	*io_dopen;
+	void	*io_dclose;
+	void	*io_dread;
+	void	*io_getstat;
+	void	*io_chstat;
+} iop_io_device_ops_t;
+
+typedef struct {
+	const char		*name;
+	int			type;
+	int			version;
+	const char		*desc;
+	iop_io_device_ops_t	*ops;
+} iop_io_device_t;
+
+#define IOP_DT_FS	0x10
+
+static inline int io_AddDrv(iop_io_device_t *device) { return 0; }
+static inline int io_DelDrv(const char *name) { return 0; }
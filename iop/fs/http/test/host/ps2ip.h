@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for ps2ip.h, on the host sockets. connect() and recv() go through
+ * test_connect() and test_recv() in http_test.c, which count the calls.
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+
+/* ps2http.c casts sin_addr to struct ip4_addr, so it is the host's struct in_addr here. */
+#define ip4_addr	in_addr
+
+#define IP4_ADDR(ipaddr, a, b, c, d)	((ipaddr)->s_addr = htonl(((a) << 24) | ((b) << 16) | ((c) << 8) | (d)))
+
+#define lwip_close	close
+
+int test_connect(int s, const struct sockaddr *name, socklen_t namelen);
+ssize_t test_recv(int s, void *mem, size_t len, int flags);
+
+#define connect		test_connect
+#define recv		test_recv
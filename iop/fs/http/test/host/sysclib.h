@@ -0,0 +1,5 @@
+/* Host stand-in for the IOP sysclib.h. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
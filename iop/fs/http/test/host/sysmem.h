@@ -0,0 +1,8 @@
+/* Host stand-in for the IOP sysmem.h. */
+
+#include <stdlib.h>
+
+#define ALLOC_FIRST	0
+
+static inline void *AllocSysMemory(int mode, int size, void *ptr) { return malloc(size); }
+static inline int FreeSysMemory(void *ptr) { free(ptr); return 0; }
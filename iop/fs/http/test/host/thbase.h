@@ -0,0 +1 @@
+/* Host stand-in for the IOP thbase.h, nothing from it is needed. */
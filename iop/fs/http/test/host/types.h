@@ -0,0 +1,3 @@
+/* Host stand-in for the IOP types.h. */
+
+typedef unsigned char u8;
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+#
+# HTTP server for http_test.c on 127.0.0.1.
+#
+# It serves /data.bin, 2.5 MB filled with the pattern that http_test.c checks,
+# and /small.txt, 5 KB of text. Other paths get 404.
+#
+# Usage: http_server.py port protocol range
+#   protocol  HTTP/1.1 keeps connections open, HTTP/1.0 closes them
+#   range     "range" answers Range requests with 206, anything else ignores them
+
+import http.server
+import re
+import sys
+
+port, protocol, use_range = int(sys.argv[1]), sys.argv[2], sys.argv[3] == 'range'
+
+files = {
+    '/data.bin': bytes(((i * 7) + (i >> 8)) & 0xff for i in range(2500000)),
+    '/small.txt': b''.join(b'line %04d of the small file\n' % i for i in range(200))[:5000],
+}
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = protocol
+
+    def log_message(self, *args):
+        pass
+
+    def do_GET(self):
+        data = files.get(self.path)
+        if data is None:
+            self.send_error(404)
+            return
+
+        start = 0
+        match = re.match(r'bytes=(\d+)-', self.headers.get('Range', '')) if use_range else None
+        if match and int(match.group(1)) < len(data):
+            start = int(match.group(1))
+            self.send_response(206)
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, len(data) - 1, len(data)))
+        else:
+            self.send_response(200)
+
+        self.send_header('Content-Length', str(len(data) - start))
+        self.end_headers()
+        self.wfile.write(data[start:])
+
+http.server.ThreadingHTTPServer(('127.0.0.1', port), Handler).serve_forever()
@@ -0,0 +1,152 @@
+/*
+ * Host test of the ps2http driver against http_server.py on 127.0.0.1.
+ *
+ * ps2http.c is built with the host sockets. The test reads a 2.5 MB file
+ * sequentially in small reads, then makes random seeks and reads of up to
+ * 200 KB on it, checking every byte, and opens a missing file. Ten opens of a
+ * small file show how many connections and recv() calls are made.
+ * Any module arguments, such as "readahead=8192", are passed to the driver.
+ *
+ * Build and run from the root of the tree, once for each server mode:
+ *
+ *   gcc -O2 -Wall -Iiop/fs/http/test/host iop/fs/http/test/http_test.c -o http_test
+ *   for mode in "HTTP/1.1 range" "HTTP/1.0 range" "HTTP/1.1 norange"; do
+ *       python3 iop/fs/http/test/http_server.py 8765 $mode 2>/dev/null & sleep 2
+ *       ./http_test 8765; kill $!
+ *   done
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _start http_start
+#include "../src/ps2http.c"
+#undef _start
+
+#undef connect
+#undef recv
+
+#define DATA_SIZE	2500000
+
+static int connects = 0, recvs = 0;
+static unsigned char data[DATA_SIZE];
+static unsigned char buf[300000];
+
+int test_connect(int s, const struct sockaddr *name, socklen_t namelen)
+{
+	connects++;
+	return connect(s, name, namelen);
+}
+
+ssize_t test_recv(int s, void *mem, size_t len, int flags)
+{
+	recvs++;
+	return recv(s, mem, len, flags);
+}
+
+static int fail(const char *what, int offset)
+{
+	printf("FAIL: %s at %d\n", what, offset);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	iop_io_file_t f;
+	char url[64], small[64], missing[64];
+	int i, k, n, pos, offset, len, expect, total;
+
+	if(argc < 2)
+	{
+		printf("usage: %s port [module arguments]\n", argv[0]);
+		return 1;
+	}
+
+	sprintf(url, "//127.0.0.1:%s/data.bin", argv[1]);
+	sprintf(small, "//127.0.0.1:%s/small.txt", argv[1]);
+	sprintf(missing, "//127.0.0.1:%s/missing.bin", argv[1]);
+
+	for(i = 0; i < DATA_SIZE; i++)
+		data[i] = i * 7 + (i >> 8);
+
+	http_start(argc - 1, argv + 1);
+
+	// Sequential small reads, after finding the size with lseek
+	if(httpOpen(&f, url, 0) != 0)
+		return fail("open", 0);
+
+	if(httpLseek(&f, 0, SEEK_END) != DATA_SIZE)
+		return fail("size from lseek", 0);
+	httpLseek(&f, 0, SEEK_SET);
+
+	for(pos = 0; (n = httpRead(&f, buf, 512)) > 0; pos += n)
+	{
+		if(memcmp(buf, data + pos, n))
+			return fail("sequential read", pos);
+	}
+
+	if(pos != DATA_SIZE)
+		return fail("end of the sequential read", pos);
+
+	httpClose(&f);
+	printf("sequential 512-byte reads: %d bytes, %d connections, %d recv calls\n", pos, connects, recvs);
+
+	// Random seeks, a third of them short forward ones
+	srand(1);
+	connects = recvs = 0;
+
+	for(i = 0; i < 20; i++)
+	{
+		if(httpOpen(&f, url, 0) != 0)
+			return fail("open", 0);
+
+		for(k = 0; k < 20; k++)
+		{
+			offset = (k % 3 == 0) ? pos + rand() % 20000 : rand() % (DATA_SIZE + 10);
+			len = rand() % 200000;
+			expect = (offset >= DATA_SIZE) ? 0 : ((len < DATA_SIZE - offset) ? len : DATA_SIZE - offset);
+
+			httpLseek(&f, offset, SEEK_SET);
+			n = httpRead(&f, buf, len);
+
+			if(n != expect || memcmp(buf, data + offset, n))
+				return fail("read after a seek", offset);
+
+			pos = offset + n;
+		}
+
+		// Reading to the end lets the connection be kept
+		httpLseek(&f, DATA_SIZE - 100, SEEK_SET);
+		if(httpRead(&f, buf, 1000) != 100)
+			return fail("read at the end", DATA_SIZE - 100);
+
+		httpClose(&f);
+	}
+
+	printf("400 random seeks and reads in 20 opens: %d connections, %d recv calls\n", connects, recvs);
+
+	// Ten opens of a small file
+	connects = recvs = 0;
+
+	for(i = 0; i < 10; i++)
+	{
+		if(httpOpen(&f, small, 0) != 0)
+			return fail("open", 0);
+
+		for(total = 0; (n = httpRead(&f, buf, sizeof(buf))) > 0; total += n);
+		httpClose(&f);
+
+		if(total != 5000)
+			return fail("size of the small file", total);
+	}
+
+	printf("10 opens of a 5000-byte file: %d connections, %d recv calls\n", connects, recvs);
+
+	if(httpOpen(&f, missing, 0) >= 0)
+		return fail("open of a missing file", 0);
+
+	printf("OK\n");
+
+	return 0;
+}
@@ -184,11 +184,16 @@ typedef struct {
 	pfs_blockinfo_t current_dir;	// block info for current directory
 	u32 lastError;				// 0 if no error :)
 	u32 free_zone[65];			// free zones in each partition (1 main + 64 possible subs)
+	struct pfs_cache_s *dirty;	// buffers that were marked dirty since the last flush
 } pfs_mount_t;
 
 typedef struct pfs_cache_s {
 	struct pfs_cache_s *next;	//
 	struct pfs_cache_s *prev;	//
+	struct pfs_cache_s *hnext;	// next entry in the same hash bucket
+	struct pfs_cache_s **hprev;	// link pointing to this entry (NULL if not hashed)
+	struct pfs_cache_s *dnext;	// next entry in the mount's dirty list
+	struct pfs_cache_s **dprev;	// link pointing to this entry (NULL if not in a dirty list)
 	u16 flags;					//
 	u16 nused;					//
 	pfs_mount_t *pfsMount;		//
@@ -234,6 +239,7 @@ void pfsCacheLink(pfs_cache_t *clink, pfs_cache_t *cnew);
 pfs_cache_t *pfsCacheUnLink(pfs_cache_t *clink);
 pfs_cache_t *pfsCacheUsedAdd(pfs_cache_t *clink);
 int pfsCacheTransfer(pfs_cache_t* clink, int mode);
+void pfsCacheMarkDirty(pfs_cache_t *clink);
 void pfsCacheFlushAllDirty(pfs_mount_t *pfsMount);
 pfs_cache_t *pfsCacheAlloc(pfs_mount_t *pfsMount, u16 sub, u32 block, int flags, int *result);
 pfs_cache_t *pfsCacheGetData(pfs_mount_t *pfsMount, u16 sub, u32 block, int flags, int *result);
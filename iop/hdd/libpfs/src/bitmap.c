@@ -67,7 +67,7 @@ void pfsBitmapAllocFree(pfs_cache_t *clink, u32 operation, u32 subpart, u32 chun
 		}
 
 		index = 0;
-		clink->flags |= PFS_CACHE_FLAG_DIRTY;
+		pfsCacheMarkDirty(clink);
 		pfsCacheFree(clink);
 
 		if (count==0)
@@ -136,7 +136,7 @@ int pfsBitmapAllocateAdditionalZones(pfs_mount_t *pfsMount, pfs_blockinfo_t *bi,
 				res++;
 				*bitmapWord |= 1<<info.bit;
 				info.bit++;
-				c->flags |= PFS_CACHE_FLAG_DIRTY;
+				pfsCacheMarkDirty(c);
 			}
 		}
 		pfsCacheFree(c);
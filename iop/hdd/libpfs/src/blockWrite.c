@@ -36,8 +36,8 @@ int pfsBlockExpandSegment(pfs_cache_t *clink, pfs_blockpos_t *blockpos, u32 coun
 	{
 		bi->count+=ret;
 		clink->u.inode->number_blocks+=ret;
-		blockpos->inode->flags |= PFS_CACHE_FLAG_DIRTY;
-		clink->flags |= PFS_CACHE_FLAG_DIRTY;
+		pfsCacheMarkDirty(blockpos->inode);
+		pfsCacheMarkDirty(clink);
 	}
 
 	return ret;
@@ -79,7 +79,7 @@ int pfsBlockAllocNewSegment(pfs_cache_t *clink, pfs_blockpos_t *blockpos, u32 bl
 		memcpy(&clink2->u.inode->last_segment, &blockpos->inode->u.inode->data[0], sizeof(pfs_blockinfo_t));
 		memcpy(&clink2->u.inode->data[0], &bi, sizeof(pfs_blockinfo_t));
 
-		clink2->flags |= PFS_CACHE_FLAG_DIRTY;
+		pfsCacheMarkDirty(clink2);
 
 		clink->u.inode->number_blocks+=bi.count;
 		clink->u.inode->number_data++;
@@ -88,13 +88,13 @@ int pfsBlockAllocNewSegment(pfs_cache_t *clink, pfs_blockpos_t *blockpos, u32 bl
 
 		clink->u.inode->number_segdesg++;
 
-		clink->flags |= PFS_CACHE_FLAG_DIRTY;
+		pfsCacheMarkDirty(clink);
 		blockpos->block_segment++;
 		blockpos->block_offset=0;
 
 		memcpy(&blockpos->inode->u.inode->next_segment, &bi, sizeof(pfs_blockinfo_t));
 
-		blockpos->inode->flags |= PFS_CACHE_FLAG_DIRTY;
+		pfsCacheMarkDirty(blockpos->inode);
 		pfsCacheFree(blockpos->inode);
 		blockpos->inode=clink2;
 	}
@@ -113,14 +113,14 @@ int pfsBlockAllocNewSegment(pfs_cache_t *clink, pfs_blockpos_t *blockpos, u32 bl
 
 	clink->u.inode->number_blocks += bi.count;
 	clink->u.inode->number_data++;
-	clink->flags |= PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(clink);
 	blockpos->block_offset=0;
 	blockpos->block_segment++;
 
 	i = pfsFixIndex(clink->u.inode->number_data-1);
 	memcpy(&blockpos->inode->u.inode->data[i], &bi, sizeof(pfs_blockinfo_t));
 
-	blockpos->inode->flags |= PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(blockpos->inode);
 	blocks -= bi.count;
 	if (blocks)
 		blocks -= pfsBlockExpandSegment(clink, blockpos, blocks);
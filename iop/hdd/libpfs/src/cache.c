@@ -27,6 +27,69 @@ extern u32 pfsBlockSize;
 pfs_cache_t *pfsCacheBuf;
 u32 pfsCacheNumBuffers;
 
+// Hash index over (mount, sub, block), so that lookups do not need to scan every buffer.
+static pfs_cache_t **pfsCacheHashTable;
+static u32 pfsCacheHashMask;
+
+static pfs_cache_t **pfsCacheHashBucket(pfs_mount_t *pfsMount, u32 sub, u32 block)
+{
+	u32 hash;
+
+	hash = ((u32)pfsMount >> 4) ^ (sub << 5) ^ block ^ (block >> 7);
+	return &pfsCacheHashTable[hash & pfsCacheHashMask];
+}
+
+static void pfsCacheHashRemove(pfs_cache_t *clink)
+{
+	if(clink->hprev != NULL) {
+		if(clink->hnext != NULL)
+			clink->hnext->hprev = clink->hprev;
+		*clink->hprev = clink->hnext;
+		clink->hnext = NULL;
+		clink->hprev = NULL;
+	}
+}
+
+static void pfsCacheHashInsert(pfs_cache_t *clink)
+{
+	pfs_cache_t **bucket;
+
+	bucket = pfsCacheHashBucket(clink->pfsMount, clink->sub, clink->block);
+	clink->hnext = *bucket;
+	clink->hprev = bucket;
+	if(*bucket != NULL)
+		(*bucket)->hprev = &clink->hnext;
+	*bucket = clink;
+}
+
+/*	Dirty buffers are also kept in a list on their mount, so that flushing a mount doesn't need to scan
+	every buffer. A buffer stays in the list when it is cleaned or invalidated by clearing its flag or
+	mount directly, such entries are dropped by the next flush or when the buffer is reused.	*/
+static void pfsCacheDirtyRemove(pfs_cache_t *clink)
+{
+	if(clink->dprev != NULL) {
+		if(clink->dnext != NULL)
+			clink->dnext->dprev = clink->dprev;
+		*clink->dprev = clink->dnext;
+		clink->dnext = NULL;
+		clink->dprev = NULL;
+	}
+}
+
+void pfsCacheMarkDirty(pfs_cache_t *clink)
+{
+	pfs_mount_t *pfsMount = clink->pfsMount;
+
+	clink->flags |= PFS_CACHE_FLAG_DIRTY;
+	if(clink->dprev == NULL && pfsMount != NULL) {
+		clink->dnext = pfsMount->dirty;
+		clink->dprev = &pfsMount->dirty;
+		if(pfsMount->dirty != NULL)
+			pfsMount->dirty->dprev = &clink->dnext;
+		pfsMount->dirty = clink;
+	}
+}
+
 void pfsCacheFree(pfs_cache_t *clink)
 {
 	if(clink==NULL) {
@@ -109,20 +172,20 @@ int pfsCacheTransfer(pfs_cache_t* clink, int mode)
 
 void pfsCacheFlushAllDirty(pfs_mount_t *pfsMount)
 {
-	u32 i;
-	int found=0;
-
-	for(i=1;i<pfsCacheNumBuffers+1;i++){
-		if(pfsCacheBuf[i].pfsMount == pfsMount &&
-			pfsCacheBuf[i].flags & PFS_CACHE_FLAG_DIRTY)
-				found=1;
+	pfs_cache_t *clink, *next;
+
+	// Drop the entries that are no longer dirty or no longer belong to this mount.
+	for(clink=pfsMount->dirty;clink!=NULL;clink=next){
+		next=clink->dnext;
+		if(clink->pfsMount != pfsMount ||
+			!(clink->flags & PFS_CACHE_FLAG_DIRTY))
+				pfsCacheDirtyRemove(clink);
 	}
-	if(found) {
+	if(pfsMount->dirty != NULL) {
 		pfsJournalWrite(pfsMount, pfsCacheBuf+1, pfsCacheNumBuffers);
-		for(i=1;i<pfsCacheNumBuffers+1;i++){
-			if(pfsCacheBuf[i].pfsMount == pfsMount &&
-				pfsCacheBuf[i].flags & PFS_CACHE_FLAG_DIRTY)
-					pfsCacheTransfer(&pfsCacheBuf[i], 1);
+		while((clink=pfsMount->dirty) != NULL){
+			pfsCacheDirtyRemove(clink);
+			pfsCacheTransfer(clink, 1);
 		}
 	}
 
@@ -144,33 +207,38 @@ pfs_cache_t *pfsCacheAlloc(pfs_mount_t *pfsMount, u16 sub, u32 block,
 		PFS_PRINTF(PFS_DRV_NAME": Panic: Null pointer allocated\n");
 	if (allocated->pfsMount && (allocated->flags & PFS_CACHE_FLAG_DIRTY))
 		pfsCacheFlushAllDirty(allocated->pfsMount);
+	pfsCacheDirtyRemove(allocated);
+	pfsCacheHashRemove(allocated);
 	allocated->flags 	= flags & PFS_CACHE_FLAG_MASKTYPE;
 	allocated->pfsMount	= pfsMount;
 	allocated->sub		= sub;
 	allocated->block	= block;
 	allocated->nused	= 1;
+	if(pfsMount != NULL)
+		pfsCacheHashInsert(allocated);
 	return pfsCacheUnLink(allocated);
 }
 
 pfs_cache_t *pfsCacheGetData(pfs_mount_t *pfsMount, u16 sub, u32 block,
 					int flags, int *result)
 {
-	u32 i;
 	pfs_cache_t *clink;
 
 	*result=0;
 
-	for (i=1; i < pfsCacheNumBuffers + 1; i++)
-		if ( pfsCacheBuf[i].pfsMount &&
-		    (pfsCacheBuf[i].pfsMount==pfsMount) &&
-		    (pfsCacheBuf[i].block  == block))
-			if (pfsCacheBuf[i].sub==sub){
-				pfsCacheBuf[i].flags &= PFS_CACHE_FLAG_MASKSTATUS;
-				pfsCacheBuf[i].flags |= flags & PFS_CACHE_FLAG_MASKTYPE;
-				if (pfsCacheBuf[i].nused == 0)
-					pfsCacheUnLink(&pfsCacheBuf[i]);
-				pfsCacheBuf[i].nused++;
-				return &pfsCacheBuf[i];
+	/*	Entries may remain hashed after their mount was invalidated (pfsMount set to NULL),
+		so the full key is still compared here. They are unhashed when the buffer is reused.	*/
+	for (clink = *pfsCacheHashBucket(pfsMount, sub, block); clink != NULL; clink = clink->hnext)
+		if ( clink->pfsMount &&
+		    (clink->pfsMount==pfsMount) &&
+		    (clink->block  == block))
+			if (clink->sub==sub){
+				clink->flags &= PFS_CACHE_FLAG_MASKSTATUS;
+				clink->flags |= flags & PFS_CACHE_FLAG_MASKTYPE;
+				if (clink->nused == 0)
+					pfsCacheUnLink(clink);
+				clink->nused++;
+				return clink;
 			}
 
 	clink=pfsCacheAlloc(pfsMount, sub, block, flags, result);
@@ -204,20 +272,28 @@ int pfsCacheIsFull(void)
 int pfsCacheInit(u32 numBuf, u32 bufSize)
 {
 	char *cacheData;
-	u32 i;
+	u32 i, numBuckets;
 
 	if(numBuf > 127) {
 		PFS_PRINTF(PFS_DRV_NAME": Error: Number of buffers larger than 127.\n");
 		return -EINVAL;
 	}
 
+	// Use at least twice as many buckets as buffers, so that the chains remain short.
+	for(numBuckets = 16; numBuckets < numBuf * 2; numBuckets <<= 1);
+
 	cacheData = pfsAllocMem(numBuf * bufSize);
 
 	if(!cacheData || !(pfsCacheBuf = pfsAllocMem((numBuf + 1) * sizeof(pfs_cache_t))))
 		return -ENOMEM;
 
+	if(!(pfsCacheHashTable = pfsAllocMem(numBuckets * sizeof(pfs_cache_t *))))
+		return -ENOMEM;
+
 	pfsCacheNumBuffers = numBuf;
+	pfsCacheHashMask = numBuckets - 1;
 	memset(pfsCacheBuf, 0, (numBuf + 1) * sizeof(pfs_cache_t));
+	memset(pfsCacheHashTable, 0, numBuckets * sizeof(pfs_cache_t *));
 
 	pfsCacheBuf->next = pfsCacheBuf;
 	pfsCacheBuf->prev = pfsCacheBuf;
@@ -238,8 +314,10 @@ void pfsCacheClose(pfs_mount_t *pfsMount)
 
 	pfsCacheFlushAllDirty(pfsMount);
 	for(i=1; i < pfsCacheNumBuffers+1;i++){
-		if(pfsCacheBuf[i].pfsMount==pfsMount)
+		if(pfsCacheBuf[i].pfsMount==pfsMount) {
+			pfsCacheHashRemove(&pfsCacheBuf[i]);
 			pfsCacheBuf[i].pfsMount=NULL;
+		}
 	}
 }
 
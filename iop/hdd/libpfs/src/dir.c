@@ -373,7 +373,7 @@ void pfsInodeFill(pfs_cache_t *ci, pfs_blockinfo_t *bi, u16 mode, u16 uid, u16 g
 
 	ci->u.inode->subpart=bi->subpart;
 
-	ci->flags |= PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(ci);
 }
 
 
@@ -683,7 +683,7 @@ void pfsFreeZones(pfs_cache_t *pfree)
 				b.number = bi->number +
 					bi->count;
 				j = 0;
-				clink->flags |= PFS_CACHE_FLAG_DIRTY;
+				pfsCacheMarkDirty(clink);
 			}
 			else
 				j -= bi->count;
@@ -696,7 +696,7 @@ void pfsFreeZones(pfs_cache_t *pfree)
 	pfree->u.inode->last_segment.number = clink->u.inode->data[0].number;
 	pfree->u.inode->last_segment.subpart= clink->u.inode->data[0].subpart;
 	pfree->u.inode->last_segment.count  = clink->u.inode->data[0].count;
-	pfree->flags |= PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(pfree);
 
 	if (b.number)
 		pfsBitmapFreeBlockSegment(pfsMount, &b);
@@ -55,13 +55,13 @@ void pfsInodeSetTime(pfs_cache_t *clink)
 	pfsGetTime(&clink->u.inode->mtime);
 	memcpy(&clink->u.inode->ctime, &clink->u.inode->mtime, sizeof(pfs_datetime_t));
 	memcpy(&clink->u.inode->atime, &clink->u.inode->mtime, sizeof(pfs_datetime_t));
-	clink->flags|=PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(clink);
 }
 
 void pfsInodeSetTimeParent(pfs_cache_t *parent, pfs_cache_t *self)
 {	// set the inode time's in cache
 	pfsInodeSetTime(parent);
-	self->flags|=PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(self);
 }
 
 int pfsInodeSync(pfs_blockpos_t *blockpos, u64 size, u32 used_segments)
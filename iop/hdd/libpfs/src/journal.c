@@ -41,22 +41,22 @@ int pfsJournalChecksum(void *header)
 	return sum & 0xFFFF;
 }
 
+// The buffers to log are taken from the mount's dirty list. All buffers (clink) are written to the log,
+// the data of each buffer is at a position in the log that follows from its position in the array.
 void pfsJournalWrite(pfs_mount_t *pfsMount, pfs_cache_t *clink, u32 pfsCacheNumBuffers)
 {
-	u32 i=0;
-	u32 logSector=2;
+	pfs_cache_t *dirty;
+	u32 logSector;
 
-	for(i=0; i <pfsCacheNumBuffers;i++)
+	for(dirty=pfsMount->dirty; dirty!=NULL; dirty=dirty->dnext)
 	{
-		if((clink[i].flags & PFS_CACHE_FLAG_DIRTY) && clink[i].pfsMount == pfsMount) {
-			if(clink[i].flags & (PFS_CACHE_FLAG_SEGD|PFS_CACHE_FLAG_SEGI))
-				clink[i].u.inode->checksum=pfsInodeCheckSum(clink[i].u.inode);
-			pfsJournalBuf.log[pfsJournalBuf.num].sector = clink[i].block << pfsBlockSize;
-			pfsJournalBuf.log[pfsJournalBuf.num].sub = clink[i].sub;
-			pfsJournalBuf.log[pfsJournalBuf.num].logSector = logSector;
-			pfsJournalBuf.num+=1;
-		}
-		logSector+=2;
+		logSector=2+(dirty-clink)*2;
+		if(dirty->flags & (PFS_CACHE_FLAG_SEGD|PFS_CACHE_FLAG_SEGI))
+			dirty->u.inode->checksum=pfsInodeCheckSum(dirty->u.inode);
+		pfsJournalBuf.log[pfsJournalBuf.num].sector = dirty->block << pfsBlockSize;
+		pfsJournalBuf.log[pfsJournalBuf.num].sub = dirty->sub;
+		pfsJournalBuf.log[pfsJournalBuf.num].logSector = logSector;
+		pfsJournalBuf.num+=1;
 	}
 
 	if(pfsMount->blockDev->transfer(pfsMount->fd, clink->u.inode, 0,
@@ -0,0 +1,300 @@
+/*
+	Host test and benchmark of the PFS metadata cache (cache.c).
+
+	The cache runs on top of a block device that is backed by a temporary file, with 8KB blocks.
+	Each block holds its sub partition, block number and a write stamp, which are checked against a
+	shadow copy every time the cache returns the block. For each cache size, a workload of reads and
+	updates is run with a hot set of blocks that fits in the cache:
+	 - every flush must write each dirty buffer of the mount exactly once, after one journal write;
+	 - the file must match the shadow copy once the mount is closed.
+	The device transfers and the time per access of the workload are printed, then the time of a
+	lookup that hits the cache.
+
+	Build and run from the root of the tree, with the cache.c from before the hash index for comparison:
+
+	F="-O2 -Wall -D_IOP -Iiop/hdd/libpfs/test/host -Iiop/hdd/libpfs/include -Iiop/hdd/pfs/src -idirafter common/include"
+	gcc $F iop/hdd/libpfs/test/pfs_cache_bench.c iop/hdd/libpfs/src/cache.c -o pfs_cache_bench
+	git show 22ecac1:iop/hdd/libpfs/src/cache.c > cache_old.c
+	gcc $F -DOLD_CACHE iop/hdd/libpfs/test/pfs_cache_bench.c cache_old.c -o pfs_cache_bench_old
+	./pfs_cache_bench && ./pfs_cache_bench_old
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <hdd-ioctl.h>
+
+#include "libpfs.h"
+
+#define SECTOR_SIZE		512
+#define BLOCK_SHIFT		4	// 8KB blocks
+#define BLOCK_SIZE		(SECTOR_SIZE << BLOCK_SHIFT)
+#define NUM_SUBS		2
+#define SUB_BLOCKS		1024
+#define ACCESSES		200000
+#define FLUSH_INTERVAL	1000
+#define LOOKUPS			2000000
+
+u32 pfsBlockSize = BLOCK_SHIFT;
+
+extern pfs_cache_t *pfsCacheBuf;
+extern u32 pfsCacheNumBuffers;
+
+typedef struct {
+	u32 sub;
+	u32 block;
+	u32 stamp;
+} block_tag_t;
+
+static FILE *disk;
+static u32 shadow[NUM_SUBS][SUB_BLOCKS];
+static long reads, writes, journalWrites;
+static int errors;
+
+static void error(const char *what, u32 sub, u32 block)
+{
+	if(errors++ < 10)
+		printf("error: %s, sub %lu, block %lu\n", what, sub, block);
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int diskTransfer(int fd, void *buffer, u32 sub, u32 sector, u32 size, u32 mode)
+{
+	off_t offset = ((off_t)sub * SUB_BLOCKS * (BLOCK_SIZE / SECTOR_SIZE) + sector) * SECTOR_SIZE;
+	ssize_t result;
+
+	if(mode == PFS_IO_MODE_WRITE) {
+		writes++;
+		result = pwrite(fileno(disk), buffer, size * SECTOR_SIZE, offset);
+	} else {
+		reads++;
+		result = pread(fileno(disk), buffer, size * SECTOR_SIZE, offset);
+	}
+
+	return(result == size * SECTOR_SIZE ? 0 : -EIO);
+}
+
+static void diskSetPartitionError(int fd)
+{
+	error("partition error set", 0, 0);
+}
+
+static pfs_block_device_t diskDev = {
+	"file",
+	diskTransfer,
+	NULL,
+	NULL,
+	diskSetPartitionError,
+	NULL
+};
+
+void pfsJournalWrite(pfs_mount_t *pfsMount, pfs_cache_t *clink, u32 numBuffers)
+{
+	journalWrites++;
+}
+
+int pfsJournalReset(pfs_mount_t *pfsMount)
+{
+	return 0;
+}
+
+int pfsInodeCheckSum(pfs_inode_t *inode)
+{
+	return 0;
+}
+
+int pfsFsckStat(pfs_mount_t *pfsMount, pfs_super_block_t *superblock, u32 stat, int mode)
+{
+	return 0;
+}
+
+void *pfsAllocMem(int size)
+{
+	return malloc(size);
+}
+
+#ifdef OLD_CACHE
+// The cache.c from before the hash index marked buffers dirty by setting the flag.
+void pfsCacheMarkDirty(pfs_cache_t *clink)
+{
+	clink->flags |= PFS_CACHE_FLAG_DIRTY;
+}
+#endif
+
+static void diskCreate(void)
+{
+	static u8 block[BLOCK_SIZE];
+	block_tag_t *tag = (block_tag_t *)block;
+	u32 sub, i;
+
+	disk = tmpfile();
+	for(sub = 0; sub < NUM_SUBS; sub++) {
+		for(i = 0; i < SUB_BLOCKS; i++) {
+			tag->sub = sub;
+			tag->block = i;
+			tag->stamp = shadow[sub][i] = 0;
+			fwrite(block, 1, BLOCK_SIZE, disk);
+		}
+	}
+	fflush(disk);
+}
+
+static void diskCheck(void)
+{
+	static u8 block[BLOCK_SIZE];
+	block_tag_t *tag = (block_tag_t *)block;
+	u32 sub, i;
+
+	for(sub = 0; sub < NUM_SUBS; sub++) {
+		for(i = 0; i < SUB_BLOCKS; i++) {
+			pread(fileno(disk), block, BLOCK_SIZE, ((off_t)sub * SUB_BLOCKS + i) * BLOCK_SIZE);
+			if(tag->sub != sub || tag->block != i || tag->stamp != shadow[sub][i])
+				error("the disk doesn't match after the close", sub, i);
+		}
+	}
+}
+
+static int countDirty(pfs_mount_t *pfsMount)
+{
+	u32 i;
+	int count = 0;
+
+	for(i = 1; i < pfsCacheNumBuffers + 1; i++)
+		if(pfsCacheBuf[i].pfsMount == pfsMount && (pfsCacheBuf[i].flags & PFS_CACHE_FLAG_DIRTY))
+			count++;
+
+	return count;
+}
+
+static void flush(pfs_mount_t *pfsMount)
+{
+	long writesBefore = writes, journalBefore = journalWrites;
+	int dirty;
+
+	dirty = countDirty(pfsMount);
+	pfsCacheFlushAllDirty(pfsMount);
+
+	if(writes - writesBefore != dirty)
+		error("the flush didn't write every dirty buffer once", 0, dirty);
+	if(journalWrites - journalBefore != (dirty != 0))
+		error("the flush didn't write the journal once", 0, dirty);
+	if(countDirty(pfsMount) != 0)
+		error("dirty buffers remain after the flush", 0, 0);
+}
+
+static pfs_cache_t *get(pfs_mount_t *pfsMount, u32 sub, u32 block)
+{
+	pfs_cache_t *clink;
+	block_tag_t *tag;
+	int result;
+
+	if((clink = pfsCacheGetData(pfsMount, sub, block, PFS_CACHE_FLAG_NOTHING, &result)) == NULL) {
+		error("pfsCacheGetData failed", sub, block);
+		return NULL;
+	}
+
+	tag = clink->u.data;
+	if(clink->sub != sub || clink->block != block || tag->sub != sub || tag->block != block || tag->stamp != shadow[sub][block])
+		error("wrong data returned", sub, block);
+
+	return clink;
+}
+
+static void run(u32 numBuf)
+{
+	pfs_mount_t mount;
+	pfs_cache_t *clink;
+	u32 i, sub, block, hot, *order;
+	long accessReads, accessWrites;
+	double t0, t1, t2;
+
+	memset(&mount, 0, sizeof(mount));
+	mount.blockDev = &diskDev;
+
+	if(pfsCacheInit(numBuf, BLOCK_SIZE) != 0) {
+		error("pfsCacheInit failed", 0, numBuf);
+		return;
+	}
+
+	/*	Nine accesses out of ten go to a hot set of 3/4 of the cache size, spread over the
+		disk, and one in five accesses updates its block.	*/
+	reads = writes = journalWrites = 0;
+	hot = numBuf * 3 / 4;
+	t0 = seconds();
+	for(i = 0; i < ACCESSES; i++) {
+		if(rand() % 10 != 0) {
+			block = rand() % hot;
+			sub = block & 1;
+			block = (block * 97) % SUB_BLOCKS;
+		} else {
+			sub = rand() % NUM_SUBS;
+			block = rand() % SUB_BLOCKS;
+		}
+
+		if((clink = get(&mount, sub, block)) == NULL)
+			break;
+		if(rand() % 5 == 0) {
+			((block_tag_t *)clink->u.data)->stamp = ++shadow[sub][block];
+			pfsCacheMarkDirty(clink);
+		}
+		pfsCacheFree(clink);
+
+		if((i + 1) % FLUSH_INTERVAL == 0)
+			flush(&mount);
+	}
+	pfsCacheClose(&mount);
+	t1 = seconds();
+	accessReads = reads;
+	accessWrites = writes;
+	diskCheck();
+
+	//Lookups that hit: every buffer holds a block, which is then looked up in a random order.
+	order = malloc(LOOKUPS * sizeof(u32));
+	for(i = 0; i < numBuf; i++)
+		pfsCacheFree(get(&mount, i % NUM_SUBS, i * 7));
+	for(i = 0; i < LOOKUPS; i++)
+		order[i] = rand() % numBuf;
+
+	reads = 0;
+	t2 = seconds();
+	for(i = 0; i < LOOKUPS; i++) {
+		block = order[i];
+		pfsCacheFree(get(&mount, block % NUM_SUBS, block * 7));
+	}
+	t2 = seconds() - t2;
+	if(reads != 0)
+		error("a lookup of a cached block read from the disk", 0, reads);
+	pfsCacheClose(&mount);
+	free(order);
+
+	printf("%3lu buffers: %6ld reads, %6ld writes, %6.0fns per access, %5.1fns per cached lookup\n",
+		numBuf, accessReads, accessWrites, (t1 - t0) * 1e9 / ACCESSES, t2 * 1e9 / LOOKUPS);
+}
+
+int main(void)
+{
+	static const u32 sizes[] = {8, 16, 32, 64, 127};
+	unsigned int i;
+
+	srand(7);
+	diskCreate();
+
+	for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		run(sizes[i]);
+
+	fclose(disk);
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return(errors ? 1 : 0);
+}
@@ -211,14 +211,14 @@ static int openFile(pfs_mount_t *pfsMount, pfs_file_slot_t *freeSlot, const char
 				{
 					memset(cached->u.aentry, 0, sizeof(pfs_inode_t)); //1024
 					cached->u.aentry->aLen=sizeof(pfs_inode_t);
-					cached->flags |= PFS_CACHE_FLAG_DIRTY;
+					pfsCacheMarkDirty(cached);
 					pfsCacheFree(cached);
 				}
 				if (result2 == 0)
 				{
 					fileInode->u.inode->size = 0;
 					fileInode->u.inode->attr &= ~PFS_FIO_ATTR_CLOSED; //~0x80==0xFF7F
-					fileInode->flags |= PFS_CACHE_FLAG_DIRTY;
+					pfsCacheMarkDirty(fileInode);
 					pfsFreeZones(fileInode);
 				}
 			}
@@ -248,7 +248,7 @@ static int openFile(pfs_mount_t *pfsMount, pfs_file_slot_t *freeSlot, const char
 					pfsFillSelfAndParentDentries(cached,
 						&fileInode->u.inode->inode_block,
 						&parentInode->u.inode->inode_block);
-					cached->flags |= PFS_CACHE_FLAG_DIRTY;
+					pfsCacheMarkDirty(cached);
 					pfsCacheFree(cached);
 				}
 				result=result3;
@@ -260,7 +260,7 @@ static int openFile(pfs_mount_t *pfsMount, pfs_file_slot_t *freeSlot, const char
 				{
 					memset(cached->u.aentry, 0, sizeof(pfs_inode_t));
 					cached->u.aentry->aLen=sizeof(pfs_inode_t);
-					cached->flags |= PFS_CACHE_FLAG_DIRTY;
+					pfsCacheMarkDirty(cached);
 					pfsCacheFree(cached);
 				}
 				result=result4;
@@ -291,7 +291,7 @@ label:
 			if ((openFlags & O_WRONLY) &&
 			    (fileInode->u.inode->attr & PFS_FIO_ATTR_CLOSED)){
 				fileInode->u.inode->attr &= ~PFS_FIO_ATTR_CLOSED;
-				fileInode->flags |= PFS_CACHE_FLAG_DIRTY;
+				pfsCacheMarkDirty(fileInode);
 				if (pfsMount->flags & PFS_FIO_ATTR_WRITEABLE)
 					pfsCacheFlushAllDirty(pfsMount);
 			}
@@ -510,7 +510,7 @@ static int fileTransfer(pfs_file_slot_t *fileSlot, u8 *buf, int size, int operat
 		if(fileSlot->clink->u.inode->size < fileSlot->position)
 		{
 			fileSlot->clink->u.inode->size = fileSlot->position;
-			fileSlot->clink->flags |= PFS_CACHE_FLAG_DIRTY;
+			pfsCacheMarkDirty(fileSlot->clink);
 		}
 
 		blockpos->block_offset+=pfsBlockSyncPos(blockpos, result);
@@ -960,7 +960,7 @@ int	pfsFioChstat(iop_file_t *f, const char *name, iox_stat_t *stat, unsigned int
 		rv = pfsCheckAccess(clink, 0x02);
 		if(rv == 0) {
 
-			clink->flags |= PFS_CACHE_FLAG_DIRTY;
+			pfsCacheMarkDirty(clink);
 
 			if((statmask & FIO_CST_MODE) && ((clink->u.inode->mode & FIO_S_IFMT) != FIO_S_IFLNK))
 				clink->u.inode->mode = (clink->u.inode->mode & FIO_S_IFMT) | (stat->mode & 0xfff);
@@ -1113,7 +1113,7 @@ int pfsFioRename(iop_file_t *ff, const char *old, const char *new)
 		}else{
 			if (sameParent){
 				if (removeOld!=addNew)
-					removeOld->flags |= PFS_CACHE_FLAG_DIRTY;
+					pfsCacheMarkDirty(removeOld);
 			}else
 			{
 				pfsInodeSetTimeParent(parentOld, removeOld);
@@ -334,7 +334,7 @@ static int ioctl2AttrAdd(pfs_cache_t *clink, pfs_ioctl2attr_t *attr)
 	aentry->aLen=tmp;
 	memcpy(&aentry->str[0], attr->key, aentry->kLen);
 	memcpy(&aentry->str[aentry->kLen], attr->value, aentry->vLen);
-	clink->flags|=PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(clink);
 
 	return 0;
 }
@@ -345,7 +345,7 @@ static int ioctl2AttrDelete(pfs_cache_t *clink, void *arg)
 
 	if((aentry=getAentry(clink, arg, NULL, PFS_AENTRY_MODE_DELETE)) == NULL)
 		return -ENOENT;
-	clink->flags|=PFS_CACHE_FLAG_DIRTY;
+	pfsCacheMarkDirty(clink);
 	return 0;
 }
 
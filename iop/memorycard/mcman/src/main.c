@@ -36,10 +36,16 @@ extern u8 mcman_sio2outbufs_PS1PDA[0x90];
 
 static u8 mcman_cachebuf[MAX_CACHEENTRY * MCMAN_CLUSTERSIZE];
 static McCacheEntry mcman_entrycache[MAX_CACHEENTRY];
-static McCacheEntry *mcman_mccache[MAX_CACHEENTRY];
 
-static McCacheEntry *pmcman_entrycache;
-static McCacheEntry **pmcman_mccache;
+/* Cache entries are looked up through a hash of (port, slot, cluster) and kept in a
+   doubly-linked LRU list, both indexed by entry number. Invalid entries are not hashed. */
+#define MCMAN_CACHE_NIL				0xFF
+static u8 mcman_cachehash[MCMAN_CACHEHASH_SIZE];	// first entry of each hash chain
+static u8 mcman_cachehnext[MAX_CACHEENTRY];		// next entry in the same hash chain
+static u8 mcman_cachenewer[MAX_CACHEENTRY];		// LRU list, towards the MRU entry
+static u8 mcman_cacheolder[MAX_CACHEENTRY];		// LRU list, towards the LRU entry
+static u8 mcman_cachemru;
+static u8 mcman_cachelru;
 
 static void *mcman_pagedata[32];
 static u8 mcman_backupbuf[16384];
@@ -1207,7 +1213,7 @@ int McReadPage(int port, int slot, int page, void *buf) // Export #18
 }
 
 //--------------------------------------------------------------
-void McDataChecksum(void *buf, void *ecc) // Export #20
+static void mcman_datachecksum_bytes(void *buf, void *ecc)
 {
 	register u8 *p, *p_ecc;
 	register int i, a2, a3, v, t0;
@@ -1233,6 +1239,50 @@ void McDataChecksum(void *buf, void *ecc) // Export #20
 	p_ecc[2] = ~t0 & 0x7F;
 }
 
+//--------------------------------------------------------------
+void McDataChecksum(void *buf, void *ecc) // Export #20
+{
+	register u32 *p;
+	register u8 *p_ecc;
+	register u32 w, x;
+	register int j, t0, a3;
+
+	if ((u32)buf & 3) {
+		mcman_datachecksum_bytes(buf, ecc);
+		return;
+	}
+
+	/*	Same result as mcman_datachecksum_bytes(), computed one word at a time:
+		the column parity is linear, so it is the xortable entry of all bytes XORed together.
+		Bits 2-6 of the row parity come from the parity of each word (bit 7 of the xortable
+		entry of its folded bytes), bits 0-1 from the bytes at odd offsets/the upper half-word
+		of the combined word. The inverted row parity only differs by the overall parity. */
+	p = (u32 *)buf;
+	x = 0;
+	t0 = 0;
+
+	for (j = 0; j < 0x20; j++) {
+		w = *p++;
+		x ^= w;
+		w ^= w >> 16;
+		w ^= w >> 8;
+		t0 ^= j & -(mcman_xortable[w & 0xFF] >> 7);
+	}
+
+	t0 <<= 2;
+	t0 |= mcman_xortable[((x >> 8) ^ (x >> 24)) & 0xFF] >> 7;
+	t0 |= (mcman_xortable[((x >> 16) ^ (x >> 24)) & 0xFF] >> 7) << 1;
+
+	w = x ^ (x >> 16);
+	w = mcman_xortable[(w ^ (w >> 8)) & 0xFF];
+	a3 = (w & 0x80) ? (t0 ^ 0x7F) : t0;
+
+	p_ecc = ecc;
+	p_ecc[0] = ~w & 0x77;
+	p_ecc[1] = ~a3 & 0x7F;
+	p_ecc[2] = ~t0 & 0x7F;
+}
+
 //--------------------------------------------------------------
 int mcman_getcnum(int port, int slot)
 {
@@ -1263,24 +1313,9 @@ int mcman_correctdata(void *buf, void *ecc)
 		return -1;
 	}
 
-	xor0 = 0;
-	xor2 = 7;
-	do {
-		if ((xor3 & 1))
-			xor0++;
-		xor2--;
-		xor3 = xor3 >> 1;
-	} while (xor2 >= 0);
-
-	xor2 = 3;
-	do {
-		if ((xor4 & 1))
-			xor0++;
-		xor2--;
-		xor4 = xor4 >> 1;
-	} while (xor2 >= 0);
-
-	if (xor0 == 1)
+	// A single differing bit means that the ECC itself is corrupted.
+	xor0 = xor3 | (xor4 << 8);
+	if ((xor0 != 0) && ((xor0 & (xor0 - 1)) == 0))
 		return -2;
 
 	return -3;
@@ -2824,7 +2859,7 @@ int mcman_FNC8ca4(int port, int slot, MC_FHANDLE *fh)
 							return r;
 
 						mce->wr_flag = -1;
-						mce->cluster -= (i - mcfree) * cluster_size;
+						mcman_setcacheentry(mce, port, slot, mce->cluster - ((i - mcfree) * cluster_size));
 
 					} while (++i < cluster_size);
 				}
@@ -3135,28 +3170,100 @@ int mcman_fillPS1backuparea(int port, int slot, int block)
 	return sceMcResSucceed;
 }
 
+//--------------------------------------------------------------
+static inline int mcman_cachehashfn(int port, int slot, int cluster)
+{
+	return (cluster ^ (slot << 3) ^ (port << 5)) & (MCMAN_CACHEHASH_SIZE - 1);
+}
+
+//--------------------------------------------------------------
+static void mcman_cacheunhash(int e)
+{
+	McCacheEntry *mce = &mcman_entrycache[e];
+	u8 *pe;
+
+	pe = &mcman_cachehash[mcman_cachehashfn(mce->mc_port, mce->mc_slot, mce->cluster)];
+	while (*pe != MCMAN_CACHE_NIL) {
+		if (*pe == e) {
+			*pe = mcman_cachehnext[e];
+			break;
+		}
+		pe = &mcman_cachehnext[*pe];
+	}
+}
+
+//--------------------------------------------------------------
+static void mcman_cachehashentry(int e)
+{
+	McCacheEntry *mce = &mcman_entrycache[e];
+	register int h;
+
+	h = mcman_cachehashfn(mce->mc_port, mce->mc_slot, mce->cluster);
+	mcman_cachehnext[e] = mcman_cachehash[h];
+	mcman_cachehash[h] = e;
+}
+
+//--------------------------------------------------------------
+static void mcman_cacheunlink(int e)
+{
+	if (mcman_cachenewer[e] != MCMAN_CACHE_NIL)
+		mcman_cacheolder[mcman_cachenewer[e]] = mcman_cacheolder[e];
+	else
+		mcman_cachemru = mcman_cacheolder[e];
+
+	if (mcman_cacheolder[e] != MCMAN_CACHE_NIL)
+		mcman_cachenewer[mcman_cacheolder[e]] = mcman_cachenewer[e];
+	else
+		mcman_cachelru = mcman_cachenewer[e];
+}
+
+//--------------------------------------------------------------
+static void mcman_cachelinkmru(int e)
+{
+	mcman_cachenewer[e] = MCMAN_CACHE_NIL;
+	mcman_cacheolder[e] = mcman_cachemru;
+	if (mcman_cachemru != MCMAN_CACHE_NIL)
+		mcman_cachenewer[mcman_cachemru] = e;
+	else
+		mcman_cachelru = e;
+	mcman_cachemru = e;
+}
+
+//--------------------------------------------------------------
+static void mcman_cachelinklru(int e)
+{
+	mcman_cacheolder[e] = MCMAN_CACHE_NIL;
+	mcman_cachenewer[e] = mcman_cachelru;
+	if (mcman_cachelru != MCMAN_CACHE_NIL)
+		mcman_cacheolder[mcman_cachelru] = e;
+	else
+		mcman_cachemru = e;
+	mcman_cachelru = e;
+}
+
 //--------------------------------------------------------------
 void mcman_initcache(void)
 {
-	register int i, j;
+	register int i;
 	u8 *p;
 
 #ifdef DEBUG
 	DPRINTF("mcman: mcman_initcache\n");
 #endif
 
-	j = MAX_CACHEENTRY - 1;
 	p = (u8 *)mcman_cachebuf;
 
 	for (i = 0; i < MAX_CACHEENTRY; i++) {
 		mcman_entrycache[i].cl_data = (u8 *)p;
-		mcman_mccache[i] = (McCacheEntry *)&mcman_entrycache[j - i];
 		mcman_entrycache[i].cluster = -1;
+		mcman_cachenewer[i] = (i == MAX_CACHEENTRY - 1) ? MCMAN_CACHE_NIL : i + 1;
+		mcman_cacheolder[i] = (i == 0) ? MCMAN_CACHE_NIL : i - 1;
 		p += MCMAN_CLUSTERSIZE;
 	}
 
-	pmcman_entrycache = (McCacheEntry *)mcman_entrycache;
-	pmcman_mccache = (McCacheEntry **)mcman_mccache;
+	mcman_cachemru = MAX_CACHEENTRY - 1;
+	mcman_cachelru = 0;
+	memset((void *)mcman_cachehash, MCMAN_CACHE_NIL, sizeof (mcman_cachehash));
 
 	for (i = 0; i < MCMAN_MAXSLOT; i++) {
 		mcman_devinfos[0][i].unknown3 = -1;
@@ -3187,38 +3294,23 @@ int McRetOnly(int fd) // Export #37
 //--------------------------------------------------------------
 int mcman_clearcache(int port, int slot)
 {
-	register int i, j;
-	McCacheEntry **pmce = (McCacheEntry **)pmcman_mccache;
-	McCacheEntry *mce, *mce_save;
+	register int e, next;
+	McCacheEntry *mce;
 
 #ifdef DEBUG
 	DPRINTF("mcman: mcman_clearcache port%d, slot%d\n", port, slot);
 #endif
 
-	for (i = MAX_CACHEENTRY - 1; i >= 0; i--) {
-		mce = (McCacheEntry *)pmce[i];
+	// Invalidated entries are moved to the LRU end, to be reused first.
+	// They are visited again at the end of the walk, but are no longer valid.
+	for (e = mcman_cachemru; e != MCMAN_CACHE_NIL; e = next) {
+		next = mcman_cacheolder[e];
+		mce = &mcman_entrycache[e];
 		if ((mce->mc_port == port) && (mce->mc_slot == slot) && (mce->cluster >= 0)) {
-			mce->mc_port = -1;
-			mce->mc_slot = -1;
+			mcman_setcacheentry(mce, -1, -1, -1);
 			mce->wr_flag = 0;
-			mce->cluster = -1;
-		}
-	}
-
-	for (i = 0; i < (MAX_CACHEENTRY - 1); i++) {
-		mce = (McCacheEntry *)pmce[i];
-		mce_save = (McCacheEntry *)pmce[i];
-		if (mce->cluster < 0) {
-			for (j = i+1; j < MAX_CACHEENTRY; j++) {
-				mce = (McCacheEntry *)pmce[j];
-				if (mce->cluster >= 0)
-					break;
-			}
-			if (j == MAX_CACHEENTRY)
-				break;
-
-			pmce[i] = (McCacheEntry *)pmce[j];
-			pmce[j] = (McCacheEntry *)mce_save;
+			mcman_cacheunlink(e);
+			mcman_cachelinklru(e);
 		}
 	}
 
@@ -3232,15 +3324,18 @@ int mcman_clearcache(int port, int slot)
 //--------------------------------------------------------------
 McCacheEntry *mcman_getcacheentry(int port, int slot, int cluster)
 {
-	register int i;
-	McCacheEntry *mce = (McCacheEntry *)pmcman_entrycache;
+	register int e;
+	McCacheEntry *mce;
 
 	//DPRINTF("mcman: mcman_getcacheentry port%d slot%d cluster %x\n", port, slot, cluster);
 
-	for (i = 0; i < MAX_CACHEENTRY; i++) {
+	if (cluster < 0)
+		return NULL;
+
+	for (e = mcman_cachehash[mcman_cachehashfn(port, slot, cluster)]; e != MCMAN_CACHE_NIL; e = mcman_cachehnext[e]) {
+		mce = &mcman_entrycache[e];
 		if ((mce->mc_port == port) && (mce->mc_slot == slot) && (mce->cluster == cluster))
 			return mce;
-		mce++;
 	}
 
 	return NULL;
@@ -3249,18 +3344,36 @@ McCacheEntry *mcman_getcacheentry(int port, int slot, int cluster)
 //--------------------------------------------------------------
 void mcman_freecluster(int port, int slot, int cluster) // release cluster from entrycache
 {
-	register int i;
-	McCacheEntry *mce = (McCacheEntry *)pmcman_entrycache;
+	register int e;
+	McCacheEntry *mce;
 
-	for (i = 0; i < MAX_CACHEENTRY; i++) {
-		if ((mce->mc_port == port) && (mce->mc_slot == slot) && (mce->cluster == cluster)) {
-			mce->cluster = -1;
-			mce->wr_flag = 0;
-		}
-		mce++;
+	mce = mcman_getcacheentry(port, slot, cluster);
+	if (mce != NULL) {
+		mcman_setcacheentry(mce, port, slot, -1);
+		mce->wr_flag = 0;
+
+		e = mce - mcman_entrycache;
+		mcman_cacheunlink(e);
+		mcman_cachelinklru(e);
 	}
 }
 
+//--------------------------------------------------------------
+void mcman_setcacheentry(McCacheEntry *mce, int port, int slot, int cluster) // (re)assign a cache entry, keeping it hashed
+{
+	register int e = mce - mcman_entrycache;
+
+	if (mce->cluster >= 0)
+		mcman_cacheunhash(e);
+
+	mce->mc_port = port;
+	mce->mc_slot = slot;
+	mce->cluster = cluster;
+
+	if (cluster >= 0)
+		mcman_cachehashentry(e);
+}
+
 //--------------------------------------------------------------
 int mcman_getFATindex(int port, int slot, int num)
 {
@@ -3270,7 +3383,7 @@ int mcman_getFATindex(int port, int slot, int num)
 //--------------------------------------------------------------
 void Mc1stCacheEntSetWrFlagOff(void)
 {
-	McCacheEntry *mce = (McCacheEntry *)*pmcman_mccache;
+	McCacheEntry *mce = &mcman_entrycache[mcman_cachemru];
 
 	mce->wr_flag = -1;
 }
@@ -3278,58 +3391,52 @@ void Mc1stCacheEntSetWrFlagOff(void)
 //--------------------------------------------------------------
 McCacheEntry *mcman_get1stcacheEntp(void)
 {
-	return *pmcman_mccache;
+	return &mcman_entrycache[mcman_cachemru];
 }
 
 //--------------------------------------------------------------
 void mcman_addcacheentry(McCacheEntry *mce)
 {
-	register int i;
-	McCacheEntry **pmce = (McCacheEntry **)pmcman_mccache;
-
-	i = MAX_CACHEENTRY - 1;
-
-	if (i < 0)
-		goto lbl1;
-
-	do {
-		if (pmce[i] == mce)
-			break;
-	} while (--i >= 0);
+	register int e = mce - mcman_entrycache;
 
-	if (i != 0) {
-lbl1:
-		do {
-			pmce[i] = pmce[i-1];
-		} while (--i != 0);
+	if (e != mcman_cachemru) {
+		mcman_cacheunlink(e);
+		mcman_cachelinkmru(e);
 	}
-
-	pmce[0] = (McCacheEntry *)mce;
 }
 
 //--------------------------------------------------------------
 int McFlushCache(int port, int slot)
 {
-	register int i, r;
-	McCacheEntry **pmce = (McCacheEntry **)pmcman_mccache;
+	register int i, j, e, r, count;
+	u8 dirty[MAX_CACHEENTRY];
 	McCacheEntry *mce;
 
 #ifdef DEBUG
 	DPRINTF("mcman: McFlushCache port%d slot%d\n", port, slot);
 #endif
 
-	i = MAX_CACHEENTRY - 1;
+	// Collect the dirty entries of this card, ordered by cluster number.
+	count = 0;
+	for (e = 0; e < MAX_CACHEENTRY; e++) {
+		mce = &mcman_entrycache[e];
+		if ((mce->mc_port == port) && (mce->mc_slot == slot) && (mce->cluster >= 0) && (mce->wr_flag != 0)) {
+			for (j = count; (j > 0) && (mcman_entrycache[dirty[j-1]].cluster > mce->cluster); j--)
+				dirty[j] = dirty[j-1];
+			dirty[j] = e;
+			count++;
+		}
+	}
 
-	if (i >= 0) {
-		do {
-			mce = (McCacheEntry *)pmce[i];
-			if ((mce->mc_port == port) && (mce->mc_slot == slot) && (mce->wr_flag != 0)) {
-				r = mcman_flushcacheentry((McCacheEntry *)mce);
-				if (r != sceMcResSucceed)
-					return r;
-			}
-			i--;
-		} while (i >= 0);
+	// Each erase block is written once: mcman_flushcacheentry() writes back every cached
+	// cluster of the block, so the following entries of the same block are already clean.
+	for (i = 0; i < count; i++) {
+		mce = &mcman_entrycache[dirty[i]];
+		if ((mce->mc_port == port) && (mce->mc_slot == slot) && (mce->wr_flag != 0)) {
+			r = mcman_flushcacheentry((McCacheEntry *)mce);
+			if (r != sceMcResSucceed)
+				return r;
+		}
 	}
 
 	return sceMcResSucceed;
@@ -3339,7 +3446,7 @@ int McFlushCache(int port, int slot)
 int mcman_flushcacheentry(McCacheEntry *mce)
 {
 	register int r, i, j, ecc_count;
-	register int temp1, temp2, offset, pageindex;
+	register int offset, pageindex;
 	static int clusters_per_block, blocksize, cardtype, pagesize, sparesize, flag, cluster, block, pages_per_fatclust;
 	McCacheEntry *pmce[16]; // sp18
 	register MCDevInfo *mcdi;
@@ -3439,22 +3546,14 @@ lbl0:
 
 	memset((void *)pmce, 0, 64);
 
-	i = 0; //s1
-	if (MAX_CACHEENTRY > 0) {
-		mcee = (McCacheEntry *)pmcman_entrycache;
-		do {
-			if ((mcee->mc_slot == mce->mc_slot) && (mcee->mc_port == mce->mc_port)) {
-				temp1 = mcee->cluster / clusters_per_block;
-				temp2 = mcee->cluster % clusters_per_block;
-
-				if (temp1 == block) {
-					pmce[temp2] = (McCacheEntry *)mcee;
-					if (mcee->rd_flag == 0)
-						flag = 1;
-				}
-			}
-			mcee++;
-		} while (++i < MAX_CACHEENTRY);
+	// Gather the cached clusters of the block, they are all written back together.
+	for (i = 0; i < clusters_per_block; i++) {
+		mcee = mcman_getcacheentry(mce->mc_port, mce->mc_slot, (block * clusters_per_block) + i);
+		if (mcee != NULL) {
+			pmce[i] = (McCacheEntry *)mcee;
+			if (mcee->rd_flag == 0)
+				flag = 1;
+		}
 	}
 
 	if (clusters_per_block > 0) {
@@ -3672,7 +3771,7 @@ int McReadCluster(int port, int slot, int cluster, McCacheEntry **pmce)
 
 	mce = mcman_getcacheentry(port, slot, cluster);
 	if (mce == NULL) {
-		mce = pmcman_mccache[MAX_CACHEENTRY - 1];
+		mce = &mcman_entrycache[mcman_cachelru];
 
 		if (mce->wr_flag != 0) {
 			r = mcman_flushcacheentry((McCacheEntry *)mce);
@@ -3680,9 +3779,7 @@ int McReadCluster(int port, int slot, int cluster, McCacheEntry **pmce)
 				return r;
 		}
 
-		mce->mc_port = port;
-		mce->mc_slot = slot;
-		mce->cluster = cluster;
+		mcman_setcacheentry(mce, port, slot, cluster);
 		mce->rd_flag = 0;
 		//s3 = (cluster * mcdi->pages_per_cluster);
 
@@ -3866,7 +3963,7 @@ int mcman_readclusterPS1(int port, int slot, int cluster, McCacheEntry **pmce)
 
 	mce = mcman_getcacheentry(port, slot, cluster);
 	if (mce == NULL) {
-		mce = pmcman_mccache[MAX_CACHEENTRY - 1];
+		mce = &mcman_entrycache[mcman_cachelru];
 
 		if (mce->wr_flag != 0) {
 			r = mcman_flushcacheentry((McCacheEntry *)mce);
@@ -3874,9 +3971,7 @@ int mcman_readclusterPS1(int port, int slot, int cluster, McCacheEntry **pmce)
 				return r;
 		}
 
-		mce->mc_port = port;
-		mce->mc_slot = slot;
-		mce->cluster = cluster;
+		mcman_setcacheentry(mce, port, slot, cluster);
 
 		pages_per_fatclust = MCMAN_CLUSTERSIZE / mcdi->pagesize;
 
@@ -4268,7 +4363,7 @@ lbl_e030:
 					if (r != sceMcResSucceed)
 						goto lbl_e168;
 
-					mce->cluster = mcman_replacementcluster[i];
+					mcman_setcacheentry(mce, mcman_badblock_port, mcman_badblock_slot, mcman_replacementcluster[i]);
 					mce->wr_flag = 1;
 				}
 			} while (++i < mcdi->clusters_per_block);
@@ -57,7 +57,14 @@ typedef struct _McFatCluster {
 	int entry[MCMAN_CLUSTERFATENTRIES];
 } McFatCluster;
 
+// Number of cached clusters. Can be overridden at build time, up to 254 entries.
+#ifndef MAX_CACHEENTRY
 #define MAX_CACHEENTRY 			0x24
+#endif
+#if (MAX_CACHEENTRY < 1) || (MAX_CACHEENTRY > 254)
+#error MAX_CACHEENTRY must be between 1 and 254
+#endif
+#define MCMAN_CACHEHASH_SIZE		64	// must be a power of 2
 
 typedef struct {
 	int entry[1 + (MCMAN_CLUSTERFATENTRIES * 2)];
@@ -167,6 +174,7 @@ void mcman_initcache(void);
 int  mcman_clearcache(int port, int slot);
 McCacheEntry *mcman_getcacheentry(int port, int slot, int cluster);
 void mcman_freecluster(int port, int slot, int cluster);
+void mcman_setcacheentry(McCacheEntry *mce, int port, int slot, int cluster);
 int  mcman_getFATindex(int port, int slot, int num);
 McCacheEntry *mcman_get1stcacheEntp(void);
 void mcman_addcacheentry(McCacheEntry *mce);
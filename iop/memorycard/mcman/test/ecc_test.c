@@ -0,0 +1,251 @@
+/*
+	Host test and benchmark of the memory card ECC routines of mcman, McDataChecksum() and
+	mcman_correctdata().
+
+	They are compared with the byte-at-a-time routines that they replaced, which are copied below.
+	For 4096 random 128-byte chunks and a few fixed ones, the ECC must be the same for aligned and
+	unaligned buffers. Then every single-bit error in the data and in the ECC, and 64 random
+	double-bit errors, must give the same result and leave the same data and ECC behind. Both
+	versions correct a single-bit error in the ECC buffer, at the offset of the data byte, so the
+	ECC buffers here are as large as the data.
+
+	The ECC of 16MB of 128-byte chunks is then timed, and the check of the same chunks without
+	errors, for both versions.
+
+	Build and run from the root of the tree. Only the ECC routines are needed from main.c, the rest
+	of mcman is dropped by --gc-sections. The -Wno options are for the mcman code, as in
+	mc_card_test.c:
+
+	F="-O2 -Wall -Wno-unused-value -Wno-pointer-to-int-cast -Wno-stringop-truncation -D_IOP -Iiop/memorycard/mcman/test/host -Iiop/memorycard/mcman/include -Iiop/system/sio2man/include -Icommon/include"
+	gcc $F -ffunction-sections -Wl,--gc-sections -Iiop/memorycard/mcman/src iop/memorycard/mcman/test/ecc_test.c -o ecc_test
+	./ecc_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _start mcman_start
+#include "main.c"
+
+#define CHUNK_SIZE		128
+#define RANDOM_CHUNKS	4096
+#define DOUBLE_ERRORS	64
+#define BENCH_BYTES		(16 * 1024 * 1024)
+#define BENCH_ROUNDS	4
+
+static u8 bench[BENCH_BYTES];
+static int errors;
+
+static void error(const char *what, int chunk, int bit)
+{
+	if (errors++ < 10)
+		printf("error: %s, chunk %d, bit %d\n", what, chunk, bit);
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------------------
+// McDataChecksum() and mcman_correctdata() from before the word-parallel version.
+static void ref_datachecksum(void *buf, void *ecc)
+{
+	register u8 *p, *p_ecc;
+	register int i, a2, a3, v, t0;
+
+	p = buf;
+	i = 0;
+	a2 = 0;
+	a3 = 0;
+	t0 = 0;
+
+	do {
+		v = mcman_xortable[*p++];
+		a2 ^= v;
+		if (v & 0x80) {
+			a3 ^= ~i;
+			t0 ^= i;
+		}
+	} while (++i < 0x80);
+
+	p_ecc = ecc;
+	p_ecc[0] = ~a2 & 0x77;
+	p_ecc[1] = ~a3 & 0x7F;
+	p_ecc[2] = ~t0 & 0x7F;
+}
+
+static int ref_correctdata(void *buf, void *ecc)
+{
+	register int xor0, xor1, xor2, xor3, xor4;
+	u8 eccbuf[12];
+	u8 *p = (u8 *)ecc;
+
+	ref_datachecksum(buf, eccbuf);
+
+	xor0 = p[0] ^ eccbuf[0];
+	xor1 = p[1] ^ eccbuf[1];
+	xor2 = p[2] ^ eccbuf[2];
+
+	xor3 = xor1 ^ xor2;
+	xor4 = (xor0 & 0xf) ^ (xor0 >> 4);
+
+	if (!xor0 && !xor1 && !xor2)
+		return 0;
+
+	if ((xor3 == 0x7f) && (xor4 == 0x7)) {
+		p[xor2] ^= 1 << (xor0 >> 4);
+		return -1;
+	}
+
+	xor0 = 0;
+	xor2 = 7;
+	do {
+		if ((xor3 & 1))
+			xor0++;
+		xor2--;
+		xor3 = xor3 >> 1;
+	} while (xor2 >= 0);
+
+	xor2 = 3;
+	do {
+		if ((xor4 & 1))
+			xor0++;
+		xor2--;
+		xor4 = xor4 >> 1;
+	} while (xor2 >= 0);
+
+	if (xor0 == 1)
+		return -2;
+
+	return -3;
+}
+
+//--------------------------------------------------------------
+static void check_checksum(const u8 *chunk, int n)
+{
+	static u32 words[(CHUNK_SIZE + 4) / 4];
+	u8 ecc[3], ref[3];
+	register int offset;
+
+	ref_datachecksum((void *)chunk, ref);
+	for (offset = 0; offset < 4; offset++) {
+		memcpy((u8 *)words + offset, chunk, CHUNK_SIZE);
+		McDataChecksum((u8 *)words + offset, ecc);
+		if (memcmp(ecc, ref, 3) != 0)
+			error("the ECC is different", n, offset);
+	}
+}
+
+// The data and the ECC are those of a chunk without errors, with the bits given flipped, -1 for none.
+// The bits 0 to 1023 are in the data, 1024 to 1047 in the ECC.
+static void check_correct(const u8 *chunk, const u8 *ecc, int n, int bit1, int bit2)
+{
+	struct {
+		u8 data[CHUNK_SIZE];
+		u8 ecc[CHUNK_SIZE];	// the correction flips a bit at the offset of the data byte in here
+	} copy[2];
+	int r[2], i, b, bit;
+
+	memset(copy, 0, sizeof(copy));
+	for (i = 0; i < 2; i++) {
+		memcpy(copy[i].data, chunk, CHUNK_SIZE);
+		memcpy(copy[i].ecc, ecc, 3);
+		for (b = 0; b < 2; b++) {
+			bit = b ? bit2 : bit1;
+			if (bit >= CHUNK_SIZE * 8)
+				copy[i].ecc[(bit >> 3) - CHUNK_SIZE] ^= 1 << (bit & 7);
+			else if (bit >= 0)
+				copy[i].data[bit >> 3] ^= 1 << (bit & 7);
+		}
+	}
+
+	r[0] = ref_correctdata(copy[0].data, copy[0].ecc);
+	r[1] = mcman_correctdata(copy[1].data, copy[1].ecc);
+
+	if (r[0] != r[1])
+		error("the correction result is different", n, bit1);
+	else if (memcmp(&copy[0], &copy[1], sizeof(copy[0])) != 0)
+		error("the corrected data is different", n, bit1);
+	else if (bit1 < 0 && r[1] != 0)
+		error("a chunk without errors isn't accepted", n, bit1);
+	else if (bit1 >= 0 && bit2 < 0 && r[1] == 0)
+		error("a single-bit error isn't detected", n, bit1);
+}
+
+static void check_chunk(const u8 *chunk, int n)
+{
+	u8 ecc[3];
+	int bit;
+
+	check_checksum(chunk, n);
+
+	McDataChecksum((void *)chunk, ecc);
+	check_correct(chunk, ecc, n, -1, -1);
+	for (bit = 0; bit < (CHUNK_SIZE + 3) * 8; bit++)
+		check_correct(chunk, ecc, n, bit, -1);
+	for (bit = 0; bit < DOUBLE_ERRORS; bit++)
+		check_correct(chunk, ecc, n, rand() % ((CHUNK_SIZE + 3) * 8), rand() % ((CHUNK_SIZE + 3) * 8));
+}
+
+static void benchmark(const char *what, void (*checksum)(void *, void *), int (*correct)(void *, void *))
+{
+	static u8 ecc[BENCH_BYTES / CHUNK_SIZE * 3];
+	double t0, t1, t2;
+	register int i, round;
+
+	t0 = seconds();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		for (i = 0; i < BENCH_BYTES / CHUNK_SIZE; i++)
+			checksum(bench + i * CHUNK_SIZE, ecc + i * 3);
+	}
+	t1 = seconds();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		for (i = 0; i < BENCH_BYTES / CHUNK_SIZE; i++) {
+			if (correct(bench + i * CHUNK_SIZE, ecc + i * 3) != 0)
+				error("a chunk without errors isn't accepted", i, -1);
+		}
+	}
+	t2 = seconds();
+
+	printf("%-14s checksum %7.1fMB/s, check %7.1fMB/s\n", what,
+		BENCH_ROUNDS * BENCH_BYTES / 1e6 / (t1 - t0), BENCH_ROUNDS * BENCH_BYTES / 1e6 / (t2 - t1));
+}
+
+int main(void)
+{
+	u8 chunk[CHUNK_SIZE];
+	register int n, i;
+
+	srand(7);
+
+	memset(chunk, 0x00, CHUNK_SIZE);
+	check_chunk(chunk, -1);
+	memset(chunk, 0xFF, CHUNK_SIZE);
+	check_chunk(chunk, -2);
+	for (i = 0; i < CHUNK_SIZE * 8; i++) {
+		memset(chunk, 0x00, CHUNK_SIZE);
+		chunk[i >> 3] = 1 << (i & 7);
+		check_checksum(chunk, -3);
+	}
+
+	for (n = 0; n < RANDOM_CHUNKS; n++) {
+		for (i = 0; i < CHUNK_SIZE; i++)
+			chunk[i] = rand();
+		check_chunk(chunk, n);
+	}
+
+	for (i = 0; i < BENCH_BYTES; i++)
+		bench[i] = rand();
+	benchmark("byte at a time", ref_datachecksum, ref_correctdata);
+	benchmark("word-parallel", McDataChecksum, mcman_correctdata);
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return (errors ? 1 : 0);
+}
@@ -0,0 +1,20 @@
+/* Host stand-in for the IOP cdvdman.h. The clock always reads 2009-01-01 12:00:00. */
+#ifndef __CDVDMAN_H__
+#define __CDVDMAN_H__
+
+#include <libcdvd-common.h>
+
+static inline int sceCdRC(sceCdCLOCK *clock)
+{
+	clock->stat = 0;
+	clock->second = 0x00;
+	clock->minute = 0x00;
+	clock->hour = 0x12;
+	clock->day = 0x01;
+	clock->month = 0x01;
+	clock->year = 0x09;
+
+	return 1;
+}
+
+#endif
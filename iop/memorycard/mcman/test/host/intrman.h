@@ -0,0 +1,7 @@
+/* Host stand-in for the IOP intrman.h: there are no interrupts. */
+#ifndef __INTRMAN_H__
+#define __INTRMAN_H__
+
+static inline int CpuEnableIntr(void) { return 0; }
+
+#endif
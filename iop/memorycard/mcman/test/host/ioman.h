@@ -0,0 +1,2 @@
+/* Host stand-in for the IOP ioman.h. */
+#include <io_common.h>
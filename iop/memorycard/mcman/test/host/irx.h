@@ -0,0 +1,20 @@
+/* Host stand-in for the IOP irx.h. */
+#ifndef __IRX_H__
+#define __IRX_H__
+
+#define MODULE_RESIDENT_END	0
+#define MODULE_NO_RESIDENT_END	1
+
+struct irx_id {
+	const char *n;
+	u16 v;
+};
+
+#define IRX_ID(name, major, minor)	struct irx_id _irx_id = { name, ((major) << 8) + (minor) }
+
+struct irx_export_table {
+	u16 version;
+	void *fptrs[64];
+};
+
+#endif
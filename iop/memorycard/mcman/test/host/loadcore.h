@@ -0,0 +1,24 @@
+/* Host stand-in for the IOP loadcore.h. There is no library list, module start up isn't tested. */
+#ifndef __LOADCORE_H__
+#define __LOADCORE_H__
+
+typedef struct _iop_library {
+	struct _iop_library *prev;
+	u16 version;
+	char name[8];
+} iop_library_t;
+
+typedef struct {
+	iop_library_t *let_next;
+} lc_internals_t;
+
+static inline lc_internals_t *GetLoadcoreInternalData(void)
+{
+	static lc_internals_t internals;
+
+	return &internals;
+}
+
+static inline int RegisterLibraryEntries(struct irx_export_table *exports) { return 0; }
+
+#endif
@@ -0,0 +1 @@
+/* Host stand-in for the IOP modload.h, nothing from it is needed. */
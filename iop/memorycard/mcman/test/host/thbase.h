@@ -0,0 +1,7 @@
+/* Host stand-in for the IOP thbase.h: there is a single thread. */
+#ifndef __THBASE_H__
+#define __THBASE_H__
+
+static inline int DelayThread(int usec) { return 0; }
+
+#endif
@@ -0,0 +1,9 @@
+/* Host stand-in for the IOP timrman.h. There are no hardware timers. */
+#ifndef __TIMRMAN_H__
+#define __TIMRMAN_H__
+
+static inline int AllocHardTimer(int source, int size, int prescale) { return -1; }
+static inline int ReferHardTimer(int source, int size, int mode, int modemask) { return -150; }
+static inline void SetTimerMode(int timid, int mode) { }
+
+#endif
@@ -0,0 +1,524 @@
+/*
+	Host test and benchmark of the mcman cluster cache, on an 8MB memory card image in RAM.
+
+	mcman is built with the SIO2 commands of mcsio2.c replaced by a RAM card with 512-byte pages,
+	16-page erase blocks and ECC. The card is formatted and filled with saves of three files each
+	until it is nearly full. Files are then rewritten, deleted and read at random, with the cache
+	flushed and dropped now and then so that the reads come from the card image. Every read is
+	checked against the data that was written, every directory against the files in it, and the
+	hash chains and the LRU list of the cache are checked after each call. The test fails if it
+	doesn't end within a minute.
+
+	The page reads, page writes and block erases of filling the card, walking every directory of the
+	full card 50 times and reading every file are counted and timed, for the cache from before the
+	hash and LRU list too.
+
+	Build and run from the root of the tree. The mcman code has statements without effect, checks
+	the alignment of pointers through u32 and copies names with strncpy() up to the size of the
+	field, hence the -Wno options:
+
+	F="-O2 -Wall -Wno-unused-value -Wno-pointer-to-int-cast -Wno-stringop-truncation -D_IOP -Iiop/memorycard/mcman/test/host -Iiop/memorycard/mcman/include -Iiop/system/sio2man/include -Icommon/include"
+	gcc $F -Iiop/memorycard/mcman/src iop/memorycard/mcman/test/mc_card_test.c -o mc_card_test
+	gcc $F -DMAX_CACHEENTRY=128 -Iiop/memorycard/mcman/src iop/memorycard/mcman/test/mc_card_test.c -o mc_card_test_128
+	mkdir -p mcman_old && git show 22ecac1:iop/memorycard/mcman/src/main.c > mcman_old/main.c
+	git show 22ecac1:iop/memorycard/mcman/src/mcman-internal.h > mcman_old/mcman-internal.h
+	gcc $F -DOLD_CACHE -Imcman_old -Iiop/memorycard/mcman/src iop/memorycard/mcman/test/mc_card_test.c -o mc_card_test_old
+	./mc_card_test && ./mc_card_test_128 && ./mc_card_test_old
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _start mcman_start
+#include "main.c"
+#include "ps2mc_fio.c"
+#include "ps1mc_fio.c"
+
+#define PORT			0
+#define SLOT			0
+#define CARD_PAGES		16384
+#define PAGE_SIZE		512
+#define SPARE_SIZE		16
+#define BLOCK_PAGES		16
+#define MAX_FILES		1024
+#define FILES_PER_SAVE	3
+#define RANDOM_CALLS	3000
+#define WALKS			50
+#define TIME_LIMIT		60	// seconds, a broken hash chain can make mcman loop forever
+
+struct test_file {
+	char path[64];
+	int id;		// the contents are a function of the id and the offset, 0 if deleted
+	int size;
+};
+
+static u8 card[CARD_PAGES][PAGE_SIZE + SPARE_SIZE];
+static unsigned int pageReads, pageWrites, blockErases;
+static struct test_file files[MAX_FILES];
+static int fileCount, saveCount, nextId = 1;
+static u8 buffer[16384];
+static int errors;
+
+static void error(const char *what, const char *path, int value)
+{
+	if (errors++ < 10)
+		printf("error: %s, %s, %d\n", what, path, value);
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------------------
+// RAM card, in place of the SIO2 commands of mcsio2.c.
+
+u8 mcman_sio2outbufs_PS1PDA[0x90];
+
+int mcsio2_transfer(int port, int slot, sio2_transfer_data_t *sio2data) { return 0; }
+int mcsio2_transfer2(int port, int slot, sio2_transfer_data_t *sio2data) { return 0; }
+int secrman_mc_command(int port, int slot, sio2_transfer_data_t *sio2data) { return 1; }
+void sio2packet_add(int port, int slot, int cmd, u8 *buf) { }
+void mcman_initPS2com(void) { }
+void mcman_initPS1PDAcom(void) { }
+int mcman_cardchanged(int port, int slot) { return sceMcResSucceed; }
+int mcman_resetauth(int port, int slot) { return sceMcResSucceed; }
+int mcman_probePS1Card(int port, int slot) { return sceMcResFailDetect; }
+int mcman_probePS1Card2(int port, int slot) { return sceMcResFailDetect; }
+int mcman_probePDACard(int port, int slot) { return sceMcResFailDetect; }
+int McReadPS1PDACard(int port, int slot, int page, void *buf) { return sceMcResFailDetect; }
+int McWritePS1PDACard(int port, int slot, int page, void *buf) { return sceMcResFailDetect; }
+
+int McGetCardSpec(int port, int slot, s16 *pagesize, u16 *blocksize, int *cardsize, u8 *flags)
+{
+	*pagesize = PAGE_SIZE;
+	*blocksize = BLOCK_PAGES;
+	*cardsize = CARD_PAGES;
+	*flags = CF_USE_ECC | CF_BAD_BLOCK;
+
+	return sceMcResSucceed;
+}
+
+// Same as in mcsio2.c, without the SIO2 commands.
+int mcman_probePS2Card2(int port, int slot)
+{
+	register int r;
+
+	r = McGetFormat(port, slot);
+	if (r > 0)
+		return sceMcResSucceed;
+	if (r < 0)
+		return sceMcResNoFormat;
+
+	return sceMcResFailDetect2;
+}
+
+int mcman_probePS2Card(int port, int slot)
+{
+	register int r;
+
+	if (McGetFormat(port, slot) != 0)
+		return sceMcResSucceed;
+
+	mcman_clearcache(port, slot);
+
+	r = mcman_setdevinfos(port, slot);
+	if (r == 0)
+		return sceMcResChangedCard;
+	if (r != sceMcResNoFormat)
+		return sceMcResFailDetect2;
+
+	mcman_devinfos[port][slot].cardform = r;
+
+	return r;
+}
+
+// Erases to 0xFF and leaves the ECC of the given pages in eccbuf, like mcsio2.c.
+int mcman_eraseblock(int port, int slot, int block, void **pagebuf, void *eccbuf)
+{
+	register int page, size;
+	u8 *p_ecc;
+
+	if (block < 0 || block >= CARD_PAGES / BLOCK_PAGES) {
+		error("erase out of range", "", block);
+		return sceMcResNoFormat;
+	}
+
+	memset(card[block * BLOCK_PAGES], 0xFF, BLOCK_PAGES * sizeof(card[0]));
+	blockErases++;
+
+	if (pagebuf && eccbuf) {
+		mcman_wmemset(eccbuf, 32, 0);
+
+		for (page = 0; page < BLOCK_PAGES; page++) {
+			p_ecc = (u8 *)eccbuf + ((page * PAGE_SIZE) >> 5);
+			for (size = 0; size < PAGE_SIZE; size += 128) {
+				if (*pagebuf)
+					McDataChecksum((u8 *)*pagebuf + size, p_ecc);
+				p_ecc += 3;
+			}
+			pagebuf++;
+		}
+	}
+
+	return sceMcResSucceed;
+}
+
+int McWritePage(int port, int slot, int page, void *pagebuf, void *eccbuf)
+{
+	if (page < 0 || page >= CARD_PAGES) {
+		error("write out of range", "", page);
+		return sceMcResNoFormat;
+	}
+
+	memcpy(card[page], pagebuf, PAGE_SIZE);
+	memcpy(card[page] + PAGE_SIZE, eccbuf, SPARE_SIZE);
+	pageWrites++;
+
+	return sceMcResSucceed;
+}
+
+int mcman_readpage(int port, int slot, int page, void *buf, void *eccbuf)
+{
+	if (page < 0 || page >= CARD_PAGES) {
+		error("read out of range", "", page);
+		return sceMcResChangedCard;
+	}
+
+	memcpy(buf, card[page], PAGE_SIZE);
+	memcpy(eccbuf, card[page] + PAGE_SIZE, SPARE_SIZE);
+	pageReads++;
+
+	return sceMcResSucceed;
+}
+
+//--------------------------------------------------------------
+// Every cached cluster is hashed once, in the chain of its hash, and the LRU list holds every entry once.
+static void check_cache(void)
+{
+#ifndef OLD_CACHE
+	u8 seen[MAX_CACHEENTRY];
+	register int e, prev, h, count;
+	McCacheEntry *mce;
+
+	memset(seen, 0, sizeof(seen));
+	count = 0;
+	prev = MCMAN_CACHE_NIL;
+	for (e = mcman_cachemru; e != MCMAN_CACHE_NIL && count <= MAX_CACHEENTRY; e = mcman_cacheolder[e]) {
+		if (seen[e]++ || mcman_cachenewer[e] != prev)
+			error("the LRU list is broken", "", e);
+		prev = e;
+		count++;
+	}
+	if (count != MAX_CACHEENTRY || mcman_cachelru != prev)
+		error("the LRU list doesn't hold every entry", "", count);
+
+	memset(seen, 0, sizeof(seen));
+	for (h = 0; h < MCMAN_CACHEHASH_SIZE; h++) {
+		count = 0;
+		for (e = mcman_cachehash[h]; e != MCMAN_CACHE_NIL && count <= MAX_CACHEENTRY; e = mcman_cachehnext[e]) {
+			mce = &mcman_entrycache[e];
+			if (seen[e]++ || mce->cluster < 0 || mcman_cachehashfn(mce->mc_port, mce->mc_slot, mce->cluster) != h)
+				error("a hash chain is broken", "", e);
+			count++;
+		}
+	}
+
+	for (e = 0; e < MAX_CACHEENTRY; e++) {
+		mce = &mcman_entrycache[e];
+		if ((mce->cluster >= 0) != (seen[e] != 0))
+			error("a cached cluster isn't hashed", "", mce->cluster);
+		else if (mce->cluster >= 0 && mcman_getcacheentry(mce->mc_port, mce->mc_slot, mce->cluster) != mce)
+			error("a cluster is cached twice", "", mce->cluster);
+	}
+#endif
+}
+
+// Writes the cache back and drops it, as if the card had been reinserted.
+static void remount(void)
+{
+	register int r;
+
+	if ((r = McFlushCache(PORT, SLOT)) != sceMcResSucceed)
+		error("flushing the cache failed", "", r);
+	mcman_clearcache(PORT, SLOT);
+	check_cache();
+}
+
+//--------------------------------------------------------------
+static u8 file_byte(int id, int offset)
+{
+	register u32 x = id * 2654435761u + offset;
+
+	x ^= x >> 13;
+	return (u8)(x * 40503u >> 8);
+}
+
+static int write_file(struct test_file *f, int id, int size)
+{
+	register int fd, pos, n, i, r;
+
+	if ((fd = McOpen(PORT, SLOT, f->path, sceMcFileCreateFile | FIO_O_RDWR)) < 0) {
+		if (fd != sceMcResFullDevice)
+			error("creating a file failed", f->path, fd);
+		return fd;
+	}
+
+	for (pos = 0; pos < size; pos += n) {
+		n = 1 + rand() % sizeof(buffer);
+		if (n > size - pos)
+			n = size - pos;
+		for (i = 0; i < n; i++)
+			buffer[i] = file_byte(id, pos + i);
+		if ((r = McWrite(fd, buffer, n)) != n) {
+			McClose(fd);
+			McDelete(PORT, SLOT, f->path, 0);
+			if (r != sceMcResFullDevice)
+				error("writing a file failed", f->path, r);
+			f->id = 0;
+			return sceMcResFullDevice;
+		}
+		check_cache();
+	}
+
+	if ((r = McClose(fd)) != sceMcResSucceed)
+		error("closing a file failed", f->path, r);
+	check_cache();
+
+	f->id = id;
+	f->size = size;
+	return sceMcResSucceed;
+}
+
+static void check_file(const struct test_file *f)
+{
+	register int fd, pos, n, i;
+
+	if ((fd = McOpen(PORT, SLOT, (char *)f->path, FIO_O_RDONLY)) < 0) {
+		error("opening a file failed", f->path, fd);
+		return;
+	}
+
+	for (pos = 0; pos <= f->size; pos += n) {
+		n = McRead(fd, buffer, 1 + rand() % sizeof(buffer));
+		if (n < 0) {
+			error("reading a file failed", f->path, n);
+			break;
+		}
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++) {
+			if (buffer[i] != file_byte(f->id, pos + i))
+				break;
+		}
+		if (i < n) {
+			error("a file has the wrong data", f->path, pos + i);
+			break;
+		}
+	}
+	if (pos != f->size)
+		error("a file has the wrong size", f->path, pos);
+
+	McClose(fd);
+	check_cache();
+}
+
+static void delete_file(struct test_file *f)
+{
+	register int r;
+
+	if ((r = McDelete(PORT, SLOT, f->path, 0)) != sceMcResSucceed)
+		error("deleting a file failed", f->path, r);
+	f->id = 0;
+	check_cache();
+}
+
+// The entries of each save must match its files, returns the number of entries.
+static int check_dirs(void)
+{
+	static sceMcTblGetDir info[16];
+	char path[64];
+	register int s, i, j, n, total;
+	const struct test_file *f;
+
+	total = 0;
+	for (s = 0; s < saveCount; s++) {
+		f = &files[s * FILES_PER_SAVE];
+		snprintf(path, sizeof(path), "%.*s/*", (int)(strchr(f->path + 1, '/') - f->path), f->path);
+		n = McGetDir(PORT, SLOT, path, 0, 16, info);
+		if (n < 0) {
+			error("listing a directory failed", path, n);
+			continue;
+		}
+		total += n;
+
+		for (i = 0; i < FILES_PER_SAVE; i++, f++) {
+			for (j = 0; j < n; j++) {
+				if (strcmp((char *)info[j].EntryName, strrchr(f->path, '/') + 1) == 0)
+					break;
+			}
+			if ((j < n) != (f->id != 0))
+				error("a directory doesn't match its files", f->path, j);
+			else if (j < n && info[j].FileSizeByte != f->size)
+				error("a directory entry has the wrong size", f->path, info[j].FileSizeByte);
+		}
+	}
+	check_cache();
+
+	return total;
+}
+
+//--------------------------------------------------------------
+static void format(void)
+{
+	register int r;
+
+	mc_detectcard = McDetectCard2;
+	mcman_sio2transfer = mcsio2_transfer;
+	mcman_initcache();
+	memset(card, 0xFF, sizeof(card));
+
+	McDetectCard(PORT, SLOT);
+	if ((r = McFormat(PORT, SLOT)) != sceMcResSucceed)
+		error("formatting the card failed", "", r);
+	if ((r = McDetectCard(PORT, SLOT)) != sceMcResSucceed)
+		error("the formatted card isn't detected", "", r);
+	check_cache();
+}
+
+// Saves of an icon.sys, an icon and a data file are written until the card is full.
+static void fill(void)
+{
+	static const char *names[FILES_PER_SAVE] = {"icon.sys", "view.ico", "data.bin"};
+	register int i, r, size;
+	char dir[32];
+
+	for (;;) {
+		snprintf(dir, sizeof(dir), "/BASLUS-%05d", 20000 + saveCount);
+		if ((r = McOpen(PORT, SLOT, dir, sceMcFileCreateDir)) < 0) {
+			if (r != sceMcResFullDevice)
+				error("creating a directory failed", dir, r);
+			return;
+		}
+		McClose(r);
+
+		for (i = 0; i < FILES_PER_SAVE; i++) {
+			if (i == 0)
+				size = 964;
+			else if (i == 1)
+				size = 8192 + rand() % 32768;
+			else
+				size = 1 + rand() % 98304;
+
+			snprintf(files[fileCount + i].path, sizeof(files[0].path), "%s/%s", dir, names[i]);
+			if (write_file(&files[fileCount + i], nextId++, size) != sceMcResSucceed)
+				break;
+		}
+		fileCount += FILES_PER_SAVE;
+		saveCount++;
+
+		if (i < FILES_PER_SAVE || fileCount + FILES_PER_SAVE > MAX_FILES)
+			return;
+	}
+}
+
+// Rewrites, deletes and reads files at random, remounting the card now and then.
+static void random_calls(void)
+{
+	register int i, size;
+	struct test_file *f;
+
+	for (i = 0; i < RANDOM_CALLS; i++) {
+		f = &files[rand() % fileCount];
+		switch (rand() % 4) {
+			case 0:
+				if (f->id != 0)
+					delete_file(f);
+				size = 1 + rand() % 65536;
+				write_file(f, nextId++, size);
+				break;
+			case 1:
+				if (f->id != 0)
+					delete_file(f);
+				break;
+			default:
+				if (f->id != 0)
+					check_file(f);
+				break;
+		}
+
+		if (rand() % 100 == 0)
+			remount();
+	}
+}
+
+static void timeout(int sig)
+{
+	printf("error: the test doesn't end\nFAIL\n");
+	exit(1);
+}
+
+static void report(const char *what, double time, unsigned int reads, unsigned int writes, unsigned int erases)
+{
+	printf("%-28s %8.2fms, %7u page reads, %6u page writes, %5u block erases\n", what, time * 1e3, reads, writes, erases);
+}
+
+int main(void)
+{
+	register int i, entries;
+	double t;
+
+	signal(SIGALRM, timeout);
+	alarm(TIME_LIMIT);
+
+	srand(7);
+	format();
+
+	pageReads = pageWrites = blockErases = 0;
+	t = seconds();
+	fill();
+	remount();
+	report("filling the card", seconds() - t, pageReads, pageWrites, blockErases);
+	printf("%d saves, %d free clusters\n", saveCount, McGetFreeClusters(PORT, SLOT));
+
+	for (i = 0; i < fileCount; i++) {
+		if (files[i].id != 0)
+			check_file(&files[i]);
+	}
+
+	// Each directory also holds "." and "..".
+	entries = saveCount * 2;
+	for (i = 0; i < fileCount; i++)
+		entries += (files[i].id != 0);
+
+	pageReads = 0;
+	t = seconds();
+	for (i = 0; i < WALKS; i++) {
+		if (check_dirs() != entries)
+			error("the directories don't hold every file", "", entries);
+	}
+	report("walking every directory", (seconds() - t) / WALKS, pageReads / WALKS, 0, 0);
+
+	random_calls();
+	remount();
+	check_dirs();
+
+	pageReads = 0;
+	t = seconds();
+	for (i = 0; i < fileCount; i++) {
+		if (files[i].id != 0)
+			check_file(&files[i]);
+	}
+	report("reading every file", seconds() - t, pageReads, 0, 0);
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return (errors ? 1 : 0);
+}
@@ -145,7 +145,10 @@ int NetManIoctl(unsigned int command, void *args, unsigned int args_len, void *o
 
 	WaitSema(NetManIOSemaID);
 
-	if(MainNetIF!=NULL){
+	if(command==NETMAN_IOCTL_GET_RX_BATCH_STATS){
+		result=NetManRpcGetRxBatchStats(output, length);
+	}
+	else if(MainNetIF!=NULL){
 		result=MainNetIF->ioctl(command, args, args_len, output, length);
 	}
 	else result=-1;
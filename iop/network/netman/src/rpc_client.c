@@ -25,8 +25,14 @@ static union{
 } SifRpcTxBuffer;
 
 //Data for IOP -> EE transfers
+//A batch has one DMA tag per frame, followed by up to two tags for the descriptors. The total number presented to sceSifSetDma must never exceed 32.
+#define NETMAN_RX_BATCH_SIZE	(NETMAN_FRAME_GROUP_SIZE*2)
+
 static unsigned short int EEFrameBufferWrPtr, NumFramesInQueue;
-static SifDmaTransfer_t dmatReqs[NETMAN_FRAME_GROUP_SIZE*2];
+static SifDmaTransfer_t dmatReqs[NETMAN_RX_BATCH_SIZE+2];
+static u32 FrameQueueTime[NETMAN_RX_BATCH_SIZE];
+static int FrameDmaID;
+static struct NetManRxBatchStats RxBatchStats;
 
 static int NetManIOSemaID = -1;
 
@@ -57,6 +63,8 @@ int NetManInitRPCClient(void)
 		memset(FrameBufferStatus, 0, NETMAN_RPC_BLOCK_SIZE * sizeof(struct NetManBD));
 		EEFrameBufferWrPtr = 0;
 		NumFramesInQueue = 0;
+		FrameDmaID = 0;
+		memset(&RxBatchStats, 0, sizeof(RxBatchStats));
 
 		for(i = 0; i < NETMAN_RPC_BLOCK_SIZE; i++)	//Mark all descriptors as "in-use", until the EE-side allocates buffers.
 			FrameBufferStatus[i].length = USHRT_MAX;
@@ -137,20 +145,54 @@ void NetManRpcNetProtStackFreeRxPacket(void *packet)
 	((struct NetManPacketBuffer*)packet)->handle = NULL;
 }
 
+//1ms = 36864 ticks.
+#define FRAME_TICKS_TO_USEC(ticks)	(((ticks) * 125) / 4608)
+
+static u32 GetFrameTime(void)
+{
+	iop_sys_clock_t clock;
+
+	GetSystemTime(&clock);
+	return clock.lo;
+}
+
 //Only one thread can enter this critical section!
 static int sendFramesToEE(int mode)
 {
-	int OldState, res;
+	int OldState, res, first, count, i;
+	u32 now, latency;
 
 	if (NumFramesInQueue > 0)
 	{
-		dmatReqs[(NumFramesInQueue-1) * 2 + 1].attr = SIF_DMA_INT_O;	//Mark the last entry to notify the receive thread of the incoming frame(s). This will stall SIF0.
+		/*	The descriptors of the frames are consecutive in the ring buffer, so they are written with a single tag after the frames
+			(two if the batch wraps around). They arrive after the frames, so the EE never sees a frame before its data. */
+		first = (EEFrameBufferWrPtr + NETMAN_RPC_BLOCK_SIZE - NumFramesInQueue) % NETMAN_RPC_BLOCK_SIZE;
+		count = NETMAN_RPC_BLOCK_SIZE - first;
+		if (count > NumFramesInQueue)
+			count = NumFramesInQueue;
+
+		dmatReqs[NumFramesInQueue].src = &FrameBufferStatus[first];
+		dmatReqs[NumFramesInQueue].dest = &EEFrameBufferStatus[first];
+		dmatReqs[NumFramesInQueue].size = count * sizeof(struct NetManBD);
+		dmatReqs[NumFramesInQueue].attr = 0;
+
+		if (count < NumFramesInQueue)
+		{
+			dmatReqs[NumFramesInQueue + 1].src = &FrameBufferStatus[0];
+			dmatReqs[NumFramesInQueue + 1].dest = &EEFrameBufferStatus[0];
+			dmatReqs[NumFramesInQueue + 1].size = (NumFramesInQueue - count) * sizeof(struct NetManBD);
+			dmatReqs[NumFramesInQueue + 1].attr = 0;
+			count = NumFramesInQueue + 2;
+		} else
+			count = NumFramesInQueue + 1;
+
+		dmatReqs[count - 1].attr = SIF_DMA_INT_O;	//Mark the last entry to notify the receive thread of the incoming frame(s). This will stall SIF0.
 
 		//Transfer the frame over to the EE
 		do{
 			if (mode == 0)
 				CpuSuspendIntr(&OldState);
-			res = sceSifSetDma(dmatReqs, 2*NumFramesInQueue);
+			res = sceSifSetDma(dmatReqs, count);
 			if (mode == 0)
 				CpuResumeIntr(OldState);
 
@@ -160,20 +202,51 @@ static int sendFramesToEE(int mode)
 				return -1;
 		}while(res == 0);
 
+		FrameDmaID = res;
+
+		now = GetFrameTime();
+		for (i = 0; i < NumFramesInQueue; i++)
+		{
+			latency = FRAME_TICKS_TO_USEC(now - FrameQueueTime[i]);
+			RxBatchStats.GroupingLatency += latency;
+			if (latency > RxBatchStats.MaxGroupingLatency)
+				RxBatchStats.MaxGroupingLatency = latency;
+		}
+
+		RxBatchStats.FrameCount += NumFramesInQueue;
+		RxBatchStats.BatchCount++;
+		RxBatchStats.TagCount += count;
+		if (mode != 0 || NumFramesInQueue > 1)
+			RxBatchStats.GroupedBatchCount++;
+		if (NumFramesInQueue > RxBatchStats.MaxBatchFrames)
+			RxBatchStats.MaxBatchFrames = NumFramesInQueue;
+
 		NumFramesInQueue = 0;
 	}
 
 	return 0;
 }
 
-//The SMAP Rx FIFO may only hold 16384 / 1518 = 10 frames. In 1ms, roughly 8 full-length frames can be transferred at 100Mbit within 1ms. 1ms = 36864 ticks.
-#define FRAME_GROUPING_INTERVAL	36864
+//Returns non-zero while the last batch is still being transferred to the EE.
+static int isFrameDmaBusy(void)
+{
+	return(FrameDmaID != 0 && sceSifDmaStat(FrameDmaID) >= 0);
+}
+
+//How often a grouped batch checks whether the previous batch has been transferred. 50us = 1843 ticks, about half of a full-length frame at 100Mbit.
+#define FRAME_GROUPING_INTERVAL	1843
 
 static unsigned int FrameSendCB(void *arg)
 {
+	if (isFrameDmaBusy())
+		return FRAME_GROUPING_INTERVAL;
+
 	return(sendFramesToEE(1) == 0 ? 0 : FRAME_GROUPING_INTERVAL); //If sending failed, try again later.
 }
 
+/*	Frames are sent right away if the previous batch has already been transferred, so that a lone frame is not delayed.
+	Under load, frames that arrive while a batch is being transferred are grouped into the next batch, which is sent once
+	the transfer completes or when the batch is full. */
 //Only one thread can enter this critical section!
 static void EnQFrame(const void *frame, unsigned int length)
 {
@@ -184,7 +257,7 @@ static void EnQFrame(const void *frame, unsigned int length)
 	//Cancel any ongoing callbacks.
 	CancelAlarm(&FrameSendCB, NULL);
 
-	if (NumFramesInQueue >= NETMAN_FRAME_GROUP_SIZE)
+	if (NumFramesInQueue >= NETMAN_RX_BATCH_SIZE)
 	{	/* If there are already sufficient frames, the frames can be sent right away.
 		   This may happen here if sending failed within the interrupt callback and there are more frames to send. */
 		sendFramesToEE(0);
@@ -193,36 +266,43 @@ static void EnQFrame(const void *frame, unsigned int length)
 	//No need to wait for a free spot to appear, as Alloc already took care of that.
 	bd = &FrameBufferStatus[EEFrameBufferWrPtr];
 
-	//Record the frame length.
+	//Record the frame length. The descriptor is transferred with the rest of the batch.
 	bd->length = length;
 
 	//Prepare DMA transfer.
-	dmat = &dmatReqs[NumFramesInQueue * 2];
-	dmat[0].src = (void*)frame;
-	dmat[0].dest = bd->payload;
-	dmat[0].size = (length + 3) & ~3;
-	dmat[0].attr = 0;
-
-	dmat[1].src = bd;
-	dmat[1].dest = &EEFrameBufferStatus[EEFrameBufferWrPtr];
-	dmat[1].size = sizeof(struct NetManBD);
-	dmat[1].attr = 0;
+	dmat = &dmatReqs[NumFramesInQueue];
+	dmat->src = (void*)frame;
+	dmat->dest = bd->payload;
+	dmat->size = (length + 3) & ~3;
+	dmat->attr = 0;
+
+	FrameQueueTime[NumFramesInQueue] = GetFrameTime();
 	NumFramesInQueue++;
 
 	//Increase the write (IOP -> EE) pointer by one place.
 	EEFrameBufferWrPtr = (EEFrameBufferWrPtr + 1) % NETMAN_RPC_BLOCK_SIZE;
 
-	if (NumFramesInQueue >= NETMAN_FRAME_GROUP_SIZE)
-	{	//If there are sufficient frames, the frames can be sent right away.
+	if (NumFramesInQueue >= NETMAN_RX_BATCH_SIZE || !isFrameDmaBusy())
+	{	//If there are sufficient frames or the previous batch is done, the frames can be sent right away.
 		sendFramesToEE(0);
 	} else {
-		//Wait a while in case further frames can be grouped, to allow sceSifSetDma() to chain the requests together.
+		//Wait for the previous batch to complete, in case further frames can be grouped, to allow sceSifSetDma() to chain the requests together.
 		clock.lo = FRAME_GROUPING_INTERVAL;
 		clock.hi = 0;
 		SetAlarm(&clock, &FrameSendCB, NULL);
 	}
 }
 
+int NetManRpcGetRxBatchStats(void *output, unsigned int length)
+{
+	if (length < sizeof(RxBatchStats))
+		return -EINVAL;
+
+	memcpy(output, &RxBatchStats, sizeof(RxBatchStats));
+
+	return 0;
+}
+
 //Frames will be enqueued in the order that they were allocated.
 void NetManRpcProtStackEnQRxPacket(void *packet)
 {
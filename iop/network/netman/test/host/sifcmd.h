@@ -0,0 +1,12 @@
+/* Host stand-in for the IOP sifcmd.h: the RPC functions are provided by the simulation. */
+#ifndef __SIFCMD_H__
+#define __SIFCMD_H__
+
+typedef struct {
+	void *server;
+} SifRpcClientData_t;
+
+int sceSifBindRpc(SifRpcClientData_t *client, int rpc_number, int mode);
+int sceSifCallRpc(SifRpcClientData_t *client, int rpc_number, int mode, void *send, int ssize, void *receive, int rsize, void *end_function, void *end_param);
+
+#endif
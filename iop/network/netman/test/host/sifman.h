@@ -0,0 +1,15 @@
+/* Host stand-in for the IOP sifman.h: the DMA functions are provided by the simulation. */
+#ifndef __SIFMAN_H__
+#define __SIFMAN_H__
+
+typedef struct {
+	void *src, *dest;
+	int size, attr;
+} SifDmaTransfer_t;
+
+#define SIF_DMA_INT_O	0x04
+
+int sceSifSetDma(SifDmaTransfer_t *dmat, int count);
+int sceSifDmaStat(int id);
+
+#endif
@@ -0,0 +1,15 @@
+/* Host stand-in for the IOP thbase.h: the clock and alarms are provided by the simulation. */
+#ifndef __THBASE_H__
+#define __THBASE_H__
+
+typedef struct {
+	unsigned int lo, hi;
+} iop_sys_clock_t;
+
+int GetSystemTime(iop_sys_clock_t *clock);
+int SetAlarm(iop_sys_clock_t *clock, unsigned int (*callback)(void *), void *arg);
+int CancelAlarm(unsigned int (*callback)(void *), void *arg);
+
+static inline int DelayThread(int usec) { return 0; }
+
+#endif
@@ -0,0 +1 @@
+/* Host stand-in for the IOP thevent.h: event flags are not used by rpc_client.c. */
@@ -0,0 +1,293 @@
+/*
+ * Host simulation of the IOP -> EE frame path of rpc_client.c.
+ *
+ * rpc_client.c runs against a model of the IOP clock, the alarms and the SIF DMA.
+ * Each call to sceSifSetDma() is checked:
+ *  - it must not have more than 32 tags;
+ *  - every frame must have its descriptor, written after the frame data;
+ *  - the last tag must carry SIF_DMA_INT_O.
+ * A transfer costs 8us, plus 0.5us per tag and about 30MB/s of data. The EE
+ * takes 10us to handle it and frees the slots 5us later. Each workload prints
+ * the batches, the tags per frame and the time from a frame being enqueued to
+ * its transfer being done.
+ *
+ * Build and run from the root of the tree, with the rpc_client.c from before
+ * the batching change for comparison. The -Wno options are for netman itself:
+ * internal.h declares malloc() with an int size, and rpc_client.c passes the
+ * module ID through the semaphore option as a u32:
+ *
+ *   F="-O2 -Wall -Wno-builtin-declaration-mismatch -Wno-pointer-to-int-cast -D_EE -Iiop/network/netman/test/host -Iiop/network/netman/src/include -idirafter common/include"
+ *   gcc $F iop/network/netman/test/rx_batch_sim.c iop/network/netman/src/rpc_client.c -o rx_batch_sim
+ *   git show 22ecac1:iop/network/netman/src/rpc_client.c > rpc_client_old.c
+ *   gcc $F -DNO_RX_BATCH_STATS iop/network/netman/test/rx_batch_sim.c rpc_client_old.c -o rx_batch_sim_old
+ *   ./rx_batch_sim && ./rx_batch_sim_old
+ */
+
+#include <stdio.h>
+#include <tamtypes.h>
+#include <sifcmd.h>
+#include <sifman.h>
+#include <thbase.h>
+#include <netman.h>
+#include <netman_rpc.h>
+
+#include "rpc_client.h"
+
+//The IOP clock runs at 36.864MHz.
+#define USEC(us)	((tick_t)((us) * 36.864))
+#define MAX_DMA		200000
+
+typedef unsigned long long tick_t;
+
+static tick_t now;
+static tick_t DmaBusyUntil, DmaDone[MAX_DMA];
+static int DmaCount;
+
+static unsigned int (*AlarmCB)(void *);
+static tick_t AlarmTime;
+
+static struct NetManBD EEFrameBufferStatus[NETMAN_RPC_BLOCK_SIZE];
+static u8 EEFrameBuffer[NETMAN_RPC_BLOCK_SIZE][NETMAN_MAX_FRAME_SIZE];
+static struct NetManBD *IOPFrameBufferStatus;
+
+//Set for a slot from the start of its transfer until the EE frees it.
+static int SlotState[NETMAN_RPC_BLOCK_SIZE];
+static tick_t SlotQueued[NETMAN_RPC_BLOCK_SIZE], SlotDone[NETMAN_RPC_BLOCK_SIZE];
+
+static long long frames, batches, tags, stalls, LatencySum, LatencyMax;
+static int errors;
+
+static void error(const char *what, int slot)
+{
+	if(errors++ < 10)
+		printf("error: %s, slot %d\n", what, slot);
+}
+
+int sceSifBindRpc(SifRpcClientData_t *client, int rpc_number, int mode)
+{
+	client->server = (void*)1;
+	return 0;
+}
+
+int sceSifCallRpc(SifRpcClientData_t *client, int rpc_number, int mode, void *send, int ssize, void *receive, int rsize, void *end_function, void *end_param)
+{
+	struct NetManEEInitResult *result = receive;
+
+	if(rpc_number == NETMAN_EE_RPC_FUNC_INIT)
+	{
+		IOPFrameBufferStatus = *(struct NetManBD**)send;
+		result->result = 0;
+		result->FrameBufferStatus = EEFrameBufferStatus;
+	}
+
+	return 0;
+}
+
+int GetSystemTime(iop_sys_clock_t *clock)
+{
+	clock->lo = (unsigned int)now;
+	clock->hi = (unsigned int)(now >> 32);
+	return 0;
+}
+
+int SetAlarm(iop_sys_clock_t *clock, unsigned int (*callback)(void *), void *arg)
+{
+	AlarmCB = callback;
+	AlarmTime = now + clock->lo;
+	return 0;
+}
+
+int CancelAlarm(unsigned int (*callback)(void *), void *arg)
+{
+	AlarmCB = NULL;
+	return 0;
+}
+
+int sceSifDmaStat(int id)
+{
+	return(DmaDone[id] > now ? 0 : -1);
+}
+
+int sceSifSetDma(SifDmaTransfer_t *dmat, int count)
+{
+	int i, slot, first, n, bytes = 0, seen[NETMAN_RPC_BLOCK_SIZE] = {0};
+	tick_t start;
+
+	if(count > 32)
+		error("more than 32 tags", -1);
+	if(!(dmat[count - 1].attr & SIF_DMA_INT_O))
+		error("the last tag has no SIF_DMA_INT_O", -1);
+
+	for(i = 0; i < count; i++)
+	{
+		bytes += dmat[i].size;
+
+		if((u8*)dmat[i].dest >= (u8*)EEFrameBufferStatus && (u8*)dmat[i].dest < (u8*)&EEFrameBufferStatus[NETMAN_RPC_BLOCK_SIZE])
+		{
+			first = (struct NetManBD*)dmat[i].dest - EEFrameBufferStatus;
+			n = dmat[i].size / sizeof(struct NetManBD);
+
+			for(slot = first; slot < first + n; slot++)
+			{
+				if(seen[slot] != 1)
+					error("descriptor written before its frame", slot);
+				if(IOPFrameBufferStatus[slot].length == 0)
+					error("descriptor of an empty slot", slot);
+				seen[slot] = 2;
+			}
+		} else {
+			slot = ((u8*)dmat[i].dest - &EEFrameBuffer[0][0]) / NETMAN_MAX_FRAME_SIZE;
+			seen[slot] = 1;
+		}
+	}
+
+	start = DmaBusyUntil > now ? DmaBusyUntil : now;
+	DmaBusyUntil = start + USEC(8) + USEC(0.5) * count + (tick_t)(bytes * 1.23) + USEC(10);
+	DmaDone[++DmaCount] = DmaBusyUntil;
+
+	for(slot = 0; slot < NETMAN_RPC_BLOCK_SIZE; slot++)
+	{
+		if(seen[slot] == 1)
+			error("frame without a descriptor", slot);
+		else if(seen[slot] == 2)
+		{
+			SlotState[slot] = 1;
+			SlotDone[slot] = DmaBusyUntil;
+		}
+	}
+
+	tags += count;
+	batches++;
+
+	return DmaCount;
+}
+
+//Runs the alarms that are due and lets the EE free the slots of the finished transfers.
+static void advance(tick_t time)
+{
+	unsigned int (*callback)(void *);
+	unsigned int next;
+	tick_t latency;
+	int slot;
+
+	while(AlarmCB != NULL && AlarmTime <= time)
+	{
+		now = AlarmTime;
+		callback = AlarmCB;
+		AlarmCB = NULL;
+
+		if((next = callback(NULL)) != 0)
+		{
+			AlarmCB = callback;
+			AlarmTime = now + next;
+		}
+	}
+
+	now = time;
+
+	for(slot = 0; slot < NETMAN_RPC_BLOCK_SIZE; slot++)
+	{
+		if(SlotState[slot] == 1 && SlotDone[slot] + USEC(5) <= now)
+		{
+			latency = SlotDone[slot] - SlotQueued[slot];
+			LatencySum += latency;
+			if(latency > LatencyMax)
+				LatencyMax = latency;
+
+			frames++;
+			SlotState[slot] = 0;
+			IOPFrameBufferStatus[slot].length = 0;
+		}
+	}
+}
+
+static int WrSlot;
+
+static int receive(int length)
+{
+	void *packet, *payload;
+	tick_t start = now;
+
+	while(IOPFrameBufferStatus[WrSlot].length != 0)
+	{
+		if(now - start > USEC(1000000))
+		{
+			error("the slot was not freed within a second", WrSlot);
+			return -1;
+		}
+
+		stalls++;
+		advance(now + USEC(1));
+	}
+
+	packet = NetManRpcNetProtStackAllocRxPacket(length, &payload);
+	SlotQueued[WrSlot] = now;
+	NetManRpcProtStackEnQRxPacket(packet);
+	WrSlot = (WrSlot + 1) % NETMAN_RPC_BLOCK_SIZE;
+
+	return 0;
+}
+
+//Frames arrive every gap microseconds, or in bursts of the given size that are burst_gap microseconds apart.
+static void run(const char *name, int count, int length, double gap, int burst, double burst_gap)
+{
+	int i;
+
+	frames = batches = tags = stalls = LatencySum = LatencyMax = 0;
+
+	for(i = 0; i < count; i++)
+	{
+		if(receive(length) != 0)
+			break;
+		advance(now + USEC((burst != 0 && (i + 1) % burst == 0) ? burst_gap : gap));
+	}
+
+	advance(now + USEC(20000));
+
+	if(frames != count)
+		error("frames were lost", -1);
+
+	printf("%-24s %6lld frames, %6lld batches, %5.2f frames/batch, %4.2f tags/frame, latency %7.1fus avg %7.1fus max, %lld stalls\n",
+		name, frames, batches, (double)frames / batches, (double)tags / frames,
+		LatencySum / 36.864 / frames, LatencyMax / 36.864, stalls);
+}
+
+int main(void)
+{
+	int i;
+
+	NetManInitRPCClient();
+
+	//The EE side allocates its buffers.
+	for(i = 0; i < NETMAN_RPC_BLOCK_SIZE; i++)
+	{
+		IOPFrameBufferStatus[i].length = 0;
+		IOPFrameBufferStatus[i].payload = EEFrameBuffer[i];
+	}
+
+	run("64B every 10ms", 500, 64, 10000, 0, 0);
+	run("1514B at 100Mbit", 20000, 1514, 122, 0, 0);
+	run("10-frame FIFO bursts", 20000, 1514, 15, 10, 1220);
+	run("64B at 100Mbit", 50000, 64, 6.7, 0, 0);
+	run("4-frame ACK bursts", 20000, 64, 2, 4, 500);
+
+#ifndef NO_RX_BATCH_STATS
+	{
+		struct NetManRxBatchStats stats;
+
+		NetManRpcGetRxBatchStats(&stats, sizeof(stats));
+		//The counters are u32, which is not an unsigned int for every target of tamtypes.h.
+		printf("stats: %lu frames, %lu batches, %lu tags, %lu grouped, largest %lu, grouping latency %luus total %luus max\n",
+			(unsigned long)stats.FrameCount, (unsigned long)stats.BatchCount, (unsigned long)stats.TagCount,
+			(unsigned long)stats.GroupedBatchCount, (unsigned long)stats.MaxBatchFrames,
+			(unsigned long)stats.GroupingLatency, (unsigned long)stats.MaxGroupingLatency);
+
+		if(stats.FrameCount != 110500 || stats.BatchCount != DmaCount)
+			error("the statistics don't match", -1);
+	}
+#endif
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return(errors ? 1 : 0);
+}
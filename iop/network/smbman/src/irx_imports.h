@@ -21,6 +21,7 @@
 #include <sifman.h>
 #include <stdio.h>
 #include <sysclib.h>
+#include <sysmem.h>
 #include <thbase.h>
 #include <thsemap.h>
 
@@ -27,6 +27,8 @@ static server_specs_t server_specs;
 
 #define CLIENT_MAX_BUFFER_SIZE	USHRT_MAX	//Allow up to 65535 bytes to be received.
 #define CLIENT_MAX_XFER_SIZE	USHRT_MAX	//Allow up to 65535 bytes to be transferred.
+#define CLIENT_MAX_MPX		4		//Allow up to 4 ReadAndX requests to be outstanding.
+#define CLIENT_READ_ALIGN	4096		//Reads are split on multiples of this size.
 
 static int main_socket = -1;
 
@@ -76,6 +78,22 @@ static struct {
 	} smb;
 } __attribute__((packed)) SMB_buf;
 
+//ReadAndX requests are built separately, as SMB_buf receives the replies while requests are outstanding.
+static struct {
+	u32 sessionHeader;
+	ReadAndXRequest_t readAndXRequest;
+} __attribute__((packed)) ReadAndX_buf;
+
+typedef struct {
+	u16 MID;	//0 if the slot is free.
+	int offset;	//Offset of the data in the caller's buffer.
+	int nbytes;
+	int received;	//Bytes received, or a negative error code.
+} ReadRequest_t;
+
+static u16 ReadMID;
+static smbReadStats_out_t read_stats;
+
 //-------------------------------------------------------------------------
 server_specs_t *getServerSpecs(void)
 {
@@ -83,11 +101,22 @@ server_specs_t *getServerSpecs(void)
 }
 
 //-------------------------------------------------------------------------
-static void nb_SetSessionMessage(u32 size) // Write Session Service header: careful it's raw TCP transport here and not NBT transport
+smbReadStats_out_t *getReadStats(void)
+{
+	return &read_stats;
+}
+
+//-------------------------------------------------------------------------
+static u32 nb_MakeSessionMessage(u32 size) // Make Session Service header: careful it's raw TCP transport here and not NBT transport
 {
 	// maximum for raw TCP transport (24 bits) !!!
 	// Byte-swap length into network byte-order.
-	SMB_buf.sessionHeader = ((size & 0xff0000) >> 8) | ((size & 0xff00) << 8) | ((size & 0xff) << 24);
+	return ((size & 0xff0000) >> 8) | ((size & 0xff00) << 8) | ((size & 0xff) << 24);
+}
+
+static void nb_SetSessionMessage(u32 size) // Write Session Service header
+{
+	SMB_buf.sessionHeader = nb_MakeSessionMessage(size);
 }
 
 //-------------------------------------------------------------------------
@@ -501,7 +530,7 @@ lbl_session_setup:
 	SSR->smbWordcount = 13;
 	SSR->smbAndxCmd = SMB_COM_NONE;		// no ANDX command
 	SSR->MaxBufferSize = CLIENT_MAX_BUFFER_SIZE;
-	SSR->MaxMpxCount = server_specs.MaxMpxCount >= 2 ? 2 : (u16)server_specs.MaxMpxCount;
+	SSR->MaxMpxCount = server_specs.MaxMpxCount >= CLIENT_MAX_MPX ? CLIENT_MAX_MPX : (u16)server_specs.MaxMpxCount;
 	SSR->VCNumber = 1;
 	SSR->SessionKey = server_specs.SessionKey;
 	SSR->Capabilities = capabilities;
@@ -1022,19 +1051,67 @@ int smb_OpenAndX(int UID, int TID, char *filename, s64 *filesize, int mode)
 }
 
 //-------------------------------------------------------------------------
-int smb_ReadAndX(int UID, int TID, int FID, s64 fileoffset, void *readbuf, int nbytes)
+static u16 smb_NextReadMID(void)
 {
-	ReadAndXRequest_t *RR = &SMB_buf.smb.readAndXRequest;
-	ReadAndXResponse_t *RRsp = &SMB_buf.smb.readAndXResponse;
-	int r, padding, DataLength;
+	//MID 0 is left to the other requests, which are never outstanding together with reads.
+	if (++ReadMID == 0)
+		ReadMID = 1;
+
+	return ReadMID;
+}
+
+static int smb_ReadAndXChunkSize(int nbytes, int window)
+{
+	int max, chunk;
+
+	//Without CAP_LARGE_READX, the whole reply must fit in the server's buffer.
+	if (server_specs.Capabilities & SERVER_CAP_LARGE_READX)
+		max = CLIENT_MAX_XFER_SIZE;
+	else
+		max = (int)server_specs.MaxBufferSize - (int)sizeof(ReadAndXResponse_t) - 4;
+
+	if (max > CLIENT_READ_ALIGN)
+		max &= ~(CLIENT_READ_ALIGN - 1);
+	else if (max < 512)
+		max = 512;
+
+	//Split the read, so that all requests of the window can be in flight together.
+	chunk = (nbytes + window - 1) / window;
+	chunk = (chunk + CLIENT_READ_ALIGN - 1) & ~(CLIENT_READ_ALIGN - 1);
+
+	return chunk < max ? chunk : max;
+}
+
+static int DiscardData(int sock, int size, int timeout_ms)
+{
+	int r, chunk;
+
+	while (size > 0)
+	{
+		chunk = size > MAX_SMB_BUF ? MAX_SMB_BUF : size;
+
+		r = RecvData(sock, (char *)SMB_buf.smb.u8buff, chunk, timeout_ms);
+		if (r <= 0)
+			return -1;
+
+		size -= chunk;
+	}
+
+	return 0;
+}
 
-	ZERO_PKT_ALIGNED(RR, sizeof(ReadAndXRequest_t));
+static int smb_SendReadAndX(int UID, int TID, int FID, s64 fileoffset, int nbytes, u16 MID)
+{
+	ReadAndXRequest_t *RR = &ReadAndX_buf.readAndXRequest;
+
+	memset(RR, 0, sizeof(ReadAndXRequest_t));
 
 	RR->smbH.Magic = SMB_MAGIC;
 	RR->smbH.Flags2 = SMB_FLAGS2_32BIT_STATUS;
 	RR->smbH.Cmd = SMB_COM_READ_ANDX;
 	RR->smbH.UID = (u16)UID;
 	RR->smbH.TID = (u16)TID;
+	RR->smbH.MID = MID;
 	RR->smbWordcount = 12;
 	RR->smbAndxCmd = SMB_COM_NONE;		// no ANDX command
 	RR->FID = (u16)FID;
@@ -1043,65 +1120,195 @@ int smb_ReadAndX(int UID, int TID, int FID, s64 fileoffset, void *readbuf, int n
 	RR->MaxCountLow = (u16)nbytes;
 	RR->MaxCountHigh = (u16)(nbytes >> 16);
 
-	nb_SetSessionMessage(sizeof(ReadAndXRequest_t));
-	r = GetSMBServerReply(0, NULL, sizeof(ReadAndXResponse_t));
+	ReadAndX_buf.sessionHeader = nb_MakeSessionMessage(sizeof(ReadAndXRequest_t));
+	if (SendData(main_socket, (char*)&ReadAndX_buf, sizeof(ReadAndX_buf)) <= 0)
+		return -EIO;
+
+	read_stats.ReadRequests++;
+
+	return 0;
+}
+
+/*	Receives the reply to one of the outstanding ReadAndX requests, whose data is stored
+	in readbuf at the offset of the request. Returns the index of the request, or a negative
+	error code if the connection can't be used anymore.	*/
+static int smb_RecvReadAndX(ReadRequest_t *requests, int count, void *readbuf)
+{
+	ReadAndXResponse_t *RRsp = &SMB_buf.smb.readAndXResponse;
+	ReadRequest_t *req;
+	int r, i, totalpkt_size, size, padding, DataLength;
+
+	//Read NetBIOS session message header. Drop NBSS Session Keep alive messages.
+	do{
+		r = RecvData(main_socket, (char *)&SMB_buf.sessionHeader, sizeof(SMB_buf.sessionHeader), 10000); // 10s before the packet is considered lost
+		if (r <= 0)
+			return -EIO;
+	} while (nb_GetPacketType() != 0);
+
+	//Error replies are shorter than the ReadAndX response.
+	totalpkt_size = nb_GetSessionMessageLength();
+	size = totalpkt_size < (int)sizeof(ReadAndXResponse_t) ? totalpkt_size : (int)sizeof(ReadAndXResponse_t);
+	if (size < SMB_HDR_SIZE)
+		return -EIO;
+
+	r = RecvData(main_socket, (char *)&SMB_buf.smb, size, 3000); // 3s before the packet is considered lost
 	if (r <= 0)
 		return -EIO;
 
+	totalpkt_size -= size;
+
 	// check sanity of SMB header
 	if (RRsp->smbH.Magic != SMB_MAGIC)
 		return -EIO;
 
-	// check there's no error
-	if ((RRsp->smbH.Eclass | (RRsp->smbH.Ecode << 16)) != STATUS_SUCCESS)
+	for (i = 0; i < count; i++)
+	{
+		if ((requests[i].MID != 0) && (requests[i].MID == RRsp->smbH.MID))
+			break;
+	}
+	if (i == count)
 		return -EIO;
 
-	//Skip any padding bytes.
-	padding = RRsp->DataOffset - sizeof(ReadAndXResponse_t);
-	if (padding > 0)
+	req = &requests[i];
+	padding = 0;
+	DataLength = 0;
+
+	// check there's no error
+	if (((RRsp->smbH.Eclass | (RRsp->smbH.Ecode << 16)) != STATUS_SUCCESS) || (size < (int)sizeof(ReadAndXResponse_t)))
+		req->received = -EIO;
+	else
 	{
-		r = RecvData(main_socket, (char *)(RRsp + 1), padding, 3000); // 3s before the packet is considered lost
-		if (r <= 0)
-			return -2;
+		padding = RRsp->DataOffset - sizeof(ReadAndXResponse_t);
+		DataLength = (int)(((u32)RRsp->DataLengthHigh << 16) | RRsp->DataLengthLow);
+
+		if ((padding < 0) || (DataLength > req->nbytes) || (padding + DataLength > totalpkt_size))
+		{
+			padding = 0;
+			DataLength = 0;
+			req->received = -EIO;
+		}
+		else
+			req->received = DataLength;
 	}
 
-	DataLength = (int)(((u32)RRsp->DataLengthHigh << 16) | RRsp->DataLengthLow);
+	//Skip any padding bytes.
+	if (DiscardData(main_socket, padding, 3000) < 0)
+		return -EIO;
+
 	if (DataLength > 0)
 	{
-		r = RecvData(main_socket, readbuf, DataLength, 3000); // 3s before the packet is considered lost
+		r = RecvData(main_socket, (char *)readbuf + req->offset, DataLength, 3000); // 3s before the packet is considered lost
 		if (r <= 0)
-			return -2;
+			return -EIO;
 	}
 
-	r = DataLength;
+	//Skip whatever else the reply contains.
+	if (DiscardData(main_socket, totalpkt_size - padding - DataLength, 3000) < 0)
+		return -EIO;
 
-	return r;
+	read_stats.RequestBytes += DataLength;
+
+	return i;
 }
 
+int smb_ReadAndX(int UID, int TID, int FID, s64 fileoffset, void *readbuf, int nbytes)
+{
+	ReadRequest_t request;
+	int r;
+
+	request.MID = smb_NextReadMID();
+	request.offset = 0;
+	request.nbytes = nbytes;
+	request.received = 0;
+
+	r = smb_SendReadAndX(UID, TID, FID, fileoffset, nbytes, request.MID);
+	if (r < 0)
+		return r;
+
+	r = smb_RecvReadAndX(&request, 1, readbuf);
+	if (r < 0)
+		return r;
+
+	return request.received;
+}
+
+/*	Keeps up to MaxMpxCount ReadAndX requests outstanding, so that the round trips overlap.
+	Returns the number of bytes read from fileoffset on, which is less than nbytes if a request
+	came back short or failed.	*/
 int smb_ReadFile(int UID, int TID, int FID, s64 fileoffset, void *readbuf, int nbytes)
 {
-	int result, remaining, toRead;
-	char *ptr;
-	s64 pos;
+	ReadRequest_t requests[CLIENT_MAX_MPX];
+	ReadRequest_t *req;
+	int r, i, window, chunk, issued, pending, limit, error, end;
 
-	remaining = nbytes;
-	ptr = readbuf;
-	pos = fileoffset;
+	window = server_specs.MaxMpxCount < CLIENT_MAX_MPX ? server_specs.MaxMpxCount : CLIENT_MAX_MPX;
+	if (window < 1)
+		window = 1;
 
-	while (remaining > 0)
+	chunk = smb_ReadAndXChunkSize(nbytes, window);
+
+	for (i = 0; i < window; i++)
+		requests[i].MID = 0;
+
+	issued = 0;
+	pending = 0;
+	limit = nbytes;
+	error = 0;
+
+	while (1)
 	{
-		toRead = remaining > CLIENT_MAX_XFER_SIZE ? CLIENT_MAX_XFER_SIZE : remaining;
+		while ((pending < window) && (issued < limit))
+		{
+			for (i = 0; requests[i].MID != 0; i++);
+
+			req = &requests[i];
+			req->MID = smb_NextReadMID();
+			req->offset = issued;
+			req->nbytes = limit - issued > chunk ? chunk : limit - issued;
+			req->received = 0;
+
+			r = smb_SendReadAndX(UID, TID, FID, fileoffset + issued, req->nbytes, req->MID);
+			if (r < 0)
+			{
+				req->MID = 0;
+				limit = issued;
+				error = r;
+				break;
+			}
 
-		result = smb_ReadAndX(UID, TID, FID, pos, ptr, toRead);
-		if (result <= 0)
-			return result;
+			issued += req->nbytes;
+			pending++;
 
-		pos += result;
-		ptr += result;
-		remaining -= result;
+			if (pending > (int)read_stats.MaxOutstanding)
+				read_stats.MaxOutstanding = pending;
+		}
+
+		if (pending == 0)
+			break;
+
+		r = smb_RecvReadAndX(requests, window, readbuf);
+		if (r < 0)
+			return r;
+
+		req = &requests[r];
+		req->MID = 0;
+		pending--;
+
+		//Nothing can be returned after a short or failed request, but the outstanding ones must still be received.
+		if (req->received < req->nbytes)
+		{
+			end = req->offset + (req->received > 0 ? req->received : 0);
+			if (end < limit)
+				limit = end;
+			if ((req->received < 0) && (error == 0))
+				error = req->received;
+		}
 	}
 
-	return nbytes;
+	if ((limit == 0) && (error != 0))
+		return error;
+
+	return limit;
 }
 
 //-------------------------------------------------------------------------
@@ -812,6 +812,7 @@ typedef struct {
 
 // function prototypes
 server_specs_t *getServerSpecs(void);
+smbReadStats_out_t *getReadStats(void);
 
 int smb_Connect(char *SMBServerIP, int SMBServerPort);
 int smb_Disconnect(void);
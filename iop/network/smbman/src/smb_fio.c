@@ -12,6 +12,7 @@
 #include "sifman.h"
 #include "stdio.h"
 #include "sysclib.h"
+#include "sysmem.h"
 #include "thbase.h"
 #include "thsemap.h"
 #include "errno.h"
@@ -73,8 +74,14 @@ typedef struct {
 	s64		position;
 	u32		mode;
 	char		name[SMB_NAME_MAX];
+	u8		*ra_buf;	// read-ahead window, allocated once the file is read sequentially
+	s64		ra_offset;	// file offset of the window
+	int		ra_len;		// bytes held by the window
+	s64		ra_next;	// where the last read ended
 } FHANDLE;
 
+#define SMB_READAHEAD_SIZE	(64 * 1024)
+
 #define MAX_FDHANDLES		32
 FHANDLE smbman_fdhandles[MAX_FDHANDLES];
 
@@ -252,6 +259,8 @@ int smb_initdev(void)
 		fh->filesize = 0;
 		fh->position = 0;
 		fh->mode = 0;
+		fh->ra_buf = NULL;
+		fh->ra_len = 0;
 	}
 
 	return 0;
@@ -346,6 +355,8 @@ int smb_open(iop_file_t *f, const char *filename, int flags, int mode)
 			fh->mode = flags;
 			fh->filesize = filesize;
 			fh->position = 0;
+			fh->ra_len = 0;
+			fh->ra_next = 0;
 			if (fh->mode & O_TRUNC)
 				fh->filesize = 0;
 			else if (fh->mode & O_APPEND)
@@ -380,6 +391,8 @@ int smb_close(iop_file_t *f)
 				goto io_unlock;
 			}
 		}
+		if (fh->ra_buf != NULL)
+			FreeSysMemory(fh->ra_buf);
 		memset(fh, 0, sizeof(FHANDLE));
 		fh->smb_fid = -1;
 		r = 0;
@@ -401,6 +414,11 @@ void smb_closeAll(void)
 		fh = (FHANDLE *)&smbman_fdhandles[i];
 		if (fh->smb_fid != -1)
 			smb_Close(UID, TID, fh->smb_fid);
+		if (fh->ra_buf != NULL) {
+			FreeSysMemory(fh->ra_buf);
+			fh->ra_buf = NULL;
+			fh->ra_len = 0;
+		}
 	}
 }
 
@@ -410,10 +428,84 @@ int smb_lseek(iop_file_t *f, int pos, int where)
 	return (int)smb_lseek64(f, pos, where);
 }
 
+//--------------------------------------------------------------
+// Small reads that continue where the previous one ended are served from
+// the read-ahead window of the handle, which is refilled by one pipelined
+// read of SMB_READAHEAD_SIZE bytes. Other reads go straight to the server.
+//
+static int smb_readWindow(FHANDLE *fh, u8 *buf, int size)
+{
+	s64 pos = fh->position;
+	int r, n, done = 0;
+
+	if ((fh->ra_len > 0) && (pos >= fh->ra_offset) && (pos < fh->ra_offset + fh->ra_len)) {
+		n = (int)(fh->ra_offset + fh->ra_len - pos);
+		if (n > size)
+			n = size;
+		memcpy(buf, &fh->ra_buf[pos - fh->ra_offset], n);
+		done = n;
+		pos += n;
+
+		getReadStats()->ReadAheadHits++;
+
+		if (done == size)
+			return done;
+	}
+
+	if ((size - done < SMB_READAHEAD_SIZE) && (fh->position == fh->ra_next)) {
+		if (fh->ra_buf == NULL)
+			fh->ra_buf = AllocSysMemory(ALLOC_FIRST, SMB_READAHEAD_SIZE, NULL);
+
+		if (fh->ra_buf != NULL) {
+			n = (fh->filesize - pos) > SMB_READAHEAD_SIZE ? SMB_READAHEAD_SIZE : (int)(fh->filesize - pos);
+
+			fh->ra_len = 0;
+			r = smb_ReadFile(UID, TID, fh->smb_fid, pos, fh->ra_buf, n);
+			if (r > 0) {
+				fh->ra_offset = pos;
+				fh->ra_len = r;
+
+				n = (r > size - done) ? size - done : r;
+				memcpy(&buf[done], fh->ra_buf, n);
+				return done + n;
+			}
+
+			return (done > 0) ? done : r;
+		}
+	}
+
+	r = smb_ReadFile(UID, TID, fh->smb_fid, pos, &buf[done], size - done);
+	if (r < 0)
+		return (done > 0) ? done : r;
+
+	return done + r;
+}
+
+//--------------------------------------------------------------
+static void smb_addReadTime(const iop_sys_clock_t *start)
+{
+	static u32 usec_carry = 0;
+	iop_sys_clock_t now;
+	u32 sec, usec;
+
+	GetSystemTime(&now);
+	if (now.lo < start->lo)
+		now.hi--;
+	now.lo -= start->lo;
+	now.hi -= start->hi;
+	SysClock2USec(&now, &sec, &usec);
+
+	usec += usec_carry;
+	getReadStats()->ReadTime += sec * 1000 + usec / 1000;
+	usec_carry = usec % 1000;
+}
+
 //--------------------------------------------------------------
 int smb_read(iop_file_t *f, void *buf, int size)
 {
 	FHANDLE *fh = (FHANDLE *)f->privdata;
+	smbReadStats_out_t *stats;
+	iop_sys_clock_t start;
 	int r;
 
 	if ((UID == -1) || (TID == -1) || (fh->smb_fid == -1))
@@ -422,13 +514,25 @@ int smb_read(iop_file_t *f, void *buf, int size)
 	if ((fh->position + size) > fh->filesize)
 		size = fh->filesize - fh->position;
 
+	if (size <= 0)
+		return 0;
+
 	smb_io_lock();
 
-	r = smb_ReadFile(UID, TID, fh->smb_fid, fh->position, buf, size);
+	GetSystemTime(&start);
+
+	r = smb_readWindow(fh, buf, size);
 	if (r > 0) {
 		fh->position += r;
+		fh->ra_next = fh->position;
 	}
 
+	stats = getReadStats();
+	stats->ReadCalls++;
+	if (r > 0)
+		stats->ReadBytes += r;
+	smb_addReadTime(&start);
+
 	smb_io_unlock();
 
 	return r;
@@ -438,7 +542,7 @@ int smb_read(iop_file_t *f, void *buf, int size)
 int smb_write(iop_file_t *f, void *buf, int size)
 {
 	FHANDLE *fh = (FHANDLE *)f->privdata;
-	int r;
+	int r, i;
 
 	if ((UID == -1) || (TID == -1) || (fh->smb_fid == -1))
 		return -EBADF;
@@ -448,6 +552,10 @@ int smb_write(iop_file_t *f, void *buf, int size)
 
 	smb_io_lock();
 
+	// The read-ahead windows of all handles might cover the data written.
+	for (i=0; i<MAX_FDHANDLES; i++)
+		smbman_fdhandles[i].ra_len = 0;
+
 	r = smb_WriteFile(UID, TID, fh->smb_fid, fh->position, buf, size);
 	if (r > 0) {
 		fh->position += r;
@@ -1059,6 +1167,21 @@ static int smb_QueryDiskInfo(smbQueryDiskInfo_out_t *querydiskinfo)
 	return smb_QueryInformationDisk(UID, TID, querydiskinfo);
 }
 
+//--------------------------------------------------------------
+static int smb_GetReadStats(smbReadStats_out_t *readstats, unsigned int buflen)
+{
+	smbReadStats_out_t *stats = getReadStats();
+
+	if (buflen < sizeof(smbReadStats_out_t))
+		return -EINVAL;
+
+	// The counters start over, so that the caller gets the rates since its last call.
+	memcpy(readstats, stats, sizeof(smbReadStats_out_t));
+	memset(stats, 0, sizeof(smbReadStats_out_t));
+
+	return 0;
+}
+
 //--------------------------------------------------------------
 int smb_devctl(iop_file_t *f, const char *devname, int cmd, void *arg, unsigned int arglen, void *bufp, unsigned int buflen)
 {
@@ -1101,6 +1224,10 @@ int smb_devctl(iop_file_t *f, const char *devname, int cmd, void *arg, unsigned
 			r = smb_QueryDiskInfo((smbQueryDiskInfo_out_t *)bufp);
 			break;
 
+		case SMB_DEVCTL_GETREADSTATS:
+			r = smb_GetReadStats((smbReadStats_out_t *)bufp, buflen);
+			break;
+
 		default:
 			r = -EINVAL;
 	}
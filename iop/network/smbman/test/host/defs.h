@@ -0,0 +1 @@
+/* Host stand-in for the IOP defs.h, nothing from it is needed. */
@@ -0,0 +1 @@
+/* Host stand-in for the IOP intrman.h, nothing from it is needed. */
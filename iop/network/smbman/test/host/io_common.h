@@ -0,0 +1 @@
+/* Host stand-in for io_common.h, the constants used are in iomanX.h. */
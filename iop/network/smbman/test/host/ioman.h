@@ -0,0 +1,3 @@
+/* Host stand-in for the IOP ioman.h. */
+
+#include <fcntl.h>
@@ -0,0 +1,57 @@
+/* Host stand-in for the IOP iomanX.h, with what smb_fio.c uses. */
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+typedef struct {
+	void	*privdata;
+} iop_file_t;
+
+typedef struct {
+	void	*init, *deinit, *format, *open, *close, *read, *write, *lseek, *ioctl;
+	void	*remove, *mkdir, *rmdir, *dopen, *dclose, *dread, *getstat, *chstat, *rename;
+	void	*chdir, *sync, *mount, *umount, *lseek64, *devctl, *symlink, *readlink, *ioctl2;
+} iop_device_ops_t;
+
+typedef struct {
+	const char	*name;
+	int		type;
+	int		version;
+	const char	*desc;
+	void		*ops;
+} iop_device_t;
+
+typedef struct {
+	unsigned int	mode;
+	unsigned int	attr;
+	unsigned int	size;
+	unsigned char	ctime[8];
+	unsigned char	atime[8];
+	unsigned char	mtime[8];
+	unsigned int	hisize;
+} iox_stat_t;
+
+typedef struct {
+	iox_stat_t	stat;
+	char		name[256];
+	void		*unknown;
+} iox_dirent_t;
+
+#define IOP_DT_FS	0x10
+#define IOP_DT_FSEXT	0x10000000
+#define O_DIROPEN	0x8
+
+#define FIO_S_IFDIR	0x1000
+#define FIO_S_IFREG	0x2000
+#define FIO_S_IRUSR	0
+#define FIO_S_IWUSR	0
+#define FIO_S_IXUSR	0
+#define FIO_S_IRGRP	0
+#define FIO_S_IWGRP	0
+#define FIO_S_IXGRP	0
+#define FIO_S_IROTH	0
+#define FIO_S_IWOTH	0
+#define FIO_S_IXOTH	0
+
+static inline int AddDrv(iop_device_t *dev) { return 0; }
+static inline int DelDrv(const char *name) { return 0; }
@@ -0,0 +1,16 @@
+/* Host stand-in for ps2ip.h, mapping the lwIP socket calls to the host sockets. */
+
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define lwip_socket		socket
+#define lwip_setsockopt		setsockopt
+#define lwip_connect		connect
+#define lwip_recv		recv
+#define lwip_send(s, data, size, flags)	send(s, data, size, MSG_NOSIGNAL)
+#define lwip_close		close
+#define lwip_select		select
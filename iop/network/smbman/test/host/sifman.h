@@ -0,0 +1,13 @@
+/* Host stand-in for the IOP sifman.h, no transfers are made by the test. */
+
+typedef struct {
+	void	*src;
+	void	*dest;
+	int	size;
+	int	attr;
+} SifDmaTransfer_t;
+
+static inline int SifSetDma(SifDmaTransfer_t *dmat, int count) { return 1; }
+static inline int SifDmaStat(int id) { return -1; }
+static inline int sceSifSetDma(SifDmaTransfer_t *dmat, int count) { return 1; }
+static inline int sceSifDmaStat(int id) { return -1; }
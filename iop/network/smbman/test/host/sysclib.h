@@ -0,0 +1,4 @@
+/* Host stand-in for the IOP sysclib.h. */
+
+#include <ctype.h>
+#include <string.h>
@@ -0,0 +1,8 @@
+/* Host stand-in for the IOP sysmem.h. */
+
+#include <stdlib.h>
+
+#define ALLOC_FIRST	0
+
+#define AllocSysMemory(mode, size, ptr)	malloc(size)
+#define FreeSysMemory(ptr)		free(ptr)
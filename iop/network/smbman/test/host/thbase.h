@@ -0,0 +1,57 @@
+/* Host stand-in for the IOP thbase.h. The clock runs at the IOP's 36.864 MHz, there are no threads or alarms. */
+
+#include <time.h>
+
+typedef struct {
+	unsigned int	lo;
+	unsigned int	hi;
+} iop_sys_clock_t;
+
+typedef struct {
+	int	attr;
+	int	option;
+	void	*thread;
+	int	stacksize;
+	int	priority;
+} iop_thread_t;
+
+#define TH_C	0
+
+static inline int GetSystemTime(iop_sys_clock_t *clock)
+{
+	struct timespec t;
+	unsigned long long v;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	v = (unsigned long long)t.tv_sec * 36864000ULL + t.tv_nsec * 36864ULL / 1000000ULL;
+	clock->lo = (unsigned int)v;
+	clock->hi = (unsigned int)(v >> 32);
+
+	return 0;
+}
+
+static inline void SysClock2USec(iop_sys_clock_t *clock, u32 *sec, u32 *usec)
+{
+	unsigned long long v = ((unsigned long long)clock->hi << 32) | clock->lo;
+
+	v = v * 1000000ULL / 36864000ULL;
+	*sec = (u32)(v / 1000000);
+	*usec = (u32)(v % 1000000);
+}
+
+static inline void USec2SysClock(u32 usec, iop_sys_clock_t *clock)
+{
+	unsigned long long v = (unsigned long long)usec * 36864000ULL / 1000000ULL;
+
+	clock->lo = (unsigned int)v;
+	clock->hi = (unsigned int)(v >> 32);
+}
+
+static inline int SetAlarm(iop_sys_clock_t *clock, unsigned int (*handler)(void *), void *arg) { return 0; }
+static inline int iSetAlarm(iop_sys_clock_t *clock, unsigned int (*handler)(void *), void *arg) { return 0; }
+static inline int CancelAlarm(unsigned int (*handler)(void *), void *arg) { return 0; }
+static inline int CreateThread(iop_thread_t *thread) { return 1; }
+static inline int StartThread(int thid, void *arg) { return 0; }
+static inline int DeleteThread(int thid) { return 0; }
+static inline int CpuSuspendIntr(int *state) { *state = 0; return 0; }
+static inline int CpuResumeIntr(int state) { return 0; }
@@ -0,0 +1,10 @@
+/* Host stand-in for the IOP thsemap.h, the test is single-threaded. */
+
+#define IOP_MUTEX_UNLOCKED	0
+#define IOP_MUTEX_LOCKED	1
+
+static inline int CreateMutex(int locked) { return 1; }
+static inline int WaitSema(int sema) { return 0; }
+static inline int SignalSema(int sema) { return 0; }
+static inline int iSignalSema(int sema) { return 0; }
+static inline int DeleteSema(int sema) { return 0; }
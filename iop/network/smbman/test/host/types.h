@@ -0,0 +1,3 @@
+/* Host stand-in for the IOP types.h. */
+
+#include <tamtypes.h>
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#
+# Minimal SMB server for smb_test.c, over raw TCP.
+#
+# It serves one read-only file of 8 MB filled with the pattern that smb_test.c
+# checks, and answers NT_CREATE_ANDX, CLOSE and READ_ANDX. Every reply is sent
+# after a fixed latency, so that requests which are in flight together overlap
+# their round trips. A read at offset 0xdead000 is answered with an error.
+#
+# Usage: smb_server.py port latency-in-seconds
+
+import socket
+import struct
+import sys
+import threading
+import time
+
+FILE_SIZE = 8 * 1024 * 1024
+ERROR_OFFSET = 0xdead000
+
+data = bytes(((i * 7) + (i >> 8)) & 0xff for i in range(FILE_SIZE))
+
+def recv_exact(conn, size):
+    buf = b''
+    while len(buf) < size:
+        chunk = conn.recv(size - len(buf))
+        if not chunk:
+            raise EOFError
+        buf += chunk
+    return buf
+
+def header(cmd, mid, status=0):
+    # Magic, command, status, flags, flags2, extra, TID, PID, UID, MID
+    return struct.pack('<4sBIBH12sHHHH', b'\xffSMB', cmd, status, 0x80, 0, b'', 1, 0, 1, mid)
+
+def reply(msg):
+    cmd = msg[4]
+    mid = struct.unpack('<H', msg[30:32])[0]
+
+    if cmd == 0xa2:     # NT_CREATE_ANDX: FID 1 and the file size
+        words = struct.pack('<BBBHBHI', 34, 0xff, 0, 0, 0, 1, 1) + b'\0' * 32 + struct.pack('<IQQHHB', 0x01, FILE_SIZE, FILE_SIZE, 0, 0, 0)
+        return header(cmd, mid) + words + struct.pack('<H', 0)
+
+    if cmd == 0x04:     # CLOSE
+        return header(cmd, mid) + b'\0' + struct.pack('<H', 0)
+
+    if cmd == 0x2e:     # READ_ANDX
+        fid, offset_low, count_low, min_count, count_high = struct.unpack('<HIHHI', msg[37:51])
+        offset = offset_low | (struct.unpack('<I', msg[53:57])[0] << 32)
+        count = count_low | ((count_high & 0xffff) << 16)
+
+        if offset == ERROR_OFFSET:
+            return header(cmd, mid, 0xc0000022) + b'\0' + struct.pack('<H', 0)
+
+        chunk = data[offset:offset + count]
+        words = bytes([12, 0xff, 0]) + struct.pack('<HHHHHHI', 0, 0, 0, 0, len(chunk) & 0xffff, 60, len(chunk) >> 16) + b'\0' * 6
+        return header(cmd, mid) + words + struct.pack('<H', min(len(chunk) + 1, 0xffff)) + b'\0' + chunk
+
+    return header(cmd, mid, 0xc0000002) + b'\0' + struct.pack('<H', 0)
+
+def serve(conn, latency):
+    conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    queue = []
+    cond = threading.Condition()
+
+    def sender():
+        while True:
+            with cond:
+                while not queue:
+                    cond.wait()
+                due, packet = queue.pop(0)
+            delay = due - time.time()
+            if delay > 0:
+                time.sleep(delay)
+            conn.sendall(packet)
+
+    threading.Thread(target=sender, daemon=True).start()
+
+    try:
+        while True:
+            size = struct.unpack('>I', recv_exact(conn, 4))[0] & 0xffffff
+            packet = reply(recv_exact(conn, size))
+            with cond:
+                queue.append((time.time() + latency, struct.pack('>I', len(packet)) + packet))
+                cond.notify()
+    except (EOFError, ConnectionError):
+        conn.close()
+
+def main():
+    port, latency = int(sys.argv[1]), float(sys.argv[2])
+    sock = socket.socket()
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('127.0.0.1', port))
+    sock.listen(4)
+    while True:
+        conn, _ = sock.accept()
+        threading.Thread(target=serve, args=(conn, latency), daemon=True).start()
+
+main()
@@ -0,0 +1,175 @@
+/*
+  Host test of the pipelined reads and the read-ahead window of smbman.
+
+  smb.c and smb_fio.c run on the host against smb_server.py, which serves an
+  8 MB file and delays every reply. The file is read with smb_ReadFile() in
+  256 KB calls with 1 and with 4 requests in flight, then through smb_read()
+  in 2 KB calls and in random sizes with random seeks. Every byte is checked,
+  as well as reads across the end of the file and an error reply. The times
+  and the SMB_DEVCTL_GETREADSTATS counters are printed.
+
+  Build and run from the root of the tree. The -Wno options are for smbman
+  itself: it mixes char and u8 strings, takes the address of packed members,
+  copies names with strncpy(), builds paths with sprintf() and passes a
+  pointer as the alarm handler's result:
+
+    S=iop/network/smbman/src
+    W="-Wno-pointer-sign -Wno-address-of-packed-member -Wno-stringop-truncation -Wno-format-overflow -Wno-pointer-to-int-cast"
+    gcc -O2 -Wall $W -Iiop/network/smbman/test/host -I$S -idirafter common/include \
+        iop/network/smbman/test/smb_test.c $S/smb.c $S/poll.c $S/auth.c $S/des.c $S/md4.c -o smb_test
+    python3 iop/network/smbman/test/smb_server.py 4450 0.005 & sleep 3
+    ./smb_test 4450
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// smb_fio.c is included to set up the logon state that the devctls would
+#include "../src/smb_fio.c"
+
+#define FILE_SIZE	(8 * 1024 * 1024)
+#define ERROR_OFFSET	0xdead000
+
+static u8 file[FILE_SIZE];
+static u8 buf[FILE_SIZE];
+
+//--------------------------------------------------------------
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------------------
+static int fail(const char *what, long pos)
+{
+	printf("FAIL: %s at %ld\n", what, pos);
+
+	return 1;
+}
+
+//--------------------------------------------------------------
+static int read_file(int mpx, int size)
+{
+	int r;
+	long pos;
+	double t;
+
+	getServerSpecs()->MaxMpxCount = mpx;
+
+	t = seconds();
+	for (pos = 0; pos < FILE_SIZE; pos += size) {
+		r = smb_ReadFile(UID, TID, 1, pos, buf + pos, size);
+		if (r != size)
+			return fail("short smb_ReadFile", pos);
+	}
+	t = seconds() - t;
+
+	if (memcmp(buf, file, FILE_SIZE))
+		return fail("wrong data from smb_ReadFile", 0);
+
+	printf("smb_ReadFile, %d requests in flight, %d-byte calls: 8 MB in %.2f s\n", mpx, size, t);
+
+	return 0;
+}
+
+//--------------------------------------------------------------
+static int read_fio(int size, int random)
+{
+	smbReadStats_out_t stats;
+	iop_file_t f;
+	int r, n, pos = 0, calls = 0;
+	double t;
+
+	smb_devctl(NULL, "smb", SMB_DEVCTL_GETREADSTATS, NULL, 0, &stats, sizeof(stats));
+
+	if (smb_open(&f, "\\file.bin", O_RDONLY, 0) != 0)
+		return fail("smb_open", 0);
+
+	srand(3);
+
+	t = seconds();
+	while (random ? calls++ < 3000 : pos < FILE_SIZE) {
+		n = random ? 1 + rand() % size : size;
+
+		if (pos >= FILE_SIZE || (random && rand() % 20 == 0)) {
+			pos = (pos >= FILE_SIZE) ? 0 : rand() % FILE_SIZE;
+			smb_lseek(&f, pos, SEEK_SET);
+		}
+
+		r = smb_read(&f, buf, n);
+		if (r <= 0 || r > n || (r < n && pos + r != FILE_SIZE))
+			return fail("smb_read", pos);
+		if (memcmp(buf, file + pos, r))
+			return fail("wrong data from smb_read", pos);
+
+		pos += r;
+	}
+	t = seconds() - t;
+
+	smb_close(&f);
+	smb_devctl(NULL, "smb", SMB_DEVCTL_GETREADSTATS, NULL, 0, &stats, sizeof(stats));
+
+	printf("smb_read, %s %d-byte calls: %.2f s; %u calls, %u bytes, %u read-ahead hits, %u requests, %u most in flight\n",
+		random ? "random seeks and sizes up to" : "sequential", size, t,
+		stats.ReadCalls, stats.ReadBytes, stats.ReadAheadHits, stats.ReadRequests, stats.MaxOutstanding);
+
+	return 0;
+}
+
+//--------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	int i, r;
+
+	if (argc < 2) {
+		printf("usage: %s port\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < FILE_SIZE; i++)
+		file[i] = i * 7 + (i >> 8);
+
+	smb_initdev();
+	smb_init(NULL);
+
+	if (smb_Connect("127.0.0.1", atoi(argv[1])) < 0) {
+		printf("FAIL: can't connect to the server\n");
+		return 1;
+	}
+
+	getServerSpecs()->Capabilities = SERVER_CAP_LARGE_READX | SERVER_CAP_NT_SMBS;
+	getServerSpecs()->MaxBufferSize = 16644;
+	UID = 1;
+	TID = 1;
+
+	if (read_file(1, 256 * 1024) || read_file(4, 256 * 1024))
+		return 1;
+
+	// Across the end of the file, an error reply, and a read after it
+	r = smb_ReadFile(UID, TID, 1, FILE_SIZE - 1000, buf, 300000);
+	if (r != 1000 || memcmp(buf, file + FILE_SIZE - 1000, 1000))
+		return fail("read across the end of the file", FILE_SIZE - 1000);
+
+	r = smb_ReadFile(UID, TID, 1, ERROR_OFFSET, buf, 1000);
+	if (r >= 0)
+		return fail("error reply not reported", ERROR_OFFSET);
+
+	r = smb_ReadFile(UID, TID, 1, 4096, buf, 5000);
+	if (r != 5000 || memcmp(buf, file + 4096, 5000))
+		return fail("read after an error reply", 4096);
+
+	if (read_fio(2048, 0) || read_fio(16384, 1))
+		return 1;
+
+	smb_Disconnect();
+
+	printf("OK\n");
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 #include <sysmem.h>
 #include <intrman.h>
 #include <sifcmd.h>
+#include <sifrpc_batch.h>
 
 #include <audsrv.h>
 #include "audsrv_internal.h"
@@ -146,6 +147,9 @@ static void *rpc_command(int func, unsigned *data, int size)
 		ret = audsrv_adpcm_set_volume(data[0], data[1]);
 		break;
 
+		case SIF_RPC_BATCH:
+		return SifRpcBatchDispatch((SifRpcFunc_t)rpc_command, data, size, sizeof(rpc_buffer));
+
 		default:
 		ret = -1;
 		break;
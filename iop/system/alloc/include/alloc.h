@@ -19,6 +19,17 @@
 #include <types.h>
 #include <irx.h>
 
+/** Heap statistics, sizes are in bytes.  */
+struct alloc_stats {
+	u32 heap_size;
+	u32 used;		/* Allocated blocks, including their headers.  */
+	u32 peak_used;		/* Highest value of used since the module was loaded.  */
+	u32 free;		/* Payload of all free blocks.  */
+	u32 largest_free;	/* Largest allocation that can currently succeed.  */
+	u32 free_blocks;	/* Number of free blocks, a measure of fragmentation.  */
+	u32 used_blocks;
+};
+
 void * malloc(size_t size);
 void * realloc(void * ptr, size_t size);
 void free(void * ptr);
@@ -28,6 +39,7 @@ void * __mem_walk_begin();
 void __mem_walk_read(void * token, u32 * size, void ** ptr, int * valid);
 void * __mem_walk_inc(void * token);
 int __mem_walk_end(void * token);
+void alloc_get_stats(struct alloc_stats * stats);
 
 #define alloc_IMPORTS_start DECLARE_IMPORT_TABLE(alloc, 1, 1)
 #define alloc_IMPORTS_end END_IMPORT_TABLE
@@ -41,5 +53,6 @@ int __mem_walk_end(void * token);
 #define I___mem_walk_read DECLARE_IMPORT(10, __mem_walk_read)
 #define I___mem_walk_inc DECLARE_IMPORT(11, __mem_walk_inc)
 #define I___mem_walk_end DECLARE_IMPORT(12, __mem_walk_end)
+#define I_alloc_get_stats DECLARE_IMPORT(13, alloc_get_stats)
 
 #endif /* __ALLOC_H__ */
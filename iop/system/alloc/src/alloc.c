@@ -23,7 +23,7 @@
 
 
 #define MODNAME "alloc"
-IRX_ID("Basic alloc library", 1, 1);
+IRX_ID("Basic alloc library", 1, 2);
 
 extern struct irx_export_table _exp_alloc;
 
@@ -32,7 +32,9 @@ static vs32 alloc_sema = -1;
 #define DEFAULT_HEAP_SIZE 128 * 1024
 
 u32 heap_size = DEFAULT_HEAP_SIZE;
-static u8 * heap_start, * heap_end, * _heap_ptr;
+static u8 * heap_start, * heap_end;
+
+static void heap_init(void);
 
 static void alloc_lock() {
     if (alloc_sema >= 0) {
@@ -60,8 +62,8 @@ int _start(int argc, char **argv)
 
     if (!(heap_start = AllocSysMemory(ALLOC_FIRST, heap_size, NULL)))
 	return -1;
-    heap_end = heap_start + heap_size;
-    _heap_ptr = heap_start;
+    heap_end = heap_start + (heap_size & ~15);
+    heap_init();
 
     sem_info.attr = 1;
     sem_info.option = 1;
@@ -92,155 +94,303 @@ int shutdown()
 #define ALIGN(x, align) (((x)+((align)-1))&~((align)-1))
 #endif
 
-/* _heap_mem_block_header structure. */
-typedef struct _heap_mem_header {
-	void *	ptr;
-	size_t	size;
-	struct _heap_mem_header * prev;
-	struct _heap_mem_header * next;
-} heap_mem_header_t;
+/*
+ * Two-level segregated fit (TLSF) allocator.
+ * Free blocks are kept in lists by size class: the first level splits sizes by powers of two, the second level
+ * splits each power of two range into SL_INDEX_COUNT linear classes. A bitmap of non-empty lists per level makes
+ * finding a suitable block a constant-time operation, and freed blocks are immediately coalesced with their free
+ * neighbours in memory.
+ */
+#define SL_INDEX_COUNT_LOG2	4
+#define SL_INDEX_COUNT		(1 << SL_INDEX_COUNT_LOG2)
+#define ALIGN_SIZE_LOG2		4	/* log2(DEFAULT_ALIGNMENT) */
+#define FL_INDEX_SHIFT		(SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2)
+#define FL_INDEX_MAX		24	/* Blocks up to 16MB */
+#define FL_INDEX_COUNT		(FL_INDEX_MAX - FL_INDEX_SHIFT + 1)
+#define SMALL_BLOCK_SIZE	(1 << FL_INDEX_SHIFT)
+
+/* Block header, followed by the payload. Blocks are contiguous in memory, the last one is a zero-sized sentinel. */
+typedef struct _heap_block {
+	struct _heap_block * prev_phys;	/* Previous block in memory, NULL for the first block.  */
+	size_t	size;			/* Payload size, bit 0 is set if the block is free.  */
+	struct _heap_block * next_free;	/* Free list links, only valid for free blocks.  */
+	struct _heap_block * prev_free;
+} heap_block_t;
+
+#define BLOCK_FREE		1
+#define BLOCK_HEADER_SIZE	sizeof(heap_block_t)
+/* A split-off block must at least have room for its header and the minimal payload.  */
+#define BLOCK_SPLIT_MIN		(BLOCK_HEADER_SIZE + DEFAULT_ALIGNMENT)
+
+static u32 fl_bitmap;
+static u32 sl_bitmap[FL_INDEX_COUNT];
+static heap_block_t * free_blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+static heap_block_t * heap_first, * heap_sentinel;
+static u32 heap_used, heap_peak;	/* Bytes in allocated blocks, including headers.  */
+
+static inline size_t block_size(const heap_block_t *block)
+{
+	return block->size & ~BLOCK_FREE;
+}
 
-static void * __alloc_heap_base = NULL;
-static heap_mem_header_t *__alloc_heap_head = NULL;
-static heap_mem_header_t *__alloc_heap_tail = NULL;
+static inline int block_is_free(const heap_block_t *block)
+{
+	return block->size & BLOCK_FREE;
+}
 
-static void * alloc_sbrk(size_t increment)
+static inline void * block_to_ptr(heap_block_t *block)
 {
-        u8 *mp, *ret = (void *)-1;
+	return (void *)((u8 *)block + BLOCK_HEADER_SIZE);
+}
 
-        if (increment == 0)
-                return _heap_ptr;
+static inline heap_block_t * block_from_ptr(const void *ptr)
+{
+	return (heap_block_t *)((u8 *)ptr - BLOCK_HEADER_SIZE);
+}
 
-        /* If the area we want to allocated is past the end of our heap, we have a problem. */
-        mp = _heap_ptr + increment;
-        if (mp <= heap_end) {
-                ret = _heap_ptr;
-                _heap_ptr = mp;
-        }
+static inline heap_block_t * block_next(heap_block_t *block)
+{
+	return (heap_block_t *)((u8 *)block_to_ptr(block) + block_size(block));
+}
+
+/* Index of the most/least significant set bit. Written out, as the IOP has no count-leading-zeros instruction.  */
+static int heap_fls(u32 word)
+{
+	int bit = 0;
+
+	if (word & 0xFFFF0000) { word >>= 16; bit += 16; }
+	if (word & 0xFF00) { word >>= 8; bit += 8; }
+	if (word & 0xF0) { word >>= 4; bit += 4; }
+	if (word & 0xC) { word >>= 2; bit += 2; }
+	if (word & 0x2) bit += 1;
 
-        return ret;
+	return bit;
 }
 
-/** Find the lowest block that we can allocate AFTER, returning NULL if there are none.  */
-static heap_mem_header_t * _heap_mem_fit(heap_mem_header_t *head, size_t size)
+static inline int heap_ffs(u32 word)
 {
-	heap_mem_header_t *prev_mem = head;
-	u32 prev_top, next_bot;
-
-	while (prev_mem != NULL) {
-		if (prev_mem->next != NULL) {
-			prev_top = (u32)prev_mem->ptr + prev_mem->size;
-			next_bot = (u32)prev_mem->next - prev_top;
-			if (next_bot >= size)
-				return prev_mem;
-		}
+	return heap_fls(word & -word);
+}
+
+static void mapping_insert(size_t size, int *fli, int *sli)
+{
+	int fl, sl;
 
-		prev_mem = prev_mem->next;
+	if (size < SMALL_BLOCK_SIZE) {
+		fl = 0;
+		sl = size >> ALIGN_SIZE_LOG2;
+	} else {
+		fl = heap_fls(size);
+		sl = (size >> (fl - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+		fl -= FL_INDEX_SHIFT - 1;
 	}
 
-	return prev_mem;
+	*fli = fl;
+	*sli = sl;
 }
 
-void * malloc(size_t size)
+/* Like mapping_insert(), but rounds up to the next class so that any block in it is large enough.  */
+static void mapping_search(size_t size, int *fli, int *sli)
 {
-	void *ptr = NULL, *mem_ptr;
-	heap_mem_header_t *new_mem, *prev_mem;
-	size_t mem_sz, heap_align_bytes;
+	if (size >= SMALL_BLOCK_SIZE)
+		size += (1 << (heap_fls(size) - SL_INDEX_COUNT_LOG2)) - 1;
 
-	mem_sz = size + sizeof(heap_mem_header_t);
+	mapping_insert(size, fli, sli);
+}
 
-	if ((mem_sz & (DEFAULT_ALIGNMENT - 1)) != 0)
-		mem_sz = ALIGN(mem_sz, DEFAULT_ALIGNMENT);
+static heap_block_t * search_suitable_block(int *fli, int *sli)
+{
+	int fl = *fli, sl = *sli;
+	u32 sl_map, fl_map;
 
-	alloc_lock();
+	if (fl >= FL_INDEX_COUNT)
+		return NULL;
 
-	/* If we don't have any allocated blocks, reserve the first block from
-	   the OS and initialize __alloc_heap_tail.  */
-	if (__alloc_heap_head == NULL) {
-		/* Align the bottom of the heap to our default alignment.  */
-		if (__alloc_heap_base == NULL) {
-			heap_align_bytes = (u32)alloc_sbrk(0) & (DEFAULT_ALIGNMENT - 1);
-			alloc_sbrk(heap_align_bytes);
-			__alloc_heap_base = alloc_sbrk(0);
-		}
+	sl_map = sl_bitmap[fl] & (~0U << sl);
+	if (!sl_map) {
+		/* No block in this first level class, take the smallest of the larger ones.  */
+		fl_map = fl_bitmap & (~0U << (fl + 1));
+		if (!fl_map)
+			return NULL;
+
+		fl = heap_ffs(fl_map);
+		sl_map = sl_bitmap[fl];
+	}
+	sl = heap_ffs(sl_map);
 
-		/* Allocate the physical heap and setup the head block.  */
-		if ((mem_ptr = alloc_sbrk(mem_sz)) == (void *)-1)
-			return ptr;	/* NULL */
+	*fli = fl;
+	*sli = sl;
+	return free_blocks[fl][sl];
+}
 
-		ptr = (void *)((u32)mem_ptr + sizeof(heap_mem_header_t));
+static void block_insert(heap_block_t *block)
+{
+	int fl, sl;
 
-		__alloc_heap_head       = (heap_mem_header_t *)mem_ptr;
-		__alloc_heap_head->ptr  = ptr;
-		__alloc_heap_head->size = mem_sz - sizeof(heap_mem_header_t);
-		__alloc_heap_head->prev = NULL;
-		__alloc_heap_head->next = NULL;
+	mapping_insert(block_size(block), &fl, &sl);
 
-		__alloc_heap_tail = __alloc_heap_head;
+	block->size |= BLOCK_FREE;
+	block->prev_free = NULL;
+	block->next_free = free_blocks[fl][sl];
+	if (block->next_free != NULL)
+		block->next_free->prev_free = block;
+	free_blocks[fl][sl] = block;
 
-		alloc_unlock();
-		return ptr;
-	}
+	fl_bitmap |= 1 << fl;
+	sl_bitmap[fl] |= 1 << sl;
+}
 
-	/* Check to see if there's free space at the bottom of the heap.  */
-	if ((__alloc_heap_base + mem_sz) < (void *)__alloc_heap_head) {
-		new_mem = (heap_mem_header_t *)__alloc_heap_base;
-		ptr     = (void *)((u32)new_mem + sizeof(heap_mem_header_t));
+static void block_remove(heap_block_t *block)
+{
+	int fl, sl;
 
-		new_mem->ptr  = ptr;
-		new_mem->size = mem_sz - sizeof(heap_mem_header_t);
-		new_mem->prev = NULL;
-		new_mem->next = __alloc_heap_head;
-		new_mem->next->prev = new_mem;
-		__alloc_heap_head = new_mem;
+	mapping_insert(block_size(block), &fl, &sl);
 
-		alloc_unlock();
-		return ptr;
+	if (block->prev_free != NULL)
+		block->prev_free->next_free = block->next_free;
+	else
+		free_blocks[fl][sl] = block->next_free;
+	if (block->next_free != NULL)
+		block->next_free->prev_free = block->prev_free;
+
+	if (free_blocks[fl][sl] == NULL) {
+		sl_bitmap[fl] &= ~(1 << sl);
+		if (!sl_bitmap[fl])
+			fl_bitmap &= ~(1 << fl);
 	}
 
-	/* See if we can allocate the block without extending the heap. */
-	prev_mem = _heap_mem_fit(__alloc_heap_head, mem_sz);
-	if (prev_mem != NULL) {
-		new_mem = (heap_mem_header_t *)((u32)prev_mem->ptr + prev_mem->size);
-		ptr     = (void *)((u32)new_mem + sizeof(heap_mem_header_t));
+	block->size &= ~BLOCK_FREE;
+}
 
-		new_mem->ptr  = ptr;
-		new_mem->size = mem_sz - sizeof(heap_mem_header_t);
-		new_mem->prev = prev_mem;
-		new_mem->next = prev_mem->next;
-		new_mem->next->prev = new_mem;
-		prev_mem->next = new_mem;
+/* Merges a free block with its free neighbours, which must not be in the free lists, and inserts the result.
+   The headers that end up inside the merged block stay marked free, so that heap_validate() rejects them.  */
+static void block_release(heap_block_t *block)
+{
+	heap_block_t *next, *prev;
 
-		alloc_unlock();
-		return ptr;
+	block->size |= BLOCK_FREE;
+
+	next = block_next(block);
+	if (block_is_free(next)) {
+		block_remove(next);
+		next->size |= BLOCK_FREE;
+		block->size += BLOCK_HEADER_SIZE + block_size(next);
+		block_next(block)->prev_phys = block;
 	}
 
-	/* Extend the heap, but make certain the block is inserted in
-	   order. */
-	if ((mem_ptr = alloc_sbrk(mem_sz)) == (void *)-1) {
-		alloc_unlock();
-		return ptr;	/* NULL */
+	prev = block->prev_phys;
+	if (prev != NULL && block_is_free(prev)) {
+		block_remove(prev);
+		prev->size += BLOCK_HEADER_SIZE + block_size(block);
+		block_next(prev)->prev_phys = prev;
+		block = prev;
 	}
 
-	ptr = (void *)((u32)mem_ptr + sizeof(heap_mem_header_t));
+	block_insert(block);
+}
+
+/* Splits the tail off an allocated block of at least size bytes, if it is large enough to be a block of its own.
+   The caller accounts for the size of the block that is left.  */
+static void block_trim(heap_block_t *block, size_t size)
+{
+	heap_block_t *rest;
+	size_t total = block_size(block);
+
+	if (total < size + BLOCK_SPLIT_MIN)
+		return;
+
+	rest = (heap_block_t *)((u8 *)block_to_ptr(block) + size);
+	rest->prev_phys = block;
+	rest->size = total - size - BLOCK_HEADER_SIZE;
+	block->size = size;
+	block_next(rest)->prev_phys = rest;
+
+	block_release(rest);
+}
+
+/* Adds a newly allocated (and already trimmed) block to the used bytes.  */
+static void heap_account(heap_block_t *block)
+{
+	heap_used += BLOCK_HEADER_SIZE + block_size(block);
+	if (heap_used > heap_peak)
+		heap_peak = heap_used;
+}
+
+static void heap_init(void)
+{
+	heap_first = (heap_block_t *)heap_start;
+	heap_sentinel = (heap_block_t *)(heap_end - BLOCK_HEADER_SIZE);
+
+	heap_first->prev_phys = NULL;
+	heap_first->size = (u8 *)heap_sentinel - (u8 *)block_to_ptr(heap_first);
+
+	heap_sentinel->prev_phys = heap_first;
+	heap_sentinel->size = 0;
+
+	block_insert(heap_first);
+}
+
+static inline size_t adjust_size(size_t size)
+{
+	if (size == 0)
+		return DEFAULT_ALIGNMENT;
+
+	return ALIGN(size, DEFAULT_ALIGNMENT);
+}
+
+static heap_block_t * heap_locate(size_t size)
+{
+	heap_block_t *block;
+	int fl, sl;
+
+	mapping_search(size, &fl, &sl);
+	if ((block = search_suitable_block(&fl, &sl)) == NULL)
+		return NULL;
+
+	block_remove(block);
+	block_trim(block, size);
+
+	return block;
+}
+
+/* Returns the block of an allocated pointer, or NULL if ptr was not returned by this allocator.  */
+static heap_block_t * heap_validate(void *ptr)
+{
+	heap_block_t *block;
+
+	if ((u8 *)ptr < heap_start + BLOCK_HEADER_SIZE || (u8 *)ptr >= heap_end || ((u32)ptr & (DEFAULT_ALIGNMENT - 1)))
+		return NULL;
+
+	block = block_from_ptr(ptr);
+	if (block_is_free(block) || block == heap_sentinel)
+		return NULL;
+
+	return block;
+}
 
-	new_mem       = (heap_mem_header_t *)mem_ptr;
-	new_mem->ptr  = ptr;
-	new_mem->size = mem_sz - sizeof(heap_mem_header_t);
-	new_mem->prev = __alloc_heap_tail;
-	new_mem->next = NULL;
+void * malloc(size_t size)
+{
+	heap_block_t *block;
+
+	if (size >= (1 << FL_INDEX_MAX))
+		return NULL;
 
-	__alloc_heap_tail->next = new_mem;
-	__alloc_heap_tail       = new_mem;
+	size = adjust_size(size);
 
+	alloc_lock();
+	if ((block = heap_locate(size)) != NULL)
+		heap_account(block);
 	alloc_unlock();
-	return ptr;
+
+	return block != NULL ? block_to_ptr(block) : NULL;
 }
 
 void * realloc(void *ptr, size_t size)
 {
-	heap_mem_header_t *prev_mem;
+	heap_block_t *block, *next;
 	void *new_ptr = NULL;
+	size_t old_size, avail;
 
 	if (!size && ptr != NULL) {
 		free(ptr);
@@ -250,57 +400,59 @@ void * realloc(void *ptr, size_t size)
 	if (ptr == NULL)
 		return malloc(size);
 
-	if ((size & (DEFAULT_ALIGNMENT - 1)) != 0)
-		size = ALIGN(size, DEFAULT_ALIGNMENT);
-
-	alloc_lock();
-	prev_mem = (heap_mem_header_t *)((u32)ptr - sizeof(heap_mem_header_t));
+	if (size >= (1 << FL_INDEX_MAX))
+		return NULL;
 
+	size = adjust_size(size);
 
-	/* Don't do anything if asked for same sized block. */
-	/* If the new size is shorter, let's just shorten the block. */
-	if (prev_mem->size >= size) {
-		/* However, if this is the last block, we have to shrink the heap. */
-		if (!prev_mem->next)
-			alloc_sbrk(ptr + size - alloc_sbrk(0));
-		prev_mem->size = size;
+	alloc_lock();
 
+	if ((block = heap_validate(ptr)) == NULL) {
 		alloc_unlock();
-		return ptr;
+		return NULL;
 	}
 
+	old_size = block_size(block);
 
-	/* We are asked for a larger block of memory. */
-
-	/* Are we the last memory block ? */
-	if (!prev_mem->next) {
-		/* Yes, let's just extend the heap then. */
-		if (alloc_sbrk(size - prev_mem->size) == (void*) -1)
-			return NULL;
-		prev_mem->size = size;
+	/* If the new size is shorter, let's just shorten the block. */
+	if (old_size >= size) {
+		block_trim(block, size);
+		heap_used -= old_size - block_size(block);
 
 		alloc_unlock();
 		return ptr;
 	}
 
-	/* Is the next block far enough so we can extend the current block ? */
-	if ((prev_mem->next->ptr - ptr) > size) {
-		prev_mem->size = size;
+	/* Is the next block free and large enough so we can extend the current block ? */
+	next = block_next(block);
+	avail = old_size + BLOCK_HEADER_SIZE + block_size(next);
+	if (block_is_free(next) && avail >= size) {
+		block_remove(next);
+		next->size |= BLOCK_FREE;
+		block->size = avail;
+		block_next(block)->prev_phys = block;
+		block_trim(block, size);
+		heap_used -= BLOCK_HEADER_SIZE + old_size;
+		heap_account(block);
 
 		alloc_unlock();
 		return ptr;
 	}
 
-	alloc_unlock();
-
 	/* We got out of luck, let's allocate a new block of memory. */
-	if ((new_ptr = malloc(size)) == NULL)
-		return new_ptr;
+	if ((block = heap_locate(size)) != NULL) {
+		heap_account(block);
+		new_ptr = block_to_ptr(block);
 
-        /* New block is larger, we only copy the old data. */
-	memcpy(new_ptr, ptr, prev_mem->size);
+		/* New block is larger, we only copy the old data. */
+		memcpy(new_ptr, ptr, old_size);
+
+		block = block_from_ptr(ptr);
+		heap_used -= BLOCK_HEADER_SIZE + block_size(block);
+		block_release(block);
+	}
 
-	free(ptr);
+	alloc_unlock();
 	return new_ptr;
 }
 
@@ -309,6 +461,9 @@ void * calloc(size_t n, size_t size)
 	void *ptr = NULL;
 	size_t sz = n * size;
 
+	if (size != 0 && sz / size != n)
+		return ptr;	/* NULL */
+
 	if ((ptr = malloc(sz)) == NULL)
 		return ptr;
 
@@ -318,140 +473,132 @@ void * calloc(size_t n, size_t size)
 
 void * memalign(size_t align, size_t size)
 {
-	heap_mem_header_t new_mem;
-	heap_mem_header_t *cur_mem;
-	heap_mem_header_t *old_mem;
-	void *ptr = NULL;
+	heap_block_t *block, *aligned, *prev;
+	size_t gap;
+	u8 *ptr;
 
 	if (align <= DEFAULT_ALIGNMENT)
 		return malloc(size);
 
-	/* Allocate with extra alignment bytes just in case it isn't aligned
-	   properly by malloc.  */
-	if ((ptr = malloc(size + align)) == NULL)
-		return ptr;	/* NULL */
-
-	/* If malloc returned it aligned for us we're fine.  */
-	if (((u32)ptr & (align - 1)) == 0)
-		return ptr;
-
-	alloc_lock();
-	cur_mem = (heap_mem_header_t *)((u32)ptr - sizeof(heap_mem_header_t));
-	cur_mem->size -= align;
+	/* Only powers of two are valid alignments.  */
+	if (align & (align - 1))
+		return NULL;
 
-	/* Otherwise, align the pointer and fixup our hearder accordingly.  */
-	ptr = (void *)ALIGN((u32)ptr, align);
+	if (size >= (1 << FL_INDEX_MAX))
+		return NULL;
 
-	old_mem = cur_mem;
+	size = adjust_size(size);
 
-	/* Copy the heap_mem_header_t locally, before repositioning (to make
-	   sure we don't overwrite ourselves.  */
-	memcpy(&new_mem, cur_mem, sizeof(heap_mem_header_t));
-	cur_mem = (heap_mem_header_t *)((u32)ptr - sizeof(heap_mem_header_t));
-	memcpy(cur_mem, &new_mem, sizeof(heap_mem_header_t));
-
-	if (cur_mem->prev)
-		cur_mem->prev->next = cur_mem;
-	if (cur_mem->next)
-		cur_mem->next->prev = cur_mem;
+	alloc_lock();
 
-	if (__alloc_heap_head == old_mem)
-		__alloc_heap_head = cur_mem;
+	/* Allocate with room for the alignment gap. As both are multiples of DEFAULT_ALIGNMENT, a non-empty gap
+	   can always hold the header of the block in front of the aligned one.  */
+	if ((block = heap_locate(size + align + BLOCK_HEADER_SIZE)) == NULL) {
+		alloc_unlock();
+		return NULL;
+	}
 
-	if (__alloc_heap_tail == old_mem)
-		__alloc_heap_tail = cur_mem;
+	ptr = block_to_ptr(block);
+	gap = (u8 *)ALIGN((u32)ptr, align) - ptr;
+	prev = block->prev_phys;
+
+	/* A gap of only a header can't be a block of its own, it has to be merged into the block in front of it.
+	   At the start of the heap there is none, so use the next aligned address instead: the allocation has
+	   room for a gap of up to align + BLOCK_HEADER_SIZE.  */
+	if (gap != 0 && gap < BLOCK_SPLIT_MIN && prev == NULL)
+		gap += align;
+
+	if (gap != 0) {
+		/* Give the gap in front of the aligned pointer back to the heap.  */
+		aligned = (heap_block_t *)(ptr + gap - BLOCK_HEADER_SIZE);
+		aligned->prev_phys = block;
+		aligned->size = block_size(block) - gap;
+		block_next(aligned)->prev_phys = aligned;
+
+		/* Free blocks are merged with their neighbours, so the block in front of this one is allocated.  */
+		if (gap < BLOCK_SPLIT_MIN) {
+			/* Too small for a free block, the allocated block in front of it keeps the gap until it is freed.  */
+			prev->size += gap;
+			heap_used += gap;
+			aligned->prev_phys = prev;
+		} else {
+			block->size = gap - BLOCK_HEADER_SIZE;
+			block_insert(block);
+		}
+		block = aligned;
+	}
 
-	cur_mem->ptr = ptr;
+	block_trim(block, size);
+	heap_account(block);
 
 	alloc_unlock();
-	return ptr;
+	return block_to_ptr(block);
 }
 
 void free(void *ptr)
 {
-	heap_mem_header_t *cur;
-	void *heap_top;
-	size_t size;
+	heap_block_t *block;
 
 	if (!ptr)
 		return;
 
 	alloc_lock();
 
-	if (!__alloc_heap_head) {
-		alloc_unlock();
-		return;
-	}
-
-
-	/* Freeing the head pointer is a special case.  */
-	if (ptr == __alloc_heap_head->ptr) {
-		size = __alloc_heap_head->size +
-			(size_t)(__alloc_heap_head->ptr - (void *)__alloc_heap_head);
-
-		__alloc_heap_head = __alloc_heap_head->next;
-
-		if (__alloc_heap_head != NULL) {
-			__alloc_heap_head->prev = NULL;
-		} else {
-			__alloc_heap_tail = NULL;
-
-			alloc_sbrk(-size);
-		}
-
-		alloc_unlock();
-		return;
-	}
-
-	cur = __alloc_heap_head;
-	while (ptr != cur->ptr)  {
-		/* ptr isn't in our list */
-		if (cur->next == NULL) {
-			alloc_unlock();
-			return;
-		}
-
-		cur = cur->next;
+	/* Silently ignore pointers that aren't ours.  */
+	if ((block = heap_validate(ptr)) != NULL) {
+		heap_used -= BLOCK_HEADER_SIZE + block_size(block);
+		block_release(block);
 	}
 
-	/* Deallocate the block.  */
-	if (cur->next != NULL) {
-		cur->next->prev = cur->prev;
-	} else {
-		/* If this block was the last one in the list, shrink the heap.  */
-		__alloc_heap_tail = cur->prev;
-
-		/* We need to free (heap top) - (prev->ptr + prev->size), or else
-		   we'll end up with an unallocatable block of heap.  */
-		heap_top = alloc_sbrk(0);
-		size = (u32)heap_top - (u32)(cur->prev->ptr + cur->prev->size);
-		alloc_sbrk(-size);
-	}
-
-	cur->prev->next = cur->next;
-
 	alloc_unlock();
 }
 
+/** Walks over all blocks in address order. valid is set for allocated blocks, and cleared for free ones.  */
 void * __mem_walk_begin() {
-	return __alloc_heap_head;
+	return heap_first;
 }
 
 void __mem_walk_read(void * token, u32 * size, void ** ptr, int * valid) {
-        heap_mem_header_t * cur = (heap_mem_header_t *) token;
+	heap_block_t * cur = (heap_block_t *) token;
 
-	*valid = 1;
+	*valid = !block_is_free(cur);
 
-	*size = cur->size;
-	*ptr = cur->ptr;
+	*size = block_size(cur);
+	*ptr = block_to_ptr(cur);
 }
 
 void * __mem_walk_inc(void * token) {
-	heap_mem_header_t * cur = (heap_mem_header_t *) token;
+	heap_block_t * next = block_next((heap_block_t *) token);
 
-	return cur->next;
+	return next != heap_sentinel ? next : NULL;
 }
 
 int __mem_walk_end(void * token) {
 	return token == NULL;
 }
+
+void alloc_get_stats(struct alloc_stats * stats) {
+	heap_block_t * cur;
+	size_t size;
+
+	memset(stats, 0, sizeof(*stats));
+
+	alloc_lock();
+
+	stats->heap_size = heap_end - heap_start;
+	stats->used = heap_used;
+	stats->peak_used = heap_peak;
+
+	for (cur = heap_first; cur != heap_sentinel; cur = block_next(cur)) {
+		size = block_size(cur);
+		if (block_is_free(cur)) {
+			stats->free += size;
+			stats->free_blocks++;
+			if (size > stats->largest_free)
+				stats->largest_free = size;
+		} else
+			stats->used_blocks++;
+	}
+
+	alloc_unlock();
+}
@@ -0,0 +1,425 @@
+/*
+ * Host benchmark of the IOP heap (alloc.c) that replays allocation traces.
+ *
+ * A trace is a text file with one call per line, where id names an allocation and the sizes are in bytes:
+ *
+ *	m id size		malloc()
+ *	c id size		calloc(1, size)
+ *	a id align size	memalign()
+ *	r id size		realloc()
+ *	f id			free()
+ *
+ * Without a trace file, one is generated that looks like network and file system drivers on the IOP:
+ * packet buffers and their headers that live for a few calls, per-request buffers of 512 bytes to
+ * 16KB, 64-byte aligned DMA buffers, and long-lived connection records that grow with realloc().
+ *
+ * The heap is 1MB. Every block is filled with a pattern that is checked when the block is freed or
+ * reallocated, and the number of allocated blocks is checked with __mem_walk_*() after the replay.
+ * Calls that fail are counted, they are skipped by the rest of the trace. The trace is then replayed
+ * 20 times without the checks. The time per call, the failed calls and the fragmentation at the peak
+ * of the trace are printed.
+ * Freeing a pointer twice must not change the heap, including after its block was merged with its
+ * neighbours.
+ *
+ * Build and run from the root of the tree, with the alloc.c from before TLSF for comparison:
+ *
+ *   F="-O2 -Wall -D_IOP -Iiop/system/alloc/test/host -Iiop/system/alloc/include -Icommon/include"
+ *   gcc $F -Iiop/system/alloc/src iop/system/alloc/test/alloc_replay.c -o alloc_replay
+ *   mkdir -p alloc_old && git show 22ecac1:iop/system/alloc/src/alloc.c > alloc_old/alloc.c
+ *   gcc $F -DOLD_ALLOC -Ialloc_old -Iiop/system/alloc/src iop/system/alloc/test/alloc_replay.c -o alloc_replay_old
+ *   ./alloc_replay && ./alloc_replay_old
+ *
+ * The old realloc() lets a block grow over the header of the next block, which breaks the list, so the
+ * old build replaces realloc() with malloc(), memcpy() and free().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The heap functions are built under other names, the host's own are still used by the C library.  */
+#define malloc		heap_malloc
+#define calloc		heap_calloc
+#define realloc		heap_realloc
+#define memalign	heap_memalign
+#define free		heap_free
+#define _start		heap_start_module
+#define shutdown	heap_shutdown
+
+#include "alloc.c"
+
+#undef malloc
+#undef calloc
+#undef realloc
+#undef memalign
+#undef free
+
+#define HEAP_SIZE	"1048576"
+#define MAX_IDS		4096
+#define MAX_CALLS	400000
+#define REPLAYS		20
+
+struct irx_export_table _exp_alloc;
+
+typedef struct {
+	char op;
+	int id;
+	u32 align;
+	u32 size;
+} trace_call_t;
+
+static trace_call_t *trace;
+static int trace_len;
+
+static u8 *ptrs[MAX_IDS];
+static u32 sizes[MAX_IDS];
+static int live, peak_live;
+static u32 live_bytes, peak_bytes;
+#ifndef OLD_ALLOC
+static u32 peak_free_blocks, peak_largest_free;
+#endif
+static long failed;
+static int errors;
+
+static void error(const char *what, int id)
+{
+	if (errors++ < 10)
+		printf("error: %s, id %d\n", what, id);
+}
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void add(char op, int id, u32 align, u32 size)
+{
+	if (trace_len == MAX_CALLS)
+		return;
+
+	trace[trace_len].op = op;
+	trace[trace_len].id = id;
+	trace[trace_len].align = align;
+	trace[trace_len].size = size;
+	trace_len++;
+}
+
+/* Ids 0-255 are packets, 256-383 requests, 1024-1279 connections and 1280-1343 scratch buffers. Each kind has its own ids, in use or not.  */
+static void generate(void)
+{
+	static char used[MAX_IDS];
+	static int packets[256], packet_head, packet_tail;
+	int i, id;
+
+	srand(7);
+	/* Leave room for freeing everything at the end.  */
+	while (trace_len < MAX_CALLS - MAX_IDS) {
+		switch (rand() % 16) {
+			case 0: case 1: case 2: case 3: case 4: case 5: case 6:
+				/* A packet and its header, freed about 100 calls later.  */
+				if (packet_head - packet_tail == 128) {
+					id = packets[packet_tail++ % 256];
+					add('f', id, 0, 0);
+					add('f', id + 128, 0, 0);
+					used[id] = used[id + 128] = 0;
+				}
+				for (id = rand() % 128; used[id]; id = (id + 1) % 128);
+				used[id] = used[id + 128] = 1;
+				packets[packet_head++ % 256] = id;
+				add('m', id, 0, 64 + rand() % 1473);
+				add('m', id + 128, 0, 16 + rand() % 112);
+				break;
+			case 7: case 8: case 9: case 10:
+				/* A request buffer, some of them DMA aligned.  */
+				id = 256 + rand() % 128;
+				if (used[id]) {
+					add('f', id, 0, 0);
+					used[id] = 0;
+				} else {
+					used[id] = 1;
+					if (rand() % 4 == 0)
+						add('a', id, 64, 512 << (rand() % 3));
+					else
+						add(rand() % 2 ? 'm' : 'c', id, 0, 512 + rand() % 15873);
+				}
+				break;
+			case 11:
+				/* A connection record, which grows over its life.  */
+				id = 1024 + rand() % 256;
+				if (!used[id]) {
+					used[id] = 1;
+					add('m', id, 0, 32 + rand() % 256);
+				} else if (rand() % 4 == 0) {
+					add('f', id, 0, 0);
+					used[id] = 0;
+				} else
+					add('r', id, 0, 32 + rand() % 2048);
+				break;
+			default:
+				/* Short-lived scratch buffers.  */
+				id = 1280 + rand() % 64;
+				if (used[id])
+					add('f', id, 0, 0);
+				else
+					add('m', id, 0, 16 + rand() % 4096);
+				used[id] = !used[id];
+				break;
+		}
+	}
+
+	for (i = 0; i < MAX_IDS; i++) {
+		if (used[i])
+			add('f', i, 0, 0);
+	}
+}
+
+static int load(const char *path)
+{
+	FILE *f;
+	char line[128], op;
+	unsigned int id, a, b;
+	int n;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		n = sscanf(line, " %c %u %u %u", &op, &id, &a, &b);
+		if (n < 2 || id >= MAX_IDS)
+			continue;
+		if (op == 'a' && n == 4)
+			add(op, id, a, b);
+		else if (op != 'a')
+			add(op, id, 0, n > 2 ? a : 0);
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void fill(int id)
+{
+	memset(ptrs[id], id, sizes[id]);
+}
+
+static void check(int id, u32 size)
+{
+	u32 i;
+
+	for (i = 0; i < size; i++) {
+		if (ptrs[id][i] != (u8)id) {
+			error("the data of a block was overwritten", id);
+			return;
+		}
+	}
+}
+
+/* The blocks must fit in the heap, and the live allocations must be allocated blocks.  */
+static void check_heap(void)
+{
+	void *token;
+	u32 size, total = 0, used = 0;
+	void *ptr;
+	int valid, blocks = 0;
+
+	for (token = __mem_walk_begin(); !__mem_walk_end(token); token = __mem_walk_inc(token)) {
+		__mem_walk_read(token, &size, &ptr, &valid);
+		used += valid;
+		total += size;
+		if (++blocks > 1000000) {
+			error("the heap walk doesn't end", 0);
+			return;
+		}
+	}
+
+	if (used != live)
+		error("the number of allocated blocks doesn't match", used);
+	if (total > (u32)(heap_end - heap_start))
+		error("the blocks don't match the heap size", total);
+}
+
+/* Only the heap calls are made if verify is 0, for timing.  */
+static void replay(int verify)
+{
+	const trace_call_t *call;
+	u8 *ptr;
+	int i, id;
+
+	for (i = 0; i < trace_len; i++) {
+		call = &trace[i];
+		id = call->id;
+
+		switch (call->op) {
+			case 'm':
+			case 'c':
+			case 'a':
+				if (ptrs[id] != NULL)
+					continue;
+				if (call->op == 'm')
+					ptr = heap_malloc(call->size);
+				else if (call->op == 'c')
+					ptr = heap_calloc(1, call->size);
+				else
+					ptr = heap_memalign(call->align, call->size);
+				if (ptr == NULL) {
+					failed += verify;
+					continue;
+				}
+				if (!verify) {
+					ptrs[id] = ptr;
+					sizes[id] = call->size;
+					continue;
+				}
+				if (call->op == 'c' && call->size != 0 && (ptr[0] != 0 || ptr[call->size - 1] != 0))
+					error("calloc() didn't clear the block", id);
+				if (call->op == 'a' && ((u32)ptr & (call->align - 1)))
+					error("memalign() returned a misaligned block", id);
+				ptrs[id] = ptr;
+				sizes[id] = call->size;
+				live++;
+				live_bytes += call->size;
+				break;
+			case 'r':
+				if (ptrs[id] == NULL)
+					continue;
+#ifndef OLD_ALLOC
+				ptr = heap_realloc(ptrs[id], call->size);
+#else
+				/* The old realloc() grows a block over the header of the next one.  */
+				if ((ptr = heap_malloc(call->size)) != NULL) {
+					memcpy(ptr, ptrs[id], sizes[id] < call->size ? sizes[id] : call->size);
+					heap_free(ptrs[id]);
+				}
+#endif
+				if (ptr == NULL) {
+					failed += verify;
+					continue;
+				}
+				ptrs[id] = ptr;
+				if (!verify) {
+					sizes[id] = call->size;
+					continue;
+				}
+				check(id, sizes[id] < call->size ? sizes[id] : call->size);
+				live_bytes += call->size - sizes[id];
+				sizes[id] = call->size;
+				break;
+			case 'f':
+				if (ptrs[id] == NULL)
+					continue;
+				if (!verify) {
+					heap_free(ptrs[id]);
+					ptrs[id] = NULL;
+					continue;
+				}
+				check(id, sizes[id]);
+				heap_free(ptrs[id]);
+				ptrs[id] = NULL;
+				live--;
+				live_bytes -= sizes[id];
+				continue;
+			default:
+				continue;
+		}
+
+		fill(id);
+		if (live_bytes > peak_bytes) {
+			struct alloc_stats stats;
+
+			peak_bytes = live_bytes;
+			peak_live = live;
+#ifndef OLD_ALLOC
+			alloc_get_stats(&stats);
+			peak_free_blocks = stats.free_blocks;
+			peak_largest_free = stats.largest_free;
+#else
+			(void)stats;
+#endif
+		}
+	}
+}
+
+#ifndef OLD_ALLOC
+/* Frees of a pointer that was already freed, after its block was merged with the next and with the previous block.
+   The heap must be empty, so that the blocks are next to each other.  */
+static void double_free(void)
+{
+	struct alloc_stats before, after;
+	u8 *a, *b, *c, *d;
+
+	a = heap_malloc(100);
+	b = heap_malloc(200);
+	c = heap_malloc(300);
+	d = heap_malloc(400);
+
+	heap_free(b);
+	heap_free(a);	/* b is merged into a */
+	heap_free(c);	/* c is merged into a */
+
+	alloc_get_stats(&before);
+	heap_free(b);
+	heap_free(c);
+	alloc_get_stats(&after);
+	if (memcmp(&before, &after, sizeof(before)) != 0)
+		error("freeing a pointer twice changed the heap", 0);
+
+	heap_free(a);
+	alloc_get_stats(&after);
+	if (memcmp(&before, &after, sizeof(before)) != 0)
+		error("freeing a merged block twice changed the heap", 0);
+
+	heap_free(d);
+	check_heap();
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	char *args[] = {"alloc", HEAP_SIZE};
+	double t0, t1;
+	int i;
+
+	trace = malloc(MAX_CALLS * sizeof(*trace));
+
+	if (argc > 1) {
+		if (load(argv[1]) != 0) {
+			printf("can't read %s\n", argv[1]);
+			return 1;
+		}
+	} else
+		generate();
+
+	if (heap_start_module(2, args) != 0) {
+		printf("can't create the heap\n");
+		return 1;
+	}
+
+#ifndef OLD_ALLOC
+	double_free();
+#endif
+
+	replay(1);
+	check_heap();
+
+	t0 = seconds();
+	for (i = 0; i < REPLAYS; i++)
+		replay(0);
+	t1 = seconds();
+	check_heap();
+
+	printf("%d calls, %.1fns per call, %ld failed (%.2f%%), peak %d blocks of %lu bytes",
+		trace_len, (t1 - t0) * 1e9 / REPLAYS / trace_len, failed, 100.0 * failed / trace_len,
+		peak_live, (unsigned long)peak_bytes);
+#ifndef OLD_ALLOC
+	printf(", %lu free blocks, largest %lu bytes", (unsigned long)peak_free_blocks, (unsigned long)peak_largest_free);
+#endif
+	printf("\n");
+
+	printf(errors ? "FAIL\n" : "OK\n");
+
+	return (errors ? 1 : 0);
+}
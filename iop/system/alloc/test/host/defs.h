@@ -0,0 +1,7 @@
+/* Host stand-in for the IOP defs.h. */
+#ifndef __DEFS_H__
+#define __DEFS_H__
+
+#define ALIGN(x, align)	(((x)+((align)-1))&~((align)-1))
+
+#endif
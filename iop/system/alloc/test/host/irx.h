@@ -0,0 +1,11 @@
+/* Host stand-in for the IOP irx.h. */
+#ifndef __IRX_H__
+#define __IRX_H__
+
+#define IRX_ID(name, major, minor)	static const char *const irx_name __attribute__((unused)) = name
+
+struct irx_export_table {
+	int unused;
+};
+
+#endif
@@ -0,0 +1,7 @@
+/* Host stand-in for the IOP loadcore.h. */
+#ifndef __LOADCORE_H__
+#define __LOADCORE_H__
+
+static inline int RegisterLibraryEntries(struct irx_export_table *exports) { return 0; }
+
+#endif
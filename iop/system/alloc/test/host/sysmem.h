@@ -0,0 +1,17 @@
+/* Host stand-in for the IOP sysmem.h. The heap is mapped directly, malloc() is alloc.c's own in the benchmark. */
+#ifndef __SYSMEM_H__
+#define __SYSMEM_H__
+
+#include <sys/mman.h>
+
+#define ALLOC_FIRST 0
+
+static inline void *AllocSysMemory(int mode, int size, void *ptr)
+{
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return ptr != MAP_FAILED ? ptr : NULL;
+}
+
+static inline int FreeSysMemory(void *ptr) { return 0; }
+
+#endif
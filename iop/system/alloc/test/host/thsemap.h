@@ -0,0 +1,15 @@
+/* Host stand-in for the IOP thsemap.h: the benchmark runs in a single thread. */
+#ifndef __THSEMAP_H__
+#define __THSEMAP_H__
+
+typedef struct {
+	unsigned int attr, option;
+	int initial, max;
+} iop_sema_t;
+
+static inline int CreateSema(iop_sema_t *sema) { return 1; }
+static inline int DeleteSema(int sema) { return 0; }
+static inline int WaitSema(int sema) { return 0; }
+static inline int SignalSema(int sema) { return 0; }
+
+#endif
@@ -0,0 +1,3 @@
+/* Host stand-in for the IOP types.h. */
+#include <stddef.h>
+#include <tamtypes.h>
@@ -21,6 +21,9 @@ NOTES:
   not restricted to a multiple of 64 bytes. The implimentation method was borrowed from fileio
   read/write code :P
 
+- recv/send on stream sockets move up to the whole EE buffer in one RPC, in BUFF_SIZE chunks that alternate
+  between two buffers, so that the SIF transfer of one chunk overlaps the socket call of the other.
+
 */
 
 #include <types.h>
@@ -37,7 +40,9 @@ NOTES:
 #define MODNAME	"TCP/IP_Stack_RPC"
 IRX_ID(MODNAME, 1, 1);
 
-#define BUFF_SIZE	(1024)
+/* Bytes moved per chunk. Stream sockets go through several chunks per RPC, alternating between the buffers */
+#define BUFF_SIZE	(4096)
+#define BUFF_COUNT	2
 
 #define MIN(a, b)	(((a)<(b))?(a):(b))
 #define RDOWN_64(a)	(((a) >> 6) << 6)
@@ -46,8 +51,19 @@ static SifRpcDataQueue_t ps2ips_queue;
 static SifRpcServerData_t ps2ips_server;
 static int _rpc_buffer[512];
 
-static char lwip_buffer[BUFF_SIZE + 32];
+/*
+	The data of a chunk starts at offset 64. In front of it go the misaligned head of the EE buffer,
+	and behind it there is room for the bytes that a recv carries over to the next chunk.
+*/
+typedef struct {
+	u8 buffer[64 + BUFF_SIZE + 64];
+	int dma_id;
+} __attribute__((aligned(64))) lwip_buffer_t;
+
+static lwip_buffer_t lwip_buffers[BUFF_COUNT];
 static rests_pkt rests;
+static int rests_dma_id;
+static t_ps2ips_stats stats;
 
 static void do_accept( void * rpcBuffer, int size )
 {
@@ -105,17 +121,49 @@ static void do_listen( void * rpcBuffer, int size )
 	ptr[0] = ret;
 }
 
-static void do_recv( void * rpcBuffer, int size )
+static void wait_dma(int dma_id)
+{
+	if(dma_id != 0)
+		while(SifDmaStat(dma_id) >= 0);
+}
+
+static int send_dma(void *src, void *dest, int size)
 {
-	int srest, erest, asize; // size of unaligned portion, remainder portion, aligned portion
-	void *abuffer, *aebuffer; // aligned buffer start, aligned buffer end
-	int s_offset; // offset into lwip_buffer of srest data
-	int rlen, recvlen;
-	int dma_id = 0;
-	int intr_stat;
-	s_recv_pkt *recv_pkt = (s_recv_pkt *)rpcBuffer;
-	r_recv_pkt *ret_pkt = (r_recv_pkt *)rpcBuffer;
 	struct t_SifDmaTransfer sifdma;
+	int intr_stat, dma_id;
+
+	sifdma.src = src;
+	sifdma.dest = dest;
+	sifdma.size = size;
+	sifdma.attr = 0;
+	CpuSuspendIntr(&intr_stat);
+	dma_id = SifSetDma(&sifdma, 1);
+	CpuResumeIntr(intr_stat);
+
+	return dma_id;
+}
+
+// Only stream sockets may be read or written in several chunks.
+static int is_stream(int s)
+{
+	int type;
+	socklen_t optlen = sizeof(type);
+
+	return(getsockopt(s, SOL_SOCKET, SO_TYPE, &type, &optlen) == 0 && type == SOCK_STREAM);
+}
+
+/*
+	Receives into the EE buffer. A stream socket is read in chunks, while the previous chunk
+	is DMA'd back. After the first chunk, only data that is already waiting is taken, so the
+	call doesn't block any longer than a single recv() would.
+*/
+static int recv_chunks(s_recv_pkt *recv_pkt, int stream, struct sockaddr *from, int *fromlen)
+{
+	int srest, carry, asize; // size of unaligned portion, bytes carried to the next chunk, aligned portion
+	int s_offset; // offset into the first buffer of srest data
+	int rlen, recvlen, total, i;
+	u8 *ee_pos, *carry_buf;
+	lwip_buffer_t *buf;
 
 	if(recv_pkt->length <= 64)
 	{
@@ -130,229 +178,219 @@ static void do_recv( void * rpcBuffer, int size )
 	}
 
 	s_offset = 64 - srest;
-	recvlen = MIN(BUFF_SIZE, recv_pkt->length);
+	ee_pos = (u8 *)recv_pkt->ee_addr + srest;
+	carry = 0;
+	carry_buf = NULL;
+	total = 0;
+
+	// The previous rests may still be on their way.
+	wait_dma(rests_dma_id);
 
-	// Do actual TCP recv
-	rlen = recv(recv_pkt->socket, lwip_buffer + s_offset, recvlen, recv_pkt->flags);
+	for(i = 0; total < recv_pkt->length; i ^= 1)
+	{
+		buf = &lwip_buffers[i];
+		wait_dma(buf->dma_id);
 
-	if(rlen <= 0) goto recv_end;
-	if(rlen <= 64) srest = rlen;
+		if(total == 0)
+		{
+			recvlen = MIN(BUFF_SIZE, recv_pkt->length);
 
-	// fill sbuffer, calculate align buffer & erest valules, fill ebuffer
-	if(srest)
-		memcpy((void *)rests.sbuffer, (void *)(lwip_buffer + s_offset), srest);
+			// Do actual recv
+			if(from != NULL)
+				rlen = recvfrom(recv_pkt->socket, buf->buffer + s_offset, recvlen, recv_pkt->flags, from, fromlen);
+			else
+				rlen = recv(recv_pkt->socket, buf->buffer + s_offset, recvlen, recv_pkt->flags);
 
-	if(rlen > 64)
-	{
-		abuffer = recv_pkt->ee_addr + srest; // aligned buffer (round up)
-		aebuffer = (void *)RDOWN_64((int)recv_pkt->ee_addr + rlen); // aligned buffer end (round down)
+			if(rlen <= 0)
+			{
+				total = rlen;
+				srest = 0;
+				break;
+			}
 
-		asize = (int)aebuffer - (int)abuffer;
+			// Anything more would have to go right after the unaligned portion
+			if(rlen < srest)
+			{
+				srest = rlen;
+				stream = 0;
+			}
 
-		erest = recv_pkt->ee_addr + rlen - aebuffer;
+			if(srest)
+				memcpy((void *)rests.sbuffer, (void *)(buf->buffer + s_offset), srest);
 
-		if(erest)
-			memcpy((void *)rests.ebuffer, (void *)(lwip_buffer + 64 + asize), erest);
+			carry = rlen - srest;
 
-//		printf("srest = 0x%X\nabuffer = 0x%X\naebuffer = 0x%X\nasize = 0x%X\nerest = 0x%X\n", srest, abuffer, aebuffer, asize, erest);
+		} else {
 
-	} else {
+			recvlen = MIN(BUFF_SIZE, recv_pkt->length - total);
 
-		abuffer = aebuffer = NULL;
-		erest = asize =  0;
+			// The bytes carried over from the previous chunk go in front of the new data.
+			rlen = recv(recv_pkt->socket, buf->buffer + 64 + carry, recvlen, recv_pkt->flags | MSG_DONTWAIT);
 
-	}
+			if(rlen <= 0)
+				break;
 
-	// DMA back the abuffer
-	if(asize)
-	{
-		while(SifDmaStat(dma_id) >= 0);
+			memcpy((void *)(buf->buffer + 64), (void *)carry_buf, carry);
+			carry += rlen;
+		}
+
+		total += rlen;
+		stats.recv_chunks++;
 
-		sifdma.src = lwip_buffer + 64;
-		sifdma.dest = abuffer;
-		sifdma.size = asize;
-		sifdma.attr = 0;
-		CpuSuspendIntr(&intr_stat);
-		dma_id = SifSetDma(&sifdma, 1);
-		CpuResumeIntr(intr_stat);
+		asize = RDOWN_64(carry);
+		carry -= asize;
+		carry_buf = buf->buffer + 64 + asize;
+
+		// DMA back the aligned part, and wait for it only when the buffer is needed again
+		if(asize)
+		{
+			buf->dma_id = send_dma(buf->buffer + 64, ee_pos, asize);
+			ee_pos += asize;
+		}
+
+		if(!stream) break;
 	}
 
-	// Fill rest of rests structure, dma back
+	if(carry)
+		memcpy((void *)rests.ebuffer, (void *)carry_buf, carry);
+
+	// Fill rest of rests structure, dma back. It's sent even if nothing was received, as the EE always copies it.
 	rests.ssize = srest;
-	rests.esize = erest;
+	rests.esize = carry;
 	rests.sbuf = recv_pkt->ee_addr;
-	rests.ebuf = aebuffer;
+	rests.ebuf = ee_pos;
 
-	while(SifDmaStat(dma_id) >= 0);
+	rests_dma_id = send_dma(&rests, recv_pkt->intr_data, sizeof(rests_pkt));
 
-	sifdma.src = &rests;
-	sifdma.dest = recv_pkt->intr_data;
-	sifdma.size = sizeof(rests_pkt);
-	sifdma.attr = 0;
-	CpuSuspendIntr(&intr_stat);
-	dma_id = SifSetDma(&sifdma, 1);
-	CpuResumeIntr(intr_stat);
+	stats.recv_rpcs++;
+	if(total > 0)
+		stats.recv_bytes += total;
 
-recv_end:
-	ret_pkt->ret = rlen;
+	return total;
 }
 
-static void do_recvfrom( void * rpcBuffer, int size )
+static void do_recv( void * rpcBuffer, int size )
 {
-	int srest, erest, asize; // size of unaligned portion, remainder portion, aligned portion
-	void *abuffer, *aebuffer; // aligned buffer start, aligned buffer end
-	int s_offset; // offset into lwip_buffer of srest data
-	int rlen, recvlen;
-	int dma_id = 0;
-	int intr_stat;
 	s_recv_pkt *recv_pkt = (s_recv_pkt *)rpcBuffer;
 	r_recv_pkt *ret_pkt = (r_recv_pkt *)rpcBuffer;
-	static struct t_SifDmaTransfer sifdma;
-	static struct sockaddr sockaddr;
-	int fromlen;
+	int stream;
 
-	if(recv_pkt->length <= 64)
-	{
-		srest = recv_pkt->length;
-
-	} else {
-
-		if( ((int)recv_pkt->ee_addr & 0x3F) == 0 ) // ee address is aligned
-			srest = 0;
-		else
-			srest = RDOWN_64((int)recv_pkt->ee_addr) - (int)recv_pkt->ee_addr + 64;
-	}
+	stream = recv_pkt->length > BUFF_SIZE && !(recv_pkt->flags & MSG_PEEK) && is_stream(recv_pkt->socket);
 
-	s_offset = 64 - srest;
-	recvlen = MIN(BUFF_SIZE, recv_pkt->length);
+	ret_pkt->ret = recv_chunks(recv_pkt, stream, NULL, NULL);
+}
 
-	// Do actual UDP recvfrom
-	rlen = recvfrom(recv_pkt->socket, lwip_buffer + s_offset, recvlen, recv_pkt->flags, &sockaddr, &fromlen);
+static void do_recvfrom( void * rpcBuffer, int size )
+{
+	s_recv_pkt *recv_pkt = (s_recv_pkt *)rpcBuffer;
+	r_recv_pkt *ret_pkt = (r_recv_pkt *)rpcBuffer;
+	static struct sockaddr sockaddr;
+	int fromlen, rlen;
 
-	if(rlen <= 0) goto recv_end;
-	if(rlen <= 64) srest = rlen;
+	fromlen = sizeof(sockaddr);
+	rlen = recv_chunks(recv_pkt, 0, &sockaddr, &fromlen);
 
 	// copy sockaddr struct to return packet
-	memcpy((void *)&ret_pkt->sockaddr, (void *)&sockaddr, sizeof(struct sockaddr));
+	if(rlen > 0)
+		memcpy((void *)&ret_pkt->sockaddr, (void *)&sockaddr, sizeof(struct sockaddr));
 
-	// fill sbuffer, calculate align buffer & erest valules, fill ebuffer
-	if(srest)
-		memcpy((void *)rests.sbuffer, (void *)(lwip_buffer + s_offset), srest);
+	ret_pkt->ret = rlen;
+}
 
-	if(rlen > 64)
-	{
-		abuffer = recv_pkt->ee_addr + srest; // aligned buffer (round up)
-		aebuffer = (void *)RDOWN_64((int)recv_pkt->ee_addr + rlen); // aligned buffer end (round down)
+/*
+	Sends from the EE buffer. A stream socket is written in chunks, the next chunk being
+	fetched from the EE while the current one is sent. Stops at the first short send.
+*/
+static int send_chunks(send_pkt *pkt, int stream, struct sockaddr *to)
+{
+	static SifRpcReceiveData_t rdata;
+	int sendlen, next, remaining, slen, total, i;
+	u8 *ee_pos, *start;
+	lwip_buffer_t *buf, *next_buf;
 
-		asize = (int)aebuffer - (int)abuffer;
+	buf = &lwip_buffers[0];
+	wait_dma(buf->dma_id);
 
-		erest = recv_pkt->ee_addr + rlen - aebuffer;
+	// The misaligned head goes in front of the data
+	start = buf->buffer + 64 - pkt->malign;
+	if(pkt->malign)
+		memcpy((void *)start, pkt->malign_buff, pkt->malign);
 
-		if(erest)
-			memcpy((void *)rests.ebuffer, (void *)(lwip_buffer + 64 + asize), erest);
+	// The EE data is fetched in whole chunks from the aligned address after the head
+	ee_pos = (u8 *)pkt->ee_addr + pkt->malign;
+	next = MIN(BUFF_SIZE, pkt->length - pkt->malign);
+	sendlen = pkt->malign + next;
 
-//		printf("srest = 0x%X\nabuffer = 0x%X\naebuffer = 0x%X\nasize = 0x%X\nerest = 0x%X\n", srest, abuffer, aebuffer, asize, erest);
+	if(next > 0)
+		SifRpcGetOtherData(&rdata, ee_pos, buf->buffer + 64, next, 0);
 
-	} else {
+	ee_pos += next;
+	remaining = pkt->length - sendlen;
+	total = 0;
 
-		abuffer = aebuffer = NULL;
-		erest = asize = 0;
+	for(i = 0; ; i ^= 1)
+	{
+		next = stream ? MIN(BUFF_SIZE, remaining) : 0;
+		next_buf = &lwip_buffers[i ^ 1];
+
+		if(next > 0)
+		{
+			wait_dma(next_buf->dma_id);
+			SifRpcGetOtherData(&rdata, ee_pos, next_buf->buffer + 64, next, SIF_RPC_M_NOWAIT);
+		}
+
+		// Do actual send
+		if(to != NULL)
+			slen = sendto(pkt->socket, start, sendlen, pkt->flags, to, sizeof(struct sockaddr));
+		else
+			slen = send(pkt->socket, start, sendlen, pkt->flags);
 
-	}
+		if(next > 0)
+			while(SifCheckStatRpc((SifRpcClientData_t *)&rdata));
 
-	// DMA back the abuffer
-	if(asize)
-	{
-		while(SifDmaStat(dma_id) >= 0);
+		stats.send_chunks++;
 
-		sifdma.src = lwip_buffer + 64;
-		sifdma.dest = abuffer;
-		sifdma.size = asize;
-		sifdma.attr = 0;
-		CpuSuspendIntr(&intr_stat);
-		dma_id = SifSetDma(&sifdma, 1);
-		CpuResumeIntr(intr_stat);
-	}
+		if(slen < 0)
+		{
+			if(total == 0) total = slen;
+			break;
+		}
 
-	// Fill rest of rests structure, dma back
-	rests.ssize = srest;
-	rests.esize = erest;
-	rests.sbuf = recv_pkt->ee_addr;
-	rests.ebuf = aebuffer;
+		total += slen;
 
-	while(SifDmaStat(dma_id) >= 0);
+		if(slen < sendlen || next <= 0)
+			break;
 
-	sifdma.src = &rests;
-	sifdma.dest = recv_pkt->intr_data;
-	sifdma.size = sizeof(rests_pkt);
-	sifdma.attr = 0;
-	CpuSuspendIntr(&intr_stat);
-	dma_id = SifSetDma(&sifdma, 1);
-	CpuResumeIntr(intr_stat);
+		start = next_buf->buffer + 64;
+		sendlen = next;
+		ee_pos += next;
+		remaining -= next;
+	}
 
-recv_end:
-	ret_pkt->ret = rlen;
+	stats.send_rpcs++;
+	if(total > 0)
+		stats.send_bytes += total;
+
+	return total;
 }
 
 static void do_send( void * rpcBuffer, int size )
 {
 	int *ptr = rpcBuffer;
 	send_pkt *pkt = (send_pkt *)rpcBuffer;
-	int slen, sendlen;
-	int s_offset; // offset into lwip_buffer for malign data
-	void *ee_pos;
-	SifRpcReceiveData_t rdata;
-
-	if(pkt->malign)
-	{
-//		printf("send: misaligned = %d\n", pkt->malign);
-
-		s_offset = 64 - pkt->malign;
-		memcpy((void *)(lwip_buffer + s_offset), pkt->malign_buff, pkt->malign);
-
-	} else s_offset = 64;
-
-	ee_pos = pkt->ee_addr + pkt->malign;
+	int stream;
 
-	sendlen = MIN(BUFF_SIZE, pkt->length);
+	stream = pkt->length > BUFF_SIZE && is_stream(pkt->socket);
 
-	SifRpcGetOtherData(&rdata, ee_pos, lwip_buffer + 64, sendlen - pkt->malign, 0);
-
-	// So actual TCP send
-	slen = send(pkt->socket, lwip_buffer + s_offset, sendlen, pkt->flags);
-
-	ptr[0] = slen;
+	ptr[0] = send_chunks(pkt, stream, NULL);
 }
 
-
 static void do_sendto( void * rpcBuffer, int size )
 {
 	int *ptr = rpcBuffer;
 	send_pkt *pkt = (send_pkt *)rpcBuffer;
-	int slen, sendlen;
-	int s_offset; // offset into lwip_buffer for malign data
-	void *ee_pos;
-	SifRpcReceiveData_t rdata;
 
-	if(pkt->malign)
-	{
-//		printf("send: misaligned = %d\n", pkt->malign);
-
-		s_offset = 64 - pkt->malign;
-		memcpy((void *)(lwip_buffer + s_offset), pkt->malign_buff, pkt->malign);
-
-	} else s_offset = 64;
-
-	ee_pos = pkt->ee_addr + pkt->malign;
-
-	sendlen = MIN(BUFF_SIZE, pkt->length);
-
-	SifRpcGetOtherData(&rdata, ee_pos, lwip_buffer + 64, sendlen - pkt->malign, 0);
-
-	// So actual UDP sendto
-	slen = sendto(pkt->socket, lwip_buffer + s_offset, sendlen, pkt->flags, &pkt->sockaddr, sizeof(struct sockaddr));
-
-	ptr[0] = slen;
+	ptr[0] = send_chunks(pkt, 0, &pkt->sockaddr);
 }
 
 static void do_socket( void * rpcBuffer, int size )
@@ -488,6 +526,12 @@ static void do_dns_getserver( void *rpcBuffer, int size )
 }
 #endif
 
+static void do_getstats( void *rpcBuffer, int size )
+{
+	memcpy(rpcBuffer, &stats, sizeof(stats));
+	memset(&stats, 0, sizeof(stats));
+}
+
 static void * rpcHandlerFunction(unsigned int command, void * rpcBuffer, int size)
 {
 	switch(command)
@@ -557,6 +601,9 @@ static void * rpcHandlerFunction(unsigned int command, void * rpcBuffer, int siz
 		do_dns_getserver(rpcBuffer, size);
 		break;
 #endif
+	case PS2IPS_ID_GETSTATS:
+		do_getstats(rpcBuffer, size);
+		break;
 	default:
 		printf("PS2IPS: Unknown Function called!\n");
 
@@ -0,0 +1,4 @@
+/* Host stand-in for the IOP intrman.h. */
+
+int CpuSuspendIntr(int *state);
+int CpuResumeIntr(int state);
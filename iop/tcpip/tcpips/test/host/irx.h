@@ -0,0 +1 @@
+/* Host stand-in for the IOP irx.h, nothing from it is needed by ps2ips.c. */
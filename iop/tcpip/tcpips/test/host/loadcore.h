@@ -0,0 +1,6 @@
+/* Host stand-in for the IOP loadcore.h. */
+
+#define IRX_ID(name, major, minor)
+
+#define MODULE_RESIDENT_END		0
+#define MODULE_NO_RESIDENT_END	1
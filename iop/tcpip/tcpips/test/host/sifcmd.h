@@ -0,0 +1,16 @@
+/* Host stand-in for the IOP sifcmd.h, with the RPC calls used by ps2ips.c. */
+
+#define SIF_RPC_M_NOWAIT	0x01
+
+typedef struct { int id; } SifRpcReceiveData_t;
+typedef struct { int id; } SifRpcClientData_t;
+typedef struct { int id; } SifRpcDataQueue_t;
+typedef struct { int id; } SifRpcServerData_t;
+
+typedef void *(*SifRpcFunc_t)(int fno, void *buffer, int length);
+
+int SifRpcGetOtherData(SifRpcReceiveData_t *rd, void *src, void *dest, int size, int mode);
+int SifCheckStatRpc(SifRpcClientData_t *cd);
+void SifSetRpcQueue(SifRpcDataQueue_t *q, int thread_id);
+void SifRegisterRpc(SifRpcServerData_t *sd, int sid, SifRpcFunc_t func, void *buff, SifRpcFunc_t cfunc, void *cbuff, SifRpcDataQueue_t *qd);
+void SifRpcLoop(SifRpcDataQueue_t *qd);
@@ -0,0 +1,11 @@
+/* Host stand-in for the IOP sifman.h. */
+
+typedef struct t_SifDmaTransfer {
+	void	*src;
+	void	*dest;
+	int	size;
+	int	attr;
+} SifDmaTransfer_t;
+
+int SifSetDma(SifDmaTransfer_t *dmat, int count);
+int SifDmaStat(int trid);
@@ -0,0 +1,3 @@
+/* Host stand-in for the IOP sysclib.h. */
+
+#include <string.h>
@@ -0,0 +1,15 @@
+/* Host stand-in for the IOP thbase.h. */
+
+#define TH_C	0x02000000
+
+typedef struct _iop_thread {
+	u32	attr;
+	u32	option;
+	void	*thread;
+	u32	stacksize;
+	u32	priority;
+} iop_thread_t;
+
+int CreateThread(iop_thread_t *thread);
+int StartThread(int thid, void *arg);
+int GetThreadId(void);
@@ -0,0 +1,292 @@
+/*
+ * Host simulation of the stream data path of the ps2ips RPC server.
+ *
+ * ps2ips.c is built against a fake lwIP socket, which returns random amounts
+ * of a known byte stream and sometimes sends short, and a SIF that copies
+ * immediately. The EE side is played by this program: it makes recv and send
+ * calls with random sizes, misaligned buffers and MSG_PEEK, applies the rests
+ * packet as the EE end function does, and checks every byte and the bytes
+ * around the buffer. Datagram sockets and a failed recv are checked as well.
+ * Finally 2 MB are moved each way with 64 KB EE buffers and the RPC counts
+ * from PS2IPS_ID_GETSTATS are printed.
+ *
+ * Build and run from the root of the tree. ps2ips.c keeps EE addresses in int
+ * and reads the DNS packet through casts of the RPC buffer, hence the -Wno
+ * options:
+ *
+ *   gcc -O2 -Wall -Wno-pointer-to-int-cast -Wno-strict-aliasing -D_IOP -DPS2IP_DNS \
+ *       -Iiop/tcpip/tcpips/test/host -Iiop/tcpip/tcpip/include -Icommon/include \
+ *       iop/tcpip/tcpips/test/ps2ips_sim.c -o ps2ips_sim
+ *   ./ps2ips_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _start ps2ips_start
+#include "../src/ps2ips.c"
+#undef _start
+
+#define STREAM_SIZE	(2 * 1024 * 1024)
+
+/* The socket */
+static u8 stream[STREAM_SIZE];
+static int rx_pos, rx_len, tx_pos, sock_type = SOCK_STREAM, fail_recv = 0;
+static u8 tx_sink[STREAM_SIZE];
+
+/* The EE */
+static u8 ee_mem[1 << 20] __attribute__((aligned(64)));
+static rests_pkt intr_data __attribute__((aligned(64)));
+
+int lwip_recv(int s, void *mem, int len, unsigned int flags)
+{
+	int n, avail = rx_len - rx_pos;
+
+	if(fail_recv)
+		return -1;
+
+	if(avail == 0 || ((flags & MSG_DONTWAIT) && rand() % 4 == 0))
+		return (flags & MSG_DONTWAIT) ? -1 : 0;
+
+	// mostly full segments, sometimes small ones
+	n = (rand() % 3 == 0) ? 1 + rand() % 70 : 1 + rand() % 3000;
+	n = MIN(n, MIN(avail, len));
+
+	memcpy(mem, stream + rx_pos, n);
+	if(!(flags & MSG_PEEK))
+		rx_pos += n;
+
+	return n;
+}
+
+int lwip_recvfrom(int s, void *mem, int len, unsigned int flags, struct sockaddr *from, socklen_t *fromlen)
+{
+	return lwip_recv(s, mem, len, flags);
+}
+
+int lwip_send(int s, void *dataptr, int size, unsigned int flags)
+{
+	int n = (rand() % 50 == 0) ? size / 2 : size;
+
+	memcpy(tx_sink + tx_pos, dataptr, n);
+	tx_pos += n;
+
+	return n;
+}
+
+int lwip_sendto(int s, void *dataptr, int size, unsigned int flags, struct sockaddr *to, socklen_t tolen)
+{
+	return lwip_send(s, dataptr, size, flags);
+}
+
+int lwip_getsockopt(int s, int level, int optname, void *optval, socklen_t *optlen)
+{
+	*(int *)optval = sock_type;
+	return 0;
+}
+
+int lwip_accept(int s, struct sockaddr *addr, socklen_t *addrlen) { return -1; }
+int lwip_bind(int s, struct sockaddr *name, socklen_t namelen) { return -1; }
+int lwip_close(int s) { return -1; }
+int lwip_connect(int s, struct sockaddr *name, socklen_t namelen) { return -1; }
+int lwip_listen(int s, int backlog) { return -1; }
+int lwip_socket(int domain, int type, int protocol) { return -1; }
+int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout) { return -1; }
+int lwip_ioctl(int s, long cmd, void *argp) { return -1; }
+int lwip_getpeername(int s, struct sockaddr *name, socklen_t *namelen) { return -1; }
+int lwip_getsockname(int s, struct sockaddr *name, socklen_t *namelen) { return -1; }
+int lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t optlen) { return -1; }
+int ps2ip_setconfig(const t_ip_info *ip_info) { return 0; }
+int ps2ip_getconfig(char *netif_name, t_ip_info *ip_info) { return 0; }
+struct hostent *lwip_gethostbyname(const char *name) { return NULL; }
+void dns_setserver(u8 numdns, const ip_addr_t *dnsserver) { }
+const ip_addr_t *dns_getserver(u8 numdns) { return NULL; }
+
+/* The SIF and the kernel */
+int SifSetDma(SifDmaTransfer_t *dmat, int count)
+{
+	static int id = 0;
+	int i;
+
+	for(i = 0; i < count; i++)
+		memcpy(dmat[i].dest, dmat[i].src, dmat[i].size);
+
+	return ++id;
+}
+
+int SifDmaStat(int trid) { return -1; }
+
+int SifRpcGetOtherData(SifRpcReceiveData_t *rd, void *src, void *dest, int size, int mode)
+{
+	if((long)src & 15)
+	{
+		printf("FAIL: misaligned fetch from the EE\n");
+		exit(1);
+	}
+
+	memcpy(dest, src, (size + 15) & ~15);
+	return 0;
+}
+
+int SifCheckStatRpc(SifRpcClientData_t *cd) { return 0; }
+void SifSetRpcQueue(SifRpcDataQueue_t *q, int thread_id) { }
+void SifRegisterRpc(SifRpcServerData_t *sd, int sid, SifRpcFunc_t func, void *buff, SifRpcFunc_t cfunc, void *cbuff, SifRpcDataQueue_t *qd) { }
+void SifRpcLoop(SifRpcDataQueue_t *qd) { }
+int CpuSuspendIntr(int *state) { return 0; }
+int CpuResumeIntr(int state) { return 0; }
+int CreateThread(iop_thread_t *thread) { return -1; }
+int StartThread(int thid, void *arg) { return 0; }
+int GetThreadId(void) { return 0; }
+
+static int fail(const char *what, int round)
+{
+	printf("FAIL: %s in round %d\n", what, round);
+	return 1;
+}
+
+/* recv() as the EE client does it, including the end function that copies the rests. */
+static int ee_recv(u8 *buf, int len, int flags)
+{
+	union { s_recv_pkt s; r_recv_pkt r; int words[512]; } pkt;
+	int i;
+
+	pkt.s.socket = 1;
+	pkt.s.length = len;
+	pkt.s.flags = flags;
+	pkt.s.ee_addr = buf;
+	pkt.s.intr_data = &intr_data;
+
+	rpcHandlerFunction(PS2IPS_ID_RECV, &pkt, sizeof(pkt));
+
+	for(i = 0; i < intr_data.ssize; i++)
+		intr_data.sbuf[i] = intr_data.sbuffer[i];
+	for(i = 0; i < intr_data.esize; i++)
+		intr_data.ebuf[i] = intr_data.ebuffer[i];
+
+	return pkt.r.ret;
+}
+
+/* send() as the EE client does it, with the misaligned head in the packet. */
+static int ee_send(u8 *buf, int len)
+{
+	union { send_pkt s; int words[512]; } pkt;
+	int miss = ((long)buf & 0x3f) ? 64 - ((long)buf & 0x3f) : 0;
+
+	pkt.s.socket = 1;
+	pkt.s.length = len;
+	pkt.s.flags = 0;
+	pkt.s.ee_addr = buf;
+	pkt.s.malign = MIN(miss, len);
+	memcpy(pkt.s.malign_buff, buf, pkt.s.malign);
+
+	rpcHandlerFunction(PS2IPS_ID_SEND, &pkt, sizeof(pkt));
+
+	return pkt.words[0];
+}
+
+int main(void)
+{
+	t_ps2ips_stats stats;
+	int round, offset, len, got, ret, peek, sent;
+
+	srand(1);
+
+	for(got = 0; got < STREAM_SIZE; got++)
+		stream[got] = got * 7 + (got >> 8);
+
+	// Random recv and send calls on a stream socket
+	for(round = 0; round < 200; round++)
+	{
+		rx_pos = 0;
+		rx_len = 64 * 1024 + rand() % 1024;
+
+		for(got = 0; got < rx_len; )
+		{
+			offset = rand() % 64;
+			len = 1 + rand() % ((rand() % 2) ? 100 : 20000);
+			peek = (rand() % 10 == 0) ? MSG_PEEK : 0;
+
+			memset(ee_mem, 0xAA, offset + len + 128);
+
+			if((ret = ee_recv(ee_mem + offset, len, peek)) <= 0)
+				return fail("recv returned nothing", round);
+
+			if(ret > len || memcmp(ee_mem + offset, stream + got, ret))
+				return fail("recv data", round);
+
+			if(ee_mem[offset + ret] != 0xAA || (offset > 0 && ee_mem[offset - 1] != 0xAA))
+				return fail("recv wrote outside the buffer", round);
+
+			if(!peek)
+				got += ret;
+		}
+
+		offset = rand() % 64;
+		len = 1 + rand() % 100000;
+		memcpy(ee_mem + offset, stream, len);
+
+		for(tx_pos = 0, sent = 0; sent < len; sent += ret)
+		{
+			if((ret = ee_send(ee_mem + offset + sent, len - sent)) <= 0)
+				return fail("send returned nothing", round);
+		}
+
+		if(tx_pos != len || memcmp(tx_sink, stream, len))
+			return fail("send data", round);
+	}
+
+	// A datagram socket is read in a single chunk
+	sock_type = SOCK_DGRAM;
+	rx_pos = 0;
+	rx_len = 20000;
+
+	if((ret = ee_recv(ee_mem, 20000, 0)) > BUFF_SIZE)
+		return fail("datagram recv of several chunks", 0);
+
+	// A failed recv sends back empty rests
+	sock_type = SOCK_STREAM;
+	fail_recv = 1;
+	intr_data.ssize = intr_data.esize = 1;
+
+	if(ee_recv(ee_mem + 3, 10000, 0) >= 0 || intr_data.ssize != 0 || intr_data.esize != 0)
+		return fail("failed recv", 0);
+
+	fail_recv = 0;
+
+	// 2 MB each way with 64 KB buffers
+	rpcHandlerFunction(PS2IPS_ID_GETSTATS, &stats, sizeof(stats));
+
+	rx_pos = 0;
+	rx_len = STREAM_SIZE;
+
+	for(got = 0; got < STREAM_SIZE; got += ret)
+	{
+		if((ret = ee_recv(ee_mem, 64 * 1024, 0)) <= 0 || memcmp(ee_mem, stream + got, ret))
+			return fail("recv data", 0);
+	}
+
+	for(tx_pos = 0, sent = 0; sent < STREAM_SIZE; sent += ret)
+	{
+		memcpy(ee_mem, stream + sent, MIN(64 * 1024, STREAM_SIZE - sent));
+		if((ret = ee_send(ee_mem, MIN(64 * 1024, STREAM_SIZE - sent))) <= 0)
+			return fail("send returned nothing", 0);
+	}
+
+	if(tx_pos != STREAM_SIZE || memcmp(tx_sink, stream, STREAM_SIZE))
+		return fail("send data", 0);
+
+	rpcHandlerFunction(PS2IPS_ID_GETSTATS, &stats, sizeof(stats));
+
+	/* u32 is unsigned long with _IOP on the host.  */
+	printf("recv: %lu bytes in %lu RPCs and %lu lwIP calls, %lu bytes per RPC\n",
+		(unsigned long)stats.recv_bytes, (unsigned long)stats.recv_rpcs, (unsigned long)stats.recv_chunks,
+		(unsigned long)(stats.recv_bytes / stats.recv_rpcs));
+	printf("send: %lu bytes in %lu RPCs and %lu lwIP calls, %lu bytes per RPC\n",
+		(unsigned long)stats.send_bytes, (unsigned long)stats.send_rpcs, (unsigned long)stats.send_chunks,
+		(unsigned long)(stats.send_bytes / stats.send_rpcs));
+
+	printf("OK\n");
+
+	return 0;
+}
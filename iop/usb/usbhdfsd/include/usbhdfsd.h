@@ -34,13 +34,16 @@ typedef struct _cache_set cache_set;
 struct _mass_dev;
 typedef struct _mass_dev mass_dev;
 
-//number of cache slots (1 slot = block)
+//default number of cache slots (1 slot = block)
 #define CACHE_SIZE 32
+//maximum number of cache slots, settable with USBMASS_DEVCTL_SET_CACHE_SIZE
+#define CACHE_SIZE_MAX 256
 
 typedef struct _cache_record
 {
 	unsigned int sector;
-	int tax;
+	short hnext;		//next slot in the same hash chain
+	char ref;			//referenced since the clock hand last passed
 	char writeDirty;
 } cache_record;
 
@@ -50,13 +53,18 @@ struct _cache_set
 	unsigned int sectorSize;
 	unsigned int indexLimit;
 	unsigned char* sectorBuf; // = NULL;		//sector content - the cache buffer
-	cache_record rec[CACHE_SIZE];	//cache info record
+	cache_record* rec;		//cache info records
+	short* hash;			//hash chain heads, keyed by block number
+	unsigned int cacheSize;	//number of slots
+	unsigned int hashMask;
+	unsigned int clockHand;	//next slot to be considered for replacement
 
-#ifdef SCACHE_RECORD_STATS
 	//statistical information
 	unsigned int cacheAccess;
 	unsigned int cacheHits;
-#endif
+	unsigned int cacheEvictions;
+	unsigned int cacheWritebacks;
+
 	unsigned int writeFlag;
 };
 
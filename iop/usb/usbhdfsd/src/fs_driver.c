@@ -31,6 +31,7 @@
 
 #include <usbhdfsd.h>
 #include "usbhd_common.h"
+#include "scache.h"
 #include "fat_driver.h"
 #include "fat_write.h"
 #include "fat.h"
@@ -785,6 +786,34 @@ static int fs_devctl(iop_file_t *fd, const char *name, int cmd, void *arg, unsig
 			mass_store_stop_all();
 			ret = 0;
 			break;
+		case USBMASS_DEVCTL_GET_CACHE_STATS:
+			fatd = fat_getData(fd->unit);
+			if (fatd == NULL)
+				ret = -ENODEV;
+			else if (buf == NULL || buflen < sizeof(struct usbmass_cache_stats))
+				ret = -EINVAL;
+			else {
+				scache_getStats(fatd->dev->cache, buf);
+				ret = 0;
+			}
+			break;
+		case USBMASS_DEVCTL_RESET_CACHE_STATS:
+			fatd = fat_getData(fd->unit);
+			if (fatd != NULL) {
+				scache_resetStats(fatd->dev->cache);
+				ret = 0;
+			} else
+				ret = -ENODEV;
+			break;
+		case USBMASS_DEVCTL_SET_CACHE_SIZE:
+			fatd = fat_getData(fd->unit);
+			if (fatd == NULL)
+				ret = -ENODEV;
+			else if (arg == NULL || arglen < sizeof(unsigned int))
+				ret = -EINVAL;
+			else
+				ret = scache_setSize(fatd->dev->cache, *(unsigned int *)arg);
+			break;
 		default:
 			ret = -ENXIO;
 	}
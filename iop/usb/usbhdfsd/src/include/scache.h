@@ -10,6 +10,10 @@ int  scache_writeSector(cache_set* cache, unsigned int sector);
 int  scache_flushSectors(cache_set* cache);
 void scache_invalidate(cache_set* cache, unsigned int sector, int count);
 
+int  scache_setSize(cache_set* cache, unsigned int size);
+
 void scache_getStat(cache_set* cache, unsigned int* access, unsigned int* hits);
+void scache_getStats(cache_set* cache, struct usbmass_cache_stats* stats);
+void scache_resetStats(cache_set* cache);
 
 #endif
@@ -13,6 +13,7 @@
  */
 //---------------------------------------------------------------------------
 #include <stdio.h>
+#include <errno.h>
 
 #ifdef WIN32
 #include <malloc.h>
@@ -24,8 +25,6 @@
 #include <sysmem.h>
 #endif
 
-//#define SCACHE_RECORD_STATS	1
-
 #include <usbhdfsd.h>
 #include "usbhd_common.h"
 #include "mass_stor.h"
@@ -43,20 +42,64 @@
 //when the flushCounter reaches FLUSH_TRIGGER then flushSectors is called
 //#define FLUSH_TRIGGER 16
 
+#define SECTOR_INVALID	0xFFFFFFF0
+#define SLOT_NONE		-1
+
 static int scache_flushSector(cache_set* cache, int index);
 
+//---------------------------------------------------------------------------
+static unsigned int getHash(cache_set* cache, unsigned int alignedSector)
+{
+	unsigned int block;
+
+	block = alignedSector / cache->indexLimit;
+	return (block ^ (block >> 8)) & cache->hashMask;
+}
+
+//---------------------------------------------------------------------------
+static void hashRemove(cache_set* cache, int index)
+{
+	short *link;
+
+	if (cache->rec[index].sector == SECTOR_INVALID)
+		return;
+
+	for (link = &cache->hash[getHash(cache, cache->rec[index].sector)]; *link != SLOT_NONE; link = &cache->rec[*link].hnext) {
+		if (*link == index) {
+			*link = cache->rec[index].hnext;
+			break;
+		}
+	}
+	cache->rec[index].hnext = SLOT_NONE;
+}
+
+//---------------------------------------------------------------------------
+static void hashInsert(cache_set* cache, int index)
+{
+	short *head;
+
+	head = &cache->hash[getHash(cache, cache->rec[index].sector)];
+	cache->rec[index].hnext = *head;
+	*head = index;
+}
+
 //---------------------------------------------------------------------------
 static void initRecords(cache_set* cache)
 {
 	unsigned int i;
 
-	for (i = 0; i < CACHE_SIZE; i++)
+	for (i = 0; i < cache->cacheSize; i++)
 	{
-		cache->rec[i].sector = 0xFFFFFFF0;
-		cache->rec[i].tax = 0;
+		cache->rec[i].sector = SECTOR_INVALID;
+		cache->rec[i].hnext = SLOT_NONE;
+		cache->rec[i].ref = 0;
 		cache->rec[i].writeDirty = 0;
 	}
 
+	for (i = 0; i <= cache->hashMask; i++)
+		cache->hash[i] = SLOT_NONE;
+
+	cache->clockHand = 0;
 	cache->writeFlag = 0;
 }
 
@@ -65,10 +108,12 @@ static void initRecords(cache_set* cache)
   returns cache record (slot) number
  */
 static int getSlot(cache_set* cache, unsigned int sector) {
+	unsigned int alignedSector;
 	int i;
 
-	for (i = 0; i < CACHE_SIZE; i++) {
-		if (sector >= cache->rec[i].sector && sector < (cache->rec[i].sector + cache->indexLimit)) {
+	alignedSector = (sector/cache->indexLimit)*cache->indexLimit;
+	for (i = cache->hash[getHash(cache, alignedSector)]; i != SLOT_NONE; i = cache->rec[i].hnext) {
+		if (cache->rec[i].sector == alignedSector) {
 			return i;
 		}
 	}
@@ -78,35 +123,30 @@ static int getSlot(cache_set* cache, unsigned int sector) {
 //---------------------------------------------------------------------------
 /* search cache records for the sector number stored in cache */
 static int getIndexRead(cache_set* cache, unsigned int sector) {
-	unsigned int i;
-	int index =-1;
+	int index;
 
-	for (i = 0; i < CACHE_SIZE; i++) {
-		if (sector >= cache->rec[i].sector && sector < (cache->rec[i].sector + cache->indexLimit)) {
-			if (cache->rec[i].tax < 0) cache->rec[i].tax = 0;
-			cache->rec[i].tax +=2;
-			index = i;
-		}
-		cache->rec[i].tax--;     //apply tax penalty
-	}
+	index = getSlot(cache, sector);
 	if (index < 0)
 		return index;
-	else
-		return ((index * cache->indexLimit) + (sector - cache->rec[index].sector));
+
+	cache->rec[index].ref = 1;
+	return ((index * cache->indexLimit) + (sector - cache->rec[index].sector));
 }
 
 //---------------------------------------------------------------------------
-/* select the best record where to store new sector */
+/* select the best record where to store new sector (CLOCK replacement) */
 static int getIndexWrite(cache_set* cache, unsigned int sector) {
 	int ret;
-	int minTax = 0x0FFFFFFF;
-	unsigned int i, index = 0;
+	unsigned int index;
 
-	for (i = 0; i < CACHE_SIZE; i++) {
-		if (cache->rec[i].tax < minTax) {
-			index = i;
-			minTax = cache->rec[i].tax;
-		}
+	//Give every referenced slot a second chance. Terminates within two sweeps.
+	for (;;) {
+		index = cache->clockHand;
+		cache->clockHand = (cache->clockHand + 1) % cache->cacheSize;
+
+		if (!cache->rec[index].ref)
+			break;
+		cache->rec[index].ref = 0;
 	}
 
 	//this sector is dirty - we need to flush it first
@@ -114,8 +154,14 @@ static int getIndexWrite(cache_set* cache, unsigned int sector) {
 	if (ret != 1)
 		return ret;
 
-	cache->rec[index].tax +=2;
+	if (cache->rec[index].sector != SECTOR_INVALID) {
+		cache->cacheEvictions++;
+		hashRemove(cache, index);
+	}
+
+	cache->rec[index].ref = 1;
 	cache->rec[index].sector = sector;
+	hashInsert(cache, index);
 
 	return index * cache->indexLimit;
 }
@@ -136,6 +182,7 @@ static int scache_flushSector(cache_set* cache, int index) {
 		}
 
 		cache->rec[index].writeDirty = 0;
+		cache->cacheWritebacks++;
 	}
 	return 1;
 }
@@ -152,7 +199,7 @@ int scache_flushSectors(cache_set* cache) {
 		return 0;
 	}
 
-	for (i = 0; i < CACHE_SIZE; i++) {
+	for (i = 0; i < cache->cacheSize; i++) {
 		if((ret = scache_flushSector(cache, i)) >= 0)
 			counter ++;
 		else
@@ -174,15 +221,11 @@ int scache_readSector(cache_set* cache, unsigned int sector, void** buf) {
 		return -1;
 	}
 
-#ifdef SCACHE_RECORD_STATS
 	cache->cacheAccess ++;
-#endif
 	index = getIndexRead(cache, sector);
 	XPRINTF("cache: indexRead=%i \n", index);
 	if (index >= 0) { //sector found in cache
-#ifdef SCACHE_RECORD_STATS
 		cache->cacheHits ++;
-#endif
 		*buf = cache->sectorBuf + (index * cache->sectorSize);
 		XPRINTF("cache: hit and done reading sector \n");
 
@@ -258,8 +301,7 @@ int scache_writeSector(cache_set* cache, unsigned int sector) {
 	}
 	XPRINTF("cache: slotFound=%i \n", index);
 
-	//prefere written sectors to stay in cache longer than read sectors
-	cache->rec[index].tax += 2;
+	cache->rec[index].ref = 1;
 
 	//set dirty status
 	cache->rec[index].writeDirty = 1;
@@ -288,13 +330,65 @@ void scache_invalidate(cache_set* cache, unsigned int sector, int count) {
 		if (index >=  0) { //sector found in cache. Write back and invalidate the block it belongs to.
 			scache_flushSector(cache, index);
 
-			cache->rec[index].sector = 0xFFFFFFF0;
-			cache->rec[index].tax = 0;
+			hashRemove(cache, index);
+			cache->rec[index].sector = SECTOR_INVALID;
+			cache->rec[index].ref = 0;
 			cache->rec[index].writeDirty = 0;
 		}
 	}
 }
 
+//---------------------------------------------------------------------------
+static void freeSlots(cache_set* cache)
+{
+	if(cache->sectorBuf != NULL)
+	{
+		free(cache->sectorBuf);
+		cache->sectorBuf = NULL;
+	}
+	if(cache->rec != NULL)
+	{
+		free(cache->rec);
+		cache->rec = NULL;
+	}
+}
+
+//---------------------------------------------------------------------------
+/* Allocates the slots for a cache of the given size, then releases the previous ones. On failure,
+   the cache keeps its previous slots and contents. */
+static int allocSlots(cache_set* cache, unsigned int size)
+{
+	unsigned char* sectorBuf;
+	cache_record* rec;
+	unsigned int hashSize;
+
+	for (hashSize = 16; hashSize < size * 2; hashSize <<= 1);
+
+	sectorBuf = (unsigned char*) malloc(BLOCK_SIZE * size);
+	if (sectorBuf == NULL) {
+		printf("Sector cache: can't alloate memory of size:%d \n", BLOCK_SIZE * size);
+		return -1;
+	}
+	XPRINTF("Sector cache: allocated memory at:%p of size:%d \n", sectorBuf, BLOCK_SIZE * size);
+
+	rec = (cache_record*) malloc(sizeof(cache_record) * size + sizeof(short) * hashSize);
+	if (rec == NULL) {
+		printf("Sector cache: can't alloate cache records\n");
+		free(sectorBuf);
+		return -1;
+	}
+
+	freeSlots(cache);
+	cache->sectorBuf = sectorBuf;
+	cache->rec = rec;
+	cache->hash = (short*)(rec + size);
+
+	cache->cacheSize = size;
+	cache->hashMask = hashSize - 1;
+	initRecords(cache);
+	return 0;
+}
+
 //---------------------------------------------------------------------------
 cache_set* scache_init(mass_dev* dev, int sectSize)
 {
@@ -309,43 +403,71 @@ cache_set* scache_init(mass_dev* dev, int sectSize)
 
 	XPRINTF("scache init! \n");
 	cache->dev = dev;
-
-	cache->sectorBuf = (unsigned char*) malloc(BLOCK_SIZE * CACHE_SIZE);
-	if (cache->sectorBuf == NULL) {
-		printf("Sector cache: can't alloate memory of size:%d \n", BLOCK_SIZE * CACHE_SIZE);
-		free(cache);
-		return NULL;
-	}
-	XPRINTF("Sector cache: allocated memory at:%p of size:%d \n", cache->sectorBuf, BLOCK_SIZE * CACHE_SIZE);
+	cache->sectorBuf = NULL;
+	cache->rec = NULL;
 
 	//added by Hermes
 	cache->sectorSize = sectSize;
 	cache->indexLimit = BLOCK_SIZE/cache->sectorSize; //number of sectors per 1 cache slot
-#ifdef SCACHE_RECORD_STATS
 	cache->cacheAccess = 0;
 	cache->cacheHits = 0;
-#endif
-	initRecords(cache);
+	cache->cacheEvictions = 0;
+	cache->cacheWritebacks = 0;
+
+	if (allocSlots(cache, CACHE_SIZE) != 0) {
+		free(cache);
+		return NULL;
+	}
 	return cache;
 }
 
-#ifdef SCACHE_RECORD_STATS
+//---------------------------------------------------------------------------
+/* Changes the number of cache slots. Dirty blocks are written back and the cache is emptied.
+   If the new size cannot be allocated, the cache keeps its previous size. */
+int scache_setSize(cache_set* cache, unsigned int size)
+{
+	int ret;
+
+	if (size < 1 || size > CACHE_SIZE_MAX)
+		return -EINVAL;
+
+	if ((ret = scache_flushSectors(cache)) < 0)
+		return ret;
+
+	if (allocSlots(cache, size) != 0)
+		return -ENOMEM;
+
+	return 0;
+}
+
 //---------------------------------------------------------------------------
 void scache_getStat(cache_set* cache, unsigned int* access, unsigned int* hits) {
 	*access = cache->cacheAccess;
 	*hits = cache->cacheHits;
 }
-#endif
+
+//---------------------------------------------------------------------------
+void scache_getStats(cache_set* cache, struct usbmass_cache_stats* stats) {
+	stats->size = cache->cacheSize;
+	stats->accesses = cache->cacheAccess;
+	stats->hits = cache->cacheHits;
+	stats->evictions = cache->cacheEvictions;
+	stats->writebacks = cache->cacheWritebacks;
+}
+
+//---------------------------------------------------------------------------
+void scache_resetStats(cache_set* cache) {
+	cache->cacheAccess = 0;
+	cache->cacheHits = 0;
+	cache->cacheEvictions = 0;
+	cache->cacheWritebacks = 0;
+}
 
 //---------------------------------------------------------------------------
 void scache_kill(cache_set* cache) //dlanor: added for disconnection events (flush impossible)
 {
 	XPRINTF("cache: kill devId = %i \n", cache->dev->devId);
-	if(cache->sectorBuf != NULL)
-	{
-		free(cache->sectorBuf);
-		cache->sectorBuf = NULL;
-	}
+	freeSlots(cache);
 	free(cache);
 }
 //---------------------------------------------------------------------------
@@ -0,0 +1,278 @@
+//---------------------------------------------------------------------------
+//File name:    scache_replay.c
+//---------------------------------------------------------------------------
+/*
+ * Host trace replay for the sector cache (scache.c).
+ *
+ * The cache runs on top of an in-memory disk. Every sector returned by the cache
+ * is checked against a shadow copy of the disk, and the disk is compared with
+ * the shadow copy after the final flush. For each cache size the replay prints
+ * the hit rate, evictions, write-backs, the number of device transfers and the
+ * time per access.
+ *
+ * Build and run from the root of the tree:
+ *
+ *   gcc -O2 -DWIN32 -Iiop/usb/usbhdfsd/test/host -Iiop/usb/usbhdfsd/include \
+ *       -Iiop/usb/usbhdfsd/src/include -idirafter common/include \
+ *       iop/usb/usbhdfsd/test/scache_replay.c iop/usb/usbhdfsd/src/scache.c -o scache_replay
+ *   ./scache_replay [trace]
+ *
+ * The replacement policy from before the hashed CLOCK cache, which has a fixed
+ * size of CACHE_SIZE slots, is replayed for comparison with its own headers:
+ *
+ *   mkdir -p scache_old
+ *   git show 22ecac1:iop/usb/usbhdfsd/include/usbhdfsd.h > scache_old/usbhdfsd.h
+ *   git show 22ecac1:iop/usb/usbhdfsd/src/include/scache.h > scache_old/scache.h
+ *   git show 22ecac1:iop/usb/usbhdfsd/src/scache.c > scache_old/scache.c
+ *   gcc -O2 -DWIN32 -DOLD_SCACHE -DSCACHE_RECORD_STATS -Iscache_old -Iiop/usb/usbhdfsd/test/host \
+ *       -Iiop/usb/usbhdfsd/src/include -idirafter common/include \
+ *       iop/usb/usbhdfsd/test/scache_replay.c scache_old/scache.c -o scache_replay_old
+ *   ./scache_replay_old [trace]
+ *
+ * A trace has one access per line: "r <sector>", "w <sector>" or "f" (flush).
+ * Without one, a FAT-like workload is generated: files are read cluster by
+ * cluster with a FAT lookup per cluster, directory sectors are searched before
+ * each file, every 16th cluster updates the FAT and every third file is one of
+ * the files before it again.
+ */
+//---------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <usbhdfsd.h>
+#include "usbhd_common.h"
+#include "mass_stor.h"
+#include "scache.h"
+
+#define SECTOR_SIZE	512
+#define DISK_SECTORS	(64 * 1024)	//32MB
+#define TRACE_MAX	(1024 * 1024)
+
+#define FAT_START	32
+#define FAT_SECTORS	256
+#define DIR_START	(FAT_START + FAT_SECTORS)
+#define DIR_SECTORS	32
+#define DATA_START	(DIR_START + DIR_SECTORS)
+#define CLUSTER_SECTORS	8
+
+typedef struct _trace_op {
+	char op;
+	unsigned int sector;
+} trace_op;
+
+static unsigned char *disk, *shadow;
+static unsigned int devReads, devWrites;
+static trace_op *trace;
+static int traceLen;
+
+static double seconds(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//---------------------------------------------------------------------------
+int mass_stor_readSector(mass_dev* dev, unsigned int sector, unsigned char* buffer, unsigned short int count)
+{
+	if (sector + count > DISK_SECTORS)
+		return -1;
+
+	memcpy(buffer, disk + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+	devReads++;
+	return count;
+}
+
+int mass_stor_writeSector(mass_dev* dev, unsigned int sector, const unsigned char* buffer, unsigned short int count)
+{
+	if (sector + count > DISK_SECTORS)
+		return -1;
+
+	memcpy(disk + sector * SECTOR_SIZE, buffer, count * SECTOR_SIZE);
+	devWrites++;
+	return count;
+}
+
+//---------------------------------------------------------------------------
+static void addOp(char op, unsigned int sector)
+{
+	if (traceLen < TRACE_MAX) {
+		trace[traceLen].op = op;
+		trace[traceLen].sector = sector;
+		traceLen++;
+	}
+}
+
+static void generateTrace(void)
+{
+	unsigned int start[64], length[64];
+	unsigned int cluster, i, files, first;
+
+	srand(1);
+	cluster = 2;
+	for (files = 0; files < 64; files++) {
+		//Search the directory for the file.
+		for (i = 0; i < (unsigned int)(rand() % DIR_SECTORS); i++)
+			addOp('r', DIR_START + i);
+
+		//Every third file is one of the last few again, the others are new.
+		if ((files % 3) == 2) {
+			start[files] = start[files - 1 - rand() % 2];
+			length[files] = length[files - 1 - rand() % 2];
+		} else {
+			start[files] = cluster;
+			length[files] = 16 + rand() % 112;
+			cluster += length[files];
+		}
+
+		//Read the file, looking up the next cluster in the FAT each time.
+		first = start[files];
+		for (i = 0; i < length[files]; i++) {
+			addOp('r', FAT_START + ((first + i) * 4) / SECTOR_SIZE);
+			addOp('r', DATA_START + (first + i - 2) * CLUSTER_SECTORS + rand() % CLUSTER_SECTORS);
+
+			if ((i % 16) == 15)
+				addOp('w', FAT_START + ((first + i) * 4) / SECTOR_SIZE);
+		}
+
+		if ((files % 8) == 7)
+			addOp('f', 0);
+	}
+}
+
+static int loadTrace(const char *path)
+{
+	char line[64], op;
+	unsigned int sector;
+	FILE *f;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, " %c %u", &op, &sector) < 1)
+			continue;
+		if (op == 'f')
+			addOp('f', 0);
+		else if ((op == 'r' || op == 'w') && sector < DISK_SECTORS)
+			addOp(op, sector);
+	}
+
+	fclose(f);
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+static int replay(unsigned int size)
+{
+#ifdef OLD_SCACHE
+	unsigned int accesses, hits;
+#else
+	struct usbmass_cache_stats stats;
+#endif
+	mass_dev dev;
+	cache_set *cache;
+	unsigned char *buf;
+	unsigned int i, stamp;
+	double start, elapsed;
+
+	for (i = 0; i < DISK_SECTORS; i++)
+		memset(disk + i * SECTOR_SIZE, i & 0xFF, SECTOR_SIZE);
+	memcpy(shadow, disk, DISK_SECTORS * SECTOR_SIZE);
+	devReads = devWrites = 0;
+
+	memset(&dev, 0, sizeof(dev));
+#ifdef OLD_SCACHE
+	if ((cache = scache_init(&dev, SECTOR_SIZE)) == NULL) {
+#else
+	if ((cache = scache_init(&dev, SECTOR_SIZE)) == NULL || scache_setSize(cache, size) != 0) {
+#endif
+		printf("%u slots: can't create the cache\n", size);
+		return -1;
+	}
+
+	start = seconds();
+	for (i = 0, stamp = 1; i < (unsigned int)traceLen; i++) {
+		if (trace[i].op == 'f') {
+			scache_flushSectors(cache);
+			continue;
+		}
+
+		if (scache_readSector(cache, trace[i].sector, (void**)&buf) != SECTOR_SIZE) {
+			printf("%u slots: read of sector %u failed\n", size, trace[i].sector);
+			return -1;
+		}
+		if (memcmp(buf, shadow + trace[i].sector * SECTOR_SIZE, SECTOR_SIZE) != 0) {
+			printf("%u slots: sector %u has the wrong contents at op %u\n", size, trace[i].sector, i);
+			return -1;
+		}
+
+		if (trace[i].op == 'w') {
+			memcpy(buf, &stamp, sizeof(stamp));
+			memcpy(shadow + trace[i].sector * SECTOR_SIZE, &stamp, sizeof(stamp));
+			stamp++;
+			scache_writeSector(cache, trace[i].sector);
+		}
+	}
+
+	elapsed = seconds() - start;
+
+#ifdef OLD_SCACHE
+	scache_getStat(cache, &accesses, &hits);
+#else
+	scache_getStats(cache, &stats);
+#endif
+	scache_close(cache);
+
+	if (memcmp(disk, shadow, DISK_SECTORS * SECTOR_SIZE) != 0) {
+		printf("%u slots: the disk doesn't match after the final flush\n", size);
+		return -1;
+	}
+
+#ifdef OLD_SCACHE
+	printf("%4u slots: %u reads, %5.1f%% hits, %u device reads, %u device writes, %5.0fns per access\n",
+		size, accesses, accesses ? 100.0 * hits / accesses : 0.0,
+		devReads, devWrites, elapsed * 1e9 / traceLen);
+#else
+	printf("%4u slots: %u reads, %5.1f%% hits, %u evictions, %u write-backs, %u device reads, %u device writes, %5.0fns per access\n",
+		size, stats.accesses, stats.accesses ? 100.0 * stats.hits / stats.accesses : 0.0,
+		stats.evictions, stats.writebacks, devReads, devWrites, elapsed * 1e9 / traceLen);
+#endif
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef OLD_SCACHE
+	static const unsigned int sizes[] = {CACHE_SIZE};
+#else
+	static const unsigned int sizes[] = {8, 16, 32, 64, 128, CACHE_SIZE_MAX};
+#endif
+	unsigned int i;
+
+	disk = malloc(DISK_SECTORS * SECTOR_SIZE);
+	shadow = malloc(DISK_SECTORS * SECTOR_SIZE);
+	trace = malloc(TRACE_MAX * sizeof(trace_op));
+	if (disk == NULL || shadow == NULL || trace == NULL)
+		return 1;
+
+	if (argc > 1) {
+		if (loadTrace(argv[1]) != 0)
+			return 1;
+	} else
+		generateTrace();
+
+	printf("%d accesses\n", traceLen);
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		if (replay(sizes[i]) != 0)
+			return 1;
+	}
+
+	printf("OK\n");
+	return 0;
+}